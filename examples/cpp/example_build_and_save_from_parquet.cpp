@@ -18,11 +18,12 @@ Example sources.json format:
 */
 
 int main(int argc, char** argv) {
-    if (argc != 7) {
+    if (argc != 7 && argc != 8) {
         std::cout << "Usage: " << argv[0] 
-                  << " <sources_json> <column_name> <save_path> <M> <ef_construction> <num_threads>" 
+                  << " <sources_json> <column_name> <save_path> <M> <ef_construction> <num_threads> [float|fp16|bf16]" 
                   << std::endl;
         std::cout << "Note: sources_json should contain an array of parquet file paths" << std::endl;
+        std::cout << "Note: fp16 and bf16 store the vectors with 2 bytes per component, the default is float" << std::endl;
         std::cout << "Example sources.json: [\"path1.parquet\", \"path2.parquet\"]" << std::endl;
         return 1;
     }
@@ -34,6 +35,11 @@ int main(int argc, char** argv) {
     size_t M = std::stoi(argv[4]);
     size_t ef_construction = std::stoi(argv[5]);
     int num_threads = std::stoi(argv[6]);
+    std::string storage = argc == 8 ? argv[7] : "float";
+    if (storage != "float" && storage != "fp16" && storage != "bf16") {
+        std::cerr << "Unknown storage type: " << storage << std::endl;
+        return 1;
+    }
 
     // Read and parse JSON file
     std::vector<std::string> parquet_paths;
@@ -60,8 +66,15 @@ int main(int argc, char** argv) {
         const size_t max_elements = data.GetRowCount();
         
         // Create HNSW index
-        hnswlib::InnerProductSpace space(dim);
-        auto alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, max_elements, M, ef_construction);
+        hnswlib::InnerProductSpace float_space(dim);
+        hnswlib::FP16InnerProductSpace fp16_space(dim);
+        hnswlib::BF16InnerProductSpace bf16_space(dim);
+        hnswlib::BaseHalfSpace<hnswlib::HalfType::FP16>* fp16 = storage == "fp16" ? &fp16_space : nullptr;
+        hnswlib::BaseHalfSpace<hnswlib::HalfType::BF16>* bf16 = storage == "bf16" ? &bf16_space : nullptr;
+        hnswlib::SpaceInterface<float>* space = &float_space;
+        if (fp16) space = fp16;
+        if (bf16) space = bf16;
+        auto alg_hnsw = new hnswlib::HierarchicalNSW<float>(space, max_elements, M, ef_construction);
 
         // Add vector data to HNSW index using multiple threads
         std::atomic<int64_t> current_index(0);
@@ -69,11 +82,20 @@ int main(int argc, char** argv) {
 
         for (int thread_id = 0; thread_id < num_threads; thread_id++) {
             threads.emplace_back([&]() {
+                std::vector<uint16_t> record(dim);
                 while (true) {
                     int64_t i = current_index.fetch_add(1);
                     if (i >= max_elements) break;
                     const float* current_vector = data.GetFloatData(i);
-                    alg_hnsw->addPoint(current_vector, i);
+                    if (fp16) {
+                        fp16->encode(current_vector, record.data());
+                        alg_hnsw->addPoint(record.data(), i);
+                    } else if (bf16) {
+                        bf16->encode(current_vector, record.data());
+                        alg_hnsw->addPoint(record.data(), i);
+                    } else {
+                        alg_hnsw->addPoint(current_vector, i);
+                    }
                 }
             });
         }
@@ -94,6 +116,7 @@ int main(int argc, char** argv) {
                   << "- M: " << M << std::endl
                   << "- ef_construction: " << ef_construction << std::endl
                   << "- Threads used: " << num_threads << std::endl
+                  << "- Storage: " << storage << std::endl
                   << "Index saved to: " << save_path << std::endl;
 
     } catch (const std::exception& e) {
@@ -2,6 +2,9 @@
 #include "DataToCpp/data2cpp/parquet/parquet2cpp.hh"
 #include <nlohmann/json.hpp>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <iostream>
 #include <fstream>
@@ -18,12 +21,14 @@ Example sources.json format:
 */
 
 int main(int argc, char** argv) {
-    if (argc != 8) {
+    if (argc != 8 && argc != 10) {
         std::cout << "Usage: " << argv[0] 
-                  << " <sources_json> <column_name> <save_path> <num_elements> <M> <ef_construction> <num_threads>" 
+                  << " <sources_json> <column_name> <save_path> <num_elements> <M> <ef_construction> <num_threads>"
+                  << " [<checkpoint_path> <checkpoint_interval_seconds>]"
                   << std::endl;
         std::cout << "Note: sources_json should contain an array of parquet file paths" << std::endl;
         std::cout << "Example sources.json: [\"path1.parquet\", \"path2.parquet\"]" << std::endl;
+        std::cout << "Note: with a checkpoint path an interrupted build resumes from its last checkpoint" << std::endl;
         return 1;
     }
 
@@ -35,6 +40,8 @@ int main(int argc, char** argv) {
     size_t M = std::stoi(argv[5]);
     size_t ef_construction = std::stoi(argv[6]);
     int num_threads = std::stoi(argv[7]);
+    std::string checkpoint_path = argc == 10 ? argv[8] : "";
+    int checkpoint_interval = argc == 10 ? std::stoi(argv[9]) : 0;
 
     // Read and parse JSON file
     std::vector<std::string> parquet_paths;
@@ -68,9 +75,22 @@ int main(int argc, char** argv) {
             num_elements = total_elements;
         }
         
-        // Create HNSW index with specified number of elements
+        // Create HNSW index with specified number of elements, or resume it from the checkpoint of an interrupted build
         hnswlib::InnerProductSpace space(dim);
-        auto alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, num_elements, M, ef_construction);
+        hnswlib::HierarchicalNSW<float>* alg_hnsw;
+        if (!checkpoint_path.empty() && std::ifstream(checkpoint_path).good()) {
+            alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space);
+            alg_hnsw->loadCheckpoint(checkpoint_path, &space, num_elements);
+            std::cout << "Resuming from checkpoint with " << alg_hnsw->getCurrentElementCount() << " elements" << std::endl;
+        } else {
+            alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, num_elements, M, ef_construction);
+        }
+
+        // The elements of the checkpoint are skipped
+        std::vector<bool> checkpointed(num_elements, false);
+        for (auto& label_and_id : alg_hnsw->label_lookup_) {
+            if (label_and_id.first < num_elements) checkpointed[label_and_id.first] = true;
+        }
 
         // Add vector data to HNSW index using multiple threads
         std::atomic<int64_t> current_index(0);
@@ -81,16 +101,39 @@ int main(int argc, char** argv) {
                 while (true) {
                     int64_t i = current_index.fetch_add(1);
                     if (i >= num_elements) break;
+                    if (checkpointed[i]) continue;
                     const float* current_vector = data.GetFloatData(i);
                     alg_hnsw->addPoint(current_vector, i);
                 }
             });
         }
 
+        // Write checkpoints periodically while the threads insert
+        std::mutex checkpoint_lock;
+        std::condition_variable checkpoint_cv;
+        bool inserting = true;
+        std::thread checkpointer;
+        if (!checkpoint_path.empty()) {
+            checkpointer = std::thread([&]() {
+                std::unique_lock<std::mutex> lock(checkpoint_lock);
+                while (!checkpoint_cv.wait_for(lock, std::chrono::seconds(checkpoint_interval), [&] { return !inserting; })) {
+                    alg_hnsw->saveCheckpoint(checkpoint_path);
+                }
+            });
+        }
+
         // Wait for all threads to complete
         for (auto& thread : threads) {
             thread.join();
         }
+        if (checkpointer.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(checkpoint_lock);
+                inserting = false;
+            }
+            checkpoint_cv.notify_all();
+            checkpointer.join();
+        }
 
         // Save the index
         alg_hnsw->saveIndex(save_path);
@@ -17,6 +17,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
     size_t data_size_;
     DISTFUNC <dist_t> fstdistfunc_;
     void *dist_func_param_;
+    SpaceInterface<dist_t> *space_{nullptr};
+    bool preprocessing_{false};
     std::mutex index_lock;
 
     std::unordered_map<labeltype, size_t > dict_external_to_internal;
@@ -48,6 +50,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
         dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
+        preprocessing_ = s->has_preprocessing();
         size_per_element_ = data_size_ + sizeof(labeltype);
         data_ = (char *) malloc(maxElements * size_per_element_);
         if (data_ == nullptr)
@@ -79,7 +83,10 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             }
         }
         memcpy(data_ + size_per_element_ * idx + data_size_, &label, sizeof(labeltype));
-        memcpy(data_ + size_per_element_ * idx, datapoint, data_size_);
+        if (preprocessing_)
+            space_->prepare_data(datapoint, data_ + size_per_element_ * idx);
+        else
+            memcpy(data_ + size_per_element_ * idx, datapoint, data_size_);
     }
 
 
@@ -108,6 +115,12 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         assert(k <= cur_element_count);
         std::priority_queue<std::pair<dist_t, labeltype >> topResults;
         if (cur_element_count == 0) return topResults;
+        std::vector<char> prepared;
+        if (preprocessing_) {
+            prepared.resize(space_->get_query_size());
+            space_->prepare_query(query_data, prepared.data());
+            query_data = prepared.data();
+        }
         for (int i = 0; i < k; i++) {
             dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
             labeltype label = *((labeltype*) (data_ + size_per_element_ * i + data_size_));
@@ -160,6 +173,8 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
         dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
+        preprocessing_ = s->has_preprocessing();
         size_per_element_ = data_size_ + sizeof(labeltype);
         data_ = (char *) malloc(maxelements_ * size_per_element_);
         if (data_ == nullptr)
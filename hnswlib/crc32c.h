@@ -0,0 +1,172 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HNSWLIB_CRC32C_HW
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <nmmintrin.h>
+#else
+#include <cpuid.h>
+#include <nmmintrin.h>
+#endif
+#endif
+
+namespace hnswlib {
+
+/*
+* CRC32C (Castagnoli), the checksum of the sections of saved indexes.
+* Uses the SSE4.2 crc32 instruction where the CPU has it and a table otherwise.
+*/
+class CRC32C {
+    static const uint32_t POLY = 0x82F63B78;  // reflected polynomial
+
+    // table[k][b]: CRC of byte b followed by k zero bytes, for slicing by 8
+    struct Table {
+        uint32_t table[8][256];
+
+        Table() {
+            for (uint32_t b = 0; b < 256; b++) {
+                uint32_t crc = b;
+                for (int i = 0; i < 8; i++)
+                    crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+                table[0][b] = crc;
+            }
+            for (uint32_t b = 0; b < 256; b++) {
+                for (int k = 1; k < 8; k++)
+                    table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+            }
+        }
+    };
+
+    static const Table &getTable() {
+        static const Table table;
+        return table;
+    }
+
+    static uint32_t updateSoftware(uint32_t crc, const unsigned char *data, size_t size) {
+        const Table &t = getTable();
+        while (size >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            word ^= crc;
+            crc = t.table[7][word & 0xff] ^ t.table[6][(word >> 8) & 0xff] ^
+                  t.table[5][(word >> 16) & 0xff] ^ t.table[4][(word >> 24) & 0xff] ^
+                  t.table[3][(word >> 32) & 0xff] ^ t.table[2][(word >> 40) & 0xff] ^
+                  t.table[1][(word >> 48) & 0xff] ^ t.table[0][word >> 56];
+            data += 8;
+            size -= 8;
+        }
+        while (size > 0) {
+            crc = (crc >> 8) ^ t.table[0][(crc ^ *data) & 0xff];
+            data++;
+            size--;
+        }
+        return crc;
+    }
+
+#if defined(HNSWLIB_CRC32C_HW)
+    static bool hardwareCapable() {
+        static const bool capable = []() {
+#ifdef _MSC_VER
+            int cpuInfo[4];
+            __cpuid(cpuInfo, 1);
+            return (cpuInfo[2] & (1 << 20)) != 0;
+#else
+            unsigned int eax, ebx, ecx, edx;
+            if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+                return false;
+            return (ecx & (1 << 20)) != 0;
+#endif
+        }();
+        return capable;
+    }
+
+#if defined(__GNUC__)
+    __attribute__((target("sse4.2")))
+#endif
+    static uint32_t updateHardware(uint32_t crc, const unsigned char *data, size_t size) {
+        uint64_t crc64 = crc;
+        while (size >= 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += 8;
+            size -= 8;
+        }
+        crc = (uint32_t) crc64;
+        while (size > 0) {
+            crc = _mm_crc32_u8(crc, *data);
+            data++;
+            size--;
+        }
+        return crc;
+    }
+#endif
+
+    // multiplication of a vector by a 32x32 matrix over GF(2)
+    static uint32_t multiply(const uint32_t *matrix, uint32_t vector) {
+        uint32_t sum = 0;
+        for (int i = 0; vector != 0; i++, vector >>= 1) {
+            if (vector & 1)
+                sum ^= matrix[i];
+        }
+        return sum;
+    }
+
+    static void square(uint32_t *square, const uint32_t *matrix) {
+        for (int i = 0; i < 32; i++)
+            square[i] = multiply(matrix, matrix[i]);
+    }
+
+ public:
+    // CRC of size bytes at data appended to the data of crc (0 for none)
+    static uint32_t update(uint32_t crc, const void *data, size_t size) {
+        crc = ~crc;
+#if defined(HNSWLIB_CRC32C_HW)
+        if (hardwareCapable())
+            return ~updateHardware(crc, (const unsigned char *) data, size);
+#endif
+        return ~updateSoftware(crc, (const unsigned char *) data, size);
+    }
+
+    /*
+    * CRC of the concatenation of two blocks from their CRCs, size2 is the size of the second block.
+    * Lets parts of a section be checksummed in parallel.
+    */
+    static uint32_t combine(uint32_t crc1, uint32_t crc2, size_t size2) {
+        if (size2 == 0)
+            return crc1;
+        uint32_t even[32];  // operator for 2^n zero bits, n even
+        uint32_t odd[32];   // operator for 2^n zero bits, n odd
+
+        // operator for one zero bit
+        odd[0] = POLY;
+        uint32_t row = 1;
+        for (int i = 1; i < 32; i++) {
+            odd[i] = row;
+            row <<= 1;
+        }
+        square(even, odd);  // two zero bits
+        square(odd, even);  // four zero bits
+
+        // apply size2 zero bytes to crc1
+        do {
+            square(even, odd);
+            if (size2 & 1)
+                crc1 = multiply(even, crc1);
+            size2 >>= 1;
+            if (size2 == 0)
+                break;
+            square(odd, even);
+            if (size2 & 1)
+                crc1 = multiply(odd, crc1);
+            size2 >>= 1;
+        } while (size2 != 0);
+        return crc1 ^ crc2;
+    }
+};
+}  // namespace hnswlib
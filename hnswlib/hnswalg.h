@@ -1,6 +1,10 @@
 #pragma once
 
 #include "visited_list_pool.h"
+#include "mapped_file.h"
+#include "index_stream.h"
+#include "crc32c.h"
+#include "thread_pool.h"
 #include "hnswlib.h"
 #include <atomic>
 #include <random>
@@ -9,16 +13,155 @@
 #include <unordered_set>
 #include <list>
 #include <memory>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
 
 namespace hnswlib {
 typedef unsigned int tableint;
 typedef unsigned int linklistsizeint;
 
+static const size_t CACHE_LINE_SIZE = 64;
+
+// Allocates size bytes aligned to the cache line size, returns nullptr on failure
+static void *alignedMalloc(size_t size) {
+    size = std::max((size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE, CACHE_LINE_SIZE);
+#ifdef _WIN32
+    return _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, CACHE_LINE_SIZE, size) != 0)
+        return nullptr;
+    return ptr;
+#endif
+}
+
+static void alignedFree(void *ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// Moves the first old_size bytes of ptr into a new aligned allocation of new_size bytes, ptr is freed on success
+static void *alignedRealloc(void *ptr, size_t old_size, size_t new_size) {
+    void *new_ptr = alignedMalloc(new_size);
+    if (new_ptr == nullptr)
+        return nullptr;
+    if (ptr != nullptr) {
+        memcpy(new_ptr, ptr, std::min(old_size, new_size));
+        alignedFree(ptr);
+    }
+    return new_ptr;
+}
+
+// Orders of the internal ids produced by HierarchicalNSW::reorderIndex
+enum class ReorderStrategy {
+    BFS,     // breadth-first traversal of the base layer from the entry point
+    RCM,     // reverse Cuthill-McKee: breadth-first with neighbors by increasing degree, reversed
+    GORDER   // greedy: next is the element with the most links to the last placed elements (as in Gorder)
+};
+
+// Sections of an index file written by HierarchicalNSW::saveIndex, in the order of the file
+enum class IndexSection : uint32_t {
+    GRAPH = 1,         // level 0 link lists of the elements
+    VECTORS = 2,       // vectors of the elements, padded to the cache line size
+    LABELS = 3,        // labels of the elements
+    UPPER_LAYERS = 4,  // levels of the elements, then their upper-layer link lists back to back
+    DELETED = 5        // internal ids of the elements marked deleted, in increasing order
+};
+
+// Entry of the section table of an index file, stored as 32 bytes in the order of the fields
+struct IndexSectionEntry {
+    uint32_t type;
+    uint32_t crc;     // CRC32C of the section
+    uint64_t offset;  // from the start of the file, a multiple of 64
+    uint64_t size;
+    uint64_t stride;  // bytes per element, 0 for UPPER_LAYERS
+};
+
+// Locks of the link lists of the elements of HierarchicalNSW
+enum class LinkListLockStrategy {
+    MUTEX,    // a std::mutex per element (about 40 bytes each)
+    SPINLOCK  // a spinlock in the unused last byte of the level 0 link list header, needs no extra memory
+};
+
+/*
+* Binary heap with the interface of std::priority_queue that can be emptied without releasing its memory.
+* Elements are pushed and popped with the same heap algorithms as in std::priority_queue, so both
+* produce the same order.
+*/
+template<typename T, typename Compare>
+class ReusableHeap {
+    std::vector<T> c_;
+    Compare comp_;
+
+ public:
+    bool empty() const {
+        return c_.empty();
+    }
+
+    size_t size() const {
+        return c_.size();
+    }
+
+    const T &top() const {
+        return c_.front();
+    }
+
+    template<typename... Args>
+    void emplace(Args&&... args) {
+        c_.emplace_back(std::forward<Args>(args)...);
+        std::push_heap(c_.begin(), c_.end(), comp_);
+    }
+
+    void push(const T &value) {
+        c_.push_back(value);
+        std::push_heap(c_.begin(), c_.end(), comp_);
+    }
+
+    void pop() {
+        std::pop_heap(c_.begin(), c_.end(), comp_);
+        c_.pop_back();
+    }
+
+    void clear() {
+        c_.clear();
+    }
+
+    void reserve(size_t n) {
+        c_.reserve(n);
+    }
+};
+
 template<typename dist_t>
 class HierarchicalNSW : public AlgorithmInterface<dist_t> {
  public:
     static const tableint MAX_LABEL_OPERATION_LOCKS = 65536;
     static const unsigned char DELETE_MARK = 0x01;
+    static const size_t UPPER_LAYER_SEARCH_GROUP_SIZE = 8;  // number of queries whose upper layer search is interleaved
+    static const uint64_t CHECKPOINT_MAGIC = 0x54504b4357534e48ULL;  // "HNSWCKPT"
+    static const uint64_t CHECKPOINT_RECORD_MAGIC = 0x4443455257534e48ULL;  // "HNSWRECD"
+    static const size_t LOAD_RANGE_SIZE = 16 << 20;  // bytes read by one thread at a time in the parallel loadIndex
+    static const uint64_t INDEX_MAGIC = 0x58444e4957534e48ULL;  // "HNSWINDX"
+    static const uint32_t INDEX_VERSION = 1;
+    static const size_t INDEX_NUM_SECTIONS = 5;
+    static const size_t INDEX_SECTION_ALIGNMENT = 64;
+    static const size_t INDEX_SPACE_NAME_SIZE = 32;
+    static const size_t INDEX_FIXED_HEADER_SIZE = 128;  // fields before the section table
+    static const size_t INDEX_SECTION_ENTRY_SIZE = 32;
+    static const size_t INDEX_EMIT_BUFFER_SIZE = 1 << 20;
+    static const size_t SEARCH_COUNTER_STRIPES = 64;
+    static const uint64_t LOG_MAGIC = 0x474f4c4457534e48ULL;  // "HNSWDLOG"
+    static const uint64_t LOG_RECORD_MAGIC = 0x4345524c57534e48ULL;  // "HNSWLREC"
+    static const uint32_t LOG_VERSION = 1;
+    static const size_t LOG_HEADER_SIZE = 16;
+    static const size_t LOG_RECORD_HEADER_SIZE = 32;
+    static const unsigned char LOG_LINKS = 0x01;  // the link lists of an element changed
+    static const unsigned char LOG_DATA = 0x02;  // the vector or the label of an element changed
+    static const size_t LOG_STRIPES = 64;  // lists of changed elements, each with its own lock
+    static const size_t COMPACTION_BATCH_SIZE = 1024;  // elements repaired by a compaction per registration as a writer
 
     size_t max_elements_{0};
     mutable std::atomic<size_t> cur_element_count{0};  // current number of elements
@@ -34,13 +177,23 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     double mult_{0.0}, revSize_{0.0};
     int maxlevel_{0};
 
+    VisitedSetType visited_set_type_{VisitedSetType::DENSE};
     std::unique_ptr<VisitedListPool> visited_list_pool_{nullptr};
 
     // Locks operations with element by label value
     mutable std::vector<std::mutex> label_op_locks_;
 
     std::mutex global;
-    std::vector<std::mutex> link_list_locks_;
+    LinkListLockStrategy lock_strategy_{LinkListLockStrategy::MUTEX};
+    std::vector<std::mutex> link_list_locks_;  // empty with LinkListLockStrategy::SPINLOCK
+
+    /*
+    * Version of the link lists of each element (seqlock), odd while the lists are being rewritten.
+    * Writers change it under the lock of the element, readers with lock_free_reads_ use it to take consistent copies.
+    * Empty until lock-free reads, a checkpoint or a compaction needs it, see enableLinkListVersions.
+    */
+    mutable std::vector<std::atomic<unsigned int>> link_list_versions_;
+    bool lock_free_reads_{false};
 
     tableint enterpoint_node_{0};
 
@@ -48,13 +201,33 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     size_t offsetData_{0}, offsetLevel0_{0}, label_offset_{ 0 };
 
     char *data_level0_memory_{nullptr};
+
+    /*
+    * The base layer is stored either interleaved (the link list, the data and the label of an element follow
+    * each other in data_level0_memory_, as in the index file) or, with soa_layout_, in three separate arrays
+    * aligned to 64 bytes. The separate arrays keep the link lists dense for the graph traversal, and the data
+    * of each element is padded to a multiple of 64 bytes, so every vector starts at an aligned address.
+    * The pointers and strides below describe both layouts and are used by all accessors.
+    */
+    bool soa_layout_{false};
+    char *level0_links_{nullptr}, *level0_data_{nullptr}, *level0_labels_{nullptr};
+    size_t level0_links_stride_{0}, level0_data_stride_{0}, level0_labels_stride_{0};
+
     char **linkLists_{nullptr};
     std::vector<int> element_levels_;  // keeps level of each element
+    // single allocation holding the upper-layer link lists of a loaded index, the lists added later are malloced
+    char *link_list_arena_{nullptr};
+    size_t link_list_arena_size_{0};
 
     size_t data_size_{0};
+    size_t query_size_{0};
 
     DISTFUNC<dist_t> fstdistfunc_;
+    BATCHDISTFUNC<dist_t> fstbatchdistfunc_{nullptr};
     void *dist_func_param_{nullptr};
+    // for the preprocessing of the inserted vectors and the queries, see SpaceInterface::has_preprocessing
+    SpaceInterface<dist_t> *space_{nullptr};
+    bool preprocessing_{false};
 
     mutable std::mutex label_lookup_lock;  // lock for label_lookup_
     std::unordered_map<labeltype, tableint> label_lookup_;
@@ -70,6 +243,80 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     std::mutex deleted_elements_lock;  // lock for deleted_elements
     std::unordered_set<tableint> deleted_elements;  // contains internal ids of deleted elements
 
+    // set when the index was loaded with loadIndexMmap, the index is read-only then
+    std::unique_ptr<MappedFile> mapped_file_{nullptr};
+
+    // created on the first batch operation
+    mutable std::mutex thread_pool_lock_;
+    mutable std::unique_ptr<ThreadPool> thread_pool_{nullptr};
+
+    /*
+    * State of the checkpoints of a build, see saveCheckpoint. Insertions, updates and changes of the deleted marks
+    * register as writers, a checkpoint waits until no writer is active and holds new ones back while it writes.
+    */
+    std::mutex checkpoint_lock_;
+    std::condition_variable checkpoint_cv_;
+    size_t active_writers_{0};
+    bool checkpoint_pending_{false};
+    std::string checkpoint_location_;  // empty if the next checkpoint has to write the whole index
+    std::streamoff checkpoint_file_size_{0};  // end of the last complete record
+    size_t checkpoint_sequence_{0};  // number of records in the file
+    size_t checkpoint_element_count_{0};
+    std::vector<unsigned int> checkpoint_versions_;  // link_list_versions_ at the last checkpoint
+    std::unordered_set<tableint> checkpoint_updated_;  // elements with vectors updated since the last checkpoint
+
+    /*
+    * State of the update log, see startLog. The writers record the elements they change in log_changes_,
+    * a commit writes them as one record while the writers are held back like for a checkpoint.
+    */
+    struct LogChangeStripe {
+        std::mutex lock;
+        std::vector<std::pair<tableint, unsigned char>> changes;  // internal id, LOG_LINKS and/or LOG_DATA
+    };
+    bool log_active_{false};
+    std::string log_index_location_;
+    std::string log_location_;
+    std::unique_ptr<AppendFile> log_file_{nullptr};
+    std::vector<LogChangeStripe> log_changes_;
+    uint64_t log_sequence_{0};  // number of records in the log
+    size_t log_element_count_{0};  // elements at the last commit, the later ones are written whole
+    bool log_compaction_required_{false};  // set when the changes cannot be recorded, e.g. after reorderIndex
+    std::mutex log_lock_;
+    std::condition_variable log_cv_;
+    bool log_committing_{false};
+    uint64_t log_requests_{0};  // calls of commitLog so far
+    uint64_t log_committed_{0};  // calls of commitLog covered by the finished commits
+    std::thread log_commit_thread_;
+    bool log_commit_thread_stop_{false};
+    std::exception_ptr log_commit_exception_;
+
+    /*
+    * State of a compaction, see startCompaction. compaction_removed_ flags the elements that were deleted
+    * when it started, compaction_thread_ repairs the link lists that point to them. While compaction_tracking_
+    * is set the writers flag the elements whose link lists they change in compaction_changed_, only these have
+    * to be repaired again at the end.
+    */
+    std::vector<char> compaction_removed_;
+    std::vector<std::atomic<char>> compaction_changed_;
+    bool compaction_tracking_{false};
+    size_t compaction_num_threads_{0};
+    std::thread compaction_thread_;
+    std::atomic<bool> compaction_stop_{false};
+    std::exception_ptr compaction_exception_;
+
+    // Counter of the searches of the threads mapped to it, padded so threads of different stripes share no cache line
+    struct SearchCounter {
+        std::atomic<size_t> count{0};
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+    };
+
+    // Searches running now, see SearchScope; withSearchesHeldBack stops new ones and waits for these.
+    // Each thread counts on one of the stripes, so concurrent searches do not contend on a shared counter.
+    mutable SearchCounter active_searches_[SEARCH_COUNTER_STRIPES];
+    std::atomic<bool> searches_held_back_{false};
+    mutable std::mutex search_gate_lock_;
+    mutable std::condition_variable search_gate_cv_;
+
 
     HierarchicalNSW(SpaceInterface<dist_t> *s) {
     }
@@ -80,8 +327,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         const std::string &location,
         bool nmslib = false,
         size_t max_elements = 0,
-        bool allow_replace_deleted = false)
-        : allow_replace_deleted_(allow_replace_deleted) {
+        bool allow_replace_deleted = false,
+        bool soa_layout = false,
+        LinkListLockStrategy lock_strategy = LinkListLockStrategy::MUTEX)
+        : lock_strategy_(lock_strategy),
+            soa_layout_(soa_layout),
+            allow_replace_deleted_(allow_replace_deleted) {
         loadIndex(location, s, max_elements);
     }
 
@@ -92,16 +343,24 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         size_t M = 16,
         size_t ef_construction = 200,
         size_t random_seed = 100,
-        bool allow_replace_deleted = false)
+        bool allow_replace_deleted = false,
+        bool soa_layout = false,
+        LinkListLockStrategy lock_strategy = LinkListLockStrategy::MUTEX)
         : label_op_locks_(MAX_LABEL_OPERATION_LOCKS),
-            link_list_locks_(max_elements),
+            lock_strategy_(lock_strategy),
+            link_list_locks_(lock_strategy == LinkListLockStrategy::MUTEX ? max_elements : 0),
+            soa_layout_(soa_layout),
             element_levels_(max_elements),
             allow_replace_deleted_(allow_replace_deleted) {
         max_elements_ = max_elements;
         num_deleted_ = 0;
         data_size_ = s->get_data_size();
+        query_size_ = s->get_query_size();
         fstdistfunc_ = s->get_dist_func();
+        fstbatchdistfunc_ = s->get_batch_dist_func();
         dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
+        preprocessing_ = s->has_preprocessing();
         if ( M <= 10000 ) {
             M_ = M;
         } else {
@@ -123,13 +382,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         label_offset_ = size_links_level0_ + data_size_;
         offsetLevel0_ = 0;
 
-        data_level0_memory_ = (char *) malloc(max_elements_ * size_data_per_element_);
-        if (data_level0_memory_ == nullptr)
+        cur_element_count = 0;
+        if (!reallocLevel0(max_elements_))
             throw std::runtime_error("Not enough memory");
 
-        cur_element_count = 0;
 
-        visited_list_pool_ = std::unique_ptr<VisitedListPool>(new VisitedListPool(1, max_elements));
+        resetVisitedListPool(max_elements);
 
         // initializations for special treatment of the first node
         enterpoint_node_ = -1;
@@ -149,16 +407,127 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
     void clear() {
-        free(data_level0_memory_);
-        data_level0_memory_ = nullptr;
-        for (tableint i = 0; i < cur_element_count; i++) {
-            if (element_levels_[i] > 0)
-                free(linkLists_[i]);
+        cancelCompaction();
+        closeLog();
+        if (!mapped_file_) {
+            free(data_level0_memory_);
+            if (soa_layout_) {
+                alignedFree(level0_links_);
+                alignedFree(level0_data_);
+                alignedFree(level0_labels_);
+            }
+            for (tableint i = 0; i < cur_element_count; i++) {
+                if (element_levels_[i] > 0)
+                    freeLinkList(i);
+            }
+            free(link_list_arena_);
         }
+        link_list_arena_ = nullptr;
+        link_list_arena_size_ = 0;
+        data_level0_memory_ = nullptr;
+        level0_links_ = level0_data_ = level0_labels_ = nullptr;
         free(linkLists_);
         linkLists_ = nullptr;
         cur_element_count = 0;
+        label_lookup_.clear();
+        num_deleted_ = 0;
+        deleted_elements.clear();
         visited_list_pool_.reset(nullptr);
+        mapped_file_.reset(nullptr);
+        checkpoint_location_.clear();
+    }
+
+
+    // Frees the upper-layer link lists of an element unless they are in the arena
+    void freeLinkList(tableint internal_id) {
+        char *link_list = linkLists_[internal_id];
+        if (link_list < link_list_arena_ || link_list >= link_list_arena_ + link_list_arena_size_)
+            free(link_list);
+    }
+
+
+    /*
+    * Allocates the arena for the upper-layer link lists of an index being loaded, returns nullptr on failure.
+    * The index must not have an arena yet.
+    */
+    char *allocLinkListArena(size_t size) {
+        link_list_arena_ = (char *) malloc(std::max(size, (size_t) 1));
+        link_list_arena_size_ = link_list_arena_ ? size : 0;
+        return link_list_arena_;
+    }
+
+
+    /*
+    * Grows (or allocates) the base layer to new_max_elements elements in the current layout,
+    * the first cur_element_count elements are kept. Returns false if the memory cannot be allocated.
+    */
+    bool reallocLevel0(size_t new_max_elements) {
+        if (!soa_layout_) {
+            char *data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
+            if (data_level0_memory_new == nullptr)
+                return false;
+            data_level0_memory_ = data_level0_memory_new;
+            setInterleavedLevel0(data_level0_memory_);
+            return true;
+        }
+
+        size_t links_stride = size_links_level0_;
+        size_t data_stride = (data_size_ + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+        size_t labels_stride = sizeof(labeltype);
+        // the prefetching in the searches reads one id past the end of a link list
+        char *links_new = (char *) alignedRealloc(level0_links_, cur_element_count * links_stride,
+                                                  new_max_elements * links_stride + sizeof(tableint));
+        if (links_new == nullptr)
+            return false;
+        level0_links_ = links_new;
+        char *data_new = (char *) alignedRealloc(level0_data_, cur_element_count * data_stride, new_max_elements * data_stride);
+        if (data_new == nullptr)
+            return false;
+        level0_data_ = data_new;
+        char *labels_new = (char *) alignedRealloc(level0_labels_, cur_element_count * labels_stride, new_max_elements * labels_stride);
+        if (labels_new == nullptr)
+            return false;
+        level0_labels_ = labels_new;
+        level0_links_stride_ = links_stride;
+        level0_data_stride_ = data_stride;
+        level0_labels_stride_ = labels_stride;
+        return true;
+    }
+
+
+    // Points the base layer accessors to interleaved elements starting at level0
+    void setInterleavedLevel0(char *level0) {
+        level0_links_ = level0 + offsetLevel0_;
+        level0_data_ = level0 + offsetData_;
+        level0_labels_ = level0 + label_offset_;
+        level0_links_stride_ = level0_data_stride_ = level0_labels_stride_ = size_data_per_element_;
+    }
+
+
+    // Copies the base layer element internal_id in the interleaved layout of the index file to dst
+    void copyLevel0ElementTo(tableint internal_id, char *dst) const {
+        memcpy(dst + offsetLevel0_, get_linklist0(internal_id), size_links_level0_);
+        memcpy(dst + offsetData_, getDataByInternalId(internal_id), data_size_);
+        memcpy(dst + label_offset_, getExternalLabeLp(internal_id), sizeof(labeltype));
+    }
+
+
+    // Copies an element in the interleaved layout of the index file from src to the base layer element internal_id
+    void copyLevel0ElementFrom(const char *src, tableint internal_id) {
+        memcpy(get_linklist0(internal_id), src + offsetLevel0_, size_links_level0_);
+        memcpy(getDataByInternalId(internal_id), src + offsetData_, data_size_);
+        memcpy(getExternalLabeLp(internal_id), src + label_offset_, sizeof(labeltype));
+    }
+
+
+    bool isReadOnly() const {
+        return mapped_file_ != nullptr;
+    }
+
+
+    void checkWritable() const {
+        if (isReadOnly())
+            throw std::runtime_error("Index is memory-mapped and read-only");
     }
 
 
@@ -170,6 +539,63 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     };
 
 
+    /*
+    * Memory used by a search: the visited list, the candidate queues and the result buffer.
+    * Passing the same context to consecutive searches lets them run without heap allocations once
+    * the buffers have grown to the needed size. A context must not be used by several threads at once.
+    */
+    class SearchContext {
+     public:
+        std::unique_ptr<VisitedList> visited_list{nullptr};
+        ReusableHeap<std::pair<dist_t, tableint>, CompareByFirst> top_candidates;
+        ReusableHeap<std::pair<dist_t, tableint>, CompareByFirst> candidate_set;
+        std::vector<std::pair<dist_t, labeltype>> result;  // closer first
+
+        SearchContext(size_t max_elements = 0, size_t ef = 0, size_t k = 0) {
+            prepare(max_elements, ef, k);
+        }
+
+        // Clears the state of the previous search and makes sure the buffers are big enough
+        void prepare(
+            size_t max_elements,
+            size_t ef,
+            size_t k,
+            VisitedSetType visited_set_type = VisitedSetType::DENSE,
+            size_t expected_visits = 0) {
+            if (!visited_list || visited_list->numelements < max_elements || visited_list->type != visited_set_type) {
+                visited_list.reset(new VisitedList(max_elements, visited_set_type, expected_visits));
+            }
+            visited_list->reset();
+            top_candidates.clear();
+            top_candidates.reserve(ef + 1);
+            candidate_set.clear();
+            candidate_set.reserve(ef + 1);
+            result.clear();
+            result.reserve(k);
+        }
+    };
+
+    // free search contexts kept for reuse by batch searches
+    mutable std::mutex search_contexts_lock_;
+    mutable std::deque<std::unique_ptr<SearchContext>> search_contexts_;
+
+
+    std::unique_ptr<SearchContext> getFreeSearchContext() const {
+        std::unique_lock <std::mutex> lock(search_contexts_lock_);
+        if (search_contexts_.empty())
+            return std::unique_ptr<SearchContext>(new SearchContext());
+        std::unique_ptr<SearchContext> ctx = std::move(search_contexts_.front());
+        search_contexts_.pop_front();
+        return ctx;
+    }
+
+
+    void releaseSearchContext(std::unique_ptr<SearchContext> ctx) const {
+        std::unique_lock <std::mutex> lock(search_contexts_lock_);
+        search_contexts_.push_front(std::move(ctx));
+    }
+
+
     void setEf(size_t ef) {
         ef_ = ef;
     }
@@ -184,23 +610,23 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     inline labeltype getExternalLabel(tableint internal_id) const {
         labeltype return_label;
-        memcpy(&return_label, (data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_), sizeof(labeltype));
+        memcpy(&return_label, (level0_labels_ + internal_id * level0_labels_stride_), sizeof(labeltype));
         return return_label;
     }
 
 
     inline void setExternalLabel(tableint internal_id, labeltype label) const {
-        memcpy((data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_), &label, sizeof(labeltype));
+        memcpy((level0_labels_ + internal_id * level0_labels_stride_), &label, sizeof(labeltype));
     }
 
 
     inline labeltype *getExternalLabeLp(tableint internal_id) const {
-        return (labeltype *) (data_level0_memory_ + internal_id * size_data_per_element_ + label_offset_);
+        return (labeltype *) (level0_labels_ + internal_id * level0_labels_stride_);
     }
 
 
     inline char *getDataByInternalId(tableint internal_id) const {
-        return (data_level0_memory_ + internal_id * size_data_per_element_ + offsetData_);
+        return (level0_data_ + internal_id * level0_data_stride_);
     }
 
 
@@ -225,9 +651,30 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
     searchBaseLayer(tableint ep_id, const void *data_point, int layer) {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
-        vl_type *visited_array = vl->mass;
-        vl_type visited_array_tag = vl->curV;
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        switch (vl->type) {
+        case VisitedSetType::DENSE:
+            top_candidates = searchBaseLayer<VisitedSetType::DENSE>(ep_id, data_point, layer, vl);
+            break;
+        case VisitedSetType::BITSET:
+            top_candidates = searchBaseLayer<VisitedSetType::BITSET>(ep_id, data_point, layer, vl);
+            break;
+        case VisitedSetType::HASH_SET:
+            top_candidates = searchBaseLayer<VisitedSetType::HASH_SET>(ep_id, data_point, layer, vl);
+            break;
+        case VisitedSetType::PAGED:
+            top_candidates = searchBaseLayer<VisitedSetType::PAGED>(ep_id, data_point, layer, vl);
+            break;
+        }
+        visited_list_pool_->releaseVisitedList(vl);
+        return top_candidates;
+    }
 
+
+    // The search of searchBaseLayer with the visited set backend as a template parameter
+    template<VisitedSetType visited_type>
+    std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst>
+    searchBaseLayer(tableint ep_id, const void *data_point, int layer, VisitedList *vl) {
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidateSet;
 
@@ -241,7 +688,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             lowerBound = std::numeric_limits<dist_t>::max();
             candidateSet.emplace(-lowerBound, ep_id);
         }
-        visited_array[ep_id] = visited_array_tag;
+        vl->visit<visited_type>(ep_id);
 
         while (!candidateSet.empty()) {
             std::pair<dist_t, tableint> curr_el_pair = candidateSet.top();
@@ -252,7 +699,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
             tableint curNodeNum = curr_el_pair.second;
 
-            std::unique_lock <std::mutex> lock(link_list_locks_[curNodeNum]);
+            LinkListLock lock(this, curNodeNum);
 
             int *data;  // = (int *)(linkList0_ + curNodeNum * size_links_per_element0_);
             if (layer == 0) {
@@ -264,8 +711,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             size_t size = getListCount((linklistsizeint*)data);
             tableint *datal = (tableint *) (data + 1);
 #ifdef USE_SSE
-            _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
-            _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
+            vl->prefetch<visited_type>(*(data + 1));
             _mm_prefetch(getDataByInternalId(*datal), _MM_HINT_T0);
             _mm_prefetch(getDataByInternalId(*(datal + 1)), _MM_HINT_T0);
 #endif
@@ -274,11 +720,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 tableint candidate_id = *(datal + j);
 //                    if (candidate_id == 0) continue;
 #ifdef USE_SSE
-                _mm_prefetch((char *) (visited_array + *(datal + j + 1)), _MM_HINT_T0);
-                _mm_prefetch(getDataByInternalId(*(datal + j + 1)), _MM_HINT_T0);
+                // the upper-layer link lists are allocated exactly, there is no id past the end to prefetch
+                if (j + 1 < size) {
+                    vl->prefetch<visited_type>(*(datal + j + 1));
+                    _mm_prefetch(getDataByInternalId(*(datal + j + 1)), _MM_HINT_T0);
+                }
 #endif
-                if (visited_array[candidate_id] == visited_array_tag) continue;
-                visited_array[candidate_id] = visited_array_tag;
+                if (!vl->visit<visited_type>(candidate_id)) continue;
                 char *currObj1 = (getDataByInternalId(candidate_id));
 
                 dist_t dist1 = fstdistfunc_(data_point, currObj1, dist_func_param_);
@@ -299,8 +747,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 }
             }
         }
-        visited_list_pool_->releaseVisitedList(vl);
-
         return top_candidates;
     }
 
@@ -315,17 +761,99 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         BaseFilterFunctor* isIdAllowed = nullptr,
         BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
         VisitedList *vl = visited_list_pool_->getFreeVisitedList();
-        vl_type *visited_array = vl->mass;
-        vl_type visited_array_tag = vl->curV;
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
 
+        searchBaseLayerST<bare_bone_search, collect_metrics>(
+            ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+
+        visited_list_pool_->releaseVisitedList(vl);
+        return top_candidates;
+    }
+
+
+    /*
+    * Same as above, but works on the given visited list and queues, so that they can be reused between searches.
+    * The queues are either std::priority_queue or ReusableHeap ordered by CompareByFirst.
+    * vl has to be reset and both queues have to be empty. The result is left in top_candidates,
+    * candidate_set may still contain elements when the search returns.
+    */
+    template <bool bare_bone_search = true, bool collect_metrics = false, typename queue_t>
+    void searchBaseLayerST(
+        tableint ep_id,
+        const void *data_point,
+        size_t ef,
+        VisitedList *vl,
+        queue_t &top_candidates,
+        queue_t &candidate_set,
+        BaseFilterFunctor* isIdAllowed = nullptr,
+        BaseSearchStopCondition<dist_t>* stop_condition = nullptr) const {
+        searchBaseLayerST<bare_bone_search, collect_metrics>(
+            SpaceDistance<dist_t>(fstdistfunc_, dist_func_param_, fstbatchdistfunc_),
+            ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+    }
+
+
+    /*
+    * Same as above with the distance, the filter and the stop condition as template parameters,
+    * so that their calls can be inlined. dist_func(data_point, data) returns the distance,
+    * filter_t and stop_condition_t need the methods of BaseFilterFunctor and BaseSearchStopCondition.
+    */
+    template <bool bare_bone_search, bool collect_metrics, typename dist_func_t, typename queue_t,
+              typename filter_t, typename stop_condition_t>
+    void searchBaseLayerST(
+        const dist_func_t &dist_func,
+        tableint ep_id,
+        const void *data_point,
+        size_t ef,
+        VisitedList *vl,
+        queue_t &top_candidates,
+        queue_t &candidate_set,
+        filter_t* isIdAllowed,
+        stop_condition_t* stop_condition) const {
+        switch (vl->type) {
+        case VisitedSetType::DENSE:
+            searchBaseLayerLoop<bare_bone_search, collect_metrics, VisitedSetType::DENSE>(
+                dist_func, ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+            break;
+        case VisitedSetType::BITSET:
+            searchBaseLayerLoop<bare_bone_search, collect_metrics, VisitedSetType::BITSET>(
+                dist_func, ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+            break;
+        case VisitedSetType::HASH_SET:
+            searchBaseLayerLoop<bare_bone_search, collect_metrics, VisitedSetType::HASH_SET>(
+                dist_func, ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+            break;
+        case VisitedSetType::PAGED:
+            searchBaseLayerLoop<bare_bone_search, collect_metrics, VisitedSetType::PAGED>(
+                dist_func, ep_id, data_point, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+            break;
+        }
+    }
+
+
+    // The loop of searchBaseLayerST with the visited set backend resolved once, as a template parameter
+    template <bool bare_bone_search, bool collect_metrics, VisitedSetType visited_type, typename dist_func_t,
+              typename queue_t, typename filter_t, typename stop_condition_t>
+    void searchBaseLayerLoop(
+        const dist_func_t &dist_func,
+        tableint ep_id,
+        const void *data_point,
+        size_t ef,
+        VisitedList *vl,
+        queue_t &top_candidates,
+        queue_t &candidate_set,
+        filter_t* isIdAllowed,
+        stop_condition_t* stop_condition) const {
+        linklistsizeint *link_list_buffer = lock_free_reads_ ? getLinkListBuffer() : nullptr;
+        NeighborBatch &batch = getNeighborBatch();
+
         dist_t lowerBound;
         if (bare_bone_search || 
             (!isMarkedDeleted(ep_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(ep_id))))) {
             char* ep_data = getDataByInternalId(ep_id);
-            dist_t dist = fstdistfunc_(data_point, ep_data, dist_func_param_);
+            dist_t dist = dist_func(data_point, ep_data);
             lowerBound = dist;
             top_candidates.emplace(dist, ep_id);
             if (!bare_bone_search && stop_condition) {
@@ -337,7 +865,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             candidate_set.emplace(-lowerBound, ep_id);
         }
 
-        visited_array[ep_id] = visited_array_tag;
+        vl->visit<visited_type>(ep_id);
 
         while (!candidate_set.empty()) {
             std::pair<dist_t, tableint> current_node_pair = candidate_set.top();
@@ -359,7 +887,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             candidate_set.pop();
 
             tableint current_node_id = current_node_pair.second;
-            int *data = (int *) get_linklist0(current_node_id);
+            int *data = (int *) getLinkListForSearch(current_node_id, 0, link_list_buffer);
             size_t size = getListCount((linklistsizeint*)data);
 //                bool cur_node_deleted = isMarkedDeleted(current_node_id);
             if (collect_metrics) {
@@ -368,75 +896,77 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
 
 #ifdef USE_SSE
-            _mm_prefetch((char *) (visited_array + *(data + 1)), _MM_HINT_T0);
-            _mm_prefetch((char *) (visited_array + *(data + 1) + 64), _MM_HINT_T0);
-            _mm_prefetch(data_level0_memory_ + (*(data + 1)) * size_data_per_element_ + offsetData_, _MM_HINT_T0);
+            vl->prefetch<visited_type>(*(data + 1));
             _mm_prefetch((char *) (data + 2), _MM_HINT_T0);
 #endif
 
+            // the unvisited neighbors are gathered first, so that their distances are computed in one call
+            size_t num_unvisited = 0;
             for (size_t j = 1; j <= size; j++) {
                 int candidate_id = *(data + j);
-//                    if (candidate_id == 0) continue;
 #ifdef USE_SSE
-                _mm_prefetch((char *) (visited_array + *(data + j + 1)), _MM_HINT_T0);
-                _mm_prefetch(data_level0_memory_ + (*(data + j + 1)) * size_data_per_element_ + offsetData_,
-                                _MM_HINT_T0);  ////////////
+                vl->prefetch<visited_type>(*(data + j + 1));
+#endif
+                if (vl->visit<visited_type>(candidate_id)) {
+                    char *candidate_data = getDataByInternalId(candidate_id);
+#ifdef USE_SSE
+                    _mm_prefetch(candidate_data, _MM_HINT_T0);
 #endif
-                if (!(visited_array[candidate_id] == visited_array_tag)) {
-                    visited_array[candidate_id] = visited_array_tag;
+                    batch.ids[num_unvisited] = candidate_id;
+                    batch.data[num_unvisited] = candidate_data;
+                    num_unvisited++;
+                }
+            }
+            computeDistances(dist_func, data_point, batch.data.data(), num_unvisited, batch.dists.data());
 
-                    char *currObj1 = (getDataByInternalId(candidate_id));
-                    dist_t dist = fstdistfunc_(data_point, currObj1, dist_func_param_);
+            for (size_t j = 0; j < num_unvisited; j++) {
+                tableint candidate_id = batch.ids[j];
+                const void *currObj1 = batch.data[j];
+                dist_t dist = batch.dists[j];
 
-                    bool flag_consider_candidate;
-                    if (!bare_bone_search && stop_condition) {
-                        flag_consider_candidate = stop_condition->should_consider_candidate(dist, lowerBound);
-                    } else {
-                        flag_consider_candidate = top_candidates.size() < ef || lowerBound > dist;
-                    }
+                bool flag_consider_candidate;
+                if (!bare_bone_search && stop_condition) {
+                    flag_consider_candidate = stop_condition->should_consider_candidate(dist, lowerBound);
+                } else {
+                    flag_consider_candidate = top_candidates.size() < ef || lowerBound > dist;
+                }
 
-                    if (flag_consider_candidate) {
-                        candidate_set.emplace(-dist, candidate_id);
+                if (flag_consider_candidate) {
+                    candidate_set.emplace(-dist, candidate_id);
 #ifdef USE_SSE
-                        _mm_prefetch(data_level0_memory_ + candidate_set.top().second * size_data_per_element_ +
-                                        offsetLevel0_,  ///////////
-                                        _MM_HINT_T0);  ////////////////////////
+                    _mm_prefetch((char *) get_linklist0(candidate_set.top().second), _MM_HINT_T0);  ////////////////////////
 #endif
 
-                        if (bare_bone_search || 
-                            (!isMarkedDeleted(candidate_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(candidate_id))))) {
-                            top_candidates.emplace(dist, candidate_id);
-                            if (!bare_bone_search && stop_condition) {
-                                stop_condition->add_point_to_result(getExternalLabel(candidate_id), currObj1, dist);
-                            }
+                    if (bare_bone_search || 
+                        (!isMarkedDeleted(candidate_id) && ((!isIdAllowed) || (*isIdAllowed)(getExternalLabel(candidate_id))))) {
+                        top_candidates.emplace(dist, candidate_id);
+                        if (!bare_bone_search && stop_condition) {
+                            stop_condition->add_point_to_result(getExternalLabel(candidate_id), currObj1, dist);
                         }
+                    }
 
-                        bool flag_remove_extra = false;
+                    bool flag_remove_extra = false;
+                    if (!bare_bone_search && stop_condition) {
+                        flag_remove_extra = stop_condition->should_remove_extra();
+                    } else {
+                        flag_remove_extra = top_candidates.size() > ef;
+                    }
+                    while (flag_remove_extra) {
+                        tableint id = top_candidates.top().second;
+                        top_candidates.pop();
                         if (!bare_bone_search && stop_condition) {
+                            stop_condition->remove_point_from_result(getExternalLabel(id), getDataByInternalId(id), dist);
                             flag_remove_extra = stop_condition->should_remove_extra();
                         } else {
                             flag_remove_extra = top_candidates.size() > ef;
                         }
-                        while (flag_remove_extra) {
-                            tableint id = top_candidates.top().second;
-                            top_candidates.pop();
-                            if (!bare_bone_search && stop_condition) {
-                                stop_condition->remove_point_from_result(getExternalLabel(id), getDataByInternalId(id), dist);
-                                flag_remove_extra = stop_condition->should_remove_extra();
-                            } else {
-                                flag_remove_extra = top_candidates.size() > ef;
-                            }
-                        }
-
-                        if (!top_candidates.empty())
-                            lowerBound = top_candidates.top().first;
                     }
+
+                    if (!top_candidates.empty())
+                        lowerBound = top_candidates.top().first;
                 }
             }
         }
-
-        visited_list_pool_->releaseVisitedList(vl);
-        return top_candidates;
     }
 
 
@@ -484,7 +1014,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     linklistsizeint *get_linklist0(tableint internal_id) const {
-        return (linklistsizeint *) (data_level0_memory_ + internal_id * size_data_per_element_ + offsetLevel0_);
+        return (linklistsizeint *) (level0_links_ + internal_id * level0_links_stride_);
     }
 
 
@@ -503,89 +1033,417 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
-    tableint mutuallyConnectNewElement(
-        const void *data_point,
-        tableint cur_c,
-        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> &top_candidates,
-        int level,
-        bool isUpdate) {
-        size_t Mcurmax = level ? maxM_ : maxM0_;
-        getNeighborsByHeuristic2(top_candidates, M_);
-        if (top_candidates.size() > M_)
-            throw std::runtime_error("Should be not be more than M_ candidates returned by the heuristic");
+    /*
+    * Lock of the link lists of one element, a std::mutex of link_list_locks_ or the spinlock in the
+    * level 0 link list header depending on lock_strategy_. Unlocks on destruction if locked.
+    */
+    class LinkListLock {
+        static const int SPINS_BEFORE_YIELD = 64;
 
-        std::vector<tableint> selectedNeighbors;
-        selectedNeighbors.reserve(M_);
-        while (top_candidates.size() > 0) {
-            selectedNeighbors.push_back(top_candidates.top().second);
-            top_candidates.pop();
+        std::mutex *mutex_{nullptr};
+        std::atomic<unsigned char> *spinlock_{nullptr};
+        bool owns_lock_{false};
+
+     public:
+        LinkListLock(HierarchicalNSW *index, tableint internal_id, bool defer_lock = false) {
+            if (index->lock_strategy_ == LinkListLockStrategy::MUTEX)
+                mutex_ = &index->link_list_locks_[internal_id];
+            else
+                spinlock_ = index->getLinkListSpinlock(internal_id);
+            if (!defer_lock)
+                lock();
         }
 
-        tableint next_closest_entry_point = selectedNeighbors.back();
+        LinkListLock(const LinkListLock &) = delete;
+        LinkListLock &operator=(const LinkListLock &) = delete;
 
-        {
-            // lock only during the update
-            // because during the addition the lock for cur_c is already acquired
-            std::unique_lock <std::mutex> lock(link_list_locks_[cur_c], std::defer_lock);
-            if (isUpdate) {
-                lock.lock();
-            }
-            linklistsizeint *ll_cur;
-            if (level == 0)
-                ll_cur = get_linklist0(cur_c);
-            else
-                ll_cur = get_linklist(cur_c, level);
+        ~LinkListLock() {
+            if (owns_lock_)
+                unlock();
+        }
 
-            if (*ll_cur && !isUpdate) {
-                throw std::runtime_error("The newly inserted element should have blank link list");
+        void lock() {
+            if (mutex_) {
+                mutex_->lock();
+            } else {
+                while (spinlock_->exchange(1, std::memory_order_acquire)) {
+                    for (int spins = 0; spinlock_->load(std::memory_order_relaxed); spins++) {
+                        if (spins < SPINS_BEFORE_YIELD) {
+#ifdef USE_SSE
+                            _mm_pause();
+#endif
+                        } else {
+                            std::this_thread::yield();
+                        }
+                    }
+                }
             }
-            setListCount(ll_cur, selectedNeighbors.size());
-            tableint *data = (tableint *) (ll_cur + 1);
-            for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-                if (data[idx] && !isUpdate)
-                    throw std::runtime_error("Possible memory corruption");
-                if (level > element_levels_[selectedNeighbors[idx]])
-                    throw std::runtime_error("Trying to make a link on a non-existent level");
+            owns_lock_ = true;
+        }
 
-                data[idx] = selectedNeighbors[idx];
-            }
+        void unlock() {
+            if (mutex_)
+                mutex_->unlock();
+            else
+                spinlock_->store(0, std::memory_order_release);
+            owns_lock_ = false;
         }
+    };
 
-        for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
-            std::unique_lock <std::mutex> lock(link_list_locks_[selectedNeighbors[idx]]);
 
-            linklistsizeint *ll_other;
-            if (level == 0)
-                ll_other = get_linklist0(selectedNeighbors[idx]);
-            else
-                ll_other = get_linklist(selectedNeighbors[idx], level);
+    std::atomic<unsigned char> *getLinkListSpinlock(tableint internal_id) const {
+        static_assert(sizeof(std::atomic<unsigned char>) == 1, "The spinlock must fit into one byte");
+        // the first two bytes of the header hold the size of the list and the third one the deleted mark
+        return reinterpret_cast<std::atomic<unsigned char> *>((unsigned char *) get_linklist0(internal_id) + 3);
+    }
 
-            size_t sz_link_list_other = getListCount(ll_other);
 
-            if (sz_link_list_other > Mcurmax)
-                throw std::runtime_error("Bad value of sz_link_list_other");
-            if (selectedNeighbors[idx] == cur_c)
-                throw std::runtime_error("Trying to connect an element to itself");
-            if (level > element_levels_[selectedNeighbors[idx]])
-                throw std::runtime_error("Trying to make a link on a non-existent level");
+    // Recreates the locks and, if they are kept, the versions of the link lists for max_elements elements, all unlocked
+    void resetLinkListLocks(size_t max_elements) {
+        size_t num_mutexes = lock_strategy_ == LinkListLockStrategy::MUTEX ? max_elements : 0;
+        std::vector<std::mutex>(num_mutexes).swap(link_list_locks_);
+        if (!link_list_versions_.empty())
+            std::vector<std::atomic<unsigned int>>(max_elements).swap(link_list_versions_);
+    }
 
-            tableint *data = (tableint *) (ll_other + 1);
 
-            bool is_cur_c_present = false;
-            if (isUpdate) {
-                for (size_t j = 0; j < sz_link_list_other; j++) {
-                    if (data[j] == cur_c) {
-                        is_cur_c_present = true;
-                        break;
-                    }
-                }
-            }
+    // Starts keeping the versions of the link lists (4 bytes per element), no writer may be running
+    void enableLinkListVersions() {
+        if (link_list_versions_.empty())
+            std::vector<std::atomic<unsigned int>>(max_elements_).swap(link_list_versions_);
+    }
 
-            // If cur_c is already present in the neighboring connections of `selectedNeighbors[idx]` then no need to modify any connections or run the heuristics.
-            if (!is_cur_c_present) {
-                if (sz_link_list_other < Mcurmax) {
-                    data[sz_link_list_other] = cur_c;
-                    setListCount(ll_other, sz_link_list_other + 1);
+
+    /*
+    * Selects how searches keep track of the visited elements. The default VisitedSetType::DENSE array takes
+    * 2 bytes per element for every concurrent search, BITSET 1 bit, and HASH_SET and PAGED take memory
+    * proportional to the number of elements a search visits, at the cost of slower lookups.
+    * Must not be called concurrently with searches or insertions.
+    */
+    void setVisitedSetType(VisitedSetType visited_set_type) {
+        visited_set_type_ = visited_set_type;
+        resetVisitedListPool(max_elements_);
+    }
+
+
+    // Rough number of elements visited by a search with the given ef, the initial size of the hash sets
+    size_t expectedVisits(size_t ef) const {
+        return ef * maxM0_;
+    }
+
+
+    void resetVisitedListPool(size_t max_elements) {
+        visited_list_pool_.reset(new VisitedListPool(
+            1, max_elements, visited_set_type_, expectedVisits(std::max(ef_, ef_construction_))));
+    }
+
+
+    /*
+    * Makes searches read link lists without locks while elements are added or updated concurrently.
+    * Writers mark every rewrite of a link list in link_list_versions_, and with lock_free_reads_ the searches
+    * copy each list they expand and retry the copy if it overlapped with a rewrite, so they never block on
+    * a lock and never see a partially written list. Updates of the vectors themselves (updatePoint) are not
+    * covered. Costs a copy of every expanded list and 4 bytes per element for the versions, so it is disabled
+    * by default.
+    */
+    void setLockFreeReads(bool lock_free_reads) {
+        if (lock_free_reads) {
+            withWritersHeldBack([&]() {
+                enableLinkListVersions();
+            });
+        }
+        lock_free_reads_ = lock_free_reads;
+    }
+
+
+    /*
+    * Marks the link lists of an element as being rewritten for the whole scope, the lock of the element must be held.
+    * With an update log the element is recorded for the next commit, with its vector for log_change LOG_DATA.
+    */
+    class LinkListUpdateGuard {
+        std::atomic<unsigned int> *version_;  // nullptr if the versions are not kept
+
+     public:
+        LinkListUpdateGuard(HierarchicalNSW *index, tableint internal_id, unsigned char log_change = LOG_LINKS,
+                            bool compaction_repair = false)
+            : version_(index->link_list_versions_.empty() ? nullptr : &index->link_list_versions_[internal_id]) {
+            if (version_) {
+                version_->store(version_->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+            if (index->log_active_)
+                index->noteLogChange(internal_id, log_change);
+            if (index->compaction_tracking_ && !compaction_repair && internal_id < index->compaction_changed_.size())
+                index->compaction_changed_[internal_id].store(1, std::memory_order_relaxed);
+        }
+
+        ~LinkListUpdateGuard() {
+            if (version_)
+                version_->store(version_->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+
+    // Registers a writer for the checkpoints for its scope, waits while a checkpoint is being written
+    class CheckpointWriterScope {
+        HierarchicalNSW *index_;
+
+     public:
+        explicit CheckpointWriterScope(HierarchicalNSW *index) : index_(index) {
+            std::unique_lock <std::mutex> lock(index_->checkpoint_lock_);
+            index_->checkpoint_cv_.wait(lock, [this] { return !index_->checkpoint_pending_; });
+            index_->active_writers_++;
+        }
+
+        CheckpointWriterScope(const CheckpointWriterScope &) = delete;
+        CheckpointWriterScope &operator=(const CheckpointWriterScope &) = delete;
+
+        ~CheckpointWriterScope() {
+            std::unique_lock <std::mutex> lock(index_->checkpoint_lock_);
+            if (--index_->active_writers_ == 0)
+                index_->checkpoint_cv_.notify_all();
+        }
+    };
+
+
+    // Registers a search for its scope, waits while the searches are held back by withSearchesHeldBack
+    class SearchScope {
+        const HierarchicalNSW *index_;
+        std::atomic<size_t> &counter_;
+
+        void leave() {
+            counter_--;
+            if (index_->searches_held_back_) {
+                std::unique_lock <std::mutex> lock(index_->search_gate_lock_);
+                index_->search_gate_cv_.notify_all();
+            }
+        }
+
+        static size_t threadStripe() {
+            thread_local size_t stripe =
+                std::hash<std::thread::id>()(std::this_thread::get_id()) % SEARCH_COUNTER_STRIPES;
+            return stripe;
+        }
+
+     public:
+        explicit SearchScope(const HierarchicalNSW *index)
+            : index_(index), counter_(index->active_searches_[threadStripe()].count) {
+            while (true) {
+                counter_++;
+                if (!index_->searches_held_back_)
+                    return;
+                leave();
+                std::unique_lock <std::mutex> lock(index_->search_gate_lock_);
+                index_->search_gate_cv_.wait(lock, [this] { return !index_->searches_held_back_; });
+            }
+        }
+
+        SearchScope(const SearchScope &) = delete;
+        SearchScope &operator=(const SearchScope &) = delete;
+
+        ~SearchScope() {
+            leave();
+        }
+    };
+
+
+    size_t numActiveSearches() const {
+        size_t count = 0;
+        for (const SearchCounter &counter : active_searches_) {
+            count += counter.count;
+        }
+        return count;
+    }
+
+
+    // Runs f once no search is running, new searches wait until f returns
+    template<typename F>
+    void withSearchesHeldBack(F f) {
+        std::unique_lock <std::mutex> lock(search_gate_lock_);
+        searches_held_back_ = true;
+        search_gate_cv_.wait(lock, [this] { return numActiveSearches() == 0; });
+        lock.unlock();
+
+        try {
+            f();
+        } catch (...) {
+            lock.lock();
+            searches_held_back_ = false;
+            lock.unlock();
+            search_gate_cv_.notify_all();
+            throw;
+        }
+        lock.lock();
+        searches_held_back_ = false;
+        lock.unlock();
+        search_gate_cv_.notify_all();
+    }
+
+
+    // Buffer for copies of link lists taken by searches of the calling thread
+    linklistsizeint *getLinkListBuffer() const {
+        // one more element, the prefetching in the searches reads one id past the end of a list
+        thread_local std::vector<linklistsizeint> buffer;
+        if (buffer.size() < maxM0_ + 2)
+            buffer.resize(maxM0_ + 2);
+        return buffer.data();
+    }
+
+
+    // Unvisited neighbors of the element expanded by a search, their data and their distances to the query
+    struct NeighborBatch {
+        std::vector<tableint> ids;
+        std::vector<const void *> data;
+        std::vector<dist_t> dists;
+    };
+
+
+    // Buffers for the neighbor batches of the searches of the calling thread
+    NeighborBatch &getNeighborBatch() const {
+        thread_local NeighborBatch batch;
+        if (batch.ids.size() < maxM0_) {
+            batch.ids.resize(maxM0_);
+            batch.data.resize(maxM0_);
+            batch.dists.resize(maxM0_);
+        }
+        return batch;
+    }
+
+
+    // Buffer for the preprocessed vectors or queries of the calling thread
+    char *getPreparedBuffer(size_t size) const {
+        thread_local std::vector<char> buffer;
+        if (buffer.size() < size)
+            buffer.resize(size);
+        return buffer.data();
+    }
+
+
+    // The query as the space compares it, preprocessed into the buffer of the calling thread if the space needs it
+    const void *prepareQuery(const void *query_data) const {
+        if (!preprocessing_)
+            return query_data;
+        char *prepared = getPreparedBuffer(query_size_);
+        space_->prepare_query(query_data, prepared);
+        return prepared;
+    }
+
+
+    // Link list of internal_id at level for a search: with lock_free_reads_ a consistent copy in buffer, else the list itself
+    linklistsizeint *getLinkListForSearch(tableint internal_id, int level, linklistsizeint *buffer) const {
+        linklistsizeint *ll = get_linklist_at_level(internal_id, level);
+        if (!lock_free_reads_)
+            return ll;
+
+        const std::atomic<unsigned int> &version = link_list_versions_[internal_id];
+        size_t max_size = level == 0 ? maxM0_ : maxM_;
+        while (true) {
+            unsigned int version_before = version.load(std::memory_order_acquire);
+            if (version_before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            buffer[0] = ll[0];
+            size_t size = std::min((size_t) getListCount(buffer), max_size);
+            memcpy(buffer + 1, ll + 1, size * sizeof(tableint));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version.load(std::memory_order_relaxed) == version_before)
+                return buffer;
+        }
+    }
+
+
+    // Level of the search start, the entry point and the top level can be replaced by concurrent insertions
+    int getSearchStartLevel(tableint entry_point) const {
+        return std::min(maxlevel_, element_levels_[entry_point]);
+    }
+
+
+    tableint mutuallyConnectNewElement(
+        const void *data_point,
+        tableint cur_c,
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> &top_candidates,
+        int level,
+        bool isUpdate) {
+        size_t Mcurmax = level ? maxM_ : maxM0_;
+        getNeighborsByHeuristic2(top_candidates, M_);
+        if (top_candidates.size() > M_)
+            throw std::runtime_error("Should be not be more than M_ candidates returned by the heuristic");
+
+        std::vector<tableint> selectedNeighbors;
+        selectedNeighbors.reserve(M_);
+        while (top_candidates.size() > 0) {
+            selectedNeighbors.push_back(top_candidates.top().second);
+            top_candidates.pop();
+        }
+
+        tableint next_closest_entry_point = selectedNeighbors.back();
+
+        {
+            // lock only during the update
+            // because during the addition the lock for cur_c is already acquired
+            LinkListLock lock(this, cur_c, true);
+            if (isUpdate) {
+                lock.lock();
+            }
+            LinkListUpdateGuard update_guard(this, cur_c);
+            linklistsizeint *ll_cur;
+            if (level == 0)
+                ll_cur = get_linklist0(cur_c);
+            else
+                ll_cur = get_linklist(cur_c, level);
+
+            if (getListCount(ll_cur) && !isUpdate) {
+                throw std::runtime_error("The newly inserted element should have blank link list");
+            }
+            setListCount(ll_cur, selectedNeighbors.size());
+            tableint *data = (tableint *) (ll_cur + 1);
+            for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
+                if (data[idx] && !isUpdate)
+                    throw std::runtime_error("Possible memory corruption");
+                if (level > element_levels_[selectedNeighbors[idx]])
+                    throw std::runtime_error("Trying to make a link on a non-existent level");
+
+                data[idx] = selectedNeighbors[idx];
+            }
+        }
+
+        for (size_t idx = 0; idx < selectedNeighbors.size(); idx++) {
+            LinkListLock lock(this, selectedNeighbors[idx]);
+
+            linklistsizeint *ll_other;
+            if (level == 0)
+                ll_other = get_linklist0(selectedNeighbors[idx]);
+            else
+                ll_other = get_linklist(selectedNeighbors[idx], level);
+
+            size_t sz_link_list_other = getListCount(ll_other);
+
+            if (sz_link_list_other > Mcurmax)
+                throw std::runtime_error("Bad value of sz_link_list_other");
+            if (selectedNeighbors[idx] == cur_c)
+                throw std::runtime_error("Trying to connect an element to itself");
+            if (level > element_levels_[selectedNeighbors[idx]])
+                throw std::runtime_error("Trying to make a link on a non-existent level");
+
+            tableint *data = (tableint *) (ll_other + 1);
+
+            bool is_cur_c_present = false;
+            if (isUpdate) {
+                for (size_t j = 0; j < sz_link_list_other; j++) {
+                    if (data[j] == cur_c) {
+                        is_cur_c_present = true;
+                        break;
+                    }
+                }
+            }
+
+            // If cur_c is already present in the neighboring connections of `selectedNeighbors[idx]` then no need to modify any connections or run the heuristics.
+            if (!is_cur_c_present) {
+                LinkListUpdateGuard update_guard(this, selectedNeighbors[idx]);
+                if (sz_link_list_other < Mcurmax) {
+                    data[sz_link_list_other] = cur_c;
+                    setListCount(ll_other, sz_link_list_other + 1);
                 } else {
                     // finding the "weakest" element to replace it with the new one
                     dist_t d_max = fstdistfunc_(getDataByInternalId(cur_c), getDataByInternalId(selectedNeighbors[idx]),
@@ -631,20 +1489,21 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     void resizeIndex(size_t new_max_elements) {
+        checkWritable();
         if (new_max_elements < cur_element_count)
             throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
 
-        visited_list_pool_.reset(new VisitedListPool(1, new_max_elements));
+        resetVisitedListPool(new_max_elements);
 
         element_levels_.resize(new_max_elements);
 
-        std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
+        resetLinkListLocks(new_max_elements);
+        // the versions start over, so the changes since the last checkpoint are unknown
+        checkpoint_location_.clear();
 
         // Reallocate base layer
-        char * data_level0_memory_new = (char *) realloc(data_level0_memory_, new_max_elements * size_data_per_element_);
-        if (data_level0_memory_new == nullptr)
+        if (!reallocLevel0(new_max_elements))
             throw std::runtime_error("Not enough memory: resizeIndex failed to allocate base layer");
-        data_level0_memory_ = data_level0_memory_new;
 
         // Reallocate all other layers
         char ** linkLists_new = (char **) realloc(linkLists_, sizeof(void *) * new_max_elements);
@@ -655,175 +1514,2355 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         max_elements_ = new_max_elements;
     }
 
-    size_t indexFileSize() const {
-        size_t size = 0;
-        size += sizeof(offsetLevel0_);
-        size += sizeof(max_elements_);
-        size += sizeof(cur_element_count);
-        size += sizeof(size_data_per_element_);
-        size += sizeof(label_offset_);
-        size += sizeof(offsetData_);
-        size += sizeof(maxlevel_);
-        size += sizeof(enterpoint_node_);
-        size += sizeof(maxM_);
-
-        size += sizeof(maxM0_);
-        size += sizeof(M_);
-        size += sizeof(mult_);
-        size += sizeof(ef_construction_);
-
-        size += cur_element_count * size_data_per_element_;
 
-        for (size_t i = 0; i < cur_element_count; i++) {
-            unsigned int linkListSize = element_levels_[i] > 0 ? size_links_per_element_ * element_levels_[i] : 0;
-            size += sizeof(linkListSize);
-            size += linkListSize;
+    /*
+    * Renumbers the internal ids so that elements linked in the base layer get close ids, which places
+    * their link lists and vectors close in memory and reduces cache and TLB misses during searches.
+    * All link lists, the labels, the levels and the deleted elements are moved to the new ids;
+    * save the index afterwards to keep the new order. Must not run concurrently with other operations.
+    */
+    void reorderIndex(ReorderStrategy strategy) {
+        checkWritable();
+        if (cur_element_count == 0) return;
+
+        std::vector<tableint> order;  // old internal ids in the new order
+        switch (strategy) {
+            case ReorderStrategy::BFS:
+                order = getBFSOrder(false);
+                break;
+            case ReorderStrategy::RCM:
+                order = getBFSOrder(true);
+                std::reverse(order.begin(), order.end());
+                break;
+            case ReorderStrategy::GORDER:
+                order = getGorderOrder();
+                break;
         }
-        return size;
+        applyOrder(order);
     }
 
-    void saveIndex(const std::string &location) {
-        std::ofstream output(location, std::ios::binary);
-        std::streampos position;
 
-        writeBinaryPOD(output, offsetLevel0_);
-        writeBinaryPOD(output, max_elements_);
-        writeBinaryPOD(output, cur_element_count);
-        writeBinaryPOD(output, size_data_per_element_);
-        writeBinaryPOD(output, label_offset_);
-        writeBinaryPOD(output, offsetData_);
-        writeBinaryPOD(output, maxlevel_);
-        writeBinaryPOD(output, enterpoint_node_);
-        writeBinaryPOD(output, maxM_);
+    /*
+    * Breadth-first order of the base layer starting from the entry point, elements not reachable from it
+    * start new traversals. With by_degree neighbors are visited by increasing degree and every traversal
+    * starts from an element with the smallest degree (Cuthill-McKee).
+    */
+    std::vector<tableint> getBFSOrder(bool by_degree) const {
+        size_t n = cur_element_count;
+        std::vector<tableint> starts;
+        if (by_degree) {
+            starts.resize(n);
+            for (tableint i = 0; i < n; i++) starts[i] = i;
+            std::stable_sort(starts.begin(), starts.end(), [this](tableint a, tableint b) {
+                return getListCount(get_linklist0(a)) < getListCount(get_linklist0(b));
+            });
+        } else {
+            starts.push_back(enterpoint_node_);
+            for (tableint i = 0; i < n; i++) starts.push_back(i);
+        }
 
-        writeBinaryPOD(output, maxM0_);
-        writeBinaryPOD(output, M_);
-        writeBinaryPOD(output, mult_);
-        writeBinaryPOD(output, ef_construction_);
+        std::vector<tableint> order;
+        order.reserve(n);
+        std::vector<bool> placed(n, false);
+        std::vector<tableint> neighbors;
+        for (tableint start : starts) {
+            if (placed[start]) continue;
+            placed[start] = true;
+            size_t head = order.size();
+            order.push_back(start);
+            while (head < order.size()) {
+                linklistsizeint *ll = get_linklist0(order[head++]);
+                tableint *links = (tableint *) (ll + 1);
+                neighbors.assign(links, links + getListCount(ll));
+                if (by_degree) {
+                    std::stable_sort(neighbors.begin(), neighbors.end(), [this](tableint a, tableint b) {
+                        return getListCount(get_linklist0(a)) < getListCount(get_linklist0(b));
+                    });
+                }
+                for (tableint neighbor : neighbors) {
+                    if (placed[neighbor]) continue;
+                    placed[neighbor] = true;
+                    order.push_back(neighbor);
+                }
+            }
+        }
+        return order;
+    }
 
-        output.write(data_level0_memory_, cur_element_count * size_data_per_element_);
 
-        for (size_t i = 0; i < cur_element_count; i++) {
-            unsigned int linkListSize = element_levels_[i] > 0 ? size_links_per_element_ * element_levels_[i] : 0;
-            writeBinaryPOD(output, linkListSize);
-            if (linkListSize)
-                output.write(linkLists_[i], linkListSize);
+    /*
+    * Gorder-like order: the next element is the one with the most links (in either direction) to the
+    * last placed elements of a small window, ties are broken by the smaller id. Only direct links are scored,
+    * common neighbors are not, to keep the cost linear in the number of links.
+    */
+    std::vector<tableint> getGorderOrder(size_t window_size = 5) const {
+        size_t n = cur_element_count;
+        std::vector<std::vector<tableint>> neighbors(n);
+        for (tableint i = 0; i < n; i++) {
+            linklistsizeint *ll = get_linklist0(i);
+            tableint *links = (tableint *) (ll + 1);
+            size_t size = getListCount(ll);
+            for (size_t j = 0; j < size; j++) {
+                neighbors[i].push_back(links[j]);
+                neighbors[links[j]].push_back(i);
+            }
         }
-        output.close();
+
+        std::vector<tableint> order;
+        order.reserve(n);
+        std::vector<bool> placed(n, false);
+        std::vector<int> score(n, 0);
+        // (score, -id), may hold outdated scores, they are checked when popped
+        std::priority_queue<std::pair<int, long long>> candidates;
+        std::deque<tableint> window;
+        tableint next_unplaced = 0;
+
+        auto updateScores = [&](tableint element, int delta) {
+            for (tableint neighbor : neighbors[element]) {
+                if (placed[neighbor]) continue;
+                score[neighbor] += delta;
+                if (delta > 0) candidates.emplace(score[neighbor], -(long long) neighbor);
+            }
+        };
+
+        for (size_t pos = 0; pos < n; pos++) {
+            tableint next = 0;
+            bool found = false;
+            if (pos == 0) {
+                next = enterpoint_node_;
+                found = true;
+            }
+            while (!found && !candidates.empty()) {
+                int candidate_score = candidates.top().first;
+                tableint candidate = (tableint) -candidates.top().second;
+                candidates.pop();
+                if (placed[candidate] || score[candidate] <= 0 || candidate_score < score[candidate]) continue;
+                if (candidate_score > score[candidate]) {
+                    // the score was decreased after the push
+                    candidates.emplace(score[candidate], -(long long) candidate);
+                    continue;
+                }
+                next = candidate;
+                found = true;
+            }
+            if (!found) {
+                while (placed[next_unplaced]) next_unplaced++;
+                next = next_unplaced;
+            }
+
+            placed[next] = true;
+            order.push_back(next);
+            updateScores(next, 1);
+            window.push_back(next);
+            if (window.size() > window_size) {
+                updateScores(window.front(), -1);
+                window.pop_front();
+            }
+        }
+        return order;
     }
 
 
-    void loadIndex(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i = 0) {
-        std::ifstream input(location, std::ios::binary);
+    // Moves the element with the internal id order[i] to the internal id i
+    void applyOrder(const std::vector<tableint> &order) {
+        size_t n = cur_element_count;
+        if (order.size() != n)
+            throw std::runtime_error("The order must contain every element once");
+        std::vector<tableint> new_ids(n, (tableint) -1);
+        for (tableint i = 0; i < n; i++) {
+            if (order[i] >= n || new_ids[order[i]] != (tableint) -1)
+                throw std::runtime_error("The order must contain every element once");
+            new_ids[order[i]] = i;
+        }
 
-        if (!input.is_open())
-            throw std::runtime_error("Cannot open file");
+        // move the base layer through a copy in the interleaved layout
+        std::vector<char> level0(n * size_data_per_element_);
+        for (tableint i = 0; i < n; i++) {
+            copyLevel0ElementTo(i, level0.data() + new_ids[i] * size_data_per_element_);
+        }
+        for (tableint i = 0; i < n; i++) {
+            copyLevel0ElementFrom(level0.data() + i * size_data_per_element_, i);
+        }
 
-        clear();
-        // get file size:
-        input.seekg(0, input.end);
-        std::streampos total_filesize = input.tellg();
-        input.seekg(0, input.beg);
+        std::vector<char *> link_lists(n);
+        std::vector<int> element_levels(n);
+        for (tableint i = 0; i < n; i++) {
+            link_lists[new_ids[i]] = linkLists_[i];
+            element_levels[new_ids[i]] = element_levels_[i];
+        }
+        for (tableint i = 0; i < n; i++) {
+            linkLists_[i] = link_lists[i];
+            element_levels_[i] = element_levels[i];
+        }
 
-        readBinaryPOD(input, offsetLevel0_);
-        readBinaryPOD(input, max_elements_);
-        readBinaryPOD(input, cur_element_count);
+        for (tableint i = 0; i < n; i++) {
+            for (int level = 0; level <= element_levels_[i]; level++) {
+                linklistsizeint *ll = get_linklist_at_level(i, level);
+                tableint *links = (tableint *) (ll + 1);
+                size_t size = getListCount(ll);
+                for (size_t j = 0; j < size; j++) {
+                    links[j] = new_ids[links[j]];
+                }
+            }
+        }
 
-        size_t max_elements = max_elements_i;
-        if (max_elements < cur_element_count)
-            max_elements = max_elements_;
-        max_elements_ = max_elements;
-        readBinaryPOD(input, size_data_per_element_);
-        readBinaryPOD(input, label_offset_);
-        readBinaryPOD(input, offsetData_);
-        readBinaryPOD(input, maxlevel_);
-        readBinaryPOD(input, enterpoint_node_);
+        for (auto &label_id : label_lookup_) {
+            label_id.second = new_ids[label_id.second];
+        }
+        std::unordered_set<tableint> deleted;
+        for (tableint id : deleted_elements) {
+            deleted.insert(new_ids[id]);
+        }
+        deleted_elements.swap(deleted);
+        enterpoint_node_ = new_ids[enterpoint_node_];
+        // all elements moved, the next checkpoint writes the whole index and the next commit of a log compacts it
+        checkpoint_location_.clear();
+        log_compaction_required_ = true;
+    }
+
+
+    /*
+    * Removes the elements marked deleted from the graph and from memory. The link lists that point to them are
+    * rebuilt with getNeighborsByHeuristic2, the remaining elements get dense internal ids in their current order
+    * and max_elements_ shrinks by the number of removed elements; their labels can be added again.
+    * Runs on the internal thread pool with num_threads threads (0 means all cores) and must not run concurrently
+    * with other operations, see startCompaction for a compaction alongside them.
+    */
+    void compact(size_t num_threads = 0) {
+        startCompaction(num_threads);
+        finishCompaction();
+    }
+
+
+    /*
+    * Starts a compaction of the elements deleted at this point: a background thread repairs the link lists
+    * that point to them while searches, insertions, updates and deletions go on, finishCompaction removes them.
+    * Elements deleted later stay marked, elements unmarked or replaced in the meantime are kept.
+    * resizeIndex, reorderIndex and the loaders must not be called until finishCompaction or cancelCompaction.
+    */
+    void startCompaction(size_t num_threads = 0) {
+        checkWritable();
+        if (compaction_thread_.joinable())
+            throw std::runtime_error("A compaction is already running");
+        if (num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        compaction_num_threads_ = std::max(num_threads, (size_t) 1);
+
+        // the elements reserved by insertions are complete once no writer is active
+        withWritersHeldBack([&]() {
+            size_t n = cur_element_count;
+            compaction_removed_.assign(n, 0);
+            for (tableint i = 0; i < n; i++) {
+                compaction_removed_[i] = isMarkedDeleted(i);
+            }
+            std::vector<std::atomic<char>>(n).swap(compaction_changed_);
+            compaction_tracking_ = true;
+            enableLinkListVersions();
+        });
+        compaction_stop_ = false;
+        compaction_exception_ = nullptr;
+        compaction_thread_ = std::thread([this]() {
+            try {
+                repairRemovedLinks(compaction_removed_.size());
+            } catch (...) {
+                compaction_exception_ = std::current_exception();
+            }
+        });
+    }
+
+
+    /*
+    * Completes the compaction started by startCompaction: waits for the repair and removes the elements.
+    * The writers are held back meanwhile. First the link lists that writers changed since the start, those of
+    * the new elements and those of the elements unmarked meanwhile are repaired again, alongside the searches;
+    * this part grows with the writes during the compaction, not with the size of the index. Then the searches
+    * are held back too while the remaining elements move to their new ids: this computes no distances but
+    * still copies the base layer and rebuilds the label lookup, so its pause grows with the number of elements.
+    * At the end the elements unmarked meanwhile are linked again, alongside the searches.
+    */
+    void finishCompaction() {
+        if (!compaction_thread_.joinable())
+            throw std::runtime_error("No compaction is running");
+        compaction_thread_.join();
+        if (compaction_exception_) {
+            endCompaction();
+            std::rethrow_exception(compaction_exception_);
+        }
+        try {
+            withWritersHeldBack([&]() {
+                removeCompactedElements();
+            });
+        } catch (...) {
+            endCompaction();
+            throw;
+        }
+        endCompaction();
+    }
+
+
+    // Stops a compaction started by startCompaction, no element is removed and the repaired link lists stay
+    void cancelCompaction() {
+        if (!compaction_thread_.joinable())
+            return;
+        compaction_stop_ = true;
+        compaction_thread_.join();
+        endCompaction();
+    }
+
+
+    // Drops the state of a compaction, the writers stop flagging their changes
+    void endCompaction() {
+        withWritersHeldBack([&]() {
+            compaction_tracking_ = false;
+            compaction_removed_ = std::vector<char>();
+            std::vector<std::atomic<char>>().swap(compaction_changed_);
+        });
+    }
+
+
+    bool isCompactionRemoved(tableint internal_id) const {
+        return internal_id < compaction_removed_.size() && compaction_removed_[internal_id];
+    }
+
+
+    /*
+    * Repairs the link lists of the first element_count elements that point to removed elements, in batches.
+    * Each batch registers as a writer, so checkpoints and commits of a log wait for one batch at most.
+    */
+    void repairRemovedLinks(size_t element_count) {
+        size_t num_batches = (element_count + COMPACTION_BATCH_SIZE - 1) / COMPACTION_BATCH_SIZE;
+        getThreadPool().parallelFor(0, num_batches, compaction_num_threads_, [&](size_t batch, size_t thread_id) {
+            if (compaction_stop_)
+                return;
+            CheckpointWriterScope writer(this);
+            size_t end = std::min((batch + 1) * COMPACTION_BATCH_SIZE, element_count);
+            for (tableint i = batch * COMPACTION_BATCH_SIZE; i < end; i++) {
+                repairElementLinks(i);
+            }
+        });
+    }
+
+
+    // Repairs the link lists of the given elements on all levels, the writers are held back
+    void repairRemovedLinks(const std::vector<tableint> &ids) {
+        getThreadPool().parallelFor(0, ids.size(), compaction_num_threads_, [&](size_t id, size_t thread_id) {
+            repairElementLinks(ids[id]);
+        });
+    }
+
+
+    void repairElementLinks(tableint internal_id) {
+        if (isCompactionRemoved(internal_id))
+            return;
+        for (int level = 0; level <= element_levels_[internal_id]; level++) {
+            repairRemovedLinks(internal_id, level);
+        }
+    }
+
+
+    /*
+    * Rebuilds the link list of internal_id at level if it points to removed elements. The candidates are its
+    * other neighbors and the elements reached from the removed ones through removed elements only. The list is
+    * read and written under the lock, if an insertion changes it in between the repair starts over.
+    */
+    void repairRemovedLinks(tableint internal_id, int level) {
+        size_t max_links = level == 0 ? maxM0_ : maxM_;
+        const void *data_point = getDataByInternalId(internal_id);
+        while (true) {
+            std::vector<tableint> links;
+            unsigned int version;
+            {
+                LinkListLock lock(this, internal_id);
+                version = link_list_versions_[internal_id].load(std::memory_order_relaxed);
+                linklistsizeint *ll = get_linklist_at_level(internal_id, level);
+                tableint *data = (tableint *) (ll + 1);
+                links.assign(data, data + getListCount(ll));
+            }
+            if (std::none_of(links.begin(), links.end(), [this](tableint id) { return isCompactionRemoved(id); }))
+                return;
+
+            std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidates;
+            std::unordered_set<tableint> seen(links.begin(), links.end());
+            seen.insert(internal_id);
+            std::vector<tableint> removed;
+            size_t num_found = 0;
+            auto addCandidate = [&](tableint id) {
+                if (isCompactionRemoved(id)) {
+                    removed.push_back(id);
+                    return;
+                }
+                num_found++;
+                candidates.emplace(fstdistfunc_(data_point, getDataByInternalId(id), dist_func_param_), id);
+                if (candidates.size() > ef_construction_)
+                    candidates.pop();
+            };
+            for (tableint id : links) {
+                addCandidate(id);
+            }
+            for (size_t i = 0; i < removed.size() && i < ef_construction_ && num_found < ef_construction_; i++) {
+                for (tableint id : getConnectionsWithLock(removed[i], level)) {
+                    if (seen.insert(id).second)
+                        addCandidate(id);
+                }
+            }
+            getNeighborsByHeuristic2(candidates, max_links);
+
+            LinkListLock lock(this, internal_id);
+            if (link_list_versions_[internal_id].load(std::memory_order_relaxed) != version)
+                continue;
+            LinkListUpdateGuard update_guard(this, internal_id, LOG_LINKS, true);
+            linklistsizeint *ll = get_linklist_at_level(internal_id, level);
+            tableint *data = (tableint *) (ll + 1);
+            size_t size = candidates.size();
+            setListCount(ll, size);
+            for (size_t i = 0; i < size; i++) {
+                data[i] = candidates.top().second;
+                candidates.pop();
+            }
+            return;
+        }
+    }
+
+
+    // The last step of a compaction, the writers are held back
+    void removeCompactedElements() {
+        // elements unmarked or replaced since the start are kept, their neighbors may have dropped them and their
+        // own lists were skipped by the repair; the lists changed by writers since the start and those of the new
+        // elements may point to removed elements again
+        std::vector<tableint> kept;
+        std::vector<tableint> changed;
+        for (tableint i = 0; i < compaction_removed_.size(); i++) {
+            if (compaction_removed_[i] && !isMarkedDeleted(i)) {
+                compaction_removed_[i] = 0;
+                kept.push_back(i);
+                changed.push_back(i);
+            } else if (compaction_changed_[i].load(std::memory_order_relaxed)) {
+                changed.push_back(i);
+            }
+        }
+        size_t n = cur_element_count;
+        for (tableint i = compaction_removed_.size(); i < n; i++) {
+            changed.push_back(i);
+        }
+        repairRemovedLinks(changed);
+
+        std::vector<tableint> new_ids(n, (tableint) -1);
+        tableint count = 0;
+        for (tableint i = 0; i < n; i++) {
+            if (!isCompactionRemoved(i))
+                new_ids[i] = count++;
+        }
+        size_t num_removed = n - count;
+
+        if (num_removed > 0) {
+            withSearchesHeldBack([&]() {
+                moveCompactedElements(new_ids, count);
+            });
+        }
+
+        for (tableint id : kept) {
+            tableint new_id = new_ids[id];
+            if (new_id != enterpoint_node_)
+                repairConnectionsForUpdate(getDataByInternalId(new_id), enterpoint_node_, new_id,
+                                           element_levels_[new_id], maxlevel_);
+        }
+    }
+
+
+    // Gives the remaining elements their new ids and frees the removed ones, the writers and the searches are held back
+    void moveCompactedElements(const std::vector<tableint> &new_ids, tableint count) {
+        size_t n = cur_element_count;
+        size_t num_removed = n - count;
+        if (isCompactionRemoved(enterpoint_node_)) {
+            // the new entry point is an element on the highest remaining level
+            maxlevel_ = -1;
+            enterpoint_node_ = -1;
+            for (tableint i = 0; i < n; i++) {
+                if (!isCompactionRemoved(i) && element_levels_[i] > maxlevel_) {
+                    maxlevel_ = element_levels_[i];
+                    enterpoint_node_ = i;
+                }
+            }
+        }
+
+        // the elements move to lower ids only, so every element is read before its place is overwritten
+        for (tableint i = 0; i < n; i++) {
+            if (isCompactionRemoved(i)) {
+                if (element_levels_[i] > 0)
+                    freeLinkList(i);
+                continue;
+            }
+            for (int level = 0; level <= element_levels_[i]; level++) {
+                linklistsizeint *ll = get_linklist_at_level(i, level);
+                tableint *links = (tableint *) (ll + 1);
+                size_t size = getListCount(ll);
+                for (size_t j = 0; j < size; j++) {
+                    links[j] = new_ids[links[j]];
+                }
+            }
+            tableint new_id = new_ids[i];
+            if (new_id != i) {
+                memcpy(get_linklist0(new_id), get_linklist0(i), size_links_level0_);
+                memcpy(getDataByInternalId(new_id), getDataByInternalId(i), data_size_);
+                memcpy(getExternalLabeLp(new_id), getExternalLabeLp(i), sizeof(labeltype));
+                linkLists_[new_id] = linkLists_[i];
+                element_levels_[new_id] = element_levels_[i];
+            }
+        }
+        if (enterpoint_node_ != (tableint) -1)
+            enterpoint_node_ = new_ids[enterpoint_node_];
+        cur_element_count = count;
+
+        label_lookup_.clear();
+        num_deleted_ = 0;
+        deleted_elements.clear();
+        buildLabelLookup(count);
+        for (tableint i = 0; i < count; i++) {
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
+
+        // the memory of the removed elements is freed, an index keeps room for one element
+        size_t new_max_elements = std::max(max_elements_ - num_removed, (size_t) 1);
+        if (!reallocLevel0(new_max_elements))
+            throw std::runtime_error("Not enough memory: compact failed to allocate base layer");
+        char **linkLists_new = (char **) realloc(linkLists_, sizeof(void *) * new_max_elements);
+        if (linkLists_new == nullptr)
+            throw std::runtime_error("Not enough memory: compact failed to allocate other layers");
+        linkLists_ = linkLists_new;
+        element_levels_.resize(new_max_elements);
+        element_levels_.shrink_to_fit();
+        resetLinkListLocks(new_max_elements);
+        resetVisitedListPool(new_max_elements);
+        max_elements_ = new_max_elements;
+
+        // all elements moved, the next checkpoint writes the whole index and the next commit of a log compacts it
+        checkpoint_location_.clear();
+        log_compaction_required_ = true;
+    }
+
+    size_t indexFileSize() const {
+        std::vector<IndexSectionEntry> sections = indexSections();
+        return sections.back().offset + sections.back().size;
+    }
+
+
+    // Size of the header of the index file, with the section table and its checksum
+    static size_t indexHeaderSize(size_t num_sections) {
+        return INDEX_FIXED_HEADER_SIZE + num_sections * INDEX_SECTION_ENTRY_SIZE + sizeof(uint32_t);
+    }
+
+
+    static size_t alignIndexOffset(size_t offset) {
+        return (offset + INDEX_SECTION_ALIGNMENT - 1) / INDEX_SECTION_ALIGNMENT * INDEX_SECTION_ALIGNMENT;
+    }
+
+
+    // Bytes of a stored vector in the file, the stride of the vectors in the SOA layout so a mapped file can be used in place
+    size_t indexVectorStride() const {
+        return (data_size_ + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    }
+
+
+    // Sections of the index file with their offsets, sizes and strides, without the checksums
+    std::vector<IndexSectionEntry> indexSections() const {
+        size_t count = cur_element_count;
+        size_t upper_size = count * sizeof(int32_t);
+        size_t num_deleted = 0;
+        for (size_t i = 0; i < count; i++) {
+            upper_size += element_levels_[i] * size_links_per_element_;
+            if (isMarkedDeleted(i))
+                num_deleted++;
+        }
+        std::vector<IndexSectionEntry> sections(INDEX_NUM_SECTIONS);
+        sections[0] = {(uint32_t) IndexSection::GRAPH, 0, 0, count * size_links_level0_, size_links_level0_};
+        sections[1] = {(uint32_t) IndexSection::VECTORS, 0, 0, count * indexVectorStride(), indexVectorStride()};
+        sections[2] = {(uint32_t) IndexSection::LABELS, 0, 0, count * sizeof(labeltype), sizeof(labeltype)};
+        sections[3] = {(uint32_t) IndexSection::UPPER_LAYERS, 0, 0, upper_size, 0};
+        sections[4] = {(uint32_t) IndexSection::DELETED, 0, 0, num_deleted * sizeof(tableint), sizeof(tableint)};
+        size_t offset = indexHeaderSize(sections.size());
+        for (IndexSectionEntry &section : sections) {
+            section.offset = alignIndexOffset(offset);
+            offset = section.offset + section.size;
+        }
+        return sections;
+    }
+
+
+    /*
+    * Passes the content of a section of the index file to emit(data, size) in pieces of up to about 1 MB.
+    * The stored vectors are padded with zeros to the stride of the section.
+    */
+    template<typename Emit>
+    void emitIndexSection(IndexSection type, Emit emit) const {
+        std::vector<char> buffer;
+        buffer.reserve(INDEX_EMIT_BUFFER_SIZE);
+        auto append = [&](const void *data, size_t size) {
+            if (buffer.size() + size > INDEX_EMIT_BUFFER_SIZE && !buffer.empty()) {
+                emit(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+            buffer.insert(buffer.end(), (const char *) data, (const char *) data + size);
+        };
+        size_t count = cur_element_count;
+        std::vector<char> padding(indexVectorStride() - data_size_);
+        for (size_t i = 0; i < count; i++) {
+            if (type == IndexSection::GRAPH) {
+                append(get_linklist0(i), size_links_level0_);
+                // the spinlock of the element may be held by a search
+                buffer[buffer.size() - size_links_level0_ + 3] = 0;
+            } else if (type == IndexSection::VECTORS) {
+                append(getDataByInternalId(i), data_size_);
+                append(padding.data(), padding.size());
+            } else if (type == IndexSection::LABELS) {
+                labeltype label = getExternalLabel(i);
+                append(&label, sizeof(label));
+            } else if (type == IndexSection::UPPER_LAYERS) {
+                int32_t level = element_levels_[i];
+                append(&level, sizeof(level));
+            } else if (type == IndexSection::DELETED && isMarkedDeleted(i)) {
+                tableint internal_id = i;
+                append(&internal_id, sizeof(internal_id));
+            }
+        }
+        if (type == IndexSection::UPPER_LAYERS) {
+            for (size_t i = 0; i < count; i++) {
+                if (element_levels_[i] > 0)
+                    append(linkLists_[i], element_levels_[i] * size_links_per_element_);
+            }
+        }
+        if (!buffer.empty())
+            emit(buffer.data(), buffer.size());
+    }
+
+
+    // Header of the index file: the fixed fields, the section table and the checksum of both
+    std::vector<char> indexFileHeader(const std::vector<IndexSectionEntry> &sections) const {
+        std::vector<char> header;
+        auto put = [&header](const void *data, size_t size) {
+            header.insert(header.end(), (const char *) data, (const char *) data + size);
+        };
+        uint64_t magic = INDEX_MAGIC;
+        uint32_t version = INDEX_VERSION;
+        uint32_t num_sections = sections.size();
+        char space_name[INDEX_SPACE_NAME_SIZE] = {};
+        std::string name = space_->get_name();
+        memcpy(space_name, name.data(), std::min(name.size(), sizeof(space_name) - 1));
+        uint64_t fields[] = {space_->get_dim(), data_size_, max_elements_, cur_element_count,
+                             M_, maxM_, maxM0_, ef_construction_};
+        int32_t maxlevel = maxlevel_;
+        uint32_t enterpoint_node = enterpoint_node_;
+        put(&magic, sizeof(magic));
+        put(&version, sizeof(version));
+        put(&num_sections, sizeof(num_sections));
+        put(space_name, sizeof(space_name));
+        put(fields, sizeof(fields));
+        put(&mult_, sizeof(mult_));
+        put(&maxlevel, sizeof(maxlevel));
+        put(&enterpoint_node, sizeof(enterpoint_node));
+        for (const IndexSectionEntry &section : sections) {
+            put(&section.type, sizeof(section.type));
+            put(&section.crc, sizeof(section.crc));
+            put(&section.offset, sizeof(section.offset));
+            put(&section.size, sizeof(section.size));
+            put(&section.stride, sizeof(section.stride));
+        }
+        uint32_t crc = CRC32C::update(0, header.data(), header.size());
+        put(&crc, sizeof(crc));
+        return header;
+    }
+
+
+    void saveIndex(const std::string &location) {
+        FileSink sink(location);
+        saveIndex(sink);
+    }
+
+
+    /*
+    * Writes the index to any sink (file, pipe, memory). The file starts with a header recording the format version,
+    * the space (name, dimension, data size) and the parameters of the index, followed by a table of the sections
+    * (graph, vectors, labels, upper layers, deleted elements) with their offsets and CRC32C checksums. The sections
+    * start at 64-byte aligned offsets, and the graph, vectors and labels have the strides of the SOA layout, so
+    * loadIndexMmap uses them in place. The index is passed to the sink in aligned chunks of chunk_size bytes,
+    * so saving needs only one chunk of memory on top of the index. The checksums are computed while the sections
+    * are written, and a seekable sink (file, memory) gets the header at the end, written as zeros until then;
+    * a pipe or socket gets the header first, so the checksums take a first pass over the index.
+    * progress gets the bytes written after each chunk, returning false cancels.
+    */
+    void saveIndex(IndexSink &sink, StreamProgress progress = nullptr, size_t chunk_size = STREAM_CHUNK_SIZE) {
+        std::vector<IndexSectionEntry> sections = indexSections();
+        bool patch_header = sink.seekable();
+        if (!patch_header) {
+            for (IndexSectionEntry &section : sections) {
+                uint32_t crc = 0;
+                emitIndexSection((IndexSection) section.type, [&crc](const char *data, size_t size) {
+                    crc = CRC32C::update(crc, data, size);
+                });
+                section.crc = crc;
+            }
+        }
+
+        StreamWriter output(sink, sections.back().offset + sections.back().size, progress, chunk_size);
+        std::vector<char> header = indexFileHeader(sections);
+        if (patch_header)
+            std::fill(header.begin(), header.end(), 0);
+        output.write(header.data(), header.size());
+        size_t position = header.size();
+        std::vector<char> padding(INDEX_SECTION_ALIGNMENT);
+        for (IndexSectionEntry &section : sections) {
+            output.write(padding.data(), section.offset - position);
+            uint32_t crc = 0;
+            emitIndexSection((IndexSection) section.type, [&](const char *data, size_t size) {
+                if (patch_header)
+                    crc = CRC32C::update(crc, data, size);
+                output.write(data, size);
+            });
+            if (patch_header)
+                section.crc = crc;
+            position = section.offset + section.size;
+        }
+        output.flush();
+        if (patch_header) {
+            header = indexFileHeader(sections);
+            sink.writeAt(0, header.data(), header.size());
+        }
+        output.finish();
+    }
+
+
+    /*
+    * Writes the index in the format of the versions before the section table, which older versions can load.
+    */
+    void saveIndexLegacy(const std::string &location) {
+        FileSink sink(location);
+        StreamWriter output(sink, legacyIndexFileSize());
+
+        output.writePOD(offsetLevel0_);
+        output.writePOD(max_elements_);
+        output.writePOD((size_t) cur_element_count);
+        output.writePOD(size_data_per_element_);
+        output.writePOD(label_offset_);
+        output.writePOD(offsetData_);
+        output.writePOD(maxlevel_);
+        output.writePOD(enterpoint_node_);
+        output.writePOD(maxM_);
+
+        output.writePOD(maxM0_);
+        output.writePOD(M_);
+        output.writePOD(mult_);
+        output.writePOD(ef_construction_);
+
+        std::vector<char> element(size_data_per_element_);
+        for (size_t i = 0; i < cur_element_count; i++) {
+            copyLevel0ElementTo(i, element.data());
+            output.write(element.data(), size_data_per_element_);
+        }
+
+        for (size_t i = 0; i < cur_element_count; i++) {
+            unsigned int linkListSize = element_levels_[i] > 0 ? size_links_per_element_ * element_levels_[i] : 0;
+            output.writePOD(linkListSize);
+            if (linkListSize)
+                output.write(linkLists_[i], linkListSize);
+        }
+        output.finish();
+    }
+
+
+    size_t legacyIndexHeaderSize() const {
+        return sizeof(offsetLevel0_) + sizeof(max_elements_) + sizeof(cur_element_count) +
+            sizeof(size_data_per_element_) + sizeof(label_offset_) + sizeof(offsetData_) + sizeof(maxlevel_) +
+            sizeof(enterpoint_node_) + sizeof(maxM_) + sizeof(maxM0_) + sizeof(M_) + sizeof(mult_) +
+            sizeof(ef_construction_);
+    }
+
+
+    // Size of the file written by saveIndexLegacy, also the size of the whole index in a checkpoint
+    size_t legacyIndexFileSize() const {
+        size_t size = legacyIndexHeaderSize() + cur_element_count * size_data_per_element_;
+        for (size_t i = 0; i < cur_element_count; i++) {
+            size += sizeof(unsigned int) + element_levels_[i] * size_links_per_element_;
+        }
+        return size;
+    }
+
+
+    /*
+    * Rewrites an index file of the legacy format (or of the current one) at legacy_location in the current format.
+    * The index is loaded into memory for that.
+    */
+    static void convertIndexFile(const std::string &legacy_location, const std::string &location, SpaceInterface<dist_t> *s) {
+        HierarchicalNSW<dist_t> index(s);
+        index.loadIndex(legacy_location, s);
+        index.saveIndex(location);
+    }
+
+
+    /*
+    * Loads an index written by saveIndex (or in the legacy format) from a file with num_threads threads
+    * (0 for all hardware threads). The threads read the file in ranges at their offsets and checksum the ranges,
+    * the upper-layer link lists are placed into a single arena and the label lookup is built meanwhile.
+    */
+    void loadIndex(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i = 0, size_t num_threads = 0) {
+        RandomAccessFile file(location);
+        if (num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        num_threads = std::max(num_threads, (size_t) 1);
+
+        clear();
+        StreamReader header(file, nullptr, 4096);
+        uint64_t magic;
+        header.readPOD(magic);
+        if (magic != INDEX_MAGIC) {
+            offsetLevel0_ = magic;
+            loadLegacyIndex(file, header, s, max_elements_i, num_threads);
+            return;
+        }
+        std::vector<IndexSectionEntry> sections;
+        size_t cur_element_count_read = readIndexFileHeader(header, s, max_elements_i, file.size(), sections);
+        initLoadedIndex();
+
+        // the graph, the vectors and the labels are read directly into the base layer if it has their strides
+        size_t count = cur_element_count_read;
+        const IndexSectionEntry &graph = sections[0];
+        uint32_t graph_crc = readFileRanges(file, graph, num_threads, soa_layout_ ? level0_links_ : nullptr,
+                       [&](size_t first, const char *data, size_t num) {
+            for (size_t i = 0; i < num; i++)
+                memcpy(get_linklist0(first + i), data + i * graph.stride, size_links_level0_);
+        });
+        const IndexSectionEntry &vectors = sections[1];
+        uint32_t vectors_crc = readFileRanges(file, vectors, num_threads, soa_layout_ ? level0_data_ : nullptr,
+                       [&](size_t first, const char *data, size_t num) {
+            for (size_t i = 0; i < num; i++)
+                memcpy(getDataByInternalId(first + i), data + i * vectors.stride, data_size_);
+        });
+        const IndexSectionEntry &labels = sections[2];
+        uint32_t labels_crc = readFileRanges(file, labels, num_threads, soa_layout_ ? level0_labels_ : nullptr,
+                       [&](size_t first, const char *data, size_t num) {
+            for (size_t i = 0; i < num; i++)
+                memcpy(getExternalLabeLp(first + i), data + i * labels.stride, sizeof(labeltype));
+        });
+        if (graph_crc != graph.crc || vectors_crc != vectors.crc || labels_crc != labels.crc)
+            throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+
+        std::exception_ptr lookup_exception;
+        std::thread lookup_thread([&]() {
+            try {
+                buildLabelLookup(count);
+            } catch (...) {
+                lookup_exception = std::current_exception();
+            }
+        });
+        try {
+            // the levels, then the link lists into the arena
+            const IndexSectionEntry &upper = sections[3];
+            std::vector<int32_t> levels(count);
+            file.readAt((char *) levels.data(), count * sizeof(int32_t), upper.offset);
+            uint32_t crc = CRC32C::update(0, levels.data(), count * sizeof(int32_t));
+            char *arena = placeLinkLists(levels, upper.size - count * sizeof(int32_t));
+            IndexSectionEntry lists = {upper.type, 0, upper.offset + count * sizeof(int32_t), upper.size - count * sizeof(int32_t), 0};
+            uint32_t lists_crc = readFileRanges(file, lists, num_threads, arena, [](size_t, const char *, size_t) {});
+            if (CRC32C::combine(crc, lists_crc, lists.size) != upper.crc)
+                throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+
+            const IndexSectionEntry &deleted = sections[4];
+            std::vector<tableint> deleted_ids(deleted.size / sizeof(tableint));
+            file.readAt((char *) deleted_ids.data(), deleted.size, deleted.offset);
+            if (CRC32C::update(0, deleted_ids.data(), deleted.size) != deleted.crc)
+                throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+            setDeletedElements(deleted_ids, count);
+        } catch (...) {
+            lookup_thread.join();
+            throw;
+        }
+        lookup_thread.join();
+        if (lookup_exception)
+            std::rethrow_exception(lookup_exception);
+        cur_element_count = cur_element_count_read;
+    }
+
+
+    /*
+    * Reads an index written by saveIndex (or in the legacy format) from any source (file, pipe, memory)
+    * in a single pass. The stream is checked while it is read: a checksum mismatch, a truncated stream
+    * or data past the end of the index throws. progress gets the bytes read about every chunk_size bytes,
+    * returning false cancels.
+    */
+    void loadIndex(IndexSource &source, SpaceInterface<dist_t> *s, size_t max_elements_i = 0,
+                   StreamProgress progress = nullptr, size_t chunk_size = STREAM_CHUNK_SIZE) {
+        StreamReader input(source, progress, chunk_size);
+
+        clear();
+        uint64_t magic;
+        input.readPOD(magic);
+        if (magic != INDEX_MAGIC) {
+            offsetLevel0_ = magic;
+            loadLegacyIndex(input, source.size(), s, max_elements_i);
+            return;
+        }
+        std::vector<IndexSectionEntry> sections;
+        size_t cur_element_count_read = readIndexFileHeader(input, s, max_elements_i, source.size(), sections);
+        initLoadedIndex();
+
+        size_t count = cur_element_count_read;
+        size_t position = indexHeaderSize(sections.size());
+        std::vector<char> scratch(INDEX_SECTION_ALIGNMENT);
+        std::vector<int32_t> levels;
+        std::vector<tableint> deleted_ids;
+        for (const IndexSectionEntry &section : sections) {
+            input.read(scratch.data(), section.offset - position);
+            uint32_t crc = 0;
+            auto read = [&](char *data, size_t size) {
+                input.read(data, size);
+                crc = CRC32C::update(crc, data, size);
+            };
+            switch ((IndexSection) section.type) {
+            case IndexSection::GRAPH:
+                if (soa_layout_) {
+                    read(level0_links_, section.size);
+                } else {
+                    for (size_t i = 0; i < count; i++)
+                        read((char *) get_linklist0(i), size_links_level0_);
+                }
+                break;
+            case IndexSection::VECTORS:
+                if (soa_layout_) {
+                    read(level0_data_, section.size);
+                } else {
+                    for (size_t i = 0; i < count; i++) {
+                        read(getDataByInternalId(i), data_size_);
+                        read(scratch.data(), section.stride - data_size_);
+                    }
+                }
+                break;
+            case IndexSection::LABELS:
+                if (soa_layout_) {
+                    read(level0_labels_, section.size);
+                } else {
+                    for (size_t i = 0; i < count; i++)
+                        read((char *) getExternalLabeLp(i), sizeof(labeltype));
+                }
+                break;
+            case IndexSection::UPPER_LAYERS: {
+                levels.resize(count);
+                read((char *) levels.data(), count * sizeof(int32_t));
+                size_t lists_size = section.size - count * sizeof(int32_t);
+                read(placeLinkLists(levels, lists_size), lists_size);
+                break;
+            }
+            case IndexSection::DELETED:
+                deleted_ids.resize(section.size / sizeof(tableint));
+                read((char *) deleted_ids.data(), section.size);
+                break;
+            }
+            if (crc != section.crc)
+                throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+            position = section.offset + section.size;
+        }
+        if (!input.atEnd())
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        buildLabelLookup(count);
+        setDeletedElements(deleted_ids, count);
+        cur_element_count = cur_element_count_read;
+    }
+
+
+    /*
+    * Reads the header of the index file after its magic number: checks the checksum, the version and that s is
+    * the space the index was saved with, and sets up the index for it. Returns the number of elements and the
+    * section table, whose sections are checked to be in place and to fit into stream_size (0 if unknown).
+    */
+    size_t readIndexFileHeader(StreamReader &input, SpaceInterface<dist_t> *s, size_t max_elements_i,
+                               size_t stream_size, std::vector<IndexSectionEntry> &sections) {
+        std::vector<char> header(INDEX_FIXED_HEADER_SIZE);
+        uint64_t magic = INDEX_MAGIC;
+        memcpy(header.data(), &magic, sizeof(magic));
+        input.read(header.data() + sizeof(magic), header.size() - sizeof(magic));
+
+        const char *fields = header.data() + sizeof(magic);
+        uint32_t version, num_sections;
+        readBinaryPOD(fields, version);
+        readBinaryPOD(fields, num_sections);
+        if (version != INDEX_VERSION)
+            throw std::runtime_error("Unsupported index version " + std::to_string(version));
+        if (num_sections != INDEX_NUM_SECTIONS)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        header.resize(indexHeaderSize(num_sections));
+        input.read(header.data() + INDEX_FIXED_HEADER_SIZE, header.size() - INDEX_FIXED_HEADER_SIZE);
+        fields = header.data() + sizeof(magic) + sizeof(version) + sizeof(num_sections);
+        uint32_t header_crc;
+        memcpy(&header_crc, header.data() + header.size() - sizeof(header_crc), sizeof(header_crc));
+        if (CRC32C::update(0, header.data(), header.size() - sizeof(header_crc)) != header_crc)
+            throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+
+        char space_name[INDEX_SPACE_NAME_SIZE];
+        uint64_t dim, data_size, max_elements, count, M, maxM, maxM0, ef_construction;
+        int32_t maxlevel;
+        uint32_t enterpoint_node;
+        memcpy(space_name, fields, sizeof(space_name));
+        fields += sizeof(space_name);
+        readBinaryPOD(fields, dim);
+        readBinaryPOD(fields, data_size);
+        readBinaryPOD(fields, max_elements);
+        readBinaryPOD(fields, count);
+        readBinaryPOD(fields, M);
+        readBinaryPOD(fields, maxM);
+        readBinaryPOD(fields, maxM0);
+        readBinaryPOD(fields, ef_construction);
+        readBinaryPOD(fields, mult_);
+        readBinaryPOD(fields, maxlevel);
+        readBinaryPOD(fields, enterpoint_node);
+        sections.resize(num_sections);
+        for (IndexSectionEntry &section : sections) {
+            readBinaryPOD(fields, section.type);
+            readBinaryPOD(fields, section.crc);
+            readBinaryPOD(fields, section.offset);
+            readBinaryPOD(fields, section.size);
+            readBinaryPOD(fields, section.stride);
+        }
+
+        space_name[sizeof(space_name) - 1] = 0;
+        std::string name = s->get_name();
+        if ((space_name[0] != 0 && !name.empty() && name.substr(0, sizeof(space_name) - 1) != space_name) ||
+            (dim != 0 && s->get_dim() != 0 && dim != s->get_dim()) || data_size != s->get_data_size())
+            throw std::runtime_error("The index was saved with another space: " + std::string(space_name) +
+                                     " of dimension " + std::to_string(dim));
+
+        max_elements_ = max_elements_i < count ? max_elements : max_elements_i;
+        M_ = M;
+        maxM_ = maxM;
+        maxM0_ = maxM0;
+        ef_construction_ = ef_construction;
+        maxlevel_ = maxlevel;
+        enterpoint_node_ = enterpoint_node;
+        setSpace(s);
+        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+        size_data_per_element_ = size_links_level0_ + data_size_ + sizeof(labeltype);
+        offsetData_ = size_links_level0_;
+        label_offset_ = size_links_level0_ + data_size_;
+        offsetLevel0_ = 0;
+
+        // the sections of this version, in order, aligned and with the sizes of the elements
+        size_t expected_strides[] = {size_links_level0_, indexVectorStride(), sizeof(labeltype), 0, sizeof(tableint)};
+        size_t end = indexHeaderSize(num_sections);
+        for (size_t i = 0; i < sections.size(); i++) {
+            const IndexSectionEntry &section = sections[i];
+            bool valid = section.type == i + 1 && section.stride == expected_strides[i] &&
+                section.offset == alignIndexOffset(end) && section.offset + section.size >= section.offset;
+            if (section.stride != 0 && i != 4)
+                valid = valid && section.size == count * section.stride;
+            else if (section.stride != 0)
+                valid = valid && section.size % section.stride == 0 && section.size / section.stride <= count;
+            else
+                valid = valid && section.size >= count * sizeof(int32_t) &&
+                    (section.size - count * sizeof(int32_t)) % size_links_per_element_ == 0;
+            if (!valid)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            end = section.offset + section.size;
+        }
+        if ((stream_size != 0 && end != stream_size) || max_elements_ < count || (count > 0 && enterpoint_node_ >= count) ||
+            maxlevel_ < (count > 0 ? 0 : -1))
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        return count;
+    }
+
+
+    void setSpace(SpaceInterface<dist_t> *s) {
+        data_size_ = s->get_data_size();
+        query_size_ = s->get_query_size();
+        fstdistfunc_ = s->get_dist_func();
+        fstbatchdistfunc_ = s->get_batch_dist_func();
+        dist_func_param_ = s->get_dist_func_param();
+        space_ = s;
+        preprocessing_ = s->has_preprocessing();
+    }
+
+
+    // Allocates the base layer and the structures of the elements for an index whose header was read
+    void initLoadedIndex() {
+        if (!reallocLevel0(max_elements_))
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
+        resetLinkListLocks(max_elements_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+
+        resetVisitedListPool(max_elements_);
+
+        linkLists_ = (char **) malloc(sizeof(void *) * max_elements_);
+        if (linkLists_ == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
+        // the levels stay 0 until the link lists are in place, so clear() can free a partially read index
+        element_levels_ = std::vector<int>(max_elements_);
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+    }
+
+
+    /*
+    * Allocates the arena for link lists of lists_size bytes in total and points the link lists of the elements
+    * with the given levels into it, back to back. Returns the arena.
+    */
+    char *placeLinkLists(const std::vector<int32_t> &levels, size_t lists_size) {
+        size_t arena_size = 0;
+        for (int32_t level : levels) {
+            if (level < 0 || level > maxlevel_)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            arena_size += level * size_links_per_element_;
+        }
+        if (arena_size != lists_size)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        char *arena = allocLinkListArena(arena_size);
+        if (arena == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
+        size_t position = 0;
+        for (size_t i = 0; i < levels.size(); i++) {
+            element_levels_[i] = levels[i];
+            linkLists_[i] = levels[i] > 0 ? arena + position : nullptr;
+            position += levels[i] * size_links_per_element_;
+        }
+        return arena;
+    }
+
+
+    void buildLabelLookup(size_t count) {
+        label_lookup_.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+        }
+    }
+
+
+    // Takes the deleted elements from the section of the index file, in increasing order and marked in the graph
+    void setDeletedElements(const std::vector<tableint> &deleted_ids, size_t count) {
+        for (size_t i = 0; i < deleted_ids.size(); i++) {
+            tableint internal_id = deleted_ids[i];
+            if (internal_id >= count || !isMarkedDeleted(internal_id) || (i > 0 && internal_id <= deleted_ids[i - 1]))
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            if (allow_replace_deleted_) deleted_elements.insert(internal_id);
+        }
+        num_deleted_ = deleted_ids.size();
+    }
+
+
+    /*
+    * Reads a section of a file in parallel ranges of whole elements of section.stride bytes (of bytes for stride 0)
+    * and returns its CRC. The ranges are read to dst if it is given, or else passed to consume(first element,
+    * data, number of elements).
+    */
+    template<typename Consume>
+    uint32_t readFileRanges(const RandomAccessFile &file, const IndexSectionEntry &section, size_t num_threads,
+                            char *dst, Consume consume) {
+        size_t stride = std::max(section.stride, (uint64_t) 1);
+        size_t range_size = std::max(LOAD_RANGE_SIZE / stride, (size_t) 1) * stride;
+        size_t num_ranges = (section.size + range_size - 1) / range_size;
+        std::vector<uint32_t> crcs(num_ranges);
+        std::vector<std::vector<char>> buffers(num_threads);
+        getThreadPool().parallelFor(0, num_ranges, num_threads, [&](size_t range, size_t thread_id) {
+            size_t begin = range * range_size;
+            size_t size = std::min(range_size, (size_t) section.size - begin);
+            char *data = dst + begin;
+            if (dst == nullptr) {
+                buffers[thread_id].resize(range_size);
+                data = buffers[thread_id].data();
+            }
+            file.readAt(data, size, section.offset + begin);
+            crcs[range] = CRC32C::update(0, data, size);
+            if (dst == nullptr)
+                consume(begin / stride, data, size / stride);
+        });
+        uint32_t crc = 0;
+        for (size_t range = 0; range < num_ranges; range++) {
+            crc = CRC32C::combine(crc, crcs[range], std::min(range_size, (size_t) section.size - range * range_size));
+        }
+        return crc;
+    }
+
+
+    // The legacy part of loadIndex(location) after the first field of the file, which is in offsetLevel0_
+    void loadLegacyIndex(const RandomAccessFile &file, StreamReader &header, SpaceInterface<dist_t> *s,
+                         size_t max_elements_i, size_t num_threads) {
+        size_t cur_element_count_read = readLegacyIndexHeader(header, s, max_elements_i, file.size());
+        size_t level0_offset = file.size() - header.remaining();
+        size_t level0_size = cur_element_count_read * size_data_per_element_;
+        initLoadedIndex();
+
+        // the base layer in ranges of whole elements
+        size_t range_elements = std::max(LOAD_RANGE_SIZE / size_data_per_element_, (size_t) 1);
+        size_t num_ranges = (cur_element_count_read + range_elements - 1) / range_elements;
+        std::vector<std::vector<char>> range_buffers(num_threads);
+        getThreadPool().parallelFor(0, num_ranges, num_threads, [&](size_t range, size_t thread_id) {
+            size_t begin = range * range_elements;
+            size_t end = std::min(begin + range_elements, cur_element_count_read);
+            size_t offset = level0_offset + begin * size_data_per_element_;
+            if (!soa_layout_) {
+                file.readAt(data_level0_memory_ + begin * size_data_per_element_, (end - begin) * size_data_per_element_, offset);
+                return;
+            }
+            std::vector<char> &buffer = range_buffers[thread_id];
+            buffer.resize((end - begin) * size_data_per_element_);
+            file.readAt(buffer.data(), buffer.size(), offset);
+            for (size_t i = begin; i < end; i++) {
+                copyLevel0ElementFrom(buffer.data() + (i - begin) * size_data_per_element_, i);
+            }
+        });
+        std::vector<std::vector<char>>().swap(range_buffers);
+
+        // the labels are in the base layer, their lookup is built meanwhile the link lists are read
+        std::exception_ptr lookup_exception;
+        std::thread lookup_thread([&]() {
+            try {
+                buildLabelLookup(cur_element_count_read);
+                for (size_t i = 0; i < cur_element_count_read; i++) {
+                    if (isMarkedDeleted(i)) {
+                        num_deleted_ += 1;
+                        if (allow_replace_deleted_) deleted_elements.insert(i);
+                    }
+                }
+            } catch (...) {
+                lookup_exception = std::current_exception();
+            }
+        });
+
+        try {
+            loadLegacyLinkLists(file, level0_offset + level0_size, cur_element_count_read, num_threads);
+        } catch (...) {
+            lookup_thread.join();
+            throw;
+        }
+        lookup_thread.join();
+        if (lookup_exception)
+            std::rethrow_exception(lookup_exception);
+        cur_element_count = cur_element_count_read;
+    }
+
+
+    // The legacy part of loadIndex(source) after the first field of the stream, which is in offsetLevel0_
+    void loadLegacyIndex(StreamReader &input, size_t stream_size, SpaceInterface<dist_t> *s, size_t max_elements_i) {
+        size_t cur_element_count_read = readLegacyIndexHeader(input, s, max_elements_i, stream_size);
+        initLoadedIndex();
+
+        if (!soa_layout_) {
+            input.read(data_level0_memory_, cur_element_count_read * size_data_per_element_);
+        } else {
+            std::vector<char> element(size_data_per_element_);
+            for (size_t i = 0; i < cur_element_count_read; i++) {
+                input.read(element.data(), size_data_per_element_);
+                copyLevel0ElementFrom(element.data(), i);
+            }
+        }
+
+        cur_element_count = cur_element_count_read;
+        for (size_t i = 0; i < cur_element_count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+            unsigned int linkListSize;
+            input.readPOD(linkListSize);
+            if (linkListSize == 0) {
+                linkLists_[i] = nullptr;
+            } else {
+                if (linkListSize % size_links_per_element_ != 0)
+                    throw std::runtime_error("Index seems to be corrupted or unsupported");
+                linkLists_[i] = (char *) malloc(linkListSize);
+                if (linkLists_[i] == nullptr)
+                    throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
+                element_levels_[i] = linkListSize / size_links_per_element_;
+                input.read(linkLists_[i], linkListSize);
+            }
+        }
+
+        if (!input.atEnd())
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        for (size_t i = 0; i < cur_element_count; i++) {
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
+    }
+
+
+    /*
+    * Reads the header of the legacy format after its first field (offsetLevel0_) and sets up the index for space s,
+    * returns the number of elements. stream_size is the size of the whole stream (0 if unknown), an index that
+    * cannot fit into it throws before anything is allocated for it.
+    */
+    size_t readLegacyIndexHeader(StreamReader &input, SpaceInterface<dist_t> *s, size_t max_elements_i, size_t stream_size) {
+        size_t cur_element_count_read;
+        input.readPOD(max_elements_);
+        input.readPOD(cur_element_count_read);
+
+        size_t max_elements = max_elements_i;
+        if (max_elements < cur_element_count_read)
+            max_elements = max_elements_;
+        max_elements_ = max_elements;
+        input.readPOD(size_data_per_element_);
+        input.readPOD(label_offset_);
+        input.readPOD(offsetData_);
+        input.readPOD(maxlevel_);
+        input.readPOD(enterpoint_node_);
+
+        input.readPOD(maxM_);
+        input.readPOD(maxM0_);
+        input.readPOD(M_);
+        input.readPOD(mult_);
+        input.readPOD(ef_construction_);
+
+        setSpace(s);
+
+        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+
+        // throw exception if it either corrupted or old index, before allocating for it
+        if (max_elements_ < cur_element_count_read || size_data_per_element_ == 0 ||
+            (stream_size != 0 && cur_element_count_read * (size_data_per_element_ + sizeof(unsigned int)) > input.remaining()))
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        if (size_data_per_element_ != size_links_level0_ + data_size_ + sizeof(labeltype))
+            throw std::runtime_error("The index was saved with another space");
+        return cur_element_count_read;
+    }
+
+
+    /*
+    * Reads the upper-layer link lists of the legacy format from offset to the end of the file into a single arena
+    * in parallel, as they are in the file. The link lists of the elements then point past the size of each,
+    * so the arena keeps 4 bytes per element on top of the lists.
+    */
+    void loadLegacyLinkLists(const RandomAccessFile &file, size_t offset, size_t element_count, size_t num_threads) {
+        if (offset > file.size())
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        size_t lists_size = file.size() - offset;
+        char *arena = allocLinkListArena(lists_size);
+        if (arena == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
+        size_t num_ranges = (lists_size + LOAD_RANGE_SIZE - 1) / LOAD_RANGE_SIZE;
+        getThreadPool().parallelFor(0, num_ranges, num_threads, [&](size_t range, size_t thread_id) {
+            size_t begin = range * LOAD_RANGE_SIZE;
+            size_t end = std::min(begin + LOAD_RANGE_SIZE, lists_size);
+            file.readAt(arena + begin, end - begin, offset + begin);
+        });
+
+        size_t position = 0;
+        for (size_t i = 0; i < element_count; i++) {
+            unsigned int linkListSize;
+            if (lists_size - position < sizeof(linkListSize))
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            memcpy(&linkListSize, arena + position, sizeof(linkListSize));
+            position += sizeof(linkListSize);
+            if (lists_size - position < linkListSize || linkListSize % size_links_per_element_ != 0)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            element_levels_[i] = linkListSize / size_links_per_element_;
+            linkLists_[i] = linkListSize > 0 ? arena + position : nullptr;
+            position += linkListSize;
+        }
+        if (position != lists_size)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+    }
+
+
+    /*
+    * Loads an index written by saveIndex (or in the legacy format) by mapping the file read-only into memory.
+    * The base layer and the upper-level link lists point directly into the mapping instead of being copied
+    * (the sections of the current format are used as the SOA layout), so processes that map the same file share
+    * the physical pages. Only the header checksum is verified by default, so loading is nearly instant and pages
+    * are read as searches touch them; with verify_checksums the sections are checksummed in parallel,
+    * which reads the whole file. The loaded index can only be searched: operations that modify it throw.
+    */
+    void loadIndexMmap(const std::string &location, SpaceInterface<dist_t> *s, bool verify_checksums = false) {
+        clear();
+        std::unique_ptr<MappedFile> mapped_file(new MappedFile(location));
+        uint64_t magic;
+        if (mapped_file->size() < sizeof(magic))
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        memcpy(&magic, mapped_file->data(), sizeof(magic));
+        if (magic != INDEX_MAGIC) {
+            loadLegacyIndexMmap(std::move(mapped_file), s);
+            return;
+        }
+
+        char *base = mapped_file->data();
+        MemorySource source(base, mapped_file->size());
+        StreamReader header(source, nullptr, INDEX_SECTION_ALIGNMENT);
+        header.readPOD(magic);
+        std::vector<IndexSectionEntry> sections;
+        size_t cur_element_count_read = readIndexFileHeader(header, s, 0, mapped_file->size(), sections);
+        // no elements can be added, so there is no need to keep room for them
+        max_elements_ = cur_element_count_read;
+
+        if (verify_checksums) {
+            for (const IndexSectionEntry &section : sections) {
+                if (memoryCRC(base + section.offset, section.size) != section.crc)
+                    throw std::runtime_error("Index seems to be corrupted: checksum mismatch");
+            }
+        }
+
+        const IndexSectionEntry &upper = sections[3];
+        std::vector<int32_t> levels(cur_element_count_read);
+        memcpy(levels.data(), base + upper.offset, levels.size() * sizeof(int32_t));
+        char **linkLists = (char **) malloc(sizeof(void *) * std::max(cur_element_count_read, (size_t) 1));
+        if (linkLists == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndexMmap failed to allocate linklists");
+        std::vector<int> element_levels(cur_element_count_read);
+        char *lists = base + upper.offset + levels.size() * sizeof(int32_t);
+        size_t position = 0;
+        for (size_t i = 0; i < levels.size(); i++) {
+            if (levels[i] < 0 || levels[i] > maxlevel_) {
+                free(linkLists);
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            }
+            element_levels[i] = levels[i];
+            linkLists[i] = levels[i] > 0 ? lists + position : nullptr;
+            position += levels[i] * size_links_per_element_;
+        }
+        if (position != upper.size - levels.size() * sizeof(int32_t)) {
+            free(linkLists);
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+
+        mapped_file_ = std::move(mapped_file);
+        soa_layout_ = true;
+        level0_links_ = base + sections[0].offset;
+        level0_data_ = base + sections[1].offset;
+        level0_labels_ = base + sections[2].offset;
+        level0_links_stride_ = sections[0].stride;
+        level0_data_stride_ = sections[1].stride;
+        level0_labels_stride_ = sections[2].stride;
+        linkLists_ = linkLists;
+        element_levels_.swap(element_levels);
+
+        resetLinkListLocks(max_elements_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+
+        resetVisitedListPool(max_elements_);
+
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+        buildLabelLookup(cur_element_count_read);
+        const IndexSectionEntry &deleted = sections[4];
+        std::vector<tableint> deleted_ids(deleted.size / sizeof(tableint));
+        memcpy(deleted_ids.data(), base + deleted.offset, deleted.size);
+        setDeletedElements(deleted_ids, cur_element_count_read);
+        cur_element_count = cur_element_count_read;
+    }
+
+
+    // CRC32C of memory, computed by all hardware threads in ranges
+    uint32_t memoryCRC(const char *data, size_t size) const {
+        size_t num_ranges = (size + LOAD_RANGE_SIZE - 1) / LOAD_RANGE_SIZE;
+        std::vector<uint32_t> crcs(num_ranges);
+        getThreadPool().parallelFor(0, num_ranges, std::thread::hardware_concurrency(), [&](size_t range, size_t thread_id) {
+            size_t begin = range * LOAD_RANGE_SIZE;
+            crcs[range] = CRC32C::update(0, data + begin, std::min((size_t) LOAD_RANGE_SIZE, size - begin));
+        });
+        uint32_t crc = 0;
+        for (size_t range = 0; range < num_ranges; range++) {
+            crc = CRC32C::combine(crc, crcs[range], std::min((size_t) LOAD_RANGE_SIZE, size - range * LOAD_RANGE_SIZE));
+        }
+        return crc;
+    }
+
+
+    void loadLegacyIndexMmap(std::unique_ptr<MappedFile> mapped_file, SpaceInterface<dist_t> *s) {
+        const char *input = mapped_file->data();
+        const char *input_end = input + mapped_file->size();
+
+        if (mapped_file->size() < legacyIndexHeaderSize())
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+
+        size_t cur_element_count_read;
+        readBinaryPOD(input, offsetLevel0_);
+        readBinaryPOD(input, max_elements_);
+        readBinaryPOD(input, cur_element_count_read);
+        readBinaryPOD(input, size_data_per_element_);
+        readBinaryPOD(input, label_offset_);
+        readBinaryPOD(input, offsetData_);
+        readBinaryPOD(input, maxlevel_);
+        readBinaryPOD(input, enterpoint_node_);
+
+        readBinaryPOD(input, maxM_);
+        readBinaryPOD(input, maxM0_);
+        readBinaryPOD(input, M_);
+        readBinaryPOD(input, mult_);
+        readBinaryPOD(input, ef_construction_);
+
+        setSpace(s);
+
+        // no elements can be added, so there is no need to keep room for them
+        max_elements_ = cur_element_count_read;
+
+        if ((size_t) (input_end - input) < cur_element_count_read * size_data_per_element_)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        char *level0 = (char *) input;
+        input += cur_element_count_read * size_data_per_element_;
+
+        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+        if (size_data_per_element_ != size_links_level0_ + data_size_ + sizeof(labeltype))
+            throw std::runtime_error("The index was saved with another space");
+
+        char **linkLists = (char **) malloc(sizeof(void *) * std::max(cur_element_count_read, (size_t) 1));
+        if (linkLists == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndexMmap failed to allocate linklists");
+        std::vector<int> element_levels(cur_element_count_read);
+        for (size_t i = 0; i < cur_element_count_read; i++) {
+            unsigned int linkListSize;
+            if ((size_t) (input_end - input) < sizeof(linkListSize)) {
+                free(linkLists);
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            }
+            readBinaryPOD(input, linkListSize);
+            if ((size_t) (input_end - input) < linkListSize) {
+                free(linkLists);
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            }
+            if (linkListSize == 0) {
+                element_levels[i] = 0;
+                linkLists[i] = nullptr;
+            } else {
+                element_levels[i] = linkListSize / size_links_per_element_;
+                linkLists[i] = (char *) input;
+                input += linkListSize;
+            }
+        }
+        if (input != input_end) {
+            free(linkLists);
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+
+        mapped_file_ = std::move(mapped_file);
+        data_level0_memory_ = level0;
+        soa_layout_ = false;
+        setInterleavedLevel0(data_level0_memory_);
+        linkLists_ = linkLists;
+        element_levels_.swap(element_levels);
+        cur_element_count = cur_element_count_read;
+
+        resetLinkListLocks(max_elements_);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+
+        resetVisitedListPool(max_elements_);
+
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+        for (size_t i = 0; i < cur_element_count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
+    }
+
+
+    /*
+    * Writes a checkpoint of a build to location, e.g. periodically from a separate thread while other threads insert.
+    * Waits until the running insertions, updates and changes of deleted marks are done and holds new ones back
+    * while writing, searches go on. The first checkpoint to a location writes the whole index, each following one
+    * appends a record with the elements added since the previous checkpoint and the link lists of the earlier
+    * elements that changed since then (their vectors only if they were updated). Every record ends with a trailer,
+    * so loadCheckpoint ignores a record cut off by a crash. Once the records add up to twice the size of the index,
+    * and after resizeIndex, reorderIndex or loading, the next checkpoint writes the whole index again, into a
+    * temporary file that is synced to the disk before it replaces the old one; a record is synced before the call
+    * returns. Must not be called from a thread that is inside addPoint, addPoints or markDelete, the progress
+    * callback of addPoints excepted.
+    */
+    void saveCheckpoint(const std::string &location) {
+        checkWritable();
+        withWritersHeldBack([&]() {
+            writeCheckpoint(location);
+        });
+    }
+
+
+    // Runs f once no insertion, update or change of a deleted mark is running, new ones wait until f returns
+    template<typename F>
+    void withWritersHeldBack(F f) {
+        std::unique_lock <std::mutex> lock(checkpoint_lock_);
+        checkpoint_cv_.wait(lock, [this] { return !checkpoint_pending_; });
+        checkpoint_pending_ = true;
+        checkpoint_cv_.wait(lock, [this] { return active_writers_ == 0; });
+        lock.unlock();
+
+        try {
+            f();
+        } catch (...) {
+            lock.lock();
+            checkpoint_pending_ = false;
+            lock.unlock();
+            checkpoint_cv_.notify_all();
+            throw;
+        }
+        lock.lock();
+        checkpoint_pending_ = false;
+        lock.unlock();
+        checkpoint_cv_.notify_all();
+    }
+
+
+    // Writes the record of saveCheckpoint, the writers are held back
+    void writeCheckpoint(const std::string &location) {
+        bool whole_index = checkpoint_location_ != location ||
+            checkpoint_file_size_ > (std::streamoff) (2 * legacyIndexFileSize());
+        // a failed write leaves the file in an unknown state, the next checkpoint then writes the whole index
+        checkpoint_location_.clear();
+        enableLinkListVersions();
+        if (whole_index) {
+            checkpoint_file_size_ = 0;
+            checkpoint_sequence_ = 0;
+            checkpoint_element_count_ = 0;
+            checkpoint_versions_.clear();
+            checkpoint_updated_.clear();
+        }
+
+        std::string output_location = whole_index ? location + ".tmp" : location;
+        std::fstream output;
+        if (whole_index)
+            output.open(output_location, std::ios::out | std::ios::binary | std::ios::trunc);
+        else
+            output.open(output_location, std::ios::in | std::ios::out | std::ios::binary);
+        if (!output.is_open())
+            throw std::runtime_error("Cannot open file");
+        output.seekp(checkpoint_file_size_);
+
+        if (whole_index) {
+            uint64_t magic = CHECKPOINT_MAGIC;
+            writeBinaryPOD(output, magic);
+            writeBinaryPOD(output, offsetLevel0_);
+            writeBinaryPOD(output, size_data_per_element_);
+            writeBinaryPOD(output, label_offset_);
+            writeBinaryPOD(output, offsetData_);
+            writeBinaryPOD(output, maxM_);
+            writeBinaryPOD(output, maxM0_);
+            writeBinaryPOD(output, M_);
+            writeBinaryPOD(output, mult_);
+            writeBinaryPOD(output, ef_construction_);
+        }
+
+        size_t element_count = cur_element_count;
+        std::vector<tableint> changed;
+        for (size_t i = 0; i < checkpoint_element_count_; i++) {
+            if (link_list_versions_[i].load(std::memory_order_acquire) != checkpoint_versions_[i])
+                changed.push_back(i);
+        }
+
+        uint64_t record_magic = CHECKPOINT_RECORD_MAGIC;
+        size_t num_changed = changed.size();
+        writeBinaryPOD(output, record_magic);
+        writeBinaryPOD(output, checkpoint_sequence_);
+        writeBinaryPOD(output, checkpoint_element_count_);
+        writeBinaryPOD(output, element_count);
+        writeBinaryPOD(output, max_elements_);
+        writeBinaryPOD(output, maxlevel_);
+        writeBinaryPOD(output, enterpoint_node_);
+        writeBinaryPOD(output, num_changed);
+
+        std::vector<char> element(size_data_per_element_);
+        for (size_t i = checkpoint_element_count_; i < element_count; i++) {
+            writeCheckpointElement(output, i, true, element.data());
+        }
+        for (tableint internal_id : changed) {
+            unsigned char with_data = checkpoint_updated_.count(internal_id) ? 1 : 0;
+            writeBinaryPOD(output, internal_id);
+            writeBinaryPOD(output, with_data);
+            writeCheckpointElement(output, internal_id, with_data, element.data());
+        }
+        writeBinaryPOD(output, record_magic);
+        writeBinaryPOD(output, checkpoint_sequence_);
+        output.flush();
+        if (!output)
+            throw std::runtime_error("Cannot write checkpoint");
+
+        checkpoint_file_size_ = output.tellp();
+        output.close();
+        if (whole_index) {
+            replaceFile(output_location, location);
+        } else {
+            syncFile(location);
+        }
+
+        checkpoint_versions_.resize(element_count);
+        for (size_t i = 0; i < element_count; i++) {
+            checkpoint_versions_[i] = link_list_versions_[i].load(std::memory_order_relaxed);
+        }
+        checkpoint_updated_.clear();
+        checkpoint_sequence_++;
+        checkpoint_element_count_ = element_count;
+        checkpoint_location_ = location;
+    }
+
+
+    // Writes the whole base layer element or, without data, only its level 0 link list, and then its upper link lists
+    void writeCheckpointElement(std::ostream &output, tableint internal_id, bool with_data, char *element) const {
+        if (with_data) {
+            copyLevel0ElementTo(internal_id, element);
+            output.write(element, size_data_per_element_);
+        } else {
+            output.write((char *) get_linklist0(internal_id), size_links_level0_);
+        }
+        unsigned int linkListSize = element_levels_[internal_id] > 0 ? size_links_per_element_ * element_levels_[internal_id] : 0;
+        writeBinaryPOD(output, linkListSize);
+        if (linkListSize)
+            output.write(linkLists_[internal_id], linkListSize);
+    }
+
+
+    /*
+    * Resumes a build from the checkpoints written by saveCheckpoint to location: the index gets the state of the
+    * last complete checkpoint, a record cut off by a crash is skipped. The build continues with the labels that
+    * are not in the index, e.g. the rest of an addPoints call that was checkpointed from its progress callback;
+    * if the build called addPoints in order with checkpoints only between the calls, these are the points after
+    * getCurrentElementCount(). The following checkpoints are appended to the same file.
+    * max_elements works as in loadIndex.
+    */
+    void loadCheckpoint(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i = 0) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        clear();
+        input.seekg(0, input.end);
+        std::streamoff total_filesize = input.tellg();
+        input.seekg(0, input.beg);
+
+        uint64_t magic = 0;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, offsetLevel0_);
+        readBinaryPOD(input, size_data_per_element_);
+        readBinaryPOD(input, label_offset_);
+        readBinaryPOD(input, offsetData_);
+        readBinaryPOD(input, maxM_);
+        readBinaryPOD(input, maxM0_);
+        readBinaryPOD(input, M_);
+        readBinaryPOD(input, mult_);
+        readBinaryPOD(input, ef_construction_);
+        if (!input || magic != CHECKPOINT_MAGIC)
+            throw std::runtime_error("Checkpoint seems to be corrupted or unsupported");
+
+        setSpace(s);
+        if (size_data_per_element_ != maxM0_ * sizeof(tableint) + sizeof(linklistsizeint) + data_size_ + sizeof(labeltype))
+            throw std::runtime_error("Checkpoint does not match the space");
+
+        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
+
+        // first pass: the complete records and the state after the last one
+        std::vector<std::streamoff> records;
+        std::streamoff records_end = input.tellg();
+        size_t element_count = 0;
+        size_t recorded_max_elements = 0;
+        maxlevel_ = -1;
+        enterpoint_node_ = -1;
+        while (true) {
+            CheckpointRecord record;
+            if (!readCheckpointRecordHeader(input, records.size(), element_count, record))
+                break;
+            bool complete = true;
+            for (size_t i = record.prev_element_count; complete && i < record.element_count; i++) {
+                complete = skipCheckpointElement(input, true, total_filesize);
+            }
+            for (size_t i = 0; complete && i < record.num_changed; i++) {
+                tableint internal_id;
+                unsigned char with_data;
+                readBinaryPOD(input, internal_id);
+                readBinaryPOD(input, with_data);
+                complete = skipCheckpointElement(input, with_data, total_filesize);
+            }
+            uint64_t trailer_magic = 0;
+            size_t trailer_sequence = 0;
+            if (complete) {
+                readBinaryPOD(input, trailer_magic);
+                readBinaryPOD(input, trailer_sequence);
+            }
+            if (!complete || !input || trailer_magic != CHECKPOINT_RECORD_MAGIC || trailer_sequence != records.size())
+                break;
+
+            records.push_back(record.start);
+            records_end = input.tellg();
+            element_count = record.element_count;
+            recorded_max_elements = record.max_elements;
+            maxlevel_ = record.maxlevel;
+            enterpoint_node_ = record.enterpoint_node;
+        }
+        input.clear();
+
+        size_t max_elements = max_elements_i;
+        if (max_elements < element_count)
+            max_elements = std::max(recorded_max_elements, element_count);
+        max_elements_ = max_elements;
+
+        cur_element_count = 0;
+        if (!reallocLevel0(max_elements))
+            throw std::runtime_error("Not enough memory: loadCheckpoint failed to allocate level0");
+        linkLists_ = (char **) malloc(sizeof(void *) * max_elements);
+        if (linkLists_ == nullptr)
+            throw std::runtime_error("Not enough memory: loadCheckpoint failed to allocate linklists");
+        element_levels_ = std::vector<int>(max_elements);
+        resetLinkListLocks(max_elements);
+        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        resetVisitedListPool(max_elements);
+        revSize_ = 1.0 / mult_;
+        ef_ = 10;
+
+        // second pass: apply the records in order
+        std::vector<char> element(size_data_per_element_);
+        for (size_t r = 0; r < records.size(); r++) {
+            input.seekg(records[r]);
+            CheckpointRecord record;
+            readCheckpointRecordHeader(input, r, cur_element_count, record);
+            for (size_t i = record.prev_element_count; i < record.element_count; i++) {
+                readCheckpointElement(input, i, true, element.data());
+            }
+            cur_element_count = record.element_count;
+            for (size_t i = 0; i < record.num_changed; i++) {
+                tableint internal_id;
+                unsigned char with_data;
+                readBinaryPOD(input, internal_id);
+                readBinaryPOD(input, with_data);
+                readCheckpointElement(input, internal_id, with_data, element.data());
+            }
+        }
+        input.close();
+
+        for (size_t i = 0; i < cur_element_count; i++) {
+            label_lookup_[getExternalLabel(i)] = i;
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
+
+        checkpoint_location_ = location;
+        checkpoint_file_size_ = records_end;
+        checkpoint_sequence_ = records.size();
+        checkpoint_element_count_ = cur_element_count;
+        enableLinkListVersions();
+        checkpoint_versions_.assign(cur_element_count, 0);
+        checkpoint_updated_.clear();
+    }
+
+
+    struct CheckpointRecord {
+        std::streamoff start;
+        size_t prev_element_count;
+        size_t element_count;
+        size_t max_elements;
+        int maxlevel;
+        tableint enterpoint_node;
+        size_t num_changed;
+    };
+
+
+    // Reads the header of the record with the given sequence number that follows the state with element_count elements
+    bool readCheckpointRecordHeader(std::istream &input, size_t sequence, size_t element_count, CheckpointRecord &record) const {
+        uint64_t magic = 0;
+        size_t record_sequence = 0;
+        record.start = input.tellg();
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, record_sequence);
+        readBinaryPOD(input, record.prev_element_count);
+        readBinaryPOD(input, record.element_count);
+        readBinaryPOD(input, record.max_elements);
+        readBinaryPOD(input, record.maxlevel);
+        readBinaryPOD(input, record.enterpoint_node);
+        readBinaryPOD(input, record.num_changed);
+        return input && magic == CHECKPOINT_RECORD_MAGIC && record_sequence == sequence &&
+            record.prev_element_count == element_count && record.element_count >= element_count &&
+            record.num_changed <= element_count;
+    }
+
+
+    // Skips an element written by writeCheckpointElement, false if the file ends within it
+    bool skipCheckpointElement(std::istream &input, bool with_data, std::streamoff total_filesize) const {
+        input.seekg(with_data ? size_data_per_element_ : size_links_level0_, input.cur);
+        unsigned int linkListSize = 0;
+        readBinaryPOD(input, linkListSize);
+        if (!input || input.tellg() + (std::streamoff) linkListSize > total_filesize)
+            return false;
+        input.seekg(linkListSize, input.cur);
+        return true;
+    }
+
+
+    void readCheckpointElement(std::istream &input, tableint internal_id, bool with_data, char *element) {
+        if (with_data) {
+            input.read(element, size_data_per_element_);
+            copyLevel0ElementFrom(element, internal_id);
+        } else {
+            input.read((char *) get_linklist0(internal_id), size_links_level0_);
+        }
+        if (element_levels_[internal_id] > 0)
+            freeLinkList(internal_id);
+        unsigned int linkListSize;
+        readBinaryPOD(input, linkListSize);
+        if (linkListSize == 0) {
+            element_levels_[internal_id] = 0;
+            linkLists_[internal_id] = nullptr;
+        } else {
+            element_levels_[internal_id] = linkListSize / size_links_per_element_;
+            linkLists_[internal_id] = (char *) malloc(linkListSize);
+            if (linkLists_[internal_id] == nullptr)
+                throw std::runtime_error("Not enough memory: loadCheckpoint failed to allocate linklist");
+            input.read(linkLists_[internal_id], linkListSize);
+        }
+    }
+
+
+    /*
+    * Starts an update log: saves the index to location as the base snapshot and starts an empty log at log_location.
+    * From then on addPoint, addPoints, updates and changes of the deleted marks record the elements they change,
+    * and commitLog appends the changes since the previous commit to the log as one record and syncs it to the disk,
+    * so persisting the index costs the size of the changes instead of a rewrite of the whole index.
+    * loadIndexWithLog rebuilds the exact state of the last commit from both files. compactLog writes a new base
+    * snapshot and empties the log. Changes after the last commit are lost when the index is destroyed, cleared or
+    * loaded again. Must not be called from a thread that is inside addPoint, addPoints or markDelete.
+    */
+    void startLog(const std::string &location, const std::string &log_location) {
+        checkWritable();
+        if (log_active_)
+            throw std::runtime_error("The index already has an update log");
+        withWritersHeldBack([&]() {
+            log_index_location_ = location;
+            log_location_ = log_location;
+            std::vector<LogChangeStripe>(LOG_STRIPES).swap(log_changes_);
+            writeLogBase();
+            log_active_ = true;
+        });
+    }
+
+
+    /*
+    * Appends the changes since the previous commit to the log and syncs it to the disk, returns once they are durable.
+    * Waits until the running insertions, updates and changes of deleted marks are done and holds new ones back while
+    * the record is put together, not while it is written. Concurrent calls are grouped: a call during a commit waits
+    * for it and then one commit covers all calls that waited. A log that cannot be written, e.g. after a failed
+    * commit or after reorderIndex, is compacted by the next commit instead.
+    * Must not be called from a thread that is inside addPoint, addPoints or markDelete.
+    */
+    void commitLog() {
+        runLogCommit(false);
+    }
+
+
+    /*
+    * Compacts the log into the base snapshot: saves the index to a temporary file, starts a new log for it and then
+    * renames both over the old files. The writers are held back while the index is saved, searches go on.
+    */
+    void compactLog() {
+        runLogCommit(true);
+    }
+
+
+    /*
+    * Commits the changes and ends the update log, the files stay. A failed commit of the background commits
+    * (see setLogCommitInterval) is thrown here or by the next commitLog.
+    */
+    void stopLog() {
+        setLogCommitInterval(0);
+        commitLog();
+        closeLog();
+    }
+
+
+    /*
+    * Commits the update log every interval_ms milliseconds from a background thread, 0 stops the commits.
+    */
+    void setLogCommitInterval(size_t interval_ms) {
+        {
+            std::unique_lock <std::mutex> lock(log_lock_);
+            log_commit_thread_stop_ = true;
+        }
+        log_cv_.notify_all();
+        if (log_commit_thread_.joinable())
+            log_commit_thread_.join();
+        if (interval_ms == 0)
+            return;
+        if (!log_active_)
+            throw std::runtime_error("The index has no update log");
+
+        log_commit_thread_stop_ = false;
+        log_commit_thread_ = std::thread([this, interval_ms]() {
+            std::unique_lock <std::mutex> lock(log_lock_);
+            while (!log_cv_.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return log_commit_thread_stop_; })) {
+                lock.unlock();
+                try {
+                    commitLog();
+                } catch (...) {
+                    lock.lock();
+                    log_commit_exception_ = std::current_exception();
+                    return;
+                }
+                lock.lock();
+            }
+        });
+    }
+
+
+    // Size of the log in bytes, e.g. to decide when to compact it
+    size_t getLogSize() {
+        std::unique_lock <std::mutex> lock(log_lock_);
+        return log_file_ ? log_file_->size() : 0;
+    }
+
+
+    /*
+    * Loads the base snapshot at location and replays the records of the log at log_location, which gives the state
+    * of the last commit. A record cut off by a crash is dropped. The index then continues the log.
+    * max_elements works as in loadIndex.
+    */
+    void loadIndexWithLog(const std::string &location, const std::string &log_location, SpaceInterface<dist_t> *s,
+                          size_t max_elements_i = 0) {
+        clear();
+        // a compaction interrupted between its renames left the new log in the temporary file
+        uint32_t base_checksum = indexFileChecksum(location);
+        uint32_t log_base_checksum;
+        if (!readLogBaseChecksum(log_location, log_base_checksum) || log_base_checksum != base_checksum) {
+            std::string new_log_location = log_location + ".tmp";
+            if (!readLogBaseChecksum(new_log_location, log_base_checksum) || log_base_checksum != base_checksum)
+                throw std::runtime_error("The update log does not belong to the index");
+            replaceFile(new_log_location, log_location);
+        }
+
+        loadIndex(location, s, max_elements_i);
+        RandomAccessFile log(log_location);
+        size_t position = LOG_HEADER_SIZE;
+        uint64_t sequence = 0;
+        std::vector<char> payload;
+        while (log.size() - position >= LOG_RECORD_HEADER_SIZE) {
+            char header[LOG_RECORD_HEADER_SIZE];
+            log.readAt(header, sizeof(header), position);
+            const char *fields = header;
+            uint64_t magic, record_sequence, payload_size;
+            uint32_t crc;
+            readBinaryPOD(fields, magic);
+            readBinaryPOD(fields, record_sequence);
+            readBinaryPOD(fields, payload_size);
+            readBinaryPOD(fields, crc);
+            if (magic != LOG_RECORD_MAGIC || record_sequence != sequence ||
+                payload_size > log.size() - position - LOG_RECORD_HEADER_SIZE)
+                break;
+            payload.resize(payload_size);
+            log.readAt(payload.data(), payload_size, position + LOG_RECORD_HEADER_SIZE);
+            if (CRC32C::update(0, payload.data(), payload_size) != crc)
+                break;
+            applyLogRecord(payload);
+            position += LOG_RECORD_HEADER_SIZE + payload_size;
+            sequence++;
+        }
+
+        label_lookup_.clear();
+        num_deleted_ = 0;
+        deleted_elements.clear();
+        buildLabelLookup(cur_element_count);
+        for (size_t i = 0; i < cur_element_count; i++) {
+            if (isMarkedDeleted(i)) {
+                num_deleted_ += 1;
+                if (allow_replace_deleted_) deleted_elements.insert(i);
+            }
+        }
 
-        readBinaryPOD(input, maxM_);
-        readBinaryPOD(input, maxM0_);
-        readBinaryPOD(input, M_);
-        readBinaryPOD(input, mult_);
-        readBinaryPOD(input, ef_construction_);
+        log_index_location_ = location;
+        log_location_ = log_location;
+        log_file_.reset(new AppendFile(log_location, position));
+        std::vector<LogChangeStripe>(LOG_STRIPES).swap(log_changes_);
+        log_sequence_ = sequence;
+        log_element_count_ = cur_element_count;
+        log_compaction_required_ = false;
+        log_active_ = true;
+    }
 
-        data_size_ = s->get_data_size();
-        fstdistfunc_ = s->get_dist_func();
-        dist_func_param_ = s->get_dist_func_param();
 
-        auto pos = input.tellg();
+    // Records a change of an element for the next commit of the log
+    void noteLogChange(tableint internal_id, unsigned char change) {
+        LogChangeStripe &stripe = log_changes_[internal_id % LOG_STRIPES];
+        std::unique_lock <std::mutex> lock(stripe.lock);
+        stripe.changes.emplace_back(internal_id, change);
+    }
 
-        /// Optional - check if index is ok:
-        input.seekg(cur_element_count * size_data_per_element_, input.cur);
-        for (size_t i = 0; i < cur_element_count; i++) {
-            if (input.tellg() < 0 || input.tellg() >= total_filesize) {
-                throw std::runtime_error("Index seems to be corrupted or unsupported");
-            }
 
-            unsigned int linkListSize;
-            readBinaryPOD(input, linkListSize);
-            if (linkListSize != 0) {
-                input.seekg(linkListSize, input.cur);
+    // Ends the log without a commit, stops the background commits
+    void closeLog() {
+        if (log_commit_thread_.joinable()) {
+            {
+                std::unique_lock <std::mutex> lock(log_lock_);
+                log_commit_thread_stop_ = true;
             }
+            log_cv_.notify_all();
+            log_commit_thread_.join();
         }
+        std::unique_lock <std::mutex> lock(log_lock_);
+        log_active_ = false;
+        log_file_.reset(nullptr);
+        log_changes_.clear();
+        log_index_location_.clear();
+        log_location_.clear();
+        log_commit_exception_ = nullptr;
+    }
 
-        // throw exception if it either corrupted or old index
-        if (input.tellg() != total_filesize)
-            throw std::runtime_error("Index seems to be corrupted or unsupported");
-
-        input.clear();
-        /// Optional check end
 
-        input.seekg(pos, input.beg);
+    // Commits the log or compacts it, one caller at a time commits for all calls before it
+    void runLogCommit(bool compact) {
+        std::unique_lock <std::mutex> lock(log_lock_);
+        if (log_commit_exception_) {
+            std::exception_ptr exception = log_commit_exception_;
+            log_commit_exception_ = nullptr;
+            std::rethrow_exception(exception);
+        }
+        if (!log_active_)
+            throw std::runtime_error("The index has no update log");
+        uint64_t request = ++log_requests_;
+        log_cv_.wait(lock, [&] { return !log_committing_ || (!compact && log_committed_ >= request); });
+        if (!compact && log_committed_ >= request)
+            return;
+        log_committing_ = true;
+        uint64_t covered = log_requests_;
+        lock.unlock();
+
+        try {
+            std::vector<char> record;
+            withWritersHeldBack([&]() {
+                if (compact || log_compaction_required_)
+                    writeLogBase();
+                else
+                    record = buildLogRecord();
+            });
+            if (!record.empty()) {
+                try {
+                    log_file_->append(record.data(), record.size());
+                    log_file_->sync();
+                } catch (...) {
+                    // the changes of the record are only in the index now
+                    log_compaction_required_ = true;
+                    throw;
+                }
+            }
+        } catch (...) {
+            lock.lock();
+            log_committing_ = false;
+            lock.unlock();
+            log_cv_.notify_all();
+            throw;
+        }
+        lock.lock();
+        log_committing_ = false;
+        log_committed_ = covered;
+        lock.unlock();
+        log_cv_.notify_all();
+    }
 
-        data_level0_memory_ = (char *) malloc(max_elements * size_data_per_element_);
-        if (data_level0_memory_ == nullptr)
-            throw std::runtime_error("Not enough memory: loadIndex failed to allocate level0");
-        input.read(data_level0_memory_, cur_element_count * size_data_per_element_);
 
-        size_links_per_element_ = maxM_ * sizeof(tableint) + sizeof(linklistsizeint);
+    // Writes the base snapshot and an empty log for it, both replace the old files at the end. The writers are held back
+    void writeLogBase() {
+        std::string index_location = log_index_location_ + ".tmp";
+        std::string log_location = log_location_ + ".tmp";
+        log_compaction_required_ = true;
+        saveIndex(index_location);
+        {
+            AppendFile log(log_location, 0);
+            uint64_t magic = LOG_MAGIC;
+            uint32_t version = LOG_VERSION;
+            uint32_t base_checksum = indexFileChecksum(index_location);
+            log.append((char *) &magic, sizeof(magic));
+            log.append((char *) &version, sizeof(version));
+            log.append((char *) &base_checksum, sizeof(base_checksum));
+            log.sync();
+        }
+        log_file_.reset(nullptr);
+        replaceFile(index_location, log_index_location_);
+        replaceFile(log_location, log_location_);
+        log_file_.reset(new AppendFile(log_location_, LOG_HEADER_SIZE));
 
-        size_links_level0_ = maxM0_ * sizeof(tableint) + sizeof(linklistsizeint);
-        std::vector<std::mutex>(max_elements).swap(link_list_locks_);
-        std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+        for (LogChangeStripe &stripe : log_changes_) {
+            std::vector<std::pair<tableint, unsigned char>>().swap(stripe.changes);
+        }
+        log_sequence_ = 0;
+        log_element_count_ = cur_element_count;
+        log_compaction_required_ = false;
+    }
 
-        visited_list_pool_.reset(new VisitedListPool(1, max_elements));
 
-        linkLists_ = (char **) malloc(sizeof(void *) * max_elements);
-        if (linkLists_ == nullptr)
-            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
-        element_levels_ = std::vector<int>(max_elements);
-        revSize_ = 1.0 / mult_;
-        ef_ = 10;
-        for (size_t i = 0; i < cur_element_count; i++) {
-            label_lookup_[getExternalLabel(i)] = i;
-            unsigned int linkListSize;
-            readBinaryPOD(input, linkListSize);
-            if (linkListSize == 0) {
-                element_levels_[i] = 0;
-                linkLists_[i] = nullptr;
-            } else {
-                element_levels_[i] = linkListSize / size_links_per_element_;
-                linkLists_[i] = (char *) malloc(linkListSize);
-                if (linkLists_[i] == nullptr)
-                    throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
-                input.read(linkLists_[i], linkListSize);
+    // Puts the changes since the last commit into a record, empty if nothing changed. The writers are held back
+    std::vector<char> buildLogRecord() {
+        std::vector<std::pair<tableint, unsigned char>> changes;
+        for (LogChangeStripe &stripe : log_changes_) {
+            changes.insert(changes.end(), stripe.changes.begin(), stripe.changes.end());
+            std::vector<std::pair<tableint, unsigned char>>().swap(stripe.changes);
+        }
+        // one entry per element with all its changes, the new elements are written whole
+        std::sort(changes.begin(), changes.end());
+        size_t num_changes = 0;
+        for (size_t i = 0; i < changes.size(); i++) {
+            if (changes[i].first >= log_element_count_)
+                continue;
+            if (num_changes > 0 && changes[num_changes - 1].first == changes[i].first)
+                changes[num_changes - 1].second |= changes[i].second;
+            else
+                changes[num_changes++] = changes[i];
+        }
+        changes.resize(num_changes);
+        size_t element_count = cur_element_count;
+        if (changes.empty() && element_count == log_element_count_)
+            return std::vector<char>();
+
+        std::vector<char> record(LOG_RECORD_HEADER_SIZE);
+        auto put = [&record](const void *data, size_t size) {
+            record.insert(record.end(), (const char *) data, (const char *) data + size);
+        };
+        uint64_t fields[] = {max_elements_, element_count, element_count - log_element_count_ + changes.size()};
+        int32_t maxlevel = maxlevel_;
+        uint32_t enterpoint_node = enterpoint_node_;
+        put(fields, sizeof(fields));
+        put(&maxlevel, sizeof(maxlevel));
+        put(&enterpoint_node, sizeof(enterpoint_node));
+        auto putElement = [&](tableint internal_id, unsigned char change) {
+            int32_t level = element_levels_[internal_id];
+            put(&internal_id, sizeof(internal_id));
+            put(&change, sizeof(change));
+            put(&level, sizeof(level));
+            if (change & LOG_LINKS) {
+                size_t start = record.size();
+                put(get_linklist0(internal_id), size_links_level0_);
+                // the spinlock of the element may be held by a search
+                record[start + 3] = 0;
+                if (level > 0)
+                    put(linkLists_[internal_id], level * size_links_per_element_);
+            }
+            if (change & LOG_DATA) {
+                labeltype label = getExternalLabel(internal_id);
+                put(&label, sizeof(label));
+                put(getDataByInternalId(internal_id), data_size_);
             }
+        };
+        for (size_t i = log_element_count_; i < element_count; i++) {
+            putElement(i, LOG_LINKS | LOG_DATA);
+        }
+        for (const std::pair<tableint, unsigned char> &change : changes) {
+            putElement(change.first, change.second);
         }
 
-        for (size_t i = 0; i < cur_element_count; i++) {
-            if (isMarkedDeleted(i)) {
-                num_deleted_ += 1;
-                if (allow_replace_deleted_) deleted_elements.insert(i);
+        uint64_t magic = LOG_RECORD_MAGIC;
+        uint64_t payload_size = record.size() - LOG_RECORD_HEADER_SIZE;
+        uint32_t crc = CRC32C::update(0, record.data() + LOG_RECORD_HEADER_SIZE, payload_size);
+        memcpy(record.data(), &magic, sizeof(magic));
+        memcpy(record.data() + 8, &log_sequence_, sizeof(log_sequence_));
+        memcpy(record.data() + 16, &payload_size, sizeof(payload_size));
+        memcpy(record.data() + 24, &crc, sizeof(crc));
+        log_sequence_++;
+        log_element_count_ = element_count;
+        return record;
+    }
+
+
+    // Applies a record of the log written by buildLogRecord to the index
+    void applyLogRecord(const std::vector<char> &payload) {
+        const char *input = payload.data();
+        const char *input_end = input + payload.size();
+        auto get = [&](void *data, size_t size) {
+            if ((size_t) (input_end - input) < size)
+                throw std::runtime_error("Update log seems to be corrupted or unsupported");
+            memcpy(data, input, size);
+            input += size;
+        };
+        uint64_t max_elements, element_count, num_elements;
+        int32_t maxlevel;
+        uint32_t enterpoint_node;
+        get(&max_elements, sizeof(max_elements));
+        get(&element_count, sizeof(element_count));
+        get(&num_elements, sizeof(num_elements));
+        get(&maxlevel, sizeof(maxlevel));
+        get(&enterpoint_node, sizeof(enterpoint_node));
+        if (element_count < cur_element_count || (element_count > 0 && enterpoint_node >= element_count))
+            throw std::runtime_error("Update log seems to be corrupted or unsupported");
+        if (element_count > max_elements_)
+            resizeIndex(std::max((size_t) max_elements, (size_t) element_count));
+
+        for (size_t i = 0; i < num_elements; i++) {
+            tableint internal_id;
+            unsigned char change;
+            int32_t level;
+            get(&internal_id, sizeof(internal_id));
+            get(&change, sizeof(change));
+            get(&level, sizeof(level));
+            bool is_new = internal_id >= cur_element_count;
+            if (internal_id >= element_count || level < 0 || level > maxlevel ||
+                (is_new && change != (LOG_LINKS | LOG_DATA)) || (!is_new && level != element_levels_[internal_id]))
+                throw std::runtime_error("Update log seems to be corrupted or unsupported");
+            if (change & LOG_LINKS) {
+                get(get_linklist0(internal_id), size_links_level0_);
+                if (is_new) {
+                    element_levels_[internal_id] = level;
+                    linkLists_[internal_id] = nullptr;
+                    if (level > 0) {
+                        linkLists_[internal_id] = (char *) malloc(size_links_per_element_ * level + 1);
+                        if (linkLists_[internal_id] == nullptr)
+                            throw std::runtime_error("Not enough memory: loadIndexWithLog failed to allocate linklist");
+                    }
+                }
+                if (level > 0)
+                    get(linkLists_[internal_id], level * size_links_per_element_);
+            }
+            if (change & LOG_DATA) {
+                get(getExternalLabeLp(internal_id), sizeof(labeltype));
+                get(getDataByInternalId(internal_id), data_size_);
             }
         }
+        if (input != input_end)
+            throw std::runtime_error("Update log seems to be corrupted or unsupported");
+        cur_element_count = element_count;
+        maxlevel_ = maxlevel;
+        enterpoint_node_ = enterpoint_node;
+    }
+
+
+    // Checksum of the header of an index file written by saveIndex, which identifies the file
+    uint32_t indexFileChecksum(const std::string &location) const {
+        RandomAccessFile file(location);
+        size_t header_size = indexHeaderSize(INDEX_NUM_SECTIONS);
+        std::vector<char> header(header_size);
+        uint64_t magic;
+        if (file.size() < header_size)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        file.readAt(header.data(), header_size, 0);
+        memcpy(&magic, header.data(), sizeof(magic));
+        if (magic != INDEX_MAGIC)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        uint32_t checksum;
+        memcpy(&checksum, header.data() + header_size - sizeof(checksum), sizeof(checksum));
+        return checksum;
+    }
+
+
+    // Reads the checksum of the base snapshot from the header of a log, false if there is no valid log at location
+    static bool readLogBaseChecksum(const std::string &location, uint32_t &base_checksum) {
+        std::ifstream input(location, std::ios::binary);
+        uint64_t magic = 0;
+        uint32_t version = 0;
+        readBinaryPOD(input, magic);
+        readBinaryPOD(input, version);
+        readBinaryPOD(input, base_checksum);
+        return input && magic == LOG_MAGIC && version == LOG_VERSION;
+    }
 
-        input.close();
 
-        return;
+    // Renames the file from over the file to, once from is on the disk, so a crash leaves either file complete
+    static void replaceFile(const std::string &from, const std::string &to) {
+        syncFile(from);
+        if (std::rename(from.c_str(), to.c_str()) != 0) {
+            // rename does not replace an existing file on Windows
+            std::remove(to.c_str());
+            if (std::rename(from.c_str(), to.c_str()) != 0)
+                throw std::runtime_error("Cannot rename file");
+        }
+        syncDirectoryOf(to);
     }
 
 
     template<typename data_t>
     std::vector<data_t> getDataByLabel(labeltype label) const {
+        SearchScope search_scope(this);
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
         
@@ -837,6 +3876,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
         char* data_ptrv = getDataByInternalId(internalId);
         size_t dim = *((size_t *) dist_func_param_);
+        std::vector<char> restored;
+        if (preprocessing_) {
+            restored.resize(query_size_);
+            space_->restore_data(data_ptrv, restored.data());
+            data_ptrv = restored.data();
+        }
         std::vector<data_t> data;
         data_t* data_ptr = (data_t*) data_ptrv;
         for (size_t i = 0; i < dim; i++) {
@@ -851,6 +3896,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     * Marks an element with the given label deleted, does NOT really change the current graph.
     */
     void markDelete(labeltype label) {
+        // registered before the label is locked, like the insertions
+        CheckpointWriterScope writer(this);
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
@@ -872,9 +3919,15 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     */
     void markDeletedInternal(tableint internalId) {
         assert(internalId < cur_element_count);
+        checkWritable();
         if (!isMarkedDeleted(internalId)) {
-            unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId))+2;
-            *ll_cur |= DELETE_MARK;
+            {
+                // the version change makes the next checkpoint write the element
+                LinkListLock lock(this, internalId);
+                LinkListUpdateGuard update_guard(this, internalId);
+                unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId))+2;
+                *ll_cur |= DELETE_MARK;
+            }
             num_deleted_ += 1;
             if (allow_replace_deleted_) {
                 std::unique_lock <std::mutex> lock_deleted_elements(deleted_elements_lock);
@@ -893,6 +3946,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     *  because elements marked as deleted can be completely removed by addPoint
     */
     void unmarkDelete(labeltype label) {
+        // registered before the label is locked, like the insertions
+        CheckpointWriterScope writer(this);
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
 
@@ -914,9 +3969,14 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     */
     void unmarkDeletedInternal(tableint internalId) {
         assert(internalId < cur_element_count);
+        checkWritable();
         if (isMarkedDeleted(internalId)) {
-            unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId)) + 2;
-            *ll_cur &= ~DELETE_MARK;
+            {
+                LinkListLock lock(this, internalId);
+                LinkListUpdateGuard update_guard(this, internalId);
+                unsigned char *ll_cur = ((unsigned char *)get_linklist0(internalId)) + 2;
+                *ll_cur &= ~DELETE_MARK;
+            }
             num_deleted_ -= 1;
             if (allow_replace_deleted_) {
                 std::unique_lock <std::mutex> lock_deleted_elements(deleted_elements_lock);
@@ -950,11 +4010,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     /*
     * Adds point. Updates the point if it is already in the index.
     * If replacement of deleted elements is enabled: replaces previously deleted point if any, updating it with new point
+    * Spaces with preprocessing get the point as the user has it, e.g. not normalized for CosineSpace.
     */
     void addPoint(const void *data_point, labeltype label, bool replace_deleted = false) {
+        checkWritable();
         if ((allow_replace_deleted_ == false) && (replace_deleted == true)) {
             throw std::runtime_error("Replacement of deleted elements is disabled in constructor");
         }
+        CheckpointWriterScope writer(this);
+        addOrReplacePoint(data_point, label, replace_deleted);
+    }
+
+
+    // addPoint for a writer that is already registered for the checkpoints
+    void addOrReplacePoint(const void *data_point, labeltype label, bool replace_deleted) {
+        if (preprocessing_) {
+            char *prepared = getPreparedBuffer(data_size_);
+            space_->prepare_data(data_point, prepared);
+            data_point = prepared;
+        }
 
         // lock all operations with element by label
         std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
@@ -992,9 +4066,126 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    /*
+    * Adds n points stored one after another in data (get_query_size() bytes each for spaces with preprocessing,
+    * get_data_size() bytes otherwise) with labels[i], on the internal thread pool with num_threads threads (0 means all cores).
+    * The labels are sorted into new and existing ones and the levels of the new elements drawn in one critical
+    * section, then the new elements are inserted from the highest level down, so the upper layers are complete
+    * before the bulk of level 0 elements searches through them. Each new element gets its internal id and its
+    * label when its insertion starts, under the lock of its label as in addPoint, so other operations on the
+    * label wait for a complete element and the ids follow the order of insertion. Labels that are already in the
+    * index, or were added concurrently, are updated; a label repeated in data gets its last vector.
+    * Every point is a writer of its own for the checkpoints, so a checkpoint during the call only waits for the
+    * points being inserted and covers the points inserted so far.
+    * progress(done, n) is called about every 1% of the points, one call at a time from the inserting threads,
+    * and may call saveCheckpoint.
+    */
+    void addPoints(
+        const void *data,
+        const labeltype *labels,
+        size_t n,
+        size_t num_threads = 0,
+        std::function<void(size_t, size_t)> progress = nullptr) {
+        checkWritable();
+        if (n == 0) return;
+        size_t point_size = preprocessing_ ? query_size_ : data_size_;
+        const char *points = (const char *) data;
+
+        // positions in data of the new labels, and of the labels to update
+        std::vector<size_t> inserts;
+        std::vector<size_t> updates;
+        std::vector<int> levels;
+        {
+            // label -> (is an update, index in updates or inserts) for the labels seen in data
+            std::unordered_map<labeltype, std::pair<bool, size_t>> batch_labels;
+            std::unique_lock <std::mutex> lock_table(label_lookup_lock);
+            for (size_t i = 0; i < n; i++) {
+                auto found = batch_labels.find(labels[i]);
+                if (found != batch_labels.end()) {
+                    if (found->second.first)
+                        updates[found->second.second] = i;
+                    else
+                        inserts[found->second.second] = i;
+                } else if (label_lookup_.find(labels[i]) != label_lookup_.end()) {
+                    batch_labels[labels[i]] = std::make_pair(true, updates.size());
+                    updates.push_back(i);
+                } else {
+                    batch_labels[labels[i]] = std::make_pair(false, inserts.size());
+                    inserts.push_back(i);
+                }
+            }
+            if (cur_element_count + inserts.size() > max_elements_) {
+                throw std::runtime_error("The number of elements exceeds the specified limit");
+            }
+            for (size_t i = 0; i < inserts.size(); i++) {
+                levels.push_back(getRandomLevel(mult_));
+            }
+        }
+
+        std::vector<size_t> order(inserts.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&levels](size_t a, size_t b) { return levels[a] > levels[b]; });
+
+        size_t step = std::max(n / 100, (size_t) 1);
+        std::atomic<size_t> done{0};
+        std::mutex progress_lock;
+        auto reportDone = [&]() {
+            size_t cur_done = ++done;
+            if (progress && (cur_done % step == 0 || cur_done == n)) {
+                std::unique_lock <std::mutex> lock(progress_lock);
+                progress(cur_done, n);
+            }
+        };
+        auto insertOne = [&](size_t id, size_t thread_id) {
+            labeltype label = labels[inserts[order[id]]];
+            const void *data_point = points + inserts[order[id]] * point_size;
+            if (preprocessing_) {
+                char *prepared = getPreparedBuffer(data_size_);
+                space_->prepare_data(data_point, prepared);
+                data_point = prepared;
+            }
+            {
+                CheckpointWriterScope writer(this);
+                std::unique_lock <std::mutex> lock_label(getLabelOpMutex(label));
+                addPoint(data_point, label, levels[order[id]], true);
+            }
+            reportDone();
+        };
+
+        if (num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        num_threads = std::max(num_threads, (size_t) 1);
+        // the element with the highest level goes first alone, in an empty index it becomes the entry point
+        if (!inserts.empty())
+            insertOne(0, 0);
+        getThreadPool().parallelFor(1, inserts.size(), num_threads, insertOne);
+        getThreadPool().parallelFor(0, updates.size(), num_threads, [&](size_t id, size_t thread_id) {
+            {
+                CheckpointWriterScope writer(this);
+                addOrReplacePoint(points + updates[id] * point_size, labels[updates[id]], false);
+            }
+            reportDone();
+        });
+        // repeated labels were applied once
+        if (progress && done < n)
+            progress(n, n);
+    }
+
+
     void updatePoint(const void *dataPoint, tableint internalId, float updateNeighborProbability) {
+        checkWritable();
         // update the feature vector associated with existing point with new vector
-        memcpy(getDataByInternalId(internalId), dataPoint, data_size_);
+        {
+            LinkListLock lock(this, internalId);
+            LinkListUpdateGuard update_guard(this, internalId, LOG_DATA);
+            memcpy(getDataByInternalId(internalId), dataPoint, data_size_);
+        }
+        {
+            std::unique_lock <std::mutex> lock_checkpoint(checkpoint_lock_);
+            checkpoint_updated_.insert(internalId);
+        }
 
         int maxLevelCopy = maxlevel_;
         tableint entryPointCopy = enterpoint_node_;
@@ -1053,7 +4244,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 getNeighborsByHeuristic2(candidates, layer == 0 ? maxM0_ : maxM_);
 
                 {
-                    std::unique_lock <std::mutex> lock(link_list_locks_[neigh]);
+                    LinkListLock lock(this, neigh);
+                    LinkListUpdateGuard update_guard(this, neigh);
                     linklistsizeint *ll_cur;
                     ll_cur = get_linklist_at_level(neigh, layer);
                     size_t candSize = candidates.size();
@@ -1085,7 +4277,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 while (changed) {
                     changed = false;
                     unsigned int *data;
-                    std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                    LinkListLock lock(this, currObj);
                     data = get_linklist_at_level(currObj, level);
                     int size = getListCount(data);
                     tableint *datal = (tableint *) (data + 1);
@@ -1140,7 +4332,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
 
     std::vector<tableint> getConnectionsWithLock(tableint internalId, int level) {
-        std::unique_lock <std::mutex> lock(link_list_locks_[internalId]);
+        LinkListLock lock(this, internalId);
         unsigned int *data = get_linklist_at_level(internalId, level);
         int size = getListCount(data);
         std::vector<tableint> result(size);
@@ -1150,7 +4342,9 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
-    tableint addPoint(const void *data_point, labeltype label, int level) {
+    // Adds the point or updates its label; level > 0 (any level with exact_level) is the level of a new element
+    tableint addPoint(const void *data_point, labeltype label, int level, bool exact_level = false) {
+        checkWritable();
         tableint cur_c = 0;
         {
             // Checking if the element with the same label already exists
@@ -1183,11 +4377,25 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             label_lookup_[label] = cur_c;
         }
 
-        std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
-        int curlevel = getRandomLevel(mult_);
+        int curlevel = exact_level ? level : getRandomLevel(mult_);
         if (level > 0)
             curlevel = level;
+        insertNewElement(data_point, label, cur_c, curlevel);
+        return cur_c;
+    }
 
+
+    // Links the element with the reserved internal id cur_c into the graph at levels 0..curlevel
+    void insertNewElement(const void *data_point, labeltype label, tableint cur_c, int curlevel) {
+        // cleared before locking, the spinlock of the element is a part of it
+        if (!soa_layout_) {
+            memset(data_level0_memory_ + cur_c * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
+        } else {
+            memset(get_linklist0(cur_c), 0, level0_links_stride_);
+            memset(getDataByInternalId(cur_c), 0, level0_data_stride_);
+            memset(getExternalLabeLp(cur_c), 0, level0_labels_stride_);
+        }
+        LinkListLock lock_el(this, cur_c);
         element_levels_[cur_c] = curlevel;
 
         std::unique_lock <std::mutex> templock(global);
@@ -1197,8 +4405,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         tableint currObj = enterpoint_node_;
         tableint enterpoint_copy = enterpoint_node_;
 
-        memset(data_level0_memory_ + cur_c * size_data_per_element_ + offsetLevel0_, 0, size_data_per_element_);
-
         // Initialisation of the data and label
         memcpy(getExternalLabeLp(cur_c), &label, sizeof(labeltype));
         memcpy(getDataByInternalId(cur_c), data_point, data_size_);
@@ -1218,7 +4424,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     while (changed) {
                         changed = false;
                         unsigned int *data;
-                        std::unique_lock <std::mutex> lock(link_list_locks_[currObj]);
+                        LinkListLock lock(this, currObj);
                         data = get_linklist(currObj, level);
                         int size = getListCount(data);
 
@@ -1263,25 +4469,23 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             enterpoint_node_ = cur_c;
             maxlevel_ = curlevel;
         }
-        return cur_c;
     }
 
 
-    std::priority_queue<std::pair<dist_t, labeltype >>
-    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
-        std::priority_queue<std::pair<dist_t, labeltype >> result;
-        if (cur_element_count == 0) return result;
-
+    // Greedy search from the entry point down to level 1, returns the entry point for the base layer
+    template<typename dist_func_t>
+    tableint searchUpperLayers(const dist_func_t &dist_func, const void *query_data) const {
         tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        dist_t curdist = dist_func(query_data, getDataByInternalId(currObj));
+        linklistsizeint *link_list_buffer = lock_free_reads_ ? getLinkListBuffer() : nullptr;
 
-        for (int level = maxlevel_; level > 0; level--) {
+        for (int level = getSearchStartLevel(currObj); level > 0; level--) {
             bool changed = true;
             while (changed) {
                 changed = false;
                 unsigned int *data;
 
-                data = (unsigned int *) get_linklist(currObj, level);
+                data = (unsigned int *) getLinkListForSearch(currObj, level, link_list_buffer);
                 int size = getListCount(data);
                 metric_hops++;
                 metric_distance_computations+=size;
@@ -1291,7 +4495,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                     tableint cand = datal[i];
                     if (cand < 0 || cand > max_elements_)
                         throw std::runtime_error("cand error");
-                    dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+                    dist_t d = dist_func(query_data, getDataByInternalId(cand));
 
                     if (d < curdist) {
                         curdist = d;
@@ -1301,6 +4505,18 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
                 }
             }
         }
+        return currObj;
+    }
+
+
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        SearchScope search_scope(this);
+        std::priority_queue<std::pair<dist_t, labeltype >> result;
+        if (cur_element_count == 0) return result;
+
+        query_data = prepareQuery(query_data);
+        tableint currObj = searchUpperLayers(SpaceDistance<dist_t>(fstdistfunc_, dist_func_param_, fstbatchdistfunc_), query_data);
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
@@ -1324,43 +4540,320 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
-    std::vector<std::pair<dist_t, labeltype >>
-    searchStopConditionClosest(
+    /*
+    * Searches the base layer from ep_id with the state kept in ctx, which has to be prepared,
+    * and writes the k nearest neighbors to ctx.result.
+    */
+    void searchBaseLayerWithContext(
+        tableint ep_id,
         const void *query_data,
-        BaseSearchStopCondition<dist_t>& stop_condition,
-        BaseFilterFunctor* isIdAllowed = nullptr) const {
-        std::vector<std::pair<dist_t, labeltype >> result;
+        size_t ef,
+        size_t k,
+        SearchContext &ctx,
+        BaseFilterFunctor* isIdAllowed) const {
+        bool bare_bone_search = !num_deleted_ && !isIdAllowed;
+        if (bare_bone_search) {
+            searchBaseLayerST<true>(
+                    ep_id, query_data, ef, ctx.visited_list.get(), ctx.top_candidates, ctx.candidate_set, isIdAllowed);
+        } else {
+            searchBaseLayerST<false>(
+                    ep_id, query_data, ef, ctx.visited_list.get(), ctx.top_candidates, ctx.candidate_set, isIdAllowed);
+        }
+
+        while (ctx.top_candidates.size() > k) {
+            ctx.top_candidates.pop();
+        }
+        size_t sz = ctx.top_candidates.size();
+        ctx.result.resize(sz);
+        while (!ctx.top_candidates.empty()) {
+            std::pair<dist_t, tableint> rez = ctx.top_candidates.top();
+            ctx.result[--sz] = std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second));
+            ctx.top_candidates.pop();
+        }
+    }
+
+
+    /*
+    * Same as searchKnnCloserFirst, but all memory needed by the search is taken from ctx,
+    * so repeated searches with the same context do not allocate.
+    * Returns ctx.result, which stays valid until the next search with ctx.
+    */
+    const std::vector<std::pair<dist_t, labeltype>> &
+    searchKnn(const void *query_data, size_t k, SearchContext &ctx, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        SearchScope search_scope(this);
+        size_t ef = std::max(ef_, k);
+        ctx.prepare(max_elements_, ef, k, visited_set_type_, expectedVisits(ef));
+        if (cur_element_count == 0) return ctx.result;
+
+        query_data = prepareQuery(query_data);
+        tableint currObj;
+        searchUpperLayersInterleaved((const char *) query_data, 1, &currObj);
+        searchBaseLayerWithContext(currObj, query_data, ef, k, ctx, isIdAllowed);
+        return ctx.result;
+    }
+
+
+    /*
+    * Same as searchKnnCloserFirst, but the distance, the filter and the stop condition are template parameters,
+    * so that their calls are inlined in the search loop instead of going through a function pointer and virtual calls.
+    * dist_func(query_data, data) has to return the distance of the index space, e.g. a functor calling
+    * a kernel directly like FixedDimL2Distance<DIM, LEVEL>, and gets the query after the preprocessing of the space.
+    * filter_t needs bool operator()(labeltype) and stop_condition_t the methods of BaseSearchStopCondition,
+    * they do not have to derive from the base classes.
+    * With a stop condition k is only an upper bound on the number of results, as in searchStopConditionClosest.
+    */
+    template<typename dist_func_t, typename filter_t = BaseFilterFunctor, typename stop_condition_t = BaseSearchStopCondition<dist_t>>
+    std::vector<std::pair<dist_t, labeltype>>
+    searchKnnInlined(
+        const void *query_data,
+        size_t k,
+        const dist_func_t &dist_func,
+        filter_t* isIdAllowed = nullptr,
+        stop_condition_t* stop_condition = nullptr) const {
+        SearchScope search_scope(this);
+        std::vector<std::pair<dist_t, labeltype>> result;
         if (cur_element_count == 0) return result;
 
-        tableint currObj = enterpoint_node_;
-        dist_t curdist = fstdistfunc_(query_data, getDataByInternalId(enterpoint_node_), dist_func_param_);
+        query_data = prepareQuery(query_data);
+        tableint currObj = searchUpperLayers(dist_func, query_data);
 
-        for (int level = maxlevel_; level > 0; level--) {
-            bool changed = true;
-            while (changed) {
-                changed = false;
-                unsigned int *data;
+        VisitedList *vl = visited_list_pool_->getFreeVisitedList();
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
+        std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> candidate_set;
+        size_t ef = stop_condition ? 0 : std::max(ef_, k);
+        bool bare_bone_search = !num_deleted_ && !isIdAllowed && !stop_condition;
+        if (bare_bone_search) {
+            searchBaseLayerST<true, false>(
+                dist_func, currObj, query_data, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+        } else {
+            searchBaseLayerST<false, false>(
+                dist_func, currObj, query_data, ef, vl, top_candidates, candidate_set, isIdAllowed, stop_condition);
+        }
+        visited_list_pool_->releaseVisitedList(vl);
 
-                data = (unsigned int *) get_linklist(currObj, level);
-                int size = getListCount(data);
-                metric_hops++;
-                metric_distance_computations+=size;
+        if (!stop_condition) {
+            while (top_candidates.size() > k) {
+                top_candidates.pop();
+            }
+        }
+        size_t sz = top_candidates.size();
+        result.resize(sz);
+        while (!top_candidates.empty()) {
+            std::pair<dist_t, tableint> rez = top_candidates.top();
+            result[--sz] = std::pair<dist_t, labeltype>(rez.first, getExternalLabel(rez.second));
+            top_candidates.pop();
+        }
+        if (stop_condition) {
+            stop_condition->filter_results(result);
+            if (result.size() > k)
+                result.resize(k);
+        }
+        return result;
+    }
 
-                tableint *datal = (tableint *) (data + 1);
-                for (int i = 0; i < size; i++) {
-                    tableint cand = datal[i];
-                    if (cand < 0 || cand > max_elements_)
-                        throw std::runtime_error("cand error");
-                    dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
 
-                    if (d < curdist) {
-                        curdist = d;
-                        currObj = cand;
-                        changed = true;
+    /*
+    * Two stage search for indices that store compressed vectors: searches the rerank_k nearest candidates
+    * in the index, then recomputes their distances to rerank_query with rerank_space on the full precision
+    * vectors returned by get_rerank_data(label) and returns the k closest of them in the order of closer first.
+    */
+    template<typename rerank_dist_t>
+    std::vector<std::pair<rerank_dist_t, labeltype>>
+    searchKnnReranked(
+        const void *query_data,
+        size_t k,
+        size_t rerank_k,
+        const void *rerank_query,
+        SpaceInterface<rerank_dist_t> *rerank_space,
+        const std::function<const void *(labeltype)> &get_rerank_data,
+        BaseFilterFunctor* isIdAllowed = nullptr) const {
+        DISTFUNC<rerank_dist_t> rerank_distfunc = rerank_space->get_dist_func();
+        void *rerank_dist_func_param = rerank_space->get_dist_func_param();
+
+        std::priority_queue<std::pair<dist_t, labeltype >> candidates = searchKnn(query_data, std::max(k, rerank_k), isIdAllowed);
+        std::vector<std::pair<rerank_dist_t, labeltype>> result;
+        result.reserve(candidates.size());
+        while (!candidates.empty()) {
+            labeltype label = candidates.top().second;
+            rerank_dist_t dist = rerank_distfunc(rerank_query, get_rerank_data(label), rerank_dist_func_param);
+            result.emplace_back(dist, label);
+            candidates.pop();
+        }
+        std::sort(result.begin(), result.end());
+        if (result.size() > k) result.resize(k);
+        return result;
+    }
+
+
+    ThreadPool &getThreadPool() const {
+        std::unique_lock <std::mutex> lock(thread_pool_lock_);
+        if (!thread_pool_) {
+            // the calling thread takes part in the work
+            size_t num_workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+            thread_pool_ = std::unique_ptr<ThreadPool>(new ThreadPool(num_workers));
+        }
+        return *thread_pool_;
+    }
+
+
+    /*
+    * Greedy search through the upper layers for a group of queries, writes the entry point into the base layer
+    * of every query to entry_points. The queries advance in turns, and before the hop of one query the link list
+    * and the neighbor vectors of the next query's hop are prefetched, so their memory latency overlaps with
+    * the distance computations of the current query.
+    */
+    void searchUpperLayersInterleaved(const char *queries, size_t nq, tableint *entry_points) const {
+        dist_t curdist[UPPER_LAYER_SEARCH_GROUP_SIZE];
+        bool changed[UPPER_LAYER_SEARCH_GROUP_SIZE];
+        tableint entry_point = enterpoint_node_;
+        for (size_t q = 0; q < nq; q++) {
+            entry_points[q] = entry_point;
+            curdist[q] = fstdistfunc_(queries + q * query_size_, getDataByInternalId(entry_point), dist_func_param_);
+        }
+        linklistsizeint *link_list_buffer = lock_free_reads_ ? getLinkListBuffer() : nullptr;
+
+        for (int level = getSearchStartLevel(entry_point); level > 0; level--) {
+            size_t num_changed = nq;
+            for (size_t q = 0; q < nq; q++) {
+                changed[q] = true;
+            }
+            while (num_changed > 0) {
+                for (size_t q = 0; q < nq; q++) {
+                    if (!changed[q]) continue;
+#ifdef USE_SSE
+                    for (size_t next = (q + 1) % nq; next != q; next = (next + 1) % nq) {
+                        if (!changed[next]) continue;
+                        unsigned int *next_data = (unsigned int *) get_linklist(entry_points[next], level);
+                        int next_size = getListCount(next_data);
+                        for (int i = 1; i <= next_size; i++) {
+                            _mm_prefetch(getDataByInternalId(next_data[i]), _MM_HINT_T0);
+                        }
+                        break;
+                    }
+#endif
+                    changed[q] = false;
+                    num_changed--;
+                    const char *query_data = queries + q * query_size_;
+
+                    unsigned int *data = (unsigned int *) getLinkListForSearch(entry_points[q], level, link_list_buffer);
+                    int size = getListCount(data);
+                    metric_hops++;
+                    metric_distance_computations+=size;
+
+                    tableint *datal = (tableint *) (data + 1);
+                    for (int i = 0; i < size; i++) {
+                        tableint cand = datal[i];
+                        if (cand < 0 || cand > max_elements_)
+                            throw std::runtime_error("cand error");
+                        dist_t d = fstdistfunc_(query_data, getDataByInternalId(cand), dist_func_param_);
+
+                        if (d < curdist[q]) {
+                            curdist[q] = d;
+                            entry_points[q] = cand;
+                            changed[q] = true;
+                        }
+                    }
+                    if (changed[q])
+                        num_changed++;
+                }
+            }
+        }
+    }
+
+
+    /*
+    * Searches the k nearest neighbors for nq queries stored one after another in queries (get_query_size() bytes each).
+    * The results of the i-th query are written in the order of closer first to labels[i * k] and distances[i * k],
+    * if less than k neighbors are found the rest is filled with -1 labels and the maximum distance.
+    * The queries are processed on the internal thread pool with num_threads threads (0 means all cores)
+    * in groups of UPPER_LAYER_SEARCH_GROUP_SIZE. Only the greedy searches through the upper layers of a group are
+    * interleaved (see searchUpperLayersInterleaved), the base layer is searched for one query after another:
+    * the search of a single query already prefetches all neighbors of a hop before computing their distances,
+    * and interleaving it across the group, which needs a visited list per query, measured slower.
+    * Every thread reuses one SearchContext for all of its queries; searchKnnBatch_bench compares the batch
+    * with searches of single queries.
+    */
+    void searchKnnBatch(
+        const void *queries,
+        size_t nq,
+        size_t k,
+        labeltype *labels,
+        dist_t *distances,
+        size_t num_threads = 0,
+        BaseFilterFunctor* isIdAllowed = nullptr) const {
+        SearchScope search_scope(this);
+        for (size_t i = 0; i < nq * k; i++) {
+            labels[i] = (labeltype) -1;
+            distances[i] = std::numeric_limits<dist_t>::max();
+        }
+        if (cur_element_count == 0 || nq == 0 || k == 0) return;
+
+        if (num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        size_t num_groups = (nq + UPPER_LAYER_SEARCH_GROUP_SIZE - 1) / UPPER_LAYER_SEARCH_GROUP_SIZE;
+        num_threads = std::max(std::min(num_threads, num_groups), (size_t) 1);
+
+        std::vector<std::unique_ptr<SearchContext>> contexts;
+        for (size_t i = 0; i < num_threads; i++) {
+            contexts.push_back(getFreeSearchContext());
+        }
+
+        size_t ef = std::max(ef_, k);
+        try {
+            getThreadPool().parallelFor(0, num_groups, num_threads, [&](size_t group, size_t thread_id) {
+                SearchContext &ctx = *contexts[thread_id];
+                size_t start = group * UPPER_LAYER_SEARCH_GROUP_SIZE;
+                size_t group_size = std::min(UPPER_LAYER_SEARCH_GROUP_SIZE, nq - start);
+                const char *group_queries = (const char *) queries + start * query_size_;
+                if (preprocessing_) {
+                    char *prepared = getPreparedBuffer(group_size * query_size_);
+                    for (size_t q = 0; q < group_size; q++) {
+                        space_->prepare_query(group_queries + q * query_size_, prepared + q * query_size_);
+                    }
+                    group_queries = prepared;
+                }
+
+                tableint entry_points[UPPER_LAYER_SEARCH_GROUP_SIZE];
+                searchUpperLayersInterleaved(group_queries, group_size, entry_points);
+
+                for (size_t q = 0; q < group_size; q++) {
+#ifdef USE_SSE
+                    if (q + 1 < group_size)
+                        _mm_prefetch(get_linklist0(entry_points[q + 1]), _MM_HINT_T0);
+#endif
+                    ctx.prepare(max_elements_, ef, k, visited_set_type_, expectedVisits(ef));
+                    searchBaseLayerWithContext(entry_points[q], group_queries + q * query_size_, ef, k, ctx, isIdAllowed);
+
+                    size_t offset = (start + q) * k;
+                    for (size_t i = 0; i < ctx.result.size(); i++) {
+                        distances[offset + i] = ctx.result[i].first;
+                        labels[offset + i] = ctx.result[i].second;
                     }
                 }
+            });
+        } catch (...) {
+            for (auto &ctx : contexts) {
+                releaseSearchContext(std::move(ctx));
             }
+            throw;
         }
+        for (auto &ctx : contexts) {
+            releaseSearchContext(std::move(ctx));
+        }
+    }
+
+
+    std::vector<std::pair<dist_t, labeltype >>
+    searchStopConditionClosest(
+        const void *query_data,
+        BaseSearchStopCondition<dist_t>& stop_condition,
+        BaseFilterFunctor* isIdAllowed = nullptr) const {
+        SearchScope search_scope(this);
+        std::vector<std::pair<dist_t, labeltype >> result;
+        if (cur_element_count == 0) return result;
+
+        query_data = prepareQuery(query_data);
+        tableint currObj = searchUpperLayers(SpaceDistance<dist_t>(fstdistfunc_, dist_func_param_, fstbatchdistfunc_), query_data);
 
         std::priority_queue<std::pair<dist_t, tableint>, std::vector<std::pair<dist_t, tableint>>, CompareByFirst> top_candidates;
         top_candidates = searchBaseLayerST<false>(currObj, query_data, 0, isIdAllowed, &stop_condition);
@@ -44,9 +44,7 @@ static uint64_t xgetbv(unsigned int index) {
 }
 #endif
 
-#if defined(USE_AVX512)
 #include <immintrin.h>
-#endif
 
 #if defined(__GNUC__)
 #define PORTABLE_ALIGN32 __attribute__((aligned(32)))
@@ -114,16 +112,187 @@ static bool AVX512Capable() {
     }
     return HW_AVX512F && avx512Supported;
 }
+
+static bool AVX2FMACapable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+
+    // CPU support
+    cpuid(cpuInfo, 0, 0);
+    int nIds = cpuInfo[0];
+
+    bool HW_AVX2 = false;
+    if (nIds >= 0x00000007) {
+        cpuid(cpuInfo, 0x00000007, 0);
+        HW_AVX2 = (cpuInfo[1] & ((int)1 << 5)) != 0;
+    }
+
+    cpuid(cpuInfo, 0x00000001, 0);
+    bool HW_FMA = (cpuInfo[2] & ((int)1 << 12)) != 0;
+    bool HW_F16C = (cpuInfo[2] & ((int)1 << 29)) != 0;
+
+    return HW_AVX2 && HW_FMA && HW_F16C;
+}
+
+// AVX-512 VPOPCNTDQ, used by the Hamming space on top of SIMDLevel::AVX512
+static bool AVX512VPOPCNTDQCapable() {
+    if (!AVX512Capable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0, 0);
+    if (cpuInfo[0] < 0x00000007) return false;
+
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[2] & ((int)1 << 14)) != 0;
+}
+
+// AVX-512 VNNI with BW and VL, used by the 8-bit integer spaces on top of SIMDLevel::AVX512
+static bool AVX512VNNICapable() {
+    if (!AVX512Capable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0, 0);
+    if (cpuInfo[0] < 0x00000007) return false;
+
+    cpuid(cpuInfo, 0x00000007, 0);
+    bool HW_AVX512BW = (cpuInfo[1] & ((int)1 << 30)) != 0;
+    bool HW_AVX512VL = (cpuInfo[1] & ((int)1 << 31)) != 0;
+    bool HW_AVX512VNNI = (cpuInfo[2] & ((int)1 << 11)) != 0;
+    return HW_AVX512BW && HW_AVX512VL && HW_AVX512VNNI;
+}
+
+// Kernels for instruction sets above the compile flags are compiled with these attributes
+// and are only called after the runtime check in getSIMDLevel()
+#if defined(__GNUC__)
+#define HNSWLIB_TARGET_AVX __attribute__((target("avx")))
+#define HNSWLIB_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define HNSWLIB_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#define HNSWLIB_TARGET_POPCNT __attribute__((target("popcnt")))
+#define HNSWLIB_TARGET_AVX512_VPOPCNTDQ __attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+#define HNSWLIB_TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni,avx2,fma,f16c")))
+#else
+#define HNSWLIB_TARGET_AVX
+#define HNSWLIB_TARGET_AVX2
+#define HNSWLIB_TARGET_AVX512
+#define HNSWLIB_TARGET_POPCNT
+#define HNSWLIB_TARGET_AVX512_VPOPCNTDQ
+#define HNSWLIB_TARGET_AVX512_VNNI
+#endif
+
+// _mm256_maskload_ps masks for the last qty % 8 floats, loaded from SIMDTailMask + 8 - qty % 8
+static const int32_t PORTABLE_ALIGN32 SIMDTailMask[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+static HNSWLIB_TARGET_AVX2 inline float
+HorizontalSumAVX(__m256 sum) {
+    __m128 sum128 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    sum128 = _mm_add_ps(sum128, _mm_movehl_ps(sum128, sum128));
+    sum128 = _mm_add_ss(sum128, _mm_shuffle_ps(sum128, sum128, 1));
+    return _mm_cvtss_f32(sum128);
+}
+
+static HNSWLIB_TARGET_AVX2 inline int
+HorizontalSumEpi32AVX(__m256i sum) {
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+}
+
+// The unmasked AVX-512 intrinsics of GCC merge into an undefined register, which -Wall reports as uninitialized.
+// The kernels use the zero-masking forms with every lane selected instead, they compute the same.
+static HNSWLIB_TARGET_AVX512 inline float
+HorizontalSumAVX512(__m512 sum) {
+    __m512d sum_pd = _mm512_castps_pd(sum);
+    __m256 low = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd((__mmask8) -1, sum_pd, 0));
+    __m256 high = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd((__mmask8) -1, sum_pd, 1));
+    return HorizontalSumAVX(_mm256_add_ps(low, high));
+}
+
+static HNSWLIB_TARGET_AVX512 inline int
+HorizontalSumEpi32AVX512(__m512i sum) {
+    __m256i low = _mm512_maskz_extracti64x4_epi64((__mmask8) -1, sum, 0);
+    __m256i high = _mm512_maskz_extracti64x4_epi64((__mmask8) -1, sum, 1);
+    return HorizontalSumEpi32AVX(_mm256_add_epi32(low, high));
+}
+
+static HNSWLIB_TARGET_AVX512 inline int64_t
+HorizontalSumEpi64AVX512(__m512i sum) {
+    __m256i sum256 = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64((__mmask8) -1, sum, 0),
+                                      _mm512_maskz_extracti64x4_epi64((__mmask8) -1, sum, 1));
+    __m128i sum128 = _mm_add_epi64(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+    sum128 = _mm_add_epi64(sum128, _mm_unpackhi_epi64(sum128, sum128));
+    return _mm_cvtsi128_si64(sum128);
+}
 #endif
 
 #include <queue>
 #include <vector>
 #include <iostream>
 #include <string.h>
+#include <string>
+#include <atomic>
+#include <stdexcept>
 
 namespace hnswlib {
 typedef size_t labeltype;
 
+// Instruction sets of the distance kernels, in increasing order
+enum class SIMDLevel {
+    SCALAR,
+    SSE,
+    AVX,
+    AVX2,    // AVX2, FMA and F16C
+    AVX512   // AVX-512F, FMA and masked tails
+};
+
+static inline const char *SIMDLevelName(SIMDLevel level) {
+    switch (level) {
+    case SIMDLevel::SCALAR: return "scalar";
+    case SIMDLevel::SSE: return "sse";
+    case SIMDLevel::AVX: return "avx";
+    case SIMDLevel::AVX2: return "avx2";
+    case SIMDLevel::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+// The best level supported by the CPU and the build (NO_MANUAL_VECTORIZATION disables all of them)
+static SIMDLevel detectSIMDLevel() {
+#if defined(USE_SSE)
+    if (AVX512Capable())
+        return SIMDLevel::AVX512;
+    if (AVX2FMACapable())
+        return SIMDLevel::AVX2;
+    if (AVXCapable())
+        return SIMDLevel::AVX;
+    return SIMDLevel::SSE;
+#else
+    return SIMDLevel::SCALAR;
+#endif
+}
+
+// Shared by all translation units, detected once per process
+inline std::atomic<SIMDLevel> &simdLevelRef() {
+    static std::atomic<SIMDLevel> level{detectSIMDLevel()};
+    return level;
+}
+
+// The level used by the spaces when they pick their distance functions
+static SIMDLevel getSIMDLevel() {
+    return simdLevelRef().load(std::memory_order_relaxed);
+}
+
+/*
+* Forces a lower level, e.g. for benchmarking the kernels against each other.
+* Only spaces created afterwards use it. Throws if the CPU does not support the level.
+*/
+static inline void setSIMDLevel(SIMDLevel level) {
+    if (level > detectSIMDLevel())
+        throw std::runtime_error(std::string("SIMD level ") + SIMDLevelName(level) + " is not supported by the CPU");
+    simdLevelRef().store(level, std::memory_order_relaxed);
+}
+
 // This can be extended to store state for filtering (e.g. from a std::set)
 class BaseFilterFunctor {
  public:
@@ -167,9 +336,59 @@ static void readBinaryPOD(std::istream &in, T &podRef) {
     in.read((char *) &podRef, sizeof(T));
 }
 
+template<typename T>
+static void readBinaryPOD(const char *&in, T &podRef) {
+    memcpy((char *) &podRef, in, sizeof(T));
+    in += sizeof(T);
+}
+
 template<typename MTYPE>
 using DISTFUNC = MTYPE(*)(const void *, const void *, const void *);
 
+// Distances from one query to n targets: out[i] = dist(query, targets[i]), with the parameter of the distance function
+template<typename MTYPE>
+using BATCHDISTFUNC = void(*)(const void *, const void *const *, size_t, MTYPE *, const void *);
+
+// Distance functor calling the distance function of a space through its pointer
+template<typename MTYPE>
+class SpaceDistance {
+    DISTFUNC<MTYPE> func_;
+    BATCHDISTFUNC<MTYPE> batch_func_;
+    void *param_;
+
+ public:
+    SpaceDistance(DISTFUNC<MTYPE> func, void *param, BATCHDISTFUNC<MTYPE> batch_func = nullptr)
+        : func_(func), batch_func_(batch_func), param_(param) {}
+
+    inline MTYPE operator()(const void *pVect1, const void *pVect2) const {
+        return func_(pVect1, pVect2, param_);
+    }
+
+    inline void batch(const void *query, const void *const *targets, size_t n, MTYPE *out) const {
+        if (batch_func_) {
+            batch_func_(query, targets, n, out, param_);
+        } else {
+            for (size_t i = 0; i < n; i++)
+                out[i] = func_(query, targets[i], param_);
+        }
+    }
+};
+
+// Distances from query to n targets with any distance functor, one call per target
+template<typename dist_func_t, typename MTYPE>
+inline void computeDistances(
+    const dist_func_t &dist_func, const void *query, const void *const *targets, size_t n, MTYPE *out) {
+    for (size_t i = 0; i < n; i++)
+        out[i] = dist_func(query, targets[i]);
+}
+
+// Same with the batch distance function of the space if it has one
+template<typename MTYPE>
+inline void computeDistances(
+    const SpaceDistance<MTYPE> &dist_func, const void *query, const void *const *targets, size_t n, MTYPE *out) {
+    dist_func.batch(query, targets, n, out);
+}
+
 template<typename MTYPE>
 class SpaceInterface {
  public:
@@ -180,6 +399,48 @@ class SpaceInterface {
 
     virtual void *get_dist_func_param() = 0;
 
+    /*
+    * Optional distance function scoring one query against several stored vectors in one call,
+    * it has to return the same distances as get_dist_func(). nullptr if the space has none.
+    */
+    virtual BATCHDISTFUNC<MTYPE> get_batch_dist_func() {
+        return nullptr;
+    }
+
+    // size of a query, differs from get_data_size() for spaces that compare queries of another type with the stored data
+    virtual size_t get_query_size() {
+        return get_data_size();
+    }
+
+    /*
+    * Optional preprocessing of the vectors given to an index, e.g. the normalization of CosineSpace.
+    * If has_preprocessing() is true, the indexes pass every inserted vector through prepare_data and every query
+    * through prepare_query once, and store get_data_size() resp. search get_query_size() prepared bytes.
+    * restore_data turns stored data back into the vector of get_query_size() bytes that was inserted, as far as
+    * the space keeps it, and is used by getDataByLabel. The functions are called concurrently by the indexes.
+    */
+    virtual bool has_preprocessing() {
+        return false;
+    }
+
+    virtual void prepare_data(const void * /*vector*/, void * /*data*/) {}
+
+    virtual void prepare_query(const void * /*query*/, void * /*prepared*/) {}
+
+    virtual void restore_data(const void * /*data*/, void * /*vector*/) {}
+
+    /*
+    * Name of the distance and of the stored representation (e.g. "l2", "ip_int8") and the dimension of the vectors.
+    * Saved indexes record both, and loading them with a space that reports others throws. "" and 0 if unknown.
+    */
+    virtual std::string get_name() {
+        return "";
+    }
+
+    virtual size_t get_dim() {
+        return 0;
+    }
+
     virtual ~SpaceInterface() {}
 };
 
@@ -223,6 +484,12 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_cosine.h"
+#include "space_sq8.h"
+#include "space_half.h"
+#include "space_hamming.h"
+#include "space_pq.h"
+#include "space_fixed_dim.h"
 #include "stop_condition.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
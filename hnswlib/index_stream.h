@@ -0,0 +1,777 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <stdio.h>
+#include <malloc.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hnswlib {
+
+/*
+* Called with the number of bytes written (or read) so far and the total number of bytes (0 if unknown).
+* Returning false cancels the operation, which then throws.
+*/
+typedef std::function<bool(size_t, size_t)> StreamProgress;
+
+static const size_t STREAM_CHUNK_SIZE = 4 << 20;  // default size of the chunks passed to sinks and read from sources
+static const size_t STREAM_ALIGNMENT = 4096;  // alignment of the chunk buffers, enough for O_DIRECT on common devices
+
+/*
+* Destination of a saved index. Receives the index as a sequence of chunks,
+* all but the last of them a multiple of alignment() bytes long and starting at an address aligned to it.
+*/
+class IndexSink {
+ public:
+    virtual ~IndexSink() {}
+
+    virtual void write(const char *data, size_t size) = 0;
+
+    // called once after the last chunk
+    virtual void finish() {}
+
+    virtual size_t alignment() const {
+        return 1;
+    }
+
+    // true if writeAt can overwrite bytes written before (files, memory), false for pipes and sockets
+    virtual bool seekable() const {
+        return false;
+    }
+
+    // overwrites size bytes at offset from the first byte written to the sink, called before finish
+    virtual void writeAt(size_t /*offset*/, const char * /*data*/, size_t /*size*/) {
+        throw std::runtime_error("Cannot write at an offset of the sink");
+    }
+};
+
+/*
+* Origin of a loaded index.
+*/
+class IndexSource {
+ public:
+    virtual ~IndexSource() {}
+
+    // reads up to size bytes, returns 0 only at the end of the stream
+    virtual size_t read(char *data, size_t size) = 0;
+
+    // total number of bytes of the stream, 0 if unknown (pipes, sockets)
+    virtual size_t size() const {
+        return 0;
+    }
+};
+
+
+/*
+* Sink appending to a memory buffer.
+*/
+class MemorySink : public IndexSink {
+    std::vector<char> &buffer_;
+    size_t start_;
+
+ public:
+    MemorySink(std::vector<char> &buffer) : buffer_(buffer), start_(buffer.size()) {}
+
+    void write(const char *data, size_t size) {
+        buffer_.insert(buffer_.end(), data, data + size);
+    }
+
+    bool seekable() const {
+        return true;
+    }
+
+    void writeAt(size_t offset, const char *data, size_t size) {
+        memcpy(buffer_.data() + start_ + offset, data, size);
+    }
+};
+
+
+/*
+* Source reading from memory, the memory has to outlive the source.
+*/
+class MemorySource : public IndexSource {
+    const char *data_;
+    size_t size_;
+    size_t position_{0};
+
+ public:
+    MemorySource(const char *data, size_t size) : data_(data), size_(size) {}
+
+    MemorySource(const std::vector<char> &buffer) : data_(buffer.data()), size_(buffer.size()) {}
+
+    size_t read(char *data, size_t size) {
+        size = std::min(size, size_ - position_);
+        memcpy(data, data_ + position_, size);
+        position_ += size;
+        return size;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+
+#if !defined(_WIN32)
+/*
+* Sink writing to a file descriptor (file, pipe, socket). The descriptor is not closed.
+*/
+class FdSink : public IndexSink {
+ protected:
+    int fd_;
+    off_t start_{-1};  // offset of the first byte written in the file, -1 if the descriptor is not seekable
+
+    void initStart() {
+        struct stat st;
+        int flags = fcntl(fd_, F_GETFL);
+        // pwrite appends with O_APPEND
+        if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && flags >= 0 && !(flags & O_APPEND))
+            start_ = lseek(fd_, 0, SEEK_CUR);
+    }
+
+ public:
+    FdSink(int fd) : fd_(fd) {
+        if (fd_ >= 0)
+            initStart();
+    }
+
+    void write(const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd_, data, size);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Cannot write file");
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    bool seekable() const {
+        return start_ >= 0;
+    }
+
+    void writeAt(size_t offset, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::pwrite(fd_, data, size, start_ + offset);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Cannot write file");
+            }
+            data += written;
+            offset += written;
+            size -= written;
+        }
+    }
+};
+
+
+/*
+* Source reading from a file descriptor (file, pipe, socket). The descriptor is not closed.
+*/
+class FdSource : public IndexSource {
+ protected:
+    int fd_;
+    size_t size_{0};
+
+ public:
+    FdSource(int fd) : fd_(fd) {
+        struct stat st;
+        if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode))
+            size_ = st.st_size;
+    }
+
+    size_t read(char *data, size_t size) {
+        while (true) {
+            ssize_t read_size = ::read(fd_, data, size);
+            if (read_size >= 0)
+                return read_size;
+            if (errno != EINTR)
+                throw std::runtime_error("Cannot read file");
+        }
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+
+/*
+* Sink creating (or truncating) a file.
+* With direct the page cache is bypassed (O_DIRECT, F_NOCACHE on macOS) where the file system supports it,
+* so saving a large index neither evicts the cache nor depends on writeback.
+*/
+class FileSink : public FdSink {
+    bool direct_{false};
+
+ public:
+    FileSink(const std::string &location, bool direct = false) : FdSink(-1) {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined(O_DIRECT)
+        if (direct) {
+            fd_ = open(location.c_str(), flags | O_DIRECT, 0644);
+            // some file systems (tmpfs) refuse O_DIRECT
+            direct_ = fd_ >= 0;
+        }
+#endif
+        if (fd_ < 0)
+            fd_ = open(location.c_str(), flags, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error("Cannot open file");
+#if defined(F_NOCACHE)
+        if (direct)
+            fcntl(fd_, F_NOCACHE, 1);
+#endif
+        initStart();
+    }
+
+    FileSink(const FileSink &) = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    ~FileSink() {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    void write(const char *data, size_t size) {
+        // the last chunk can have any size, which O_DIRECT does not accept
+        if (size % STREAM_ALIGNMENT != 0)
+            stopDirect();
+        FdSink::write(data, size);
+    }
+
+    void writeAt(size_t offset, const char *data, size_t size) {
+        stopDirect();
+        FdSink::writeAt(offset, data, size);
+    }
+
+    void finish() {
+        if (close(fd_) != 0) {
+            fd_ = -1;
+            throw std::runtime_error("Cannot write file");
+        }
+        fd_ = -1;
+    }
+
+    size_t alignment() const {
+        return direct_ ? STREAM_ALIGNMENT : 1;
+    }
+
+ private:
+    void stopDirect() {
+#if defined(O_DIRECT)
+        if (direct_) {
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+            direct_ = false;
+        }
+#endif
+    }
+};
+
+
+/*
+* Source reading a file.
+*/
+class FileSource : public FdSource {
+ public:
+    FileSource(const std::string &location) : FdSource(open(location.c_str(), O_RDONLY)) {
+        if (fd_ < 0)
+            throw std::runtime_error("Cannot open file");
+        struct stat st;
+        if (fstat(fd_, &st) == 0)
+            size_ = st.st_size;
+#if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    FileSource(const FileSource &) = delete;
+    FileSource &operator=(const FileSource &) = delete;
+
+    ~FileSource() {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+};
+#else
+class FileSink : public IndexSink {
+    FILE *file_;
+
+ public:
+    // direct is ignored on Windows
+    FileSink(const std::string &location, bool direct = false) {
+        file_ = fopen(location.c_str(), "wb");
+        if (file_ == nullptr)
+            throw std::runtime_error("Cannot open file");
+        setvbuf(file_, nullptr, _IONBF, 0);
+    }
+
+    FileSink(const FileSink &) = delete;
+    FileSink &operator=(const FileSink &) = delete;
+
+    ~FileSink() {
+        if (file_ != nullptr)
+            fclose(file_);
+    }
+
+    void write(const char *data, size_t size) {
+        if (fwrite(data, 1, size, file_) != size)
+            throw std::runtime_error("Cannot write file");
+    }
+
+    bool seekable() const {
+        return true;
+    }
+
+    void writeAt(size_t offset, const char *data, size_t size) {
+        bool written = _fseeki64(file_, offset, SEEK_SET) == 0 && fwrite(data, 1, size, file_) == size;
+        if (_fseeki64(file_, 0, SEEK_END) != 0 || !written)
+            throw std::runtime_error("Cannot write file");
+    }
+
+    void finish() {
+        int result = fclose(file_);
+        file_ = nullptr;
+        if (result != 0)
+            throw std::runtime_error("Cannot write file");
+    }
+};
+
+
+class FileSource : public IndexSource {
+    FILE *file_;
+    size_t size_{0};
+
+ public:
+    FileSource(const std::string &location) {
+        file_ = fopen(location.c_str(), "rb");
+        if (file_ == nullptr)
+            throw std::runtime_error("Cannot open file");
+        setvbuf(file_, nullptr, _IONBF, 0);
+        _fseeki64(file_, 0, SEEK_END);
+        size_ = (size_t) _ftelli64(file_);
+        _fseeki64(file_, 0, SEEK_SET);
+    }
+
+    FileSource(const FileSource &) = delete;
+    FileSource &operator=(const FileSource &) = delete;
+
+    ~FileSource() {
+        fclose(file_);
+    }
+
+    size_t read(char *data, size_t size) {
+        size_t read_size = fread(data, 1, size, file_);
+        if (read_size == 0 && ferror(file_))
+            throw std::runtime_error("Cannot read file");
+        return read_size;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+#endif
+
+
+/*
+* File read at explicit offsets, so several threads can read different parts of it at the same time.
+* As a source it reads the file from the beginning.
+*/
+class RandomAccessFile : public IndexSource {
+#if !defined(_WIN32)
+    int fd_;
+#else
+    HANDLE file_;
+#endif
+    size_t size_{0};
+    size_t position_{0};
+
+ public:
+    RandomAccessFile(const std::string &location) {
+#if !defined(_WIN32)
+        fd_ = open(location.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            throw std::runtime_error("Cannot open file");
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            close(fd_);
+            throw std::runtime_error("Cannot stat file");
+        }
+        size_ = st.st_size;
+#else
+        file_ = CreateFileA(location.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open file");
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_, &file_size)) {
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot stat file");
+        }
+        size_ = (size_t) file_size.QuadPart;
+#endif
+    }
+
+    RandomAccessFile(const RandomAccessFile &) = delete;
+    RandomAccessFile &operator=(const RandomAccessFile &) = delete;
+
+    ~RandomAccessFile() {
+#if !defined(_WIN32)
+        close(fd_);
+#else
+        CloseHandle(file_);
+#endif
+    }
+
+    // reads exactly size bytes at offset, throws if the file ends before
+    void readAt(char *data, size_t size, size_t offset) const {
+        while (size > 0) {
+#if !defined(_WIN32)
+            ssize_t read_size = pread(fd_, data, size, offset);
+            if (read_size < 0 && errno == EINTR)
+                continue;
+            if (read_size < 0)
+                throw std::runtime_error("Cannot read file");
+#else
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD) offset;
+            overlapped.OffsetHigh = (DWORD) ((uint64_t) offset >> 32);
+            DWORD read_size = 0;
+            DWORD part = (DWORD) std::min(size, (size_t) (1u << 30));
+            if (!ReadFile(file_, data, part, &read_size, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+                throw std::runtime_error("Cannot read file");
+#endif
+            if (read_size == 0)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            data += read_size;
+            size -= read_size;
+            offset += read_size;
+        }
+    }
+
+    size_t read(char *data, size_t size) {
+        size = std::min(size, size_ - position_);
+        readAt(data, size, position_);
+        position_ += size;
+        return size;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+
+/*
+* File that data is appended to and synced to the disk, e.g. a log. Opening keeps the first size bytes
+* of the file and drops the rest (size 0 creates or empties the file), so a part cut off by a crash is removed.
+*/
+class AppendFile {
+#if !defined(_WIN32)
+    int fd_;
+#else
+    HANDLE file_;
+#endif
+    size_t size_;
+
+ public:
+    AppendFile(const std::string &location, size_t size) : size_(size) {
+#if !defined(_WIN32)
+        fd_ = open(location.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error("Cannot open file");
+        if (ftruncate(fd_, size) != 0 || lseek(fd_, size, SEEK_SET) < 0) {
+            close(fd_);
+            throw std::runtime_error("Cannot write file");
+        }
+#else
+        file_ = CreateFileA(location.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open file");
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG) size;
+        if (!SetFilePointerEx(file_, position, nullptr, FILE_BEGIN) || !SetEndOfFile(file_)) {
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot write file");
+        }
+#endif
+    }
+
+    AppendFile(const AppendFile &) = delete;
+    AppendFile &operator=(const AppendFile &) = delete;
+
+    ~AppendFile() {
+#if !defined(_WIN32)
+        close(fd_);
+#else
+        CloseHandle(file_);
+#endif
+    }
+
+    void append(const char *data, size_t size) {
+        while (size > 0) {
+#if !defined(_WIN32)
+            ssize_t written = ::write(fd_, data, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                throw std::runtime_error("Cannot write file");
+#else
+            DWORD written = 0;
+            DWORD part = (DWORD) std::min(size, (size_t) (1u << 30));
+            if (!WriteFile(file_, data, part, &written, nullptr) || written == 0)
+                throw std::runtime_error("Cannot write file");
+#endif
+            data += written;
+            size -= written;
+            size_ += written;
+        }
+    }
+
+    // returns once the appended data is on the disk
+    void sync() {
+#if defined(_WIN32)
+        if (!FlushFileBuffers(file_))
+            throw std::runtime_error("Cannot sync file");
+#elif defined(__APPLE__)
+        if (fsync(fd_) != 0)
+            throw std::runtime_error("Cannot sync file");
+#else
+        if (fdatasync(fd_) != 0)
+            throw std::runtime_error("Cannot sync file");
+#endif
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+
+// Returns once the file at location is on the disk, e.g. before it replaces another file
+inline void syncFile(const std::string &location) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(location.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open file");
+    bool synced = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+#else
+    int fd = open(location.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open file");
+#if defined(__APPLE__)
+    bool synced = fsync(fd) == 0;
+#else
+    bool synced = fdatasync(fd) == 0;
+#endif
+    close(fd);
+#endif
+    if (!synced)
+        throw std::runtime_error("Cannot sync file");
+}
+
+
+// Returns once the entries of the directory that holds location, e.g. a file renamed into it, are on the disk
+inline void syncDirectoryOf(const std::string &location) {
+#if !defined(_WIN32)
+    size_t separator = location.find_last_of('/');
+    std::string directory = separator == std::string::npos ? "." : location.substr(0, std::max(separator, (size_t) 1));
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open directory");
+    // some file systems cannot sync directories and keep their entries safe without it
+    bool synced = fsync(fd) == 0 || errno == EINVAL;
+    close(fd);
+    if (!synced)
+        throw std::runtime_error("Cannot sync directory");
+#endif
+    // NTFS journals the rename itself, there is no directory handle to sync on Windows
+}
+
+
+/*
+* Buffers the writes of a serializer into aligned chunks of a fixed size,
+* so the memory used while saving is bounded by one chunk regardless of the size of the index.
+*/
+class StreamWriter {
+    IndexSink &sink_;
+    StreamProgress progress_;
+    size_t total_;
+    size_t chunk_size_;
+    char *buffer_;
+    size_t buffered_{0};
+    size_t written_{0};
+
+    void flushChunk() {
+        sink_.write(buffer_, buffered_);
+        written_ += buffered_;
+        buffered_ = 0;
+        if (progress_ && !progress_(written_, total_))
+            throw std::runtime_error("Index saving was cancelled");
+    }
+
+ public:
+    StreamWriter(IndexSink &sink, size_t total, StreamProgress progress = nullptr, size_t chunk_size = STREAM_CHUNK_SIZE)
+        : sink_(sink), progress_(progress), total_(total) {
+        // direct I/O needs the chunks to be whole blocks
+        chunk_size_ = std::max((chunk_size + STREAM_ALIGNMENT - 1) / STREAM_ALIGNMENT, (size_t) 1) * STREAM_ALIGNMENT;
+#if defined(_WIN32)
+        buffer_ = (char *) _aligned_malloc(chunk_size_, STREAM_ALIGNMENT);
+#else
+        if (posix_memalign((void **) &buffer_, STREAM_ALIGNMENT, chunk_size_) != 0)
+            buffer_ = nullptr;
+#endif
+        if (buffer_ == nullptr)
+            throw std::runtime_error("Not enough memory: StreamWriter failed to allocate buffer");
+    }
+
+    StreamWriter(const StreamWriter &) = delete;
+    StreamWriter &operator=(const StreamWriter &) = delete;
+
+    ~StreamWriter() {
+#if defined(_WIN32)
+        _aligned_free(buffer_);
+#else
+        free(buffer_);
+#endif
+    }
+
+    void write(const char *data, size_t size) {
+        while (size > 0) {
+            size_t part = std::min(size, chunk_size_ - buffered_);
+            memcpy(buffer_ + buffered_, data, part);
+            buffered_ += part;
+            data += part;
+            size -= part;
+            if (buffered_ == chunk_size_)
+                flushChunk();
+        }
+    }
+
+    template<typename T>
+    void writePOD(const T &podRef) {
+        write((const char *) &podRef, sizeof(T));
+    }
+
+    // writes the last (partial) chunk, after which the sink can be patched with writeAt
+    void flush() {
+        if (buffered_ > 0 || written_ == 0)
+            flushChunk();
+    }
+
+    // writes the last (partial) chunk and finishes the sink
+    void finish() {
+        flush();
+        sink_.finish();
+    }
+};
+
+
+/*
+* Reads a source in chunks of a fixed size. Large reads go directly into the destination.
+* Running out of data throws, as the stream is then truncated.
+*/
+class StreamReader {
+    IndexSource &source_;
+    StreamProgress progress_;
+    size_t chunk_size_;
+    std::vector<char> buffer_;
+    size_t begin_{0};
+    size_t end_{0};
+    size_t read_{0};
+    size_t reported_{0};
+
+    size_t readSource(char *data, size_t size) {
+        size_t read_size = source_.read(data, size);
+        read_ += read_size;
+        if (progress_ && (read_ - reported_ >= chunk_size_ || read_size == 0)) {
+            reported_ = read_;
+            if (!progress_(read_, source_.size()))
+                throw std::runtime_error("Index loading was cancelled");
+        }
+        return read_size;
+    }
+
+ public:
+    StreamReader(IndexSource &source, StreamProgress progress = nullptr, size_t chunk_size = STREAM_CHUNK_SIZE)
+        : source_(source), progress_(progress), chunk_size_(std::max(chunk_size, (size_t) 1)) {}
+
+    void read(char *data, size_t size) {
+        size_t part = std::min(size, end_ - begin_);
+        memcpy(data, buffer_.data() + begin_, part);
+        begin_ += part;
+        data += part;
+        size -= part;
+        while (size >= chunk_size_) {
+            size_t read_size = readSource(data, size);
+            if (read_size == 0)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            data += read_size;
+            size -= read_size;
+        }
+        while (size > 0) {
+            if (buffer_.empty())
+                buffer_.resize(chunk_size_);
+            begin_ = 0;
+            end_ = readSource(buffer_.data(), chunk_size_);
+            if (end_ == 0)
+                throw std::runtime_error("Index seems to be corrupted or unsupported");
+            part = std::min(size, end_);
+            memcpy(data, buffer_.data(), part);
+            begin_ = part;
+            data += part;
+            size -= part;
+        }
+    }
+
+    template<typename T>
+    void readPOD(T &podRef) {
+        read((char *) &podRef, sizeof(T));
+    }
+
+    // true if the stream has no more data
+    bool atEnd() {
+        if (begin_ < end_)
+            return false;
+        if (buffer_.empty())
+            buffer_.resize(chunk_size_);
+        begin_ = 0;
+        end_ = readSource(buffer_.data(), chunk_size_);
+        return end_ == 0;
+    }
+
+    // number of bytes which were not read yet, 0 if the size of the source is unknown
+    size_t remaining() const {
+        size_t total = source_.size();
+        size_t consumed = read_ - (end_ - begin_);
+        return total > consumed ? total - consumed : 0;
+    }
+};
+}  // namespace hnswlib
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hnswlib {
+
+/*
+* Read-only memory mapping of a whole file.
+* The mapping is shared, so several processes mapping the same file share the physical pages
+* through the page cache.
+*/
+class MappedFile {
+    char *data_{nullptr};
+    size_t size_{0};
+
+ public:
+    MappedFile(const std::string &location) {
+#if !defined(_WIN32)
+        int fd = open(location.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Cannot open file");
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Cannot stat file");
+        }
+        size_ = st.st_size;
+        if (size_ == 0) {
+            close(fd);
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw std::runtime_error("Cannot mmap file");
+        data_ = (char *) addr;
+#else
+        HANDLE file = CreateFileA(location.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open file");
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            throw std::runtime_error("Cannot stat file");
+        }
+        size_ = (size_t) file_size.QuadPart;
+        if (size_ == 0) {
+            CloseHandle(file);
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            throw std::runtime_error("Cannot mmap file");
+        void *addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        // the view keeps its own reference to the mapping
+        CloseHandle(mapping);
+        if (addr == nullptr)
+            throw std::runtime_error("Cannot mmap file");
+        data_ = (char *) addr;
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+        if (data_ == nullptr)
+            return;
+#if !defined(_WIN32)
+        munmap(data_, size_);
+#else
+        UnmapViewOfFile(data_);
+#endif
+    }
+
+    char *data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+}  // namespace hnswlib
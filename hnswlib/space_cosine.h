@@ -0,0 +1,113 @@
+#pragma once
+#include "hnswlib.h"
+#include <cmath>
+
+namespace hnswlib {
+
+/*
+* Cosine distance 1 - <x, y> / (|x| |y|).
+*
+* Vectors are normalized once, when they are inserted and when a query enters a search
+* (see SpaceInterface::has_preprocessing), the distances are then inner product distances of unit vectors
+* computed with the kernels of InnerProductSpace, including its batch kernels.
+* With store_norms the norm of every inserted vector is kept in one float after the normalized vector,
+* the data takes (dim + 1) * 4 bytes then and getDataByLabel returns the vectors as they were inserted.
+* Without it getDataByLabel returns the normalized vectors.
+*/
+
+// Picks the kernel of the plain inner product <x, y> used for the norms
+static DISTFUNC<float> GetInnerProductFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return InnerProductAVX512;
+    if (level >= SIMDLevel::AVX2)
+        return InnerProductAVX2;
+#endif
+    return InnerProduct;
+}
+
+class CosineSpace : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    BATCHDISTFUNC<float> batchdistfunc_;
+    DISTFUNC<float> normfunc_;
+    size_t data_size_;
+    size_t query_size_;
+    size_t dim_;
+    bool store_norms_;
+
+    // Writes vector / |vector| to out and returns |vector|, zero vectors stay zero
+    float normalize(const float *vector, float *out) const {
+        float norm = std::sqrt(normfunc_(vector, vector, &dim_));
+        float scale = 1.0f / (norm + 1e-30f);
+        for (size_t i = 0; i < dim_; i++) {
+            out[i] = vector[i] * scale;
+        }
+        return norm;
+    }
+
+ public:
+    CosineSpace(size_t dim, bool store_norms = false) {
+        fstdistfunc_ = GetInnerProductDistanceFunc(dim);
+        batchdistfunc_ = GetInnerProductDistanceBatchFunc();
+        normfunc_ = GetInnerProductFunc();
+        dim_ = dim;
+        store_norms_ = store_norms;
+        query_size_ = dim * sizeof(float);
+        data_size_ = store_norms ? (dim + 1) * sizeof(float) : query_size_;
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    std::string get_name() {
+        return "cosine";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
+    size_t get_query_size() {
+        return query_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    BATCHDISTFUNC<float> get_batch_dist_func() {
+        return batchdistfunc_;
+    }
+
+    bool has_preprocessing() {
+        return true;
+    }
+
+    void prepare_data(const void *vector, void *data) {
+        float norm = normalize((const float *) vector, (float *) data);
+        if (store_norms_)
+            ((float *) data)[dim_] = norm;
+    }
+
+    void prepare_query(const void *query, void *prepared) {
+        normalize((const float *) query, (float *) prepared);
+    }
+
+    void restore_data(const void *data, void *vector) {
+        const float *x = (const float *) data;
+        float norm = store_norms_ ? x[dim_] : 1.0f;
+        for (size_t i = 0; i < dim_; i++) {
+            ((float *) vector)[i] = x[i] * norm;
+        }
+    }
+
+    ~CosineSpace() {}
+};
+
+}  // namespace hnswlib
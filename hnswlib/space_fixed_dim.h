@@ -0,0 +1,308 @@
+#pragma once
+#include "hnswlib.h"
+#include <memory>
+
+namespace hnswlib {
+
+/*
+* L2 and inner product spaces with the dimension as a template parameter.
+*
+* The kernels have compile-time trip counts, so the compiler unrolls them and keeps several
+* accumulators in registers instead of reading the dimension from the distance function parameter.
+* They compute the same distances as L2Space and InnerProductSpace and plug into HierarchicalNSW
+* through SpaceInterface. createL2Space() and createInnerProductSpace() pick the specialization for
+* the common dimensions (HNSWLIB_FIXED_DIMS below) and fall back to the generic spaces otherwise.
+*/
+
+// Sum of (x[i] - y[i])^2 if IS_L2, of x[i] * y[i] otherwise
+template<size_t DIM, bool IS_L2>
+static float
+FixedDimSum(const float *x, const float *y) {
+    float res = 0;
+    for (size_t i = 0; i < DIM; i++) {
+        float t = IS_L2 ? x[i] - y[i] : x[i];
+        res += t * (IS_L2 ? t : y[i]);
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+template<bool IS_L2>
+static HNSWLIB_TARGET_AVX512 inline __m512
+FixedDimStepAVX512(__m512 v1, __m512 v2, __m512 sum) {
+    if (IS_L2) {
+        __m512 diff = _mm512_sub_ps(v1, v2);
+        return _mm512_fmadd_ps(diff, diff, sum);
+    }
+    return _mm512_fmadd_ps(v1, v2, sum);
+}
+
+template<size_t DIM, bool IS_L2>
+static HNSWLIB_TARGET_AVX512 float
+FixedDimSumAVX512(const float *x, const float *y) {
+    const size_t DIM64 = DIM / 64 * 64;
+    const size_t DIM16 = DIM / 16 * 16;
+
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    __m512 sum3 = _mm512_setzero_ps();
+    __m512 sum4 = _mm512_setzero_ps();
+    for (size_t i = 0; i < DIM64; i += 64) {
+        sum1 = FixedDimStepAVX512<IS_L2>(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), sum1);
+        sum2 = FixedDimStepAVX512<IS_L2>(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(y + i + 16), sum2);
+        sum3 = FixedDimStepAVX512<IS_L2>(_mm512_loadu_ps(x + i + 32), _mm512_loadu_ps(y + i + 32), sum3);
+        sum4 = FixedDimStepAVX512<IS_L2>(_mm512_loadu_ps(x + i + 48), _mm512_loadu_ps(y + i + 48), sum4);
+    }
+    for (size_t i = DIM64; i < DIM16; i += 16) {
+        sum1 = FixedDimStepAVX512<IS_L2>(_mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i), sum1);
+    }
+    if (DIM16 < DIM) {
+        const __mmask16 mask = (__mmask16) ((1u << (DIM - DIM16)) - 1);
+        sum2 = FixedDimStepAVX512<IS_L2>(
+            _mm512_maskz_loadu_ps(mask, x + DIM16), _mm512_maskz_loadu_ps(mask, y + DIM16), sum2);
+    }
+
+    return HorizontalSumAVX512(_mm512_add_ps(_mm512_add_ps(sum1, sum2), _mm512_add_ps(sum3, sum4)));
+}
+
+template<bool IS_L2>
+static HNSWLIB_TARGET_AVX2 inline __m256
+FixedDimStepAVX2(__m256 v1, __m256 v2, __m256 sum) {
+    if (IS_L2) {
+        __m256 diff = _mm256_sub_ps(v1, v2);
+        return _mm256_fmadd_ps(diff, diff, sum);
+    }
+    return _mm256_fmadd_ps(v1, v2, sum);
+}
+
+template<size_t DIM, bool IS_L2>
+static HNSWLIB_TARGET_AVX2 float
+FixedDimSumAVX2(const float *x, const float *y) {
+    const size_t DIM32 = DIM / 32 * 32;
+    const size_t DIM8 = DIM / 8 * 8;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    __m256 sum3 = _mm256_setzero_ps();
+    __m256 sum4 = _mm256_setzero_ps();
+    for (size_t i = 0; i < DIM32; i += 32) {
+        sum1 = FixedDimStepAVX2<IS_L2>(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum1);
+        sum2 = FixedDimStepAVX2<IS_L2>(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), sum2);
+        sum3 = FixedDimStepAVX2<IS_L2>(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), sum3);
+        sum4 = FixedDimStepAVX2<IS_L2>(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24), sum4);
+    }
+    for (size_t i = DIM32; i < DIM8; i += 8) {
+        sum1 = FixedDimStepAVX2<IS_L2>(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum1);
+    }
+    if (DIM8 < DIM) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *) (SIMDTailMask + 8 - (DIM - DIM8)));
+        sum2 = FixedDimStepAVX2<IS_L2>(_mm256_maskload_ps(x + DIM8, mask), _mm256_maskload_ps(y + DIM8, mask), sum2);
+    }
+
+    return HorizontalSumAVX(_mm256_add_ps(_mm256_add_ps(sum1, sum2), _mm256_add_ps(sum3, sum4)));
+}
+
+template<bool IS_L2>
+static inline __m128
+FixedDimStepSSE(__m128 v1, __m128 v2, __m128 sum) {
+    if (IS_L2) {
+        __m128 diff = _mm_sub_ps(v1, v2);
+        return _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+    }
+    return _mm_add_ps(sum, _mm_mul_ps(v1, v2));
+}
+
+template<size_t DIM, bool IS_L2>
+static float
+FixedDimSumSSE(const float *x, const float *y) {
+    const size_t DIM16 = DIM / 16 * 16;
+    const size_t DIM4 = DIM / 4 * 4;
+
+    __m128 sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps();
+    __m128 sum3 = _mm_setzero_ps();
+    __m128 sum4 = _mm_setzero_ps();
+    for (size_t i = 0; i < DIM16; i += 16) {
+        sum1 = FixedDimStepSSE<IS_L2>(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), sum1);
+        sum2 = FixedDimStepSSE<IS_L2>(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(y + i + 4), sum2);
+        sum3 = FixedDimStepSSE<IS_L2>(_mm_loadu_ps(x + i + 8), _mm_loadu_ps(y + i + 8), sum3);
+        sum4 = FixedDimStepSSE<IS_L2>(_mm_loadu_ps(x + i + 12), _mm_loadu_ps(y + i + 12), sum4);
+    }
+    for (size_t i = DIM16; i < DIM4; i += 4) {
+        sum1 = FixedDimStepSSE<IS_L2>(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), sum1);
+    }
+
+    float PORTABLE_ALIGN32 TmpRes[4];
+    _mm_store_ps(TmpRes, _mm_add_ps(_mm_add_ps(sum1, sum2), _mm_add_ps(sum3, sum4)));
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+    return res + FixedDimSum<DIM - DIM4, IS_L2>(x + DIM4, y + DIM4);
+}
+
+#endif
+
+// Distance functions with the DISTFUNC signature, the dimension parameter is not read
+template<float (*Sum)(const float *, const float *)>
+static float
+FixedDimL2Sqr(const void *pVect1, const void *pVect2, const void *) {
+    return Sum((const float *) pVect1, (const float *) pVect2);
+}
+
+template<float (*Sum)(const float *, const float *)>
+static float
+FixedDimInnerProductDistance(const void *pVect1, const void *pVect2, const void *) {
+    return 1.0f - Sum((const float *) pVect1, (const float *) pVect2);
+}
+
+template<size_t DIM>
+static DISTFUNC<float> GetFixedDimL2SqrFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return FixedDimL2Sqr<FixedDimSumAVX512<DIM, true>>;
+    if (level >= SIMDLevel::AVX2)
+        return FixedDimL2Sqr<FixedDimSumAVX2<DIM, true>>;
+    if (level >= SIMDLevel::SSE)
+        return FixedDimL2Sqr<FixedDimSumSSE<DIM, true>>;
+#endif
+    return FixedDimL2Sqr<FixedDimSum<DIM, true>>;
+}
+
+template<size_t DIM>
+static DISTFUNC<float> GetFixedDimInnerProductDistanceFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return FixedDimInnerProductDistance<FixedDimSumAVX512<DIM, false>>;
+    if (level >= SIMDLevel::AVX2)
+        return FixedDimInnerProductDistance<FixedDimSumAVX2<DIM, false>>;
+    if (level >= SIMDLevel::SSE)
+        return FixedDimInnerProductDistance<FixedDimSumSSE<DIM, false>>;
+#endif
+    return FixedDimInnerProductDistance<FixedDimSum<DIM, false>>;
+}
+
+/*
+* Distance functors for HierarchicalNSW::searchKnnInlined with the SIMD level as a template parameter,
+* so the search loop calls the kernel directly instead of through DISTFUNC. LEVEL must not be above getSIMDLevel().
+*/
+template<size_t DIM, bool IS_L2, SIMDLevel LEVEL>
+static inline float
+FixedDimSumAt(const float *x, const float *y) {
+#if defined(USE_SSE)
+    if (LEVEL >= SIMDLevel::AVX512)
+        return FixedDimSumAVX512<DIM, IS_L2>(x, y);
+    if (LEVEL >= SIMDLevel::AVX2)
+        return FixedDimSumAVX2<DIM, IS_L2>(x, y);
+    if (LEVEL >= SIMDLevel::SSE)
+        return FixedDimSumSSE<DIM, IS_L2>(x, y);
+#endif
+    return FixedDimSum<DIM, IS_L2>(x, y);
+}
+
+template<size_t DIM, SIMDLevel LEVEL>
+struct FixedDimL2Distance {
+    inline float operator()(const void *pVect1, const void *pVect2) const {
+        return FixedDimSumAt<DIM, true, LEVEL>((const float *) pVect1, (const float *) pVect2);
+    }
+};
+
+template<size_t DIM, SIMDLevel LEVEL>
+struct FixedDimIPDistance {
+    inline float operator()(const void *pVect1, const void *pVect2) const {
+        return 1.0f - FixedDimSumAt<DIM, false, LEVEL>((const float *) pVect1, (const float *) pVect2);
+    }
+};
+
+template<size_t DIM>
+class FixedDimL2Space : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t dim_;
+
+ public:
+    FixedDimL2Space() {
+        fstdistfunc_ = GetFixedDimL2SqrFunc<DIM>();
+        dim_ = DIM;
+    }
+
+    size_t get_data_size() override {
+        return DIM * sizeof(float);
+    }
+
+    std::string get_name() override {
+        return "l2";
+    }
+
+    size_t get_dim() override {
+        return DIM;
+    }
+
+    DISTFUNC<float> get_dist_func() override {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() override {
+        return &dim_;
+    }
+
+    ~FixedDimL2Space() {}
+};
+
+template<size_t DIM>
+class FixedDimInnerProductSpace : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t dim_;
+
+ public:
+    FixedDimInnerProductSpace() {
+        fstdistfunc_ = GetFixedDimInnerProductDistanceFunc<DIM>();
+        dim_ = DIM;
+    }
+
+    size_t get_data_size() override {
+        return DIM * sizeof(float);
+    }
+
+    std::string get_name() override {
+        return "ip";
+    }
+
+    size_t get_dim() override {
+        return DIM;
+    }
+
+    DISTFUNC<float> get_dist_func() override {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() override {
+        return &dim_;
+    }
+
+    ~FixedDimInnerProductSpace() {}
+};
+
+// Dimensions with a specialized space in createL2Space() and createInnerProductSpace()
+#define HNSWLIB_FIXED_DIMS(X) X(128) X(256) X(384) X(512) X(768) X(1024) X(1536)
+
+// A FixedDimL2Space if there is one for dim, an L2Space otherwise
+inline std::unique_ptr<SpaceInterface<float>> createL2Space(size_t dim) {
+    switch (dim) {
+#define HNSWLIB_FIXED_DIM_CASE(D) case D: return std::unique_ptr<SpaceInterface<float>>(new FixedDimL2Space<D>());
+    HNSWLIB_FIXED_DIMS(HNSWLIB_FIXED_DIM_CASE)
+#undef HNSWLIB_FIXED_DIM_CASE
+    default: return std::unique_ptr<SpaceInterface<float>>(new L2Space(dim));
+    }
+}
+
+// A FixedDimInnerProductSpace if there is one for dim, an InnerProductSpace otherwise
+inline std::unique_ptr<SpaceInterface<float>> createInnerProductSpace(size_t dim) {
+    switch (dim) {
+#define HNSWLIB_FIXED_DIM_CASE(D) case D: return std::unique_ptr<SpaceInterface<float>>(new FixedDimInnerProductSpace<D>());
+    HNSWLIB_FIXED_DIMS(HNSWLIB_FIXED_DIM_CASE)
+#undef HNSWLIB_FIXED_DIM_CASE
+    default: return std::unique_ptr<SpaceInterface<float>>(new InnerProductSpace(dim));
+    }
+}
+
+}  // namespace hnswlib
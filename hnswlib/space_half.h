@@ -0,0 +1,386 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+
+namespace hnswlib {
+
+/*
+* L2 and inner product spaces storing vectors with 2 bytes per component, as IEEE half precision (FP16)
+* or bfloat16 (BF16). This halves the memory and the memory bandwidth of the float spaces.
+*
+* Vectors and queries are records of get_data_size() bytes created with encode(), which rounds each float
+* to the nearest half value. The kernels widen the halves to floats (F16C, AVX-512F or a scalar loop)
+* and accumulate in single precision, so the only loss is the rounding of the stored components.
+*/
+
+enum class HalfType {
+    FP16,  // 1 sign, 5 exponent and 10 mantissa bits
+    BF16   // 1 sign, 8 exponent and 7 mantissa bits, the upper half of a float
+};
+
+static inline uint32_t floatBits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static inline float bitsToFloat(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline float FP16ToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    if (exponent == 0x1f)  // inf or nan
+        return bitsToFloat(sign | 0x7f800000 | (mantissa << 13));
+    if (exponent == 0) {
+        // zero or subnormal, mantissa * 2^-24
+        float f = (float) mantissa * bitsToFloat(0x33800000);
+        return sign ? -f : f;
+    }
+    return bitsToFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Rounds to the nearest FP16 value, ties to even, overflows to inf
+static inline uint16_t FloatToFP16(float f) {
+    uint32_t u = floatBits(f);
+    uint16_t sign = (uint16_t) ((u >> 16) & 0x8000);
+    uint32_t abs = u & 0x7fffffff;
+    if (abs > 0x7f800000)  // nan
+        return sign | 0x7e00;
+    if (abs >= 0x477ff000)  // rounds to 65536 or more
+        return sign | 0x7c00;
+    if (abs < 0x38800000) {
+        // subnormal: adding 0.5 makes the float unit round the value to a multiple of 2^-24
+        float r = bitsToFloat(abs) + 0.5f;
+        return sign | (uint16_t) (floatBits(r) - floatBits(0.5f));
+    }
+    uint32_t rounded = abs + 0xfff + ((abs >> 13) & 1);
+    return sign | (uint16_t) ((rounded - (112u << 23)) >> 13);
+}
+
+static inline float BF16ToFloat(uint16_t h) {
+    return bitsToFloat((uint32_t) h << 16);
+}
+
+// Rounds to the nearest BF16 value, ties to even
+static inline uint16_t FloatToBF16(float f) {
+    uint32_t u = floatBits(f);
+    if ((u & 0x7fffffff) > 0x7f800000)  // nan
+        return (uint16_t) ((u >> 16) | 0x40);
+    return (uint16_t) ((u + 0x7fff + ((u >> 16) & 1)) >> 16);
+}
+
+template<HalfType TYPE>
+static inline float HalfToFloat(uint16_t h) {
+    return TYPE == HalfType::FP16 ? FP16ToFloat(h) : BF16ToFloat(h);
+}
+
+template<HalfType TYPE>
+static inline uint16_t FloatToHalf(float f) {
+    return TYPE == HalfType::FP16 ? FloatToFP16(f) : FloatToBF16(f);
+}
+
+// Sum of (x[i] - y[i])^2 if IS_L2, of x[i] * y[i] otherwise
+template<HalfType TYPE, bool IS_L2>
+static float
+HalfSum(const uint16_t *x, const uint16_t *y, size_t qty) {
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float a = HalfToFloat<TYPE>(x[i]);
+        float b = HalfToFloat<TYPE>(y[i]);
+        float t = IS_L2 ? a - b : a;
+        res += t * (IS_L2 ? t : b);
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+template<HalfType TYPE>
+static HNSWLIB_TARGET_AVX512 inline __m512
+HalfLoadAVX512(const uint16_t *p) {
+    __m256i h = _mm256_loadu_si256((const __m256i *) p);
+    if (TYPE == HalfType::FP16)
+        return _mm512_maskz_cvtph_ps((__mmask16) -1, h);
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32((__mmask16) -1, _mm512_maskz_cvtepu16_epi32((__mmask16) -1, h), 16));
+}
+
+template<HalfType TYPE, bool IS_L2>
+static HNSWLIB_TARGET_AVX512 float
+HalfSumAVX512(const uint16_t *x, const uint16_t *y, size_t qty) {
+    size_t qty32 = qty >> 5 << 5;
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i < qty32; i += 32) {
+        __m512 v1 = HalfLoadAVX512<TYPE>(x + i);
+        __m512 v2 = HalfLoadAVX512<TYPE>(y + i);
+        __m512 v3 = HalfLoadAVX512<TYPE>(x + i + 16);
+        __m512 v4 = HalfLoadAVX512<TYPE>(y + i + 16);
+        if (IS_L2) {
+            __m512 diff1 = _mm512_sub_ps(v1, v2);
+            __m512 diff2 = _mm512_sub_ps(v3, v4);
+            sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+            sum2 = _mm512_fmadd_ps(diff2, diff2, sum2);
+        } else {
+            sum1 = _mm512_fmadd_ps(v1, v2, sum1);
+            sum2 = _mm512_fmadd_ps(v3, v4, sum2);
+        }
+    }
+    for (; i < qty16; i += 16) {
+        __m512 v1 = HalfLoadAVX512<TYPE>(x + i);
+        __m512 v2 = HalfLoadAVX512<TYPE>(y + i);
+        if (IS_L2) {
+            __m512 diff = _mm512_sub_ps(v1, v2);
+            sum1 = _mm512_fmadd_ps(diff, diff, sum1);
+        } else {
+            sum1 = _mm512_fmadd_ps(v1, v2, sum1);
+        }
+    }
+
+    return HorizontalSumAVX512(_mm512_add_ps(sum1, sum2)) + HalfSum<TYPE, IS_L2>(x + qty16, y + qty16, qty - qty16);
+}
+
+template<HalfType TYPE>
+static HNSWLIB_TARGET_AVX2 inline __m256
+HalfLoadAVX2(const uint16_t *p) {
+    __m128i h = _mm_loadu_si128((const __m128i *) p);
+    if (TYPE == HalfType::FP16)
+        return _mm256_cvtph_ps(h);
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+}
+
+template<HalfType TYPE, bool IS_L2>
+static HNSWLIB_TARGET_AVX2 float
+HalfSumAVX2(const uint16_t *x, const uint16_t *y, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i < qty16; i += 16) {
+        __m256 v1 = HalfLoadAVX2<TYPE>(x + i);
+        __m256 v2 = HalfLoadAVX2<TYPE>(y + i);
+        __m256 v3 = HalfLoadAVX2<TYPE>(x + i + 8);
+        __m256 v4 = HalfLoadAVX2<TYPE>(y + i + 8);
+        if (IS_L2) {
+            __m256 diff1 = _mm256_sub_ps(v1, v2);
+            __m256 diff2 = _mm256_sub_ps(v3, v4);
+            sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+            sum2 = _mm256_fmadd_ps(diff2, diff2, sum2);
+        } else {
+            sum1 = _mm256_fmadd_ps(v1, v2, sum1);
+            sum2 = _mm256_fmadd_ps(v3, v4, sum2);
+        }
+    }
+    for (; i < qty8; i += 8) {
+        __m256 v1 = HalfLoadAVX2<TYPE>(x + i);
+        __m256 v2 = HalfLoadAVX2<TYPE>(y + i);
+        if (IS_L2) {
+            __m256 diff = _mm256_sub_ps(v1, v2);
+            sum1 = _mm256_fmadd_ps(diff, diff, sum1);
+        } else {
+            sum1 = _mm256_fmadd_ps(v1, v2, sum1);
+        }
+    }
+
+    return HorizontalSumAVX(_mm256_add_ps(sum1, sum2)) + HalfSum<TYPE, IS_L2>(x + qty8, y + qty8, qty - qty8);
+}
+
+// Converts 8 floats, FP16 with the F16C rounding and BF16 with the same rounding as FloatToBF16
+template<HalfType TYPE>
+static HNSWLIB_TARGET_AVX2 inline __m128i
+HalfStoreAVX2(__m256 v) {
+    if (TYPE == HalfType::FP16)
+        return _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256i u = _mm256_castps_si256(v);
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+    __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(u, _mm256_set1_epi32(0x7fff)), lsb), 16);
+    // nan stays nan
+    __m256i is_nan = _mm256_cmpgt_epi32(_mm256_and_si256(u, _mm256_set1_epi32(0x7fffffff)), _mm256_set1_epi32(0x7f800000));
+    __m256i quiet_nan = _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x40));
+    rounded = _mm256_blendv_epi8(rounded, quiet_nan, is_nan);
+    __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+    return packed;
+}
+
+template<HalfType TYPE>
+static HNSWLIB_TARGET_AVX2 void
+HalfEncodeAVX2(const float *src, uint16_t *dst, size_t qty) {
+    size_t qty8 = qty >> 3 << 3;
+    for (size_t i = 0; i < qty8; i += 8) {
+        _mm_storeu_si128((__m128i *) (dst + i), HalfStoreAVX2<TYPE>(_mm256_loadu_ps(src + i)));
+    }
+    for (size_t i = qty8; i < qty; i++) {
+        dst[i] = FloatToHalf<TYPE>(src[i]);
+    }
+}
+
+template<HalfType TYPE>
+static HNSWLIB_TARGET_AVX2 void
+HalfDecodeAVX2(const uint16_t *src, float *dst, size_t qty) {
+    size_t qty8 = qty >> 3 << 3;
+    for (size_t i = 0; i < qty8; i += 8) {
+        _mm256_storeu_ps(dst + i, HalfLoadAVX2<TYPE>(src + i));
+    }
+    for (size_t i = qty8; i < qty; i++) {
+        dst[i] = HalfToFloat<TYPE>(src[i]);
+    }
+}
+
+#endif
+
+template<HalfType TYPE>
+static void
+HalfEncode(const float *src, uint16_t *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++) {
+        dst[i] = FloatToHalf<TYPE>(src[i]);
+    }
+}
+
+template<HalfType TYPE>
+static void
+HalfDecode(const uint16_t *src, float *dst, size_t qty) {
+    for (size_t i = 0; i < qty; i++) {
+        dst[i] = HalfToFloat<TYPE>(src[i]);
+    }
+}
+
+// Distance functions with the DISTFUNC signature
+template<float (*Sum)(const uint16_t *, const uint16_t *, size_t)>
+static float
+HalfL2Sqr(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    return Sum((const uint16_t *) pVect1, (const uint16_t *) pVect2, *((size_t *) qty_ptr));
+}
+
+template<float (*Sum)(const uint16_t *, const uint16_t *, size_t)>
+static float
+HalfInnerProductDistance(const void *pVect1, const void *pVect2, const void *qty_ptr) {
+    return 1.0f - Sum((const uint16_t *) pVect1, (const uint16_t *) pVect2, *((size_t *) qty_ptr));
+}
+
+template<HalfType TYPE>
+static DISTFUNC<float> GetHalfL2SqrFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return HalfL2Sqr<HalfSumAVX512<TYPE, true>>;
+    if (level >= SIMDLevel::AVX2)
+        return HalfL2Sqr<HalfSumAVX2<TYPE, true>>;
+#endif
+    return HalfL2Sqr<HalfSum<TYPE, true>>;
+}
+
+template<HalfType TYPE>
+static DISTFUNC<float> GetHalfInnerProductDistanceFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return HalfInnerProductDistance<HalfSumAVX512<TYPE, false>>;
+    if (level >= SIMDLevel::AVX2)
+        return HalfInnerProductDistance<HalfSumAVX2<TYPE, false>>;
+#endif
+    return HalfInnerProductDistance<HalfSum<TYPE, false>>;
+}
+
+
+template<HalfType TYPE>
+class BaseHalfSpace : public SpaceInterface<float> {
+ protected:
+    size_t dim_;
+    size_t data_size_;
+    void (*encode_)(const float *, uint16_t *, size_t);
+    void (*decode_)(const uint16_t *, float *, size_t);
+
+ public:
+    BaseHalfSpace(size_t dim) {
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+        encode_ = HalfEncode<TYPE>;
+        decode_ = HalfDecode<TYPE>;
+#if defined(USE_SSE)
+        if (getSIMDLevel() >= SIMDLevel::AVX2) {
+            encode_ = HalfEncodeAVX2<TYPE>;
+            decode_ = HalfDecodeAVX2<TYPE>;
+        }
+#endif
+    }
+
+    size_t get_data_size() override {
+        return data_size_;
+    }
+
+    size_t get_dim() override {
+        return dim_;
+    }
+
+    void *get_dist_func_param() override {
+        return &dim_;
+    }
+
+    // Rounds dim floats from vector into a record of get_data_size() bytes, for addPoint and for queries
+    void encode(const float *vector, void *record) const {
+        encode_(vector, (uint16_t *) record, dim_);
+    }
+
+    // Restores dim floats from a record created by encode
+    void decode(const void *record, float *vector) const {
+        decode_((const uint16_t *) record, vector, dim_);
+    }
+};
+
+
+template<HalfType TYPE>
+class HalfL2Space : public BaseHalfSpace<TYPE> {
+    DISTFUNC<float> fstdistfunc_;
+
+ public:
+    HalfL2Space(size_t dim) : BaseHalfSpace<TYPE>(dim) {
+        fstdistfunc_ = GetHalfL2SqrFunc<TYPE>();
+    }
+
+    DISTFUNC<float> get_dist_func() override {
+        return fstdistfunc_;
+    }
+
+    std::string get_name() override {
+        return TYPE == HalfType::FP16 ? "l2_fp16" : "l2_bf16";
+    }
+
+    ~HalfL2Space() {}
+};
+
+
+template<HalfType TYPE>
+class HalfInnerProductSpace : public BaseHalfSpace<TYPE> {
+    DISTFUNC<float> fstdistfunc_;
+
+ public:
+    HalfInnerProductSpace(size_t dim) : BaseHalfSpace<TYPE>(dim) {
+        fstdistfunc_ = GetHalfInnerProductDistanceFunc<TYPE>();
+    }
+
+    DISTFUNC<float> get_dist_func() override {
+        return fstdistfunc_;
+    }
+
+    std::string get_name() override {
+        return TYPE == HalfType::FP16 ? "ip_fp16" : "ip_bf16";
+    }
+
+    ~HalfInnerProductSpace() {}
+};
+
+typedef HalfL2Space<HalfType::FP16> FP16L2Space;
+typedef HalfInnerProductSpace<HalfType::FP16> FP16InnerProductSpace;
+typedef HalfL2Space<HalfType::BF16> BF16L2Space;
+typedef HalfInnerProductSpace<HalfType::BF16> BF16InnerProductSpace;
+
+}  // namespace hnswlib
@@ -0,0 +1,157 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+
+namespace hnswlib {
+
+/*
+* Hamming distance between packed binary codes.
+*
+* A code of dim bits is stored in get_data_size() bytes: ceil(dim / 64) 64-bit words, bit i of the code
+* is bit i % 64 of word i / 64 and the padding bits are zero. encode() creates the code of a float vector
+* from the signs of its components (binary quantization), codes can also be written directly.
+*
+* The usual setup is a two stage search: the graph is built and searched on the codes of a
+* HierarchicalNSW<int>, then searchKnnReranked recomputes the distances of the best candidates
+* on the float vectors kept in a side store, e.g. with L2Space or InnerProductSpace.
+*/
+
+static inline int
+PopCount64(uint64_t x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+static int
+HammingDistance(const void *pVect1, const void *pVect2, const void *words_ptr) {
+    const uint64_t *a = (const uint64_t *) pVect1;
+    const uint64_t *b = (const uint64_t *) pVect2;
+    size_t words = *((size_t *) words_ptr);
+
+    int res = 0;
+    for (size_t i = 0; i < words; i++) {
+        res += PopCount64(a[i] ^ b[i]);
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_POPCNT int
+HammingDistancePOPCNT(const void *pVect1, const void *pVect2, const void *words_ptr) {
+    const uint64_t *a = (const uint64_t *) pVect1;
+    const uint64_t *b = (const uint64_t *) pVect2;
+    size_t words = *((size_t *) words_ptr);
+    size_t words4 = words >> 2 << 2;
+
+    // independent accumulators, popcnt has a latency of 3 cycles
+    uint64_t sum1 = 0, sum2 = 0, sum3 = 0, sum4 = 0;
+    size_t i = 0;
+    for (; i < words4; i += 4) {
+        sum1 += _mm_popcnt_u64(a[i] ^ b[i]);
+        sum2 += _mm_popcnt_u64(a[i + 1] ^ b[i + 1]);
+        sum3 += _mm_popcnt_u64(a[i + 2] ^ b[i + 2]);
+        sum4 += _mm_popcnt_u64(a[i + 3] ^ b[i + 3]);
+    }
+    for (; i < words; i++) {
+        sum1 += _mm_popcnt_u64(a[i] ^ b[i]);
+    }
+    return (int) (sum1 + sum2 + sum3 + sum4);
+}
+
+static HNSWLIB_TARGET_AVX512_VPOPCNTDQ int
+HammingDistanceAVX512(const void *pVect1, const void *pVect2, const void *words_ptr) {
+    const uint64_t *a = (const uint64_t *) pVect1;
+    const uint64_t *b = (const uint64_t *) pVect2;
+    size_t words = *((size_t *) words_ptr);
+    size_t words16 = words >> 4 << 4;
+    size_t words8 = words >> 3 << 3;
+
+    __m512i sum1 = _mm512_setzero_si512();
+    __m512i sum2 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i < words16; i += 16) {
+        __m512i x1 = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        __m512i x2 = _mm512_xor_si512(_mm512_loadu_si512(a + i + 8), _mm512_loadu_si512(b + i + 8));
+        sum1 = _mm512_add_epi64(sum1, _mm512_popcnt_epi64(x1));
+        sum2 = _mm512_add_epi64(sum2, _mm512_popcnt_epi64(x2));
+    }
+    for (; i < words8; i += 8) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        sum1 = _mm512_add_epi64(sum1, _mm512_popcnt_epi64(x));
+    }
+    if (i < words) {
+        __mmask8 mask = (__mmask8) ((1u << (words - i)) - 1);
+        __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi64(mask, a + i), _mm512_maskz_loadu_epi64(mask, b + i));
+        sum2 = _mm512_add_epi64(sum2, _mm512_popcnt_epi64(x));
+    }
+
+    return (int) HorizontalSumEpi64AVX512(_mm512_add_epi64(sum1, sum2));
+}
+
+#endif
+
+// Picks the Hamming kernel for the current SIMD level, VPOPCNTDQ is checked on top of SIMDLevel::AVX512
+static DISTFUNC<int> GetHammingDistanceFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512 && AVX512VPOPCNTDQCapable())
+        return HammingDistanceAVX512;
+    // every CPU with AVX has POPCNT
+    if (level >= SIMDLevel::AVX)
+        return HammingDistancePOPCNT;
+#endif
+    return HammingDistance;
+}
+
+class HammingSpace : public SpaceInterface<int> {
+    DISTFUNC<int> fstdistfunc_;
+    size_t dim_;
+    size_t words_;
+    size_t data_size_;
+
+ public:
+    // dim is the number of bits of a code
+    HammingSpace(size_t dim) {
+        fstdistfunc_ = GetHammingDistanceFunc();
+        dim_ = dim;
+        words_ = (dim + 63) / 64;
+        data_size_ = words_ * sizeof(uint64_t);
+    }
+
+    size_t get_data_size() override {
+        return data_size_;
+    }
+
+    std::string get_name() override {
+        return "hamming";
+    }
+
+    size_t get_dim() override {
+        return dim_;
+    }
+
+    DISTFUNC<int> get_dist_func() override {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() override {
+        return &words_;
+    }
+
+    // Sets bit i of the code of get_data_size() bytes to vector[i] > 0
+    void encode(const float *vector, void *code) const {
+        uint64_t *words = (uint64_t *) code;
+        memset(words, 0, data_size_);
+        for (size_t i = 0; i < dim_; i++) {
+            if (vector[i] > 0)
+                words[i / 64] |= (uint64_t) 1 << (i % 64);
+        }
+    }
+
+    ~HammingSpace() {}
+};
+
+}  // namespace hnswlib
@@ -1,5 +1,6 @@
 #pragma once
 #include "hnswlib.h"
+#include <stdint.h>
 
 namespace hnswlib {
 
@@ -18,10 +19,10 @@ InnerProductDistance(const void *pVect1, const void *pVect2, const void *qty_ptr
     return 1.0f - InnerProduct(pVect1, pVect2, qty_ptr);
 }
 
-#if defined(USE_AVX)
+#if defined(USE_SSE)
 
 // Favor using AVX if available.
-static float
+static HNSWLIB_TARGET_AVX float
 InnerProductSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
     float *pVect1 = (float *) pVect1v;
@@ -68,7 +69,7 @@ InnerProductSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qt
     return sum;
 }
 
-static float
+static HNSWLIB_TARGET_AVX float
 InnerProductDistanceSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return 1.0f - InnerProductSIMD4ExtAVX(pVect1v, pVect2v, qty_ptr);
 }
@@ -141,73 +142,75 @@ InnerProductDistanceSIMD4ExtSSE(const void *pVect1v, const void *pVect2v, const
 #endif
 
 
-#if defined(USE_AVX512)
+#if defined(USE_SSE)
 
-static float
-InnerProductSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
-    float PORTABLE_ALIGN64 TmpRes[16];
+static HNSWLIB_TARGET_AVX512 float
+InnerProductAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
     float *pVect2 = (float *) pVect2v;
     size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    size_t qty16 = qty >> 4 << 4;
 
-    size_t qty16 = qty / 16;
-
-
-    const float *pEnd1 = pVect1 + 16 * qty16;
-
-    __m512 sum512 = _mm512_set1_ps(0);
-
-    size_t loop = qty16 / 4;
-    
-    while (loop--) {
-        __m512 v1 = _mm512_loadu_ps(pVect1);
-        __m512 v2 = _mm512_loadu_ps(pVect2);
-        pVect1 += 16;
-        pVect2 += 16;
-
-        __m512 v3 = _mm512_loadu_ps(pVect1);
-        __m512 v4 = _mm512_loadu_ps(pVect2);
-        pVect1 += 16;
-        pVect2 += 16;
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    __m512 sum3 = _mm512_setzero_ps();
+    __m512 sum4 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i), sum1);
+        sum2 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16), sum2);
+        sum3 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 32), _mm512_loadu_ps(pVect2 + i + 32), sum3);
+        sum4 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i + 48), _mm512_loadu_ps(pVect2 + i + 48), sum4);
+    }
+    for (; i < qty16; i += 16) {
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i), sum1);
+    }
+    if (i < qty) {
+        __mmask16 mask = (__mmask16) ((1u << (qty - i)) - 1);
+        sum2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, pVect1 + i), _mm512_maskz_loadu_ps(mask, pVect2 + i), sum2);
+    }
 
-        __m512 v5 = _mm512_loadu_ps(pVect1);
-        __m512 v6 = _mm512_loadu_ps(pVect2);
-        pVect1 += 16;
-        pVect2 += 16;
+    return HorizontalSumAVX512(_mm512_add_ps(_mm512_add_ps(sum1, sum2), _mm512_add_ps(sum3, sum4)));
+}
 
-        __m512 v7 = _mm512_loadu_ps(pVect1);
-        __m512 v8 = _mm512_loadu_ps(pVect2);
-        pVect1 += 16;
-        pVect2 += 16;
+static HNSWLIB_TARGET_AVX512 float
+InnerProductDistanceAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductAVX512(pVect1v, pVect2v, qty_ptr);
+}
 
-        sum512 = _mm512_fmadd_ps(v1, v2, sum512);
-        sum512 = _mm512_fmadd_ps(v3, v4, sum512);
-        sum512 = _mm512_fmadd_ps(v5, v6, sum512);
-        sum512 = _mm512_fmadd_ps(v7, v8, sum512);
+static HNSWLIB_TARGET_AVX2 float
+InnerProductAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    float *pVect1 = (float *) pVect1v;
+    float *pVect2 = (float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i < qty16; i += 16) {
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8), sum2);
     }
-
-    while (pVect1 < pEnd1) {
-        __m512 v1 = _mm512_loadu_ps(pVect1);
-        __m512 v2 = _mm512_loadu_ps(pVect2);
-        pVect1 += 16;
-        pVect2 += 16;
-        sum512 = _mm512_fmadd_ps(v1, v2, sum512);
+    for (; i < qty8; i += 8) {
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i), sum1);
+    }
+    if (i < qty) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *) (SIMDTailMask + 8 - (qty - i)));
+        sum2 = _mm256_fmadd_ps(_mm256_maskload_ps(pVect1 + i, mask), _mm256_maskload_ps(pVect2 + i, mask), sum2);
     }
 
-    float sum = _mm512_reduce_add_ps(sum512);
-    return sum;
+    return HorizontalSumAVX(_mm256_add_ps(sum1, sum2));
 }
 
-static float
-InnerProductDistanceSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
-    return 1.0f - InnerProductSIMD16ExtAVX512(pVect1v, pVect2v, qty_ptr);
+static HNSWLIB_TARGET_AVX2 float
+InnerProductDistanceAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductAVX2(pVect1v, pVect2v, qty_ptr);
 }
 
-#endif
-
-#if defined(USE_AVX)
-
-static float
+static HNSWLIB_TARGET_AVX float
 InnerProductSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
     float *pVect1 = (float *) pVect1v;
@@ -243,7 +246,7 @@ InnerProductSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *q
     return sum;
 }
 
-static float
+static HNSWLIB_TARGET_AVX float
 InnerProductDistanceSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return 1.0f - InnerProductSIMD16ExtAVX(pVect1v, pVect2v, qty_ptr);
 }
@@ -304,12 +307,8 @@ InnerProductDistanceSIMD16ExtSSE(const void *pVect1v, const void *pVect2v, const
 
 #endif
 
-#if defined(USE_SSE) || defined(USE_AVX) || defined(USE_AVX512)
-static DISTFUNC<float> InnerProductSIMD16Ext = InnerProductSIMD16ExtSSE;
-static DISTFUNC<float> InnerProductSIMD4Ext = InnerProductSIMD4ExtSSE;
-static DISTFUNC<float> InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtSSE;
-static DISTFUNC<float> InnerProductDistanceSIMD4Ext = InnerProductDistanceSIMD4ExtSSE;
-
+#if defined(USE_SSE)
+template<DISTFUNC<float> InnerProductSIMD16Ext>
 static float
 InnerProductDistanceSIMD16ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     size_t qty = *((size_t *) qty_ptr);
@@ -323,6 +322,7 @@ InnerProductDistanceSIMD16ExtResiduals(const void *pVect1v, const void *pVect2v,
     return 1.0f - (res + res_tail);
 }
 
+template<DISTFUNC<float> InnerProductSIMD4Ext>
 static float
 InnerProductDistanceSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     size_t qty = *((size_t *) qty_ptr);
@@ -339,45 +339,173 @@ InnerProductDistanceSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v,
 }
 #endif
 
-class InnerProductSpace : public SpaceInterface<float> {
-    DISTFUNC<float> fstdistfunc_;
-    size_t data_size_;
-    size_t dim_;
+#if defined(USE_SSE)
 
- public:
-    InnerProductSpace(size_t dim) {
-        fstdistfunc_ = InnerProductDistance;
-#if defined(USE_AVX) || defined(USE_SSE) || defined(USE_AVX512)
-    #if defined(USE_AVX512)
-        if (AVX512Capable()) {
-            InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX512;
-            InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX512;
-        } else if (AVXCapable()) {
-            InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX;
-            InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
-        }
-    #elif defined(USE_AVX)
-        if (AVXCapable()) {
-            InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX;
-            InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
+/*
+* Batch kernels: each block of B targets reads every part of the query once for all of them.
+* The accumulation order of every target is the one of InnerProductAVX512 and InnerProductAVX2,
+* so the distances are bit-identical to the single target kernels.
+*/
+template<size_t B>
+static HNSWLIB_TARGET_AVX512 inline void
+InnerProductDistanceBlockAVX512(const float *query, const void *const *targets, float *out, size_t qty) {
+    size_t qty64 = qty >> 6 << 6;
+    size_t qty16 = qty >> 4 << 4;
+    const float *x[B];
+    __m512 sum1[B], sum2[B], sum3[B], sum4[B];
+    for (size_t b = 0; b < B; b++) {
+        x[b] = (const float *) targets[b];
+        sum1[b] = _mm512_setzero_ps();
+        sum2[b] = _mm512_setzero_ps();
+        sum3[b] = _mm512_setzero_ps();
+        sum4[b] = _mm512_setzero_ps();
+    }
+
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        __m512 q1 = _mm512_loadu_ps(query + i);
+        __m512 q2 = _mm512_loadu_ps(query + i + 16);
+        __m512 q3 = _mm512_loadu_ps(query + i + 32);
+        __m512 q4 = _mm512_loadu_ps(query + i + 48);
+        for (size_t b = 0; b < B; b++) {
+            sum1[b] = _mm512_fmadd_ps(q1, _mm512_loadu_ps(x[b] + i), sum1[b]);
+            sum2[b] = _mm512_fmadd_ps(q2, _mm512_loadu_ps(x[b] + i + 16), sum2[b]);
+            sum3[b] = _mm512_fmadd_ps(q3, _mm512_loadu_ps(x[b] + i + 32), sum3[b]);
+            sum4[b] = _mm512_fmadd_ps(q4, _mm512_loadu_ps(x[b] + i + 48), sum4[b]);
         }
-    #endif
-    #if defined(USE_AVX)
-        if (AVXCapable()) {
-            InnerProductSIMD4Ext = InnerProductSIMD4ExtAVX;
-            InnerProductDistanceSIMD4Ext = InnerProductDistanceSIMD4ExtAVX;
+    }
+    for (; i < qty16; i += 16) {
+        __m512 q = _mm512_loadu_ps(query + i);
+        for (size_t b = 0; b < B; b++)
+            sum1[b] = _mm512_fmadd_ps(q, _mm512_loadu_ps(x[b] + i), sum1[b]);
+    }
+    if (i < qty) {
+        __mmask16 mask = (__mmask16) ((1u << (qty - i)) - 1);
+        __m512 q = _mm512_maskz_loadu_ps(mask, query + i);
+        for (size_t b = 0; b < B; b++)
+            sum2[b] = _mm512_fmadd_ps(q, _mm512_maskz_loadu_ps(mask, x[b] + i), sum2[b]);
+    }
+
+    for (size_t b = 0; b < B; b++) {
+        out[b] = 1.0f - HorizontalSumAVX512(
+            _mm512_add_ps(_mm512_add_ps(sum1[b], sum2[b]), _mm512_add_ps(sum3[b], sum4[b])));
+    }
+}
+
+static HNSWLIB_TARGET_AVX512 void
+InnerProductDistanceBatchAVX512(const void *query, const void *const *targets, size_t n, float *out, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        InnerProductDistanceBlockAVX512<4>((const float *) query, targets + i, out + i, qty);
+    for (; i < n; i++)
+        InnerProductDistanceBlockAVX512<1>((const float *) query, targets + i, out + i, qty);
+}
+
+template<size_t B>
+static HNSWLIB_TARGET_AVX2 inline void
+InnerProductDistanceBlockAVX2(const float *query, const void *const *targets, float *out, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    size_t qty8 = qty >> 3 << 3;
+    const float *x[B];
+    __m256 sum1[B], sum2[B];
+    for (size_t b = 0; b < B; b++) {
+        x[b] = (const float *) targets[b];
+        sum1[b] = _mm256_setzero_ps();
+        sum2[b] = _mm256_setzero_ps();
+    }
+
+    size_t i = 0;
+    for (; i < qty16; i += 16) {
+        __m256 q1 = _mm256_loadu_ps(query + i);
+        __m256 q2 = _mm256_loadu_ps(query + i + 8);
+        for (size_t b = 0; b < B; b++) {
+            sum1[b] = _mm256_fmadd_ps(q1, _mm256_loadu_ps(x[b] + i), sum1[b]);
+            sum2[b] = _mm256_fmadd_ps(q2, _mm256_loadu_ps(x[b] + i + 8), sum2[b]);
         }
-    #endif
+    }
+    for (; i < qty8; i += 8) {
+        __m256 q = _mm256_loadu_ps(query + i);
+        for (size_t b = 0; b < B; b++)
+            sum1[b] = _mm256_fmadd_ps(q, _mm256_loadu_ps(x[b] + i), sum1[b]);
+    }
+    if (i < qty) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *) (SIMDTailMask + 8 - (qty - i)));
+        __m256 q = _mm256_maskload_ps(query + i, mask);
+        for (size_t b = 0; b < B; b++)
+            sum2[b] = _mm256_fmadd_ps(q, _mm256_maskload_ps(x[b] + i, mask), sum2[b]);
+    }
+
+    for (size_t b = 0; b < B; b++)
+        out[b] = 1.0f - HorizontalSumAVX(_mm256_add_ps(sum1[b], sum2[b]));
+}
 
+static HNSWLIB_TARGET_AVX2 void
+InnerProductDistanceBatchAVX2(const void *query, const void *const *targets, size_t n, float *out, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        InnerProductDistanceBlockAVX2<4>((const float *) query, targets + i, out + i, qty);
+    for (; i < n; i++)
+        InnerProductDistanceBlockAVX2<1>((const float *) query, targets + i, out + i, qty);
+}
+
+#endif
+
+// The batch inner product distance kernel for the current SIMD level, nullptr below AVX2. It handles any dimension
+static BATCHDISTFUNC<float> GetInnerProductDistanceBatchFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return InnerProductDistanceBatchAVX512;
+    if (level >= SIMDLevel::AVX2)
+        return InnerProductDistanceBatchAVX2;
+#endif
+    return nullptr;
+}
+
+// Picks the inner product distance kernel for the dimension and the current SIMD level
+static DISTFUNC<float> GetInnerProductDistanceFunc(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return InnerProductDistanceAVX512;
+    if (level >= SIMDLevel::AVX2)
+        return InnerProductDistanceAVX2;
+    if (level >= SIMDLevel::AVX) {
         if (dim % 16 == 0)
-            fstdistfunc_ = InnerProductDistanceSIMD16Ext;
+            return InnerProductDistanceSIMD16ExtAVX;
         else if (dim % 4 == 0)
-            fstdistfunc_ = InnerProductDistanceSIMD4Ext;
+            return InnerProductDistanceSIMD4ExtAVX;
         else if (dim > 16)
-            fstdistfunc_ = InnerProductDistanceSIMD16ExtResiduals;
+            return InnerProductDistanceSIMD16ExtResiduals<InnerProductSIMD16ExtAVX>;
         else if (dim > 4)
-            fstdistfunc_ = InnerProductDistanceSIMD4ExtResiduals;
+            return InnerProductDistanceSIMD4ExtResiduals<InnerProductSIMD4ExtAVX>;
+    }
+    if (level >= SIMDLevel::SSE) {
+        if (dim % 16 == 0)
+            return InnerProductDistanceSIMD16ExtSSE;
+        else if (dim % 4 == 0)
+            return InnerProductDistanceSIMD4ExtSSE;
+        else if (dim > 16)
+            return InnerProductDistanceSIMD16ExtResiduals<InnerProductSIMD16ExtSSE>;
+        else if (dim > 4)
+            return InnerProductDistanceSIMD4ExtResiduals<InnerProductSIMD4ExtSSE>;
+    }
 #endif
+    return InnerProductDistance;
+}
+
+class InnerProductSpace : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    BATCHDISTFUNC<float> batchdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpace(size_t dim) {
+        fstdistfunc_ = GetInnerProductDistanceFunc(dim);
+        batchdistfunc_ = GetInnerProductDistanceBatchFunc();
         dim_ = dim;
         data_size_ = dim * sizeof(float);
     }
@@ -386,6 +514,14 @@ class InnerProductSpace : public SpaceInterface<float> {
         return data_size_;
     }
 
+    std::string get_name() {
+        return "ip";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
     DISTFUNC<float> get_dist_func() {
         return fstdistfunc_;
     }
@@ -394,7 +530,252 @@ class InnerProductSpace : public SpaceInterface<float> {
         return &dim_;
     }
 
+    BATCHDISTFUNC<float> get_batch_dist_func() {
+        return batchdistfunc_;
+    }
+
 ~InnerProductSpace() {}
 };
 
+/*
+* Inner product spaces of 8-bit vectors, uint8 (InnerProductSpaceI, the counterpart of L2SpaceI) and int8.
+* The distance is the negated inner product, so that closer elements have smaller distances.
+*/
+
+static int
+InnerProductI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    int res = 0;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    for (size_t i = 0; i < qty; i++) {
+        res += a[i] * b[i];
+    }
+    return res;
+}
+
+static int
+InnerProductDistanceI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    return -InnerProductI(pVect1, pVect2, qty_ptr);
+}
+
+static int
+InnerProductInt8(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    int res = 0;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    for (size_t i = 0; i < qty; i++) {
+        res += a[i] * b[i];
+    }
+    return res;
+}
+
+static int
+InnerProductDistanceInt8(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    return -InnerProductInt8(pVect1, pVect2, qty_ptr);
+}
+
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_AVX2 int
+InnerProductDistanceIAVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i v2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v1, v2));
+    }
+
+    size_t qty_left = qty - qty16;
+    return -(HorizontalSumEpi32AVX(sum) + InnerProductI(a + qty16, b + qty16, &qty_left));
+}
+
+static HNSWLIB_TARGET_AVX2 int
+InnerProductDistanceInt8AVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i v2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v1, v2));
+    }
+
+    size_t qty_left = qty - qty16;
+    return -(HorizontalSumEpi32AVX(sum) + InnerProductInt8(a + qty16, b + qty16, &qty_left));
+}
+
+/*
+* vpdpbusd multiplies unsigned by signed bytes, so b is shifted into the signed range:
+* a * b = a * (b - 128) + 128 * a, the second sum is one more vpdpbusd with ones.
+* The tail is a masked load, the zeroed bytes of a cancel both products.
+*/
+static HNSWLIB_TARGET_AVX512_VNNI int
+InnerProductDistanceIAVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    const __m512i offset = _mm512_set1_epi8((char) 0x80);
+    const __m512i ones = _mm512_set1_epi8(1);
+    __m512i dot = _mm512_setzero_si512();
+    __m512i sum = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        __m512i v1 = _mm512_loadu_si512(a + i);
+        __m512i v2 = _mm512_loadu_si512(b + i);
+        dot = _mm512_dpbusd_epi32(dot, v1, _mm512_xor_si512(v2, offset));
+        sum = _mm512_dpbusd_epi32(sum, v1, ones);
+    }
+    if (i < qty) {
+        __mmask64 mask = (__mmask64) ((1ULL << (qty - i)) - 1);
+        __m512i v1 = _mm512_maskz_loadu_epi8(mask, a + i);
+        __m512i v2 = _mm512_maskz_loadu_epi8(mask, b + i);
+        dot = _mm512_dpbusd_epi32(dot, v1, _mm512_xor_si512(v2, offset));
+        sum = _mm512_dpbusd_epi32(sum, v1, ones);
+    }
+
+    return -HorizontalSumEpi32AVX512(_mm512_add_epi32(dot, _mm512_maskz_slli_epi32((__mmask16) -1, sum, 7)));
+}
+
+/*
+* Here a is shifted into the unsigned range: a * b = (a + 128) * b - 128 * b,
+* the second sum is one more vpdpbusd with the bytes 128.
+*/
+static HNSWLIB_TARGET_AVX512_VNNI int
+InnerProductDistanceInt8AVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    const __m512i offset = _mm512_set1_epi8((char) 0x80);
+    __m512i dot = _mm512_setzero_si512();
+    __m512i correction = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        __m512i v1 = _mm512_loadu_si512(a + i);
+        __m512i v2 = _mm512_loadu_si512(b + i);
+        dot = _mm512_dpbusd_epi32(dot, _mm512_xor_si512(v1, offset), v2);
+        correction = _mm512_dpbusd_epi32(correction, offset, v2);
+    }
+    if (i < qty) {
+        __mmask64 mask = (__mmask64) ((1ULL << (qty - i)) - 1);
+        __m512i v1 = _mm512_maskz_loadu_epi8(mask, a + i);
+        __m512i v2 = _mm512_maskz_loadu_epi8(mask, b + i);
+        dot = _mm512_dpbusd_epi32(dot, _mm512_xor_si512(v1, offset), v2);
+        correction = _mm512_dpbusd_epi32(correction, offset, v2);
+    }
+
+    return -HorizontalSumEpi32AVX512(_mm512_sub_epi32(dot, correction));
+}
+
+#endif
+
+// Picks the uint8 inner product kernel for the dimension and the current SIMD level, VNNI is checked on top of SIMDLevel::AVX512
+static DISTFUNC<int> GetInnerProductDistanceIFunc(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512 && AVX512VNNICapable())
+        return InnerProductDistanceIAVX512VNNI;
+    if (level >= SIMDLevel::AVX2 && dim >= 16)
+        return InnerProductDistanceIAVX2;
+#endif
+    return InnerProductDistanceI;
+}
+
+// Picks the int8 inner product kernel for the dimension and the current SIMD level, VNNI is checked on top of SIMDLevel::AVX512
+static DISTFUNC<int> GetInnerProductDistanceInt8Func(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512 && AVX512VNNICapable())
+        return InnerProductDistanceInt8AVX512VNNI;
+    if (level >= SIMDLevel::AVX2 && dim >= 16)
+        return InnerProductDistanceInt8AVX2;
+#endif
+    return InnerProductDistanceInt8;
+}
+
+class InnerProductSpaceI : public SpaceInterface<int> {
+    DISTFUNC<int> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceI(size_t dim) {
+        fstdistfunc_ = GetInnerProductDistanceIFunc(dim);
+        dim_ = dim;
+        data_size_ = dim * sizeof(unsigned char);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    std::string get_name() {
+        return "ip_uint8";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
+    DISTFUNC<int> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceI() {}
+};
+
+class InnerProductSpaceInt8 : public SpaceInterface<int> {
+    DISTFUNC<int> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceInt8(size_t dim) {
+        fstdistfunc_ = GetInnerProductDistanceInt8Func(dim);
+        dim_ = dim;
+        data_size_ = dim * sizeof(int8_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    std::string get_name() {
+        return "ip_int8";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
+    DISTFUNC<int> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceInt8() {}
+};
+
 }  // namespace hnswlib
@@ -1,5 +1,6 @@
 #pragma once
 #include "hnswlib.h"
+#include <stdint.h>
 
 namespace hnswlib {
 
@@ -19,45 +20,69 @@ L2Sqr(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return (res);
 }
 
-#if defined(USE_AVX512)
+#if defined(USE_SSE)
 
-// Favor using AVX512 if available.
-static float
-L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+static HNSWLIB_TARGET_AVX512 float
+L2SqrAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
     float *pVect2 = (float *) pVect2v;
     size_t qty = *((size_t *) qty_ptr);
-    float PORTABLE_ALIGN64 TmpRes[16];
-    size_t qty16 = qty >> 4;
+    size_t qty32 = qty >> 5 << 5;
+    size_t qty16 = qty >> 4 << 4;
 
-    const float *pEnd1 = pVect1 + (qty16 << 4);
+    __m512 sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i < qty32; i += 32) {
+        __m512 diff1 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i));
+        __m512 diff2 = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i + 16), _mm512_loadu_ps(pVect2 + i + 16));
+        sum1 = _mm512_fmadd_ps(diff1, diff1, sum1);
+        sum2 = _mm512_fmadd_ps(diff2, diff2, sum2);
+    }
+    for (; i < qty16; i += 16) {
+        __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(pVect1 + i), _mm512_loadu_ps(pVect2 + i));
+        sum1 = _mm512_fmadd_ps(diff, diff, sum1);
+    }
+    if (i < qty) {
+        __mmask16 mask = (__mmask16) ((1u << (qty - i)) - 1);
+        __m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, pVect1 + i), _mm512_maskz_loadu_ps(mask, pVect2 + i));
+        sum2 = _mm512_fmadd_ps(diff, diff, sum2);
+    }
 
-    __m512 diff, v1, v2;
-    __m512 sum = _mm512_set1_ps(0);
+    return HorizontalSumAVX512(_mm512_add_ps(sum1, sum2));
+}
 
-    while (pVect1 < pEnd1) {
-        v1 = _mm512_loadu_ps(pVect1);
-        pVect1 += 16;
-        v2 = _mm512_loadu_ps(pVect2);
-        pVect2 += 16;
-        diff = _mm512_sub_ps(v1, v2);
-        // sum = _mm512_fmadd_ps(diff, diff, sum);
-        sum = _mm512_add_ps(sum, _mm512_mul_ps(diff, diff));
+static HNSWLIB_TARGET_AVX2 float
+L2SqrAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    float *pVect1 = (float *) pVect1v;
+    float *pVect2 = (float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i < qty16; i += 16) {
+        __m256 diff1 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        __m256 diff2 = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i + 8), _mm256_loadu_ps(pVect2 + i + 8));
+        sum1 = _mm256_fmadd_ps(diff1, diff1, sum1);
+        sum2 = _mm256_fmadd_ps(diff2, diff2, sum2);
+    }
+    for (; i < qty8; i += 8) {
+        __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + i), _mm256_loadu_ps(pVect2 + i));
+        sum1 = _mm256_fmadd_ps(diff, diff, sum1);
+    }
+    if (i < qty) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *) (SIMDTailMask + 8 - (qty - i)));
+        __m256 diff = _mm256_sub_ps(_mm256_maskload_ps(pVect1 + i, mask), _mm256_maskload_ps(pVect2 + i, mask));
+        sum2 = _mm256_fmadd_ps(diff, diff, sum2);
     }
 
-    _mm512_store_ps(TmpRes, sum);
-    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] +
-            TmpRes[7] + TmpRes[8] + TmpRes[9] + TmpRes[10] + TmpRes[11] + TmpRes[12] +
-            TmpRes[13] + TmpRes[14] + TmpRes[15];
-
-    return (res);
+    return HorizontalSumAVX(_mm256_add_ps(sum1, sum2));
 }
-#endif
-
-#if defined(USE_AVX)
 
-// Favor using AVX if available.
-static float
+static HNSWLIB_TARGET_AVX float
 L2SqrSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
     float *pVect2 = (float *) pVect2v;
@@ -143,9 +168,8 @@ L2SqrSIMD16ExtSSE(const void *pVect1v, const void *pVect2v, const void *qty_ptr)
 }
 #endif
 
-#if defined(USE_SSE) || defined(USE_AVX) || defined(USE_AVX512)
-static DISTFUNC<float> L2SqrSIMD16Ext = L2SqrSIMD16ExtSSE;
-
+#if defined(USE_SSE)
+template<DISTFUNC<float> L2SqrSIMD16Ext>
 static float
 L2SqrSIMD16ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     size_t qty = *((size_t *) qty_ptr);
@@ -205,34 +229,173 @@ L2SqrSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v, const void *qty
 }
 #endif
 
-class L2Space : public SpaceInterface<float> {
-    DISTFUNC<float> fstdistfunc_;
-    size_t data_size_;
-    size_t dim_;
+#if defined(USE_SSE)
 
- public:
-    L2Space(size_t dim) {
-        fstdistfunc_ = L2Sqr;
-#if defined(USE_SSE) || defined(USE_AVX) || defined(USE_AVX512)
-    #if defined(USE_AVX512)
-        if (AVX512Capable())
-            L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX512;
-        else if (AVXCapable())
-            L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX;
-    #elif defined(USE_AVX)
-        if (AVXCapable())
-            L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX;
-    #endif
+/*
+* Batch kernels: each block of B targets reads every part of the query once for all of them.
+* The accumulation order of every target is the one of L2SqrAVX512 and L2SqrAVX2,
+* so the distances are bit-identical to the single target kernels.
+*/
+template<size_t B>
+static HNSWLIB_TARGET_AVX512 inline void
+L2SqrBlockAVX512(const float *query, const void *const *targets, float *out, size_t qty) {
+    size_t qty32 = qty >> 5 << 5;
+    size_t qty16 = qty >> 4 << 4;
+    const float *x[B];
+    __m512 sum1[B], sum2[B];
+    for (size_t b = 0; b < B; b++) {
+        x[b] = (const float *) targets[b];
+        sum1[b] = _mm512_setzero_ps();
+        sum2[b] = _mm512_setzero_ps();
+    }
+
+    size_t i = 0;
+    for (; i < qty32; i += 32) {
+        __m512 q1 = _mm512_loadu_ps(query + i);
+        __m512 q2 = _mm512_loadu_ps(query + i + 16);
+        for (size_t b = 0; b < B; b++) {
+            __m512 diff1 = _mm512_sub_ps(q1, _mm512_loadu_ps(x[b] + i));
+            __m512 diff2 = _mm512_sub_ps(q2, _mm512_loadu_ps(x[b] + i + 16));
+            sum1[b] = _mm512_fmadd_ps(diff1, diff1, sum1[b]);
+            sum2[b] = _mm512_fmadd_ps(diff2, diff2, sum2[b]);
+        }
+    }
+    for (; i < qty16; i += 16) {
+        __m512 q = _mm512_loadu_ps(query + i);
+        for (size_t b = 0; b < B; b++) {
+            __m512 diff = _mm512_sub_ps(q, _mm512_loadu_ps(x[b] + i));
+            sum1[b] = _mm512_fmadd_ps(diff, diff, sum1[b]);
+        }
+    }
+    if (i < qty) {
+        __mmask16 mask = (__mmask16) ((1u << (qty - i)) - 1);
+        __m512 q = _mm512_maskz_loadu_ps(mask, query + i);
+        for (size_t b = 0; b < B; b++) {
+            __m512 diff = _mm512_sub_ps(q, _mm512_maskz_loadu_ps(mask, x[b] + i));
+            sum2[b] = _mm512_fmadd_ps(diff, diff, sum2[b]);
+        }
+    }
+
+    for (size_t b = 0; b < B; b++)
+        out[b] = HorizontalSumAVX512(_mm512_add_ps(sum1[b], sum2[b]));
+}
+
+static HNSWLIB_TARGET_AVX512 void
+L2SqrBatchAVX512(const void *query, const void *const *targets, size_t n, float *out, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        L2SqrBlockAVX512<4>((const float *) query, targets + i, out + i, qty);
+    for (; i < n; i++)
+        L2SqrBlockAVX512<1>((const float *) query, targets + i, out + i, qty);
+}
+
+template<size_t B>
+static HNSWLIB_TARGET_AVX2 inline void
+L2SqrBlockAVX2(const float *query, const void *const *targets, float *out, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    size_t qty8 = qty >> 3 << 3;
+    const float *x[B];
+    __m256 sum1[B], sum2[B];
+    for (size_t b = 0; b < B; b++) {
+        x[b] = (const float *) targets[b];
+        sum1[b] = _mm256_setzero_ps();
+        sum2[b] = _mm256_setzero_ps();
+    }
+
+    size_t i = 0;
+    for (; i < qty16; i += 16) {
+        __m256 q1 = _mm256_loadu_ps(query + i);
+        __m256 q2 = _mm256_loadu_ps(query + i + 8);
+        for (size_t b = 0; b < B; b++) {
+            __m256 diff1 = _mm256_sub_ps(q1, _mm256_loadu_ps(x[b] + i));
+            __m256 diff2 = _mm256_sub_ps(q2, _mm256_loadu_ps(x[b] + i + 8));
+            sum1[b] = _mm256_fmadd_ps(diff1, diff1, sum1[b]);
+            sum2[b] = _mm256_fmadd_ps(diff2, diff2, sum2[b]);
+        }
+    }
+    for (; i < qty8; i += 8) {
+        __m256 q = _mm256_loadu_ps(query + i);
+        for (size_t b = 0; b < B; b++) {
+            __m256 diff = _mm256_sub_ps(q, _mm256_loadu_ps(x[b] + i));
+            sum1[b] = _mm256_fmadd_ps(diff, diff, sum1[b]);
+        }
+    }
+    if (i < qty) {
+        __m256i mask = _mm256_loadu_si256((const __m256i *) (SIMDTailMask + 8 - (qty - i)));
+        __m256 q = _mm256_maskload_ps(query + i, mask);
+        for (size_t b = 0; b < B; b++) {
+            __m256 diff = _mm256_sub_ps(q, _mm256_maskload_ps(x[b] + i, mask));
+            sum2[b] = _mm256_fmadd_ps(diff, diff, sum2[b]);
+        }
+    }
+
+    for (size_t b = 0; b < B; b++)
+        out[b] = HorizontalSumAVX(_mm256_add_ps(sum1[b], sum2[b]));
+}
 
+static HNSWLIB_TARGET_AVX2 void
+L2SqrBatchAVX2(const void *query, const void *const *targets, size_t n, float *out, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        L2SqrBlockAVX2<4>((const float *) query, targets + i, out + i, qty);
+    for (; i < n; i++)
+        L2SqrBlockAVX2<1>((const float *) query, targets + i, out + i, qty);
+}
+
+#endif
+
+// The batch L2 kernel for the current SIMD level, nullptr below AVX2. It handles any dimension
+static BATCHDISTFUNC<float> GetL2SqrBatchFunc() {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return L2SqrBatchAVX512;
+    if (level >= SIMDLevel::AVX2)
+        return L2SqrBatchAVX2;
+#endif
+    return nullptr;
+}
+
+// Picks the L2 kernel for the dimension and the current SIMD level
+static DISTFUNC<float> GetL2SqrFunc(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512)
+        return L2SqrAVX512;
+    if (level >= SIMDLevel::AVX2)
+        return L2SqrAVX2;
+    if (level >= SIMDLevel::AVX) {
         if (dim % 16 == 0)
-            fstdistfunc_ = L2SqrSIMD16Ext;
+            return L2SqrSIMD16ExtAVX;
+        if (dim > 16 && dim % 4 != 0)
+            return L2SqrSIMD16ExtResiduals<L2SqrSIMD16ExtAVX>;
+    }
+    if (level >= SIMDLevel::SSE) {
+        if (dim % 16 == 0)
+            return L2SqrSIMD16ExtSSE;
         else if (dim % 4 == 0)
-            fstdistfunc_ = L2SqrSIMD4Ext;
+            return L2SqrSIMD4Ext;
         else if (dim > 16)
-            fstdistfunc_ = L2SqrSIMD16ExtResiduals;
+            return L2SqrSIMD16ExtResiduals<L2SqrSIMD16ExtSSE>;
         else if (dim > 4)
-            fstdistfunc_ = L2SqrSIMD4ExtResiduals;
+            return L2SqrSIMD4ExtResiduals;
+    }
 #endif
+    return L2Sqr;
+}
+
+class L2Space : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    BATCHDISTFUNC<float> batchdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2Space(size_t dim) {
+        fstdistfunc_ = GetL2SqrFunc(dim);
+        batchdistfunc_ = GetL2SqrBatchFunc();
         dim_ = dim;
         data_size_ = dim * sizeof(float);
     }
@@ -241,6 +404,14 @@ class L2Space : public SpaceInterface<float> {
         return data_size_;
     }
 
+    std::string get_name() {
+        return "l2";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
     DISTFUNC<float> get_dist_func() {
         return fstdistfunc_;
     }
@@ -249,6 +420,10 @@ class L2Space : public SpaceInterface<float> {
         return &dim_;
     }
 
+    BATCHDISTFUNC<float> get_batch_dist_func() {
+        return batchdistfunc_;
+    }
+
     ~L2Space() {}
 };
 
@@ -291,6 +466,102 @@ static int L2SqrI(const void* __restrict pVect1, const void* __restrict pVect2,
     return (res);
 }
 
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_AVX512 int
+L2SqrIAVX512(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    __m512i sum = _mm512_setzero_si512();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512i v1 = _mm512_maskz_cvtepu8_epi32((__mmask16) -1, _mm_loadu_si128((const __m128i *) (a + i)));
+        __m512i v2 = _mm512_maskz_cvtepu8_epi32((__mmask16) -1, _mm_loadu_si128((const __m128i *) (b + i)));
+        __m512i diff = _mm512_sub_epi32(v1, v2);
+        sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(diff, diff));
+    }
+
+    size_t qty_left = qty - qty16;
+    return HorizontalSumEpi32AVX512(sum) + L2SqrI(a + qty16, b + qty16, &qty_left);
+}
+
+static HNSWLIB_TARGET_AVX2 int
+L2SqrIAVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i v2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m256i diff = _mm256_sub_epi16(v1, v2);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff, diff));
+    }
+
+    size_t qty_left = qty - qty16;
+    return HorizontalSumEpi32AVX(sum) + L2SqrI(a + qty16, b + qty16, &qty_left);
+}
+
+/*
+* 32 components per step widened to 16 bits, vpdpwssd squares the differences and adds
+* pairs of them to the 32-bit sums in one instruction. The tail is a masked load.
+*/
+static HNSWLIB_TARGET_AVX512_VNNI int
+L2SqrIAVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    size_t qty32 = qty >> 5 << 5;
+    unsigned char *a = (unsigned char *) pVect1;
+    unsigned char *b = (unsigned char *) pVect2;
+
+    __m512i sum1 = _mm512_setzero_si512();
+    __m512i sum2 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        __m512i diff1 = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (a + i))),
+                                         _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (b + i))));
+        __m512i diff2 = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (a + i + 32))),
+                                         _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (b + i + 32))));
+        sum1 = _mm512_dpwssd_epi32(sum1, diff1, diff1);
+        sum2 = _mm512_dpwssd_epi32(sum2, diff2, diff2);
+    }
+    for (; i < qty32; i += 32) {
+        __m512i diff = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (a + i))),
+                                        _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *) (b + i))));
+        sum1 = _mm512_dpwssd_epi32(sum1, diff, diff);
+    }
+    if (i < qty) {
+        __mmask32 mask = (__mmask32) ((1u << (qty - i)) - 1);
+        __m512i diff = _mm512_sub_epi16(_mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, a + i)),
+                                        _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, b + i)));
+        sum2 = _mm512_dpwssd_epi32(sum2, diff, diff);
+    }
+
+    return HorizontalSumEpi32AVX512(_mm512_add_epi32(sum1, sum2));
+}
+
+#endif
+
+// Picks the uint8 L2 kernel for the dimension and the current SIMD level, VNNI is checked on top of SIMDLevel::AVX512
+static DISTFUNC<int> GetL2SqrIFunc(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512 && AVX512VNNICapable())
+        return L2SqrIAVX512VNNI;
+    if (level >= SIMDLevel::AVX512 && dim >= 16)
+        return L2SqrIAVX512;
+    if (level >= SIMDLevel::AVX2 && dim >= 16)
+        return L2SqrIAVX2;
+#endif
+    if (dim % 4 == 0)
+        return L2SqrI4x;
+    return L2SqrI;
+}
+
 class L2SpaceI : public SpaceInterface<int> {
     DISTFUNC<int> fstdistfunc_;
     size_t data_size_;
@@ -298,11 +569,7 @@ class L2SpaceI : public SpaceInterface<int> {
 
  public:
     L2SpaceI(size_t dim) {
-        if (dim % 4 == 0) {
-            fstdistfunc_ = L2SqrI4x;
-        } else {
-            fstdistfunc_ = L2SqrI;
-        }
+        fstdistfunc_ = GetL2SqrIFunc(dim);
         dim_ = dim;
         data_size_ = dim * sizeof(unsigned char);
     }
@@ -311,6 +578,14 @@ class L2SpaceI : public SpaceInterface<int> {
         return data_size_;
     }
 
+    std::string get_name() {
+        return "l2_uint8";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
     DISTFUNC<int> get_dist_func() {
         return fstdistfunc_;
     }
@@ -321,4 +596,124 @@ class L2SpaceI : public SpaceInterface<int> {
 
     ~L2SpaceI() {}
 };
+
+static int
+L2SqrInt8(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    int res = 0;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    for (size_t i = 0; i < qty; i++) {
+        int diff = a[i] - b[i];
+        res += diff * diff;
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_AVX2 int
+L2SqrInt8AVX2(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty16 = qty >> 4 << 4;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (a + i)));
+        __m256i v2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (b + i)));
+        __m256i diff = _mm256_sub_epi16(v1, v2);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(diff, diff));
+    }
+
+    size_t qty_left = qty - qty16;
+    return HorizontalSumEpi32AVX(sum) + L2SqrInt8(a + qty16, b + qty16, &qty_left);
+}
+
+// Same as L2SqrIAVX512VNNI with sign extension
+static HNSWLIB_TARGET_AVX512_VNNI int
+L2SqrInt8AVX512VNNI(const void *__restrict pVect1, const void *__restrict pVect2, const void *__restrict qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty64 = qty >> 6 << 6;
+    size_t qty32 = qty >> 5 << 5;
+    int8_t *a = (int8_t *) pVect1;
+    int8_t *b = (int8_t *) pVect2;
+
+    __m512i sum1 = _mm512_setzero_si512();
+    __m512i sum2 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i < qty64; i += 64) {
+        __m512i diff1 = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (a + i))),
+                                         _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (b + i))));
+        __m512i diff2 = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (a + i + 32))),
+                                         _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (b + i + 32))));
+        sum1 = _mm512_dpwssd_epi32(sum1, diff1, diff1);
+        sum2 = _mm512_dpwssd_epi32(sum2, diff2, diff2);
+    }
+    for (; i < qty32; i += 32) {
+        __m512i diff = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (a + i))),
+                                        _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *) (b + i))));
+        sum1 = _mm512_dpwssd_epi32(sum1, diff, diff);
+    }
+    if (i < qty) {
+        __mmask32 mask = (__mmask32) ((1u << (qty - i)) - 1);
+        __m512i diff = _mm512_sub_epi16(_mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, a + i)),
+                                        _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(mask, b + i)));
+        sum2 = _mm512_dpwssd_epi32(sum2, diff, diff);
+    }
+
+    return HorizontalSumEpi32AVX512(_mm512_add_epi32(sum1, sum2));
+}
+
+#endif
+
+// Picks the int8 L2 kernel for the dimension and the current SIMD level, VNNI is checked on top of SIMDLevel::AVX512
+static DISTFUNC<int> GetL2SqrInt8Func(size_t dim) {
+#if defined(USE_SSE)
+    SIMDLevel level = getSIMDLevel();
+    if (level >= SIMDLevel::AVX512 && AVX512VNNICapable())
+        return L2SqrInt8AVX512VNNI;
+    if (level >= SIMDLevel::AVX2 && dim >= 16)
+        return L2SqrInt8AVX2;
+#endif
+    return L2SqrInt8;
+}
+
+// Squared L2 distance of int8 vectors, e.g. embeddings quantized symmetrically around zero
+class L2SpaceInt8 : public SpaceInterface<int> {
+    DISTFUNC<int> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2SpaceInt8(size_t dim) {
+        fstdistfunc_ = GetL2SqrInt8Func(dim);
+        dim_ = dim;
+        data_size_ = dim * sizeof(int8_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    std::string get_name() {
+        return "l2_int8";
+    }
+
+    size_t get_dim() {
+        return dim_;
+    }
+
+    DISTFUNC<int> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~L2SpaceInt8() {}
+};
 }  // namespace hnswlib
@@ -0,0 +1,382 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <random>
+
+namespace hnswlib {
+
+/*
+* Product quantization (PQ) with M subquantizers of 256 centroids each.
+*
+* The vector is split into M subvectors of dim / M values, and every subvector is replaced with the
+* one byte index of its closest centroid. A stored record of get_data_size() bytes is:
+*   uint8 0 (marks stored codes), uint8 codes[M]
+* Records are created with encode() after the codebooks have been trained (or loaded).
+*
+* A query record of get_query_size() bytes holds the asymmetric distance (ADC) table of the query:
+*   uint8 1 (marks a query), 3 bytes of padding, float table[M][256]
+* where table[m][j] is the distance between the m-th subvector of the query and the j-th centroid of the
+* m-th subquantizer. It is computed once by encodeQuery(), after that the distance to a stored record
+* is the sum of M table lookups. Distances between stored records (used during construction) are looked
+* up in a symmetric table of the distances between the centroids.
+*/
+
+static const size_t PQ_NUM_CENTROIDS = 256;
+
+struct PQParam {
+    size_t dim;  // has to be the first member, the dimension is read from the distance function parameter
+    size_t M;
+    const float *symmetric_table;  // [M][256][256]
+    float (*lookup_sum)(const float *, const uint8_t *, size_t);
+};
+
+// Sum of table[m][codes[m]] over the M tables
+static float
+PQLookupSum(const float *table, const uint8_t *codes, size_t M) {
+    float res = 0;
+    for (size_t m = 0; m < M; m++) {
+        res += table[m * PQ_NUM_CENTROIDS + codes[m]];
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_AVX512 float
+PQLookupSumAVX512(const float *table, const uint8_t *codes, size_t M) {
+    size_t M16 = M >> 4 << 4;
+
+    const __m512i step = _mm512_set1_epi32(16 * PQ_NUM_CENTROIDS);
+    __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                         _mm512_set1_epi32(PQ_NUM_CENTROIDS));
+    __m512 sum512 = _mm512_set1_ps(0);
+    for (size_t m = 0; m < M16; m += 16) {
+        __m512i idx = _mm512_add_epi32(offsets, _mm512_maskz_cvtepu8_epi32((__mmask16) -1, _mm_loadu_si128((const __m128i *) (codes + m))));
+        sum512 = _mm512_add_ps(sum512, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), (__mmask16) -1, idx, table, sizeof(float)));
+        offsets = _mm512_add_epi32(offsets, step);
+    }
+
+    float res = HorizontalSumAVX512(sum512);
+    return res + PQLookupSum(table + M16 * PQ_NUM_CENTROIDS, codes + M16, M - M16);
+}
+
+static HNSWLIB_TARGET_AVX2 float
+PQLookupSumAVX2(const float *table, const uint8_t *codes, size_t M) {
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t M8 = M >> 3 << 3;
+
+    const __m256i step = _mm256_set1_epi32(8 * PQ_NUM_CENTROIDS);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(PQ_NUM_CENTROIDS));
+    __m256 sum256 = _mm256_set1_ps(0);
+    for (size_t m = 0; m < M8; m += 8) {
+        __m256i idx = _mm256_add_epi32(offsets, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (codes + m))));
+        sum256 = _mm256_add_ps(sum256, _mm256_i32gather_ps(table, idx, sizeof(float)));
+        offsets = _mm256_add_epi32(offsets, step);
+    }
+
+    _mm256_store_ps(TmpRes, sum256);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+    return res + PQLookupSum(table + M8 * PQ_NUM_CENTROIDS, codes + M8, M - M8);
+}
+
+#endif
+
+static float
+PQSum(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    const PQParam *param = (const PQParam *) param_ptr;
+    const uint8_t *record1 = (const uint8_t *) pVect1;
+    const uint8_t *codes2 = (const uint8_t *) pVect2 + 1;
+    if (record1[0] == 1) {
+        // query table against stored codes
+        return param->lookup_sum((const float *) (record1 + sizeof(float)), codes2, param->M);
+    }
+    const uint8_t *codes1 = record1 + 1;
+    float res = 0;
+    for (size_t m = 0; m < param->M; m++) {
+        res += param->symmetric_table[(m * PQ_NUM_CENTROIDS + codes1[m]) * PQ_NUM_CENTROIDS + codes2[m]];
+    }
+    return res;
+}
+
+static float
+PQL2Sqr(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    return PQSum(pVect1, pVect2, param_ptr);
+}
+
+static float
+PQInnerProductDistance(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    return 1.0f - PQSum(pVect1, pVect2, param_ptr);
+}
+
+
+class BasePQSpace : public SpaceInterface<float> {
+ protected:
+    PQParam param_;
+    size_t dsub_;
+    size_t data_size_;
+    size_t query_size_;
+    std::vector<float> centroids_;  // [M][256][dsub]
+    std::vector<float> symmetric_table_;
+
+    // distance between two subvectors that is summed up over the subquantizers
+    virtual float subDistance(const float *x, const float *y) const = 0;
+
+    static float subL2Sqr(const float *x, const float *y, size_t dsub) {
+        float res = 0;
+        for (size_t i = 0; i < dsub; i++) {
+            float t = x[i] - y[i];
+            res += t * t;
+        }
+        return res;
+    }
+
+    const float *getCentroid(size_t m, size_t j) const {
+        return centroids_.data() + (m * PQ_NUM_CENTROIDS + j) * dsub_;
+    }
+
+    size_t nearestCentroid(size_t m, const float *subvector) const {
+        size_t best = 0;
+        float best_dist = std::numeric_limits<float>::max();
+        for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+            float dist = subL2Sqr(subvector, getCentroid(m, j), dsub_);
+            if (dist < best_dist) {
+                best_dist = dist;
+                best = j;
+            }
+        }
+        return best;
+    }
+
+    void computeSymmetricTable() {
+        size_t M = param_.M;
+        symmetric_table_.resize(M * PQ_NUM_CENTROIDS * PQ_NUM_CENTROIDS);
+        for (size_t m = 0; m < M; m++) {
+            for (size_t i = 0; i < PQ_NUM_CENTROIDS; i++) {
+                for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+                    symmetric_table_[(m * PQ_NUM_CENTROIDS + i) * PQ_NUM_CENTROIDS + j] =
+                        subDistance(getCentroid(m, i), getCentroid(m, j));
+                }
+            }
+        }
+        param_.symmetric_table = symmetric_table_.data();
+    }
+
+    void checkTrained() const {
+        if (!isTrained())
+            throw std::runtime_error("PQ codebooks are not trained");
+    }
+
+ public:
+    BasePQSpace(size_t dim, size_t M) {
+        if (M == 0 || dim % M != 0)
+            throw std::runtime_error("The dimension must be a multiple of the number of subquantizers");
+        param_.dim = dim;
+        param_.M = M;
+        param_.symmetric_table = nullptr;
+        param_.lookup_sum = PQLookupSum;
+#if defined(USE_SSE)
+        if (getSIMDLevel() >= SIMDLevel::AVX512)
+            param_.lookup_sum = PQLookupSumAVX512;
+        else if (getSIMDLevel() >= SIMDLevel::AVX2)
+            param_.lookup_sum = PQLookupSumAVX2;
+#endif
+        dsub_ = dim / M;
+        data_size_ = 1 + M;
+        query_size_ = sizeof(float) + M * PQ_NUM_CENTROIDS * sizeof(float);
+    }
+
+    size_t get_data_size() override {
+        return data_size_;
+    }
+
+    size_t get_dim() override {
+        return param_.dim;
+    }
+
+    size_t get_query_size() override {
+        return query_size_;
+    }
+
+    void *get_dist_func_param() override {
+        return &param_;
+    }
+
+    bool isTrained() const {
+        return !centroids_.empty();
+    }
+
+    /*
+    * Trains the codebooks with k-means on n vectors of dim floats, every subquantizer is trained separately.
+    * At least 256 training vectors are needed.
+    */
+    void train(const float *data, size_t n, size_t num_iterations = 25, size_t random_seed = 100) {
+        if (n < PQ_NUM_CENTROIDS)
+            throw std::runtime_error("Not enough training vectors for PQ");
+        size_t M = param_.M;
+        std::vector<float> centroids(M * PQ_NUM_CENTROIDS * dsub_);
+        std::vector<float> subvectors(n * dsub_);
+        std::vector<size_t> assignment(n);
+        std::vector<size_t> counts(PQ_NUM_CENTROIDS);
+        std::default_random_engine rng(random_seed);
+
+        for (size_t m = 0; m < M; m++) {
+            for (size_t i = 0; i < n; i++) {
+                memcpy(&subvectors[i * dsub_], data + i * param_.dim + m * dsub_, dsub_ * sizeof(float));
+            }
+            float *cent = &centroids[m * PQ_NUM_CENTROIDS * dsub_];
+
+            // initialize with distinct random training vectors
+            std::vector<size_t> perm(n);
+            for (size_t i = 0; i < n; i++) perm[i] = i;
+            std::shuffle(perm.begin(), perm.end(), rng);
+            for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+                memcpy(cent + j * dsub_, &subvectors[perm[j] * dsub_], dsub_ * sizeof(float));
+            }
+
+            for (size_t iter = 0; iter < num_iterations; iter++) {
+                for (size_t i = 0; i < n; i++) {
+                    float best_dist = std::numeric_limits<float>::max();
+                    for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+                        float dist = subL2Sqr(&subvectors[i * dsub_], cent + j * dsub_, dsub_);
+                        if (dist < best_dist) {
+                            best_dist = dist;
+                            assignment[i] = j;
+                        }
+                    }
+                }
+
+                std::fill(cent, cent + PQ_NUM_CENTROIDS * dsub_, 0.0f);
+                std::fill(counts.begin(), counts.end(), 0);
+                for (size_t i = 0; i < n; i++) {
+                    float *c = cent + assignment[i] * dsub_;
+                    for (size_t t = 0; t < dsub_; t++) c[t] += subvectors[i * dsub_ + t];
+                    counts[assignment[i]]++;
+                }
+                std::uniform_int_distribution<size_t> pick(0, n - 1);
+                for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+                    float *c = cent + j * dsub_;
+                    if (counts[j] == 0) {
+                        // empty cluster, restart it from a random training vector
+                        memcpy(c, &subvectors[pick(rng) * dsub_], dsub_ * sizeof(float));
+                        continue;
+                    }
+                    for (size_t t = 0; t < dsub_; t++) c[t] /= counts[j];
+                }
+            }
+        }
+        centroids_.swap(centroids);
+        computeSymmetricTable();
+    }
+
+    // Writes the codes of dim floats from vector into a record of get_data_size() bytes
+    void encode(const float *vector, void *record) const {
+        checkTrained();
+        uint8_t *codes = (uint8_t *) record;
+        codes[0] = 0;
+        for (size_t m = 0; m < param_.M; m++) {
+            codes[1 + m] = (uint8_t) nearestCentroid(m, vector + m * dsub_);
+        }
+    }
+
+    // Writes the distance table of dim floats from vector into a query record of get_query_size() bytes
+    void encodeQuery(const float *vector, void *record) const {
+        checkTrained();
+        memset(record, 0, sizeof(float));
+        *((uint8_t *) record) = 1;
+        float *table = (float *) ((char *) record + sizeof(float));
+        for (size_t m = 0; m < param_.M; m++) {
+            for (size_t j = 0; j < PQ_NUM_CENTROIDS; j++) {
+                table[m * PQ_NUM_CENTROIDS + j] = subDistance(vector + m * dsub_, getCentroid(m, j));
+            }
+        }
+    }
+
+    // Restores dim floats from a record created by encode
+    void decode(const void *record, float *vector) const {
+        checkTrained();
+        const uint8_t *codes = (const uint8_t *) record + 1;
+        for (size_t m = 0; m < param_.M; m++) {
+            memcpy(vector + m * dsub_, getCentroid(m, codes[m]), dsub_ * sizeof(float));
+        }
+    }
+
+    void saveCodebooks(const std::string &location) const {
+        checkTrained();
+        std::ofstream output(location, std::ios::binary);
+        writeBinaryPOD(output, param_.dim);
+        writeBinaryPOD(output, param_.M);
+        output.write((const char *) centroids_.data(), centroids_.size() * sizeof(float));
+        output.close();
+    }
+
+    void loadCodebooks(const std::string &location) {
+        std::ifstream input(location, std::ios::binary);
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+        size_t dim, M;
+        readBinaryPOD(input, dim);
+        readBinaryPOD(input, M);
+        if (dim != param_.dim || M != param_.M)
+            throw std::runtime_error("PQ codebooks do not match the space");
+        std::vector<float> centroids(M * PQ_NUM_CENTROIDS * dsub_);
+        input.read((char *) centroids.data(), centroids.size() * sizeof(float));
+        if (!input)
+            throw std::runtime_error("PQ codebooks file is truncated");
+        input.close();
+        centroids_.swap(centroids);
+        computeSymmetricTable();
+    }
+
+    virtual ~BasePQSpace() {}
+};
+
+
+class PQL2Space : public BasePQSpace {
+ protected:
+    float subDistance(const float *x, const float *y) const override {
+        return subL2Sqr(x, y, dsub_);
+    }
+
+ public:
+    PQL2Space(size_t dim, size_t M) : BasePQSpace(dim, M) {}
+
+    DISTFUNC<float> get_dist_func() override {
+        return PQL2Sqr;
+    }
+
+    std::string get_name() override {
+        return "l2_pq";
+    }
+
+    ~PQL2Space() {}
+};
+
+
+class PQInnerProductSpace : public BasePQSpace {
+ protected:
+    float subDistance(const float *x, const float *y) const override {
+        float res = 0;
+        for (size_t i = 0; i < dsub_; i++) {
+            res += x[i] * y[i];
+        }
+        return res;
+    }
+
+ public:
+    PQInnerProductSpace(size_t dim, size_t M) : BasePQSpace(dim, M) {}
+
+    DISTFUNC<float> get_dist_func() override {
+        return PQInnerProductDistance;
+    }
+
+    std::string get_name() override {
+        return "ip_pq";
+    }
+
+    ~PQInnerProductSpace() {}
+};
+
+}  // namespace hnswlib
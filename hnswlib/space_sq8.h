@@ -0,0 +1,244 @@
+#pragma once
+#include "hnswlib.h"
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+
+namespace hnswlib {
+
+/*
+* Scalar quantization to int8 with a scale per vector (SQ8).
+*
+* A vector x is stored as a record of get_data_size() bytes:
+*   float scale, float squared norm of the dequantized vector, int8 codes[dim]
+* where x[i] ~ scale * codes[i] and scale = max|x[i]| / 127.
+* Records are created with encode() and are what has to be passed to addPoint.
+*
+* Queries keep full precision, a query record of get_query_size() bytes is:
+*   float -1 (marks a query), float squared norm of the query, float values[dim]
+* and is created with encodeQuery(). Distances between a query and the stored data are computed
+* asymmetrically (float query against int8 codes), distances between stored records
+* (used during construction) are computed on the codes.
+* A query record must always be the first argument of the distance function, as HierarchicalNSW does.
+*/
+
+struct SQ8Param {
+    size_t dim;  // has to be the first member, the dimension is read from the distance function parameter
+    float (*inner_product_f32_i8)(const float *, const int8_t *, size_t);
+    int32_t (*inner_product_i8_i8)(const int8_t *, const int8_t *, size_t);
+};
+
+static float
+InnerProductF32I8(const float *pVect1, const int8_t *pVect2, size_t qty) {
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += pVect1[i] * pVect2[i];
+    }
+    return res;
+}
+
+static int32_t
+InnerProductI8I8(const int8_t *pVect1, const int8_t *pVect2, size_t qty) {
+    int32_t res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += (int32_t) pVect1[i] * pVect2[i];
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+static HNSWLIB_TARGET_AVX512 float
+InnerProductF32I8AVX512(const float *pVect1, const int8_t *pVect2, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+
+    __m512 sum512 = _mm512_set1_ps(0);
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m512 v1 = _mm512_loadu_ps(pVect1 + i);
+        __m512 v2 = _mm512_maskz_cvtepi32_ps((__mmask16) -1, _mm512_maskz_cvtepi8_epi32((__mmask16) -1, _mm_loadu_si128((const __m128i *) (pVect2 + i))));
+        sum512 = _mm512_fmadd_ps(v1, v2, sum512);
+    }
+
+    float res = HorizontalSumAVX512(sum512);
+    return res + InnerProductF32I8(pVect1 + qty16, pVect2 + qty16, qty - qty16);
+}
+
+static HNSWLIB_TARGET_AVX2 float
+InnerProductF32I8AVX2(const float *pVect1, const int8_t *pVect2, size_t qty) {
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum256 = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v1 = _mm256_loadu_ps(pVect1 + i);
+        __m256 v2 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) (pVect2 + i))));
+        sum256 = _mm256_add_ps(sum256, _mm256_mul_ps(v1, v2));
+    }
+
+    _mm256_store_ps(TmpRes, sum256);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+    return res + InnerProductF32I8(pVect1 + qty8, pVect2 + qty8, qty - qty8);
+}
+
+static HNSWLIB_TARGET_AVX2 int32_t
+InnerProductI8I8AVX2(const int8_t *pVect1, const int8_t *pVect2, size_t qty) {
+    int32_t PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty16 = qty >> 4 << 4;
+
+    __m256i sum256 = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256i v2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        sum256 = _mm256_add_epi32(sum256, _mm256_madd_epi16(v1, v2));
+    }
+
+    _mm256_store_si256((__m256i *) TmpRes, sum256);
+    int32_t res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+    return res + InnerProductI8I8(pVect1 + qty16, pVect2 + qty16, qty - qty16);
+}
+
+#endif
+
+static float
+SQ8InnerProduct(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    const SQ8Param *param = (const SQ8Param *) param_ptr;
+    const float *header1 = (const float *) pVect1;
+    const float *header2 = (const float *) pVect2;
+    const int8_t *codes2 = (const int8_t *) (header2 + 2);
+    if (header1[0] < 0) {
+        // float query against quantized data
+        return header2[0] * param->inner_product_f32_i8(header1 + 2, codes2, param->dim);
+    }
+    const int8_t *codes1 = (const int8_t *) (header1 + 2);
+    return header1[0] * header2[0] * param->inner_product_i8_i8(codes1, codes2, param->dim);
+}
+
+static float
+SQ8InnerProductDistance(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    return 1.0f - SQ8InnerProduct(pVect1, pVect2, param_ptr);
+}
+
+static float
+SQ8L2Sqr(const void *pVect1, const void *pVect2, const void *param_ptr) {
+    // |x - y|^2 = |x|^2 + |y|^2 - 2 <x, y>
+    float res = ((const float *) pVect1)[1] + ((const float *) pVect2)[1] - 2 * SQ8InnerProduct(pVect1, pVect2, param_ptr);
+    return res > 0 ? res : 0;
+}
+
+
+class BaseSQ8Space : public SpaceInterface<float> {
+ protected:
+    SQ8Param param_;
+    size_t data_size_;
+    size_t query_size_;
+
+ public:
+    BaseSQ8Space(size_t dim) {
+        param_.dim = dim;
+        param_.inner_product_f32_i8 = InnerProductF32I8;
+        param_.inner_product_i8_i8 = InnerProductI8I8;
+#if defined(USE_SSE)
+        SIMDLevel level = getSIMDLevel();
+        if (level >= SIMDLevel::AVX512)
+            param_.inner_product_f32_i8 = InnerProductF32I8AVX512;
+        else if (level >= SIMDLevel::AVX2)
+            param_.inner_product_f32_i8 = InnerProductF32I8AVX2;
+        if (level >= SIMDLevel::AVX2)
+            param_.inner_product_i8_i8 = InnerProductI8I8AVX2;
+#endif
+        data_size_ = 2 * sizeof(float) + dim * sizeof(int8_t);
+        query_size_ = (2 + dim) * sizeof(float);
+    }
+
+    size_t get_data_size() override {
+        return data_size_;
+    }
+
+    size_t get_dim() override {
+        return param_.dim;
+    }
+
+    size_t get_query_size() override {
+        return query_size_;
+    }
+
+    void *get_dist_func_param() override {
+        return &param_;
+    }
+
+    // Quantizes dim floats from vector into a record of get_data_size() bytes
+    void encode(const float *vector, void *record) const {
+        float *header = (float *) record;
+        int8_t *codes = (int8_t *) (header + 2);
+        float max_abs = 0;
+        for (size_t i = 0; i < param_.dim; i++) {
+            max_abs = std::max(max_abs, std::fabs(vector[i]));
+        }
+        float scale = max_abs / 127.0f;
+        float inv_scale = max_abs > 0 ? 127.0f / max_abs : 0.0f;
+        int32_t sum_sqr = 0;
+        for (size_t i = 0; i < param_.dim; i++) {
+            float code = std::round(vector[i] * inv_scale);
+            code = std::min(std::max(code, -127.0f), 127.0f);
+            codes[i] = (int8_t) code;
+            sum_sqr += (int32_t) codes[i] * codes[i];
+        }
+        header[0] = scale;
+        header[1] = scale * scale * sum_sqr;
+    }
+
+    // Writes dim floats from vector into a query record of get_query_size() bytes
+    void encodeQuery(const float *vector, void *record) const {
+        float *header = (float *) record;
+        float sum_sqr = 0;
+        for (size_t i = 0; i < param_.dim; i++) {
+            header[2 + i] = vector[i];
+            sum_sqr += vector[i] * vector[i];
+        }
+        header[0] = -1.0f;
+        header[1] = sum_sqr;
+    }
+
+    // Restores dim floats from a record created by encode
+    void decode(const void *record, float *vector) const {
+        const float *header = (const float *) record;
+        const int8_t *codes = (const int8_t *) (header + 2);
+        for (size_t i = 0; i < param_.dim; i++) {
+            vector[i] = header[0] * codes[i];
+        }
+    }
+};
+
+
+class SQ8L2Space : public BaseSQ8Space {
+ public:
+    SQ8L2Space(size_t dim) : BaseSQ8Space(dim) {}
+
+    DISTFUNC<float> get_dist_func() override {
+        return SQ8L2Sqr;
+    }
+
+    std::string get_name() override {
+        return "l2_sq8";
+    }
+
+    ~SQ8L2Space() {}
+};
+
+
+class SQ8InnerProductSpace : public BaseSQ8Space {
+ public:
+    SQ8InnerProductSpace(size_t dim) : BaseSQ8Space(dim) {}
+
+    DISTFUNC<float> get_dist_func() override {
+        return SQ8InnerProductDistance;
+    }
+
+    std::string get_name() override {
+        return "ip_sq8";
+    }
+
+    ~SQ8InnerProductSpace() {}
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hnswlib {
+
+/*
+* Pool of persistent worker threads, so that batch operations do not have to spawn threads per call.
+* The pool can be shared by concurrent callers.
+*/
+class ThreadPool {
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex tasks_lock_;
+    std::condition_variable tasks_cv_;
+    bool stop_{false};
+
+    // state of one parallelFor call, shared with the tasks that may start after the call has returned
+    struct ParallelForState {
+        std::atomic<size_t> current{0};
+        size_t end{0};
+        std::function<void(size_t, size_t)> fn;
+        size_t running{0};
+        std::mutex lock;
+        std::condition_variable cv;
+        std::exception_ptr last_exception{nullptr};
+    };
+
+    static void runParallelFor(ParallelForState &state, size_t thread_id) {
+        while (true) {
+            size_t id = state.current.fetch_add(1);
+            if (id >= state.end) {
+                break;
+            }
+            try {
+                state.fn(id, thread_id);
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(state.lock);
+                state.last_exception = std::current_exception();
+                // stop the other threads from taking new ids
+                state.current = state.end;
+                break;
+            }
+        }
+    }
+
+ public:
+    ThreadPool(size_t num_threads) {
+        for (size_t i = 0; i < num_threads; i++) {
+            workers_.emplace_back([this] {
+                while (true) {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(tasks_lock_);
+                        tasks_cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+                        if (stop_ && tasks_.empty())
+                            return;
+                        task = std::move(tasks_.front());
+                        tasks_.pop_front();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(tasks_lock_);
+            stop_ = true;
+        }
+        tasks_cv_.notify_all();
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers_.size();
+    }
+
+    /*
+    * Calls fn(id, thread_id) for every id from start (inclusive) to end (exclusive) using up to num_threads threads
+    * (at most the pool size plus one) and waits for completion. The calling thread takes part in the work as thread_id 0, the others get
+    * thread ids 1..num_threads-1, so per-thread state can be indexed by thread_id.
+    * The last exception thrown by fn is rethrown in the calling thread.
+    */
+    template<class Function>
+    void parallelFor(size_t start, size_t end, size_t num_threads, Function fn) {
+        if (start >= end)
+            return;
+        num_threads = std::min(std::min(num_threads, workers_.size() + 1), end - start);
+
+        if (num_threads <= 1) {
+            for (size_t id = start; id < end; id++) {
+                fn(id, 0);
+            }
+            return;
+        }
+
+        std::shared_ptr<ParallelForState> state(new ParallelForState());
+        state->current = start;
+        state->end = end;
+        state->fn = fn;
+
+        {
+            std::unique_lock<std::mutex> lock(tasks_lock_);
+            for (size_t thread_id = 1; thread_id < num_threads; thread_id++) {
+                tasks_.emplace_back([state, thread_id] {
+                    {
+                        std::unique_lock<std::mutex> state_lock(state->lock);
+                        state->running++;
+                    }
+                    runParallelFor(*state, thread_id);
+                    {
+                        std::unique_lock<std::mutex> state_lock(state->lock);
+                        state->running--;
+                    }
+                    state->cv.notify_all();
+                });
+            }
+        }
+        tasks_cv_.notify_all();
+
+        runParallelFor(*state, 0);
+
+        // all ids are taken at this point, wait for the tasks that are still processing theirs;
+        // the tasks that start later find no work and only touch the shared state
+        std::unique_lock<std::mutex> state_lock(state->lock);
+        state->cv.wait(state_lock, [&state] { return state->running == 0; });
+        if (state->last_exception) {
+            std::rethrow_exception(state->last_exception);
+        }
+    }
+};
+}  // namespace hnswlib
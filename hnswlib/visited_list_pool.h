@@ -2,32 +2,303 @@
 
 #include <mutex>
 #include <string.h>
+#include <stdint.h>
 #include <deque>
+#include <vector>
 
 namespace hnswlib {
 typedef unsigned short int vl_type;
 
+// How a VisitedList stores the visited elements
+enum class VisitedSetType {
+    DENSE,     // a tag per element, O(numelements) memory, the fastest
+    BITSET,    // a bit per element, only the words set by the previous search are cleared
+    HASH_SET,  // open addressing hash set, memory proportional to the number of visited elements
+    PAGED      // bits in pages of PAGE_SIZE elements allocated on first touch, cleared lazily per search
+};
+
+// Selects the operations of one backend of a VisitedList at compile time
+template<VisitedSetType type>
+struct VisitedSetTag {};
+
 class VisitedList {
  public:
+    static const unsigned int PAGE_BITS = 12;
+    static const unsigned int PAGE_SIZE = 1 << PAGE_BITS;
+
     vl_type curV;
-    vl_type *mass;
+    vl_type *mass;  // only with VisitedSetType::DENSE
     unsigned int numelements;
+    VisitedSetType type;
 
-    VisitedList(int numelements1) {
+    VisitedList(int numelements1, VisitedSetType type1 = VisitedSetType::DENSE, size_t expected_visits = 0) {
         curV = -1;
         numelements = numelements1;
-        mass = new vl_type[numelements];
+        type = type1;
+        mass = nullptr;
+        switch (type) {
+        case VisitedSetType::DENSE:
+            mass = new vl_type[numelements];
+            break;
+        case VisitedSetType::BITSET:
+            bits.assign((numelements + 63) / 64, 0);
+            break;
+        case VisitedSetType::HASH_SET:
+            hash_bits = 6;
+            while (((size_t) 1 << hash_bits) < 2 * expected_visits && hash_bits < 31)
+                hash_bits++;
+            slots.assign((size_t) 1 << hash_bits, HashSlot());
+            break;
+        case VisitedSetType::PAGED:
+            pages.assign((numelements + PAGE_SIZE - 1) / PAGE_SIZE, nullptr);
+            break;
+        }
     }
 
+    VisitedList(const VisitedList &) = delete;
+    VisitedList &operator=(const VisitedList &) = delete;
+
     void reset() {
-        curV++;
-        if (curV == 0) {
-            memset(mass, 0, sizeof(vl_type) * numelements);
+        switch (type) {
+        case VisitedSetType::DENSE:
+        case VisitedSetType::HASH_SET:
             curV++;
+            if (curV == 0) {
+                if (type == VisitedSetType::DENSE)
+                    memset(mass, 0, sizeof(vl_type) * numelements);
+                else
+                    slots.assign(slots.size(), HashSlot());
+                curV++;
+            }
+            hash_count = 0;
+            break;
+        case VisitedSetType::BITSET:
+            if (touched_words.size() * 16 > bits.size()) {
+                memset(bits.data(), 0, bits.size() * sizeof(uint64_t));
+            } else {
+                for (unsigned int w : touched_words)
+                    bits[w] = 0;
+            }
+            touched_words.clear();
+            break;
+        case VisitedSetType::PAGED:
+            // pages left over from earlier searches are released once they outnumber the ones in use
+            page_epoch++;
+            if (page_epoch == 0 || num_pages > 4 * touched_pages + 64) {
+                freePages();
+                page_epoch = 1;
+            }
+            touched_pages = 0;
+            break;
         }
     }
 
-    ~VisitedList() { delete[] mass; }
+    /*
+    * Marks the element as visited, returns false if it already was. visit<T> and prefetch<T> are the operations
+    * of the backend T == type, search loops templated on it resolve the backend once instead of for every element.
+    */
+    template<VisitedSetType T>
+    inline bool visit(unsigned int id) {
+        return visit(id, VisitedSetTag<T>());
+    }
+
+    template<VisitedSetType T>
+    inline void prefetch(unsigned int id) const {
+        prefetch(id, VisitedSetTag<T>());
+    }
+
+    inline bool visit(unsigned int id) {
+        switch (type) {
+        case VisitedSetType::DENSE:
+            return visit<VisitedSetType::DENSE>(id);
+        case VisitedSetType::BITSET:
+            return visit<VisitedSetType::BITSET>(id);
+        case VisitedSetType::HASH_SET:
+            return visit<VisitedSetType::HASH_SET>(id);
+        case VisitedSetType::PAGED:
+            return visit<VisitedSetType::PAGED>(id);
+        }
+        return true;
+    }
+
+    inline void prefetch(unsigned int id) const {
+        switch (type) {
+        case VisitedSetType::DENSE:
+            prefetch<VisitedSetType::DENSE>(id);
+            break;
+        case VisitedSetType::BITSET:
+            prefetch<VisitedSetType::BITSET>(id);
+            break;
+        case VisitedSetType::HASH_SET:
+            prefetch<VisitedSetType::HASH_SET>(id);
+            break;
+        case VisitedSetType::PAGED:
+            prefetch<VisitedSetType::PAGED>(id);
+            break;
+        }
+    }
+
+    // Bytes allocated for the visited set
+    size_t memoryUsage() const {
+        switch (type) {
+        case VisitedSetType::DENSE:
+            return sizeof(vl_type) * numelements;
+        case VisitedSetType::BITSET:
+            return sizeof(uint64_t) * (bits.size() + touched_words.capacity());
+        case VisitedSetType::HASH_SET:
+            return sizeof(HashSlot) * slots.size();
+        case VisitedSetType::PAGED:
+            return sizeof(VisitedPage *) * pages.size() + sizeof(VisitedPage) * num_pages;
+        }
+        return 0;
+    }
+
+    ~VisitedList() {
+        delete[] mass;
+        freePages();
+    }
+
+ private:
+    struct HashSlot {
+        unsigned int id{0};
+        vl_type tag{0};  // the slot is used in the current search if it equals curV
+    };
+
+    struct VisitedPage {
+        unsigned int epoch{0};
+        uint64_t words[PAGE_SIZE / 64];
+    };
+
+    std::vector<uint64_t> bits;
+    std::vector<unsigned int> touched_words;
+
+    std::vector<HashSlot> slots;
+    unsigned int hash_bits{0};
+    size_t hash_count{0};
+
+    std::vector<VisitedPage *> pages;
+    size_t num_pages{0};
+    size_t touched_pages{0};
+    unsigned int page_epoch{0};
+
+    inline bool visit(unsigned int id, VisitedSetTag<VisitedSetType::DENSE>) {
+        if (mass[id] == curV)
+            return false;
+        mass[id] = curV;
+        return true;
+    }
+
+    inline bool visit(unsigned int id, VisitedSetTag<VisitedSetType::BITSET>) {
+        uint64_t &word = bits[id >> 6];
+        uint64_t bit = (uint64_t) 1 << (id & 63);
+        if (word & bit)
+            return false;
+        if (!word)
+            touched_words.push_back(id >> 6);
+        word |= bit;
+        return true;
+    }
+
+    inline bool visit(unsigned int id, VisitedSetTag<VisitedSetType::HASH_SET>) {
+        return visitHashSet(id);
+    }
+
+    inline bool visit(unsigned int id, VisitedSetTag<VisitedSetType::PAGED>) {
+        VisitedPage *page = getPage(id >> PAGE_BITS);
+        uint64_t &word = page->words[(id >> 6) & (PAGE_SIZE / 64 - 1)];
+        uint64_t bit = (uint64_t) 1 << (id & 63);
+        if (word & bit)
+            return false;
+        word |= bit;
+        return true;
+    }
+
+    inline void prefetch(unsigned int id, VisitedSetTag<VisitedSetType::DENSE>) const {
+#ifdef USE_SSE
+        _mm_prefetch((char *) (mass + id), _MM_HINT_T0);
+#endif
+    }
+
+    inline void prefetch(unsigned int id, VisitedSetTag<VisitedSetType::BITSET>) const {
+#ifdef USE_SSE
+        _mm_prefetch((char *) (bits.data() + (id >> 6)), _MM_HINT_T0);
+#endif
+    }
+
+    inline void prefetch(unsigned int id, VisitedSetTag<VisitedSetType::HASH_SET>) const {
+#ifdef USE_SSE
+        _mm_prefetch((char *) (slots.data() + hashSlot(id)), _MM_HINT_T0);
+#endif
+    }
+
+    inline void prefetch(unsigned int id, VisitedSetTag<VisitedSetType::PAGED>) const {
+#ifdef USE_SSE
+        // the word of the element, a page that is not allocated yet has nothing to fetch. Unlike the other
+        // backends this reads memory, and searches prefetch the id past the end of a link list, which can be any value
+        if ((id >> PAGE_BITS) >= pages.size())
+            return;
+        const VisitedPage *page = pages[id >> PAGE_BITS];
+        if (page)
+            _mm_prefetch((char *) (page->words + ((id >> 6) & (PAGE_SIZE / 64 - 1))), _MM_HINT_T0);
+#endif
+    }
+
+    inline size_t hashSlot(unsigned int id) const {
+        return (uint32_t) (id * 2654435769u) >> (32 - hash_bits);
+    }
+
+    inline bool visitHashSet(unsigned int id) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hashSlot(id);; i = (i + 1) & mask) {
+            HashSlot &slot = slots[i];
+            if (slot.tag != curV) {
+                slot.id = id;
+                slot.tag = curV;
+                if (++hash_count * 2 > slots.size())
+                    growHashSet();
+                return true;
+            }
+            if (slot.id == id)
+                return false;
+        }
+    }
+
+    void growHashSet() {
+        std::vector<HashSlot> old_slots(slots.size() * 2);
+        old_slots.swap(slots);
+        hash_bits++;
+        size_t mask = slots.size() - 1;
+        for (const HashSlot &old_slot : old_slots) {
+            if (old_slot.tag != curV)
+                continue;
+            size_t i = hashSlot(old_slot.id);
+            while (slots[i].tag == curV)
+                i = (i + 1) & mask;
+            slots[i] = old_slot;
+        }
+    }
+
+    inline VisitedPage *getPage(size_t page_id) {
+        VisitedPage *&page = pages[page_id];
+        if (!page) {
+            page = new VisitedPage();
+            num_pages++;
+        }
+        if (page->epoch != page_epoch) {
+            memset(page->words, 0, sizeof(page->words));
+            page->epoch = page_epoch;
+            touched_pages++;
+        }
+        return page;
+    }
+
+    void freePages() {
+        for (VisitedPage *&page : pages) {
+            delete page;
+            page = nullptr;
+        }
+        num_pages = 0;
+    }
 };
 ///////////////////////////////////////////////////////////
 //
@@ -39,12 +310,20 @@ class VisitedListPool {
     std::deque<VisitedList *> pool;
     std::mutex poolguard;
     int numelements;
+    VisitedSetType type;
+    size_t expected_visits;
 
  public:
-    VisitedListPool(int initmaxpools, int numelements1) {
+    VisitedListPool(
+        int initmaxpools,
+        int numelements1,
+        VisitedSetType type1 = VisitedSetType::DENSE,
+        size_t expected_visits1 = 0) {
         numelements = numelements1;
+        type = type1;
+        expected_visits = expected_visits1;
         for (int i = 0; i < initmaxpools; i++)
-            pool.push_front(new VisitedList(numelements));
+            pool.push_front(new VisitedList(numelements, type, expected_visits));
     }
 
     VisitedList *getFreeVisitedList() {
@@ -55,7 +334,7 @@ class VisitedListPool {
                 rez = pool.front();
                 pool.pop_front();
             } else {
-                rez = new VisitedList(numelements);
+                rez = new VisitedList(numelements, type, expected_visits);
             }
         }
         rez->reset();
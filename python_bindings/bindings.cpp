@@ -154,7 +154,7 @@ class Index {
 
     bool index_inited;
     bool ep_added;
-    bool normalize;
+    bool normalize;  // no longer set, the cosine space normalizes itself; kept in the pickled parameters
     int num_threads_default;
     hnswlib::labeltype cur_l;
     hnswlib::HierarchicalNSW<dist_t>* appr_alg;
@@ -168,8 +168,8 @@ class Index {
         } else if (space_name == "ip") {
             l2space = new hnswlib::InnerProductSpace(dim);
         } else if (space_name == "cosine") {
-            l2space = new hnswlib::InnerProductSpace(dim);
-            normalize = true;
+            // normalizes the vectors and the queries itself
+            l2space = new hnswlib::CosineSpace(dim);
         } else {
             throw std::runtime_error("Space name must be one of l2, ip, or cosine.");
         }
@@ -238,16 +238,6 @@ class Index {
     }
 
 
-    void normalize_vector(float* data, float* norm_array) {
-        float norm = 0.0f;
-        for (int i = 0; i < dim; i++)
-            norm += data[i] * data[i];
-        norm = 1.0f / (sqrtf(norm) + 1e-30f);
-        for (int i = 0; i < dim; i++)
-            norm_array[i] = data[i] * norm;
-    }
-
-
     void addItems(py::object input, py::object ids_ = py::none(), int num_threads = -1, bool replace_deleted = false) {
         py::array_t < dist_t, py::array::c_style | py::array::forcecast > items(input);
         auto buffer = items.request();
@@ -271,34 +261,16 @@ class Index {
             int start = 0;
             if (!ep_added) {
                 size_t id = ids.size() ? ids.at(0) : (cur_l);
-                float* vector_data = (float*)items.data(0);
-                std::vector<float> norm_array(dim);
-                if (normalize) {
-                    normalize_vector(vector_data, norm_array.data());
-                    vector_data = norm_array.data();
-                }
-                appr_alg->addPoint((void*)vector_data, (size_t)id, replace_deleted);
+                appr_alg->addPoint((void*)items.data(0), (size_t)id, replace_deleted);
                 start = 1;
                 ep_added = true;
             }
 
             py::gil_scoped_release l;
-            if (normalize == false) {
-                ParallelFor(start, rows, num_threads, [&](size_t row, size_t threadId) {
-                    size_t id = ids.size() ? ids.at(row) : (cur_l + row);
-                    appr_alg->addPoint((void*)items.data(row), (size_t)id, replace_deleted);
-                    });
-            } else {
-                std::vector<float> norm_array(num_threads * dim);
-                ParallelFor(start, rows, num_threads, [&](size_t row, size_t threadId) {
-                    // normalize vector:
-                    size_t start_idx = threadId * dim;
-                    normalize_vector((float*)items.data(row), (norm_array.data() + start_idx));
-
-                    size_t id = ids.size() ? ids.at(row) : (cur_l + row);
-                    appr_alg->addPoint((void*)(norm_array.data() + start_idx), (size_t)id, replace_deleted);
-                    });
-            }
+            ParallelFor(start, rows, num_threads, [&](size_t row, size_t threadId) {
+                size_t id = ids.size() ? ids.at(row) : (cur_l + row);
+                appr_alg->addPoint((void*)items.data(row), (size_t)id, replace_deleted);
+                });
             cur_l += rows;
         }
     }
@@ -554,6 +526,7 @@ class Index {
         auto data_level0_npy = d["data_level0"].cast<py::array_t < char, py::array::c_style | py::array::forcecast > >();
         auto link_list_npy = d["link_lists"].cast<py::array_t < char, py::array::c_style | py::array::forcecast > >();
 
+        appr_alg->label_lookup_.reserve(appr_alg->cur_element_count);
         for (size_t i = 0; i < appr_alg->cur_element_count; i++) {
             if (label_lookup_val_npy.data()[i] < 0) {
                 throw std::runtime_error("Internal id cannot be negative!");
@@ -576,17 +549,17 @@ class Index {
 
         memcpy(appr_alg->data_level0_memory_, data_level0_npy.data(), data_level0_npy.nbytes());
 
+        assert_true((size_t) link_list_npy.nbytes() >= link_npy_size, "Invalid size of link_lists ");
+        // the link lists are stored back to back, they are copied at once into the arena of the index
+        char *link_list_arena = appr_alg->allocLinkListArena(link_npy_size);
+        if (link_list_arena == nullptr)
+            throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklists");
+        memcpy(link_list_arena, link_list_npy.data(), link_npy_size);
         for (size_t i = 0; i < appr_alg->max_elements_; i++) {
-            size_t linkListSize = appr_alg->element_levels_[i] > 0 ? appr_alg->size_links_per_element_ * appr_alg->element_levels_[i] : 0;
-            if (linkListSize == 0) {
+            if (appr_alg->element_levels_[i] > 0)
+                appr_alg->linkLists_[i] = link_list_arena + link_npy_offsets[i];
+            else
                 appr_alg->linkLists_[i] = nullptr;
-            } else {
-                appr_alg->linkLists_[i] = (char*)malloc(linkListSize);
-                if (appr_alg->linkLists_[i] == nullptr)
-                    throw std::runtime_error("Not enough memory: loadIndex failed to allocate linklist");
-
-                memcpy(appr_alg->linkLists_[i], link_list_npy.data() + link_npy_offsets[i], linkListSize);
-            }
         }
 
         // process deleted elements
@@ -639,41 +612,19 @@ class Index {
             CustomFilterFunctor idFilter(filter);
             CustomFilterFunctor* p_idFilter = filter ? &idFilter : nullptr;
 
-            if (normalize == false) {
-                ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
-                    std::priority_queue<std::pair<dist_t, hnswlib::labeltype >> result = appr_alg->searchKnn(
-                        (void*)items.data(row), k, p_idFilter);
-                    if (result.size() != k)
-                        throw std::runtime_error(
-                            "Cannot return the results in a contiguous 2D array. Probably ef or M is too small");
-                    for (int i = k - 1; i >= 0; i--) {
-                        auto& result_tuple = result.top();
-                        data_numpy_d[row * k + i] = result_tuple.first;
-                        data_numpy_l[row * k + i] = result_tuple.second;
-                        result.pop();
-                    }
-                });
-            } else {
-                std::vector<float> norm_array(num_threads * features);
-                ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
-                    float* data = (float*)items.data(row);
-
-                    size_t start_idx = threadId * dim;
-                    normalize_vector((float*)items.data(row), (norm_array.data() + start_idx));
-
-                    std::priority_queue<std::pair<dist_t, hnswlib::labeltype >> result = appr_alg->searchKnn(
-                        (void*)(norm_array.data() + start_idx), k, p_idFilter);
-                    if (result.size() != k)
-                        throw std::runtime_error(
-                            "Cannot return the results in a contiguous 2D array. Probably ef or M is too small");
-                    for (int i = k - 1; i >= 0; i--) {
-                        auto& result_tuple = result.top();
-                        data_numpy_d[row * k + i] = result_tuple.first;
-                        data_numpy_l[row * k + i] = result_tuple.second;
-                        result.pop();
-                    }
-                });
-            }
+            ParallelFor(0, rows, num_threads, [&](size_t row, size_t threadId) {
+                std::priority_queue<std::pair<dist_t, hnswlib::labeltype >> result = appr_alg->searchKnn(
+                    (void*)items.data(row), k, p_idFilter);
+                if (result.size() != k)
+                    throw std::runtime_error(
+                        "Cannot return the results in a contiguous 2D array. Probably ef or M is too small");
+                for (int i = k - 1; i >= 0; i--) {
+                    auto& result_tuple = result.top();
+                    data_numpy_d[row * k + i] = result_tuple.first;
+                    data_numpy_l[row * k + i] = result_tuple.second;
+                    result.pop();
+                }
+            });
         }
         py::capsule free_when_done_l(data_numpy_l, [](void* f) {
             delete[] f;
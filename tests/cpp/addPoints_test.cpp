@@ -0,0 +1,219 @@
+// This is a test file for testing the interface
+//  >>> void addPoints(const void *data, const labeltype *labels, size_t n, size_t num_threads,
+//  >>>                std::function<void(size_t, size_t)> progress);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+float recall(
+    hnswlib::HierarchicalNSW<float>* alg_hnsw,
+    hnswlib::BruteforceSearch<float>* alg_brute,
+    const std::vector<float>& query,
+    int d,
+    size_t nq,
+    size_t k) {
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto gd = alg_brute->searchKnn(p, k);
+        auto res = alg_hnsw->searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (expected.count(res.top().second)) correct++;
+            res.pop();
+        }
+    }
+    return correct / (nq * k);
+}
+
+void test() {
+    int d = 16;
+    idx_t n = 4000;
+    size_t nq = 100;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    std::vector<idx_t> labels(n);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < n; ++i) {
+        labels[i] = 10 * i;
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_brute.addPoint(data.data() + d * i, labels[i]);
+    }
+
+    for (size_t num_threads : {1, 4}) {
+        hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+        size_t last_done = 0;
+        size_t num_reports = 0;
+        alg_hnsw->addPoints(data.data(), labels.data(), n, num_threads, [&](size_t done, size_t total) {
+            assert(total == n);
+            assert(done <= total);
+            last_done = std::max(last_done, done);
+            num_reports++;
+        });
+        assert(last_done == n);
+        assert(num_reports >= 100);
+        assert(alg_hnsw->getCurrentElementCount() == n);
+        alg_hnsw->checkIntegrity();
+
+        for (size_t i = 0; i < n; ++i) {
+            assert(alg_hnsw->getExternalLabel(alg_hnsw->label_lookup_[labels[i]]) == labels[i]);
+            std::vector<float> stored = alg_hnsw->getDataByLabel<float>(labels[i]);
+            assert(memcmp(stored.data(), data.data() + d * i, d * sizeof(float)) == 0);
+        }
+
+        alg_hnsw->setEf(100);
+        float r = recall(alg_hnsw, &alg_brute, query, d, nq, k);
+        std::cout << "Recall with " << num_threads << " threads: " << r << std::endl;
+        assert(r > 0.9);
+        delete alg_hnsw;
+    }
+}
+
+void testUpdatesAndRepeatedLabels() {
+    int d = 4;
+    size_t n = 100;
+
+    std::vector<float> data(2 * n * d);
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    for (size_t i = 0; i < 2 * n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 2 * n);
+    std::vector<idx_t> labels(n);
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = i;
+    }
+    alg_hnsw->addPoints(data.data(), labels.data(), n, 4);
+
+    // the first half updates existing labels, the second half adds labels 100..149 twice
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = i < n / 2 ? i : n + i % (n / 4);
+    }
+    alg_hnsw->addPoints(data.data() + n * d, labels.data(), n, 4);
+    assert(alg_hnsw->getCurrentElementCount() == n + n / 4);
+    alg_hnsw->checkIntegrity();
+
+    for (size_t i = 0; i < n; ++i) {
+        // a repeated label keeps its last vector
+        size_t last = i < n / 2 ? i : i + (i < 3 * n / 4 ? n / 4 : 0);
+        std::vector<float> stored = alg_hnsw->getDataByLabel<float>(labels[i]);
+        assert(memcmp(stored.data(), data.data() + (n + last) * d, d * sizeof(float)) == 0);
+    }
+
+    // exceeding the capacity adds nothing
+    bool thrown = false;
+    std::vector<idx_t> new_labels(n);
+    for (size_t i = 0; i < n; ++i) {
+        new_labels[i] = 1000 + i;
+    }
+    try {
+        alg_hnsw->addPoints(data.data(), new_labels.data(), n, 4);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(alg_hnsw->getCurrentElementCount() == n + n / 4);
+    delete alg_hnsw;
+}
+
+void testConcurrentLabelOperations() {
+    int d = 8;
+    size_t n = 2000;
+
+    std::vector<float> data(2 * n * d);
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    for (size_t i = 0; i < 2 * n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    std::vector<idx_t> labels(n);
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = i;
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    // even labels are deleted as soon as they are in the index, odd labels get a second vector from addPoint
+    std::thread inserter([&]() {
+        alg_hnsw->addPoints(data.data(), labels.data(), n, 2);
+    });
+    std::thread deleter([&]() {
+        for (idx_t label = 0; label < n; label += 2) {
+            while (true) {
+                try {
+                    alg_hnsw->markDelete(label);
+                    break;
+                } catch (const std::runtime_error &) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    });
+    for (idx_t label = 1; label < n; label += 2) {
+        alg_hnsw->addPoint(data.data() + (n + label) * d, label);
+    }
+    inserter.join();
+    deleter.join();
+
+    assert(alg_hnsw->getCurrentElementCount() == n);
+    assert(alg_hnsw->getDeletedCount() == n / 2);
+    for (idx_t label = 0; label < n; ++label) {
+        hnswlib::tableint id = alg_hnsw->label_lookup_[label];
+        assert(alg_hnsw->getExternalLabel(id) == label);
+        assert(alg_hnsw->isMarkedDeleted(id) == (label % 2 == 0));
+        if (label % 2 == 0)
+            continue;
+        std::vector<float> stored = alg_hnsw->getDataByLabel<float>(label);
+        bool from_batch = memcmp(stored.data(), data.data() + label * d, d * sizeof(float)) == 0;
+        bool from_add = memcmp(stored.data(), data.data() + (n + label) * d, d * sizeof(float)) == 0;
+        assert(from_batch || from_add);
+    }
+    delete alg_hnsw;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    testUpdatesAndRepeatedLabels();
+    testConcurrentLabelOperations();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+// This is a test file for testing the batch distance functions of the spaces
+//  >>> BATCHDISTFUNC<dist_t> SpaceInterface<dist_t>::get_batch_dist_func();
+// and the searches using them
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+// The same space without its batch distance function, the searches then call the distance function per neighbor
+class NoBatchSpace : public hnswlib::SpaceInterface<float> {
+    hnswlib::SpaceInterface<float> &space_;
+
+ public:
+    explicit NoBatchSpace(hnswlib::SpaceInterface<float> &space) : space_(space) {}
+
+    size_t get_data_size() override {
+        return space_.get_data_size();
+    }
+
+    hnswlib::DISTFUNC<float> get_dist_func() override {
+        return space_.get_dist_func();
+    }
+
+    void *get_dist_func_param() override {
+        return space_.get_dist_func_param();
+    }
+};
+
+void testKernels(size_t dim) {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    size_t n = 11;
+    std::vector<float> query(dim), data(n * dim);
+    for (size_t i = 0; i < dim; i++) {
+        query[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < n * dim; i++) {
+        data[i] = distrib(rng);
+    }
+    std::vector<const void *> targets(n);
+    for (size_t i = 0; i < n; i++) {
+        targets[i] = data.data() + (n - 1 - i) * dim;
+    }
+
+    // bit-identical to the single target kernels at every SIMD level
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (int level = 0; level <= (int) detected; level++) {
+        hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+        hnswlib::L2Space l2(dim);
+        hnswlib::InnerProductSpace ip(dim);
+        for (hnswlib::SpaceInterface<float> *space : {(hnswlib::SpaceInterface<float> *) &l2, (hnswlib::SpaceInterface<float> *) &ip}) {
+            hnswlib::BATCHDISTFUNC<float> batch_func = space->get_batch_dist_func();
+            assert((batch_func != nullptr) == (level >= (int) hnswlib::SIMDLevel::AVX2));
+            hnswlib::SpaceDistance<float> dist_func(space->get_dist_func(), space->get_dist_func_param(), batch_func);
+
+            for (size_t m = 0; m <= n; m++) {
+                std::vector<float> out(m);
+                dist_func.batch(query.data(), targets.data(), m, out.data());
+                for (size_t i = 0; i < m; i++) {
+                    assert(out[i] == dist_func(query.data(), targets[i]));
+                }
+            }
+        }
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+void testSearch() {
+    int d = 100;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::InnerProductSpace space(d);
+    NoBatchSpace no_batch_space(space);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.saveIndex("batchDist.bin");
+    hnswlib::HierarchicalNSW<float> alg_no_batch(&no_batch_space, "batchDist.bin");
+    alg_hnsw.setEf(100);
+    alg_no_batch.setEf(100);
+
+    // the same results with and without the batch distance function
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto res = alg_hnsw.searchKnnCloserFirst(p, k);
+        auto expected = alg_no_batch.searchKnnCloserFirst(p, k);
+        assert(res.size() == expected.size());
+        for (size_t i = 0; i < res.size(); i++) {
+            assert(res[i] == expected[i]);
+        }
+    }
+    remove("batchDist.bin");
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testKernels(1);
+    testKernels(7);
+    testKernels(16);
+    testKernels(33);
+    testKernels(100);
+    testKernels(128);
+    testKernels(200);
+    testSearch();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
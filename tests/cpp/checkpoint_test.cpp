@@ -0,0 +1,354 @@
+// This is a test file for testing the checkpoints of a build
+//  >>> void saveCheckpoint(const std::string &location);
+//  >>> void loadCheckpoint(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+size_t fileSize(const std::string &location) {
+    std::ifstream input(location, std::ios::binary | std::ios::ate);
+    return input.tellg();
+}
+
+// Copies the first size bytes of a file, as if the writing of the rest was cut off
+void copyPrefix(const std::string &from, const std::string &to, size_t size) {
+    std::ifstream input(from, std::ios::binary);
+    std::vector<char> buffer(size);
+    input.read(buffer.data(), size);
+    std::ofstream output(to, std::ios::binary);
+    output.write(buffer.data(), size);
+}
+
+void checkSameGraph(hnswlib::HierarchicalNSW<float>* expected, hnswlib::HierarchicalNSW<float>* actual) {
+    assert(actual->cur_element_count == expected->cur_element_count);
+    assert(actual->maxlevel_ == expected->maxlevel_);
+    assert(actual->enterpoint_node_ == expected->enterpoint_node_);
+    assert(actual->getDeletedCount() == expected->getDeletedCount());
+    for (size_t i = 0; i < expected->cur_element_count; i++) {
+        assert(memcmp(actual->get_linklist0(i), expected->get_linklist0(i), expected->size_links_level0_) == 0);
+        assert(memcmp(actual->getDataByInternalId(i), expected->getDataByInternalId(i), expected->data_size_) == 0);
+        assert(actual->getExternalLabel(i) == expected->getExternalLabel(i));
+        assert(actual->element_levels_[i] == expected->element_levels_[i]);
+        if (expected->element_levels_[i] > 0) {
+            assert(memcmp(actual->linkLists_[i], expected->linkLists_[i],
+                          expected->size_links_per_element_ * expected->element_levels_[i]) == 0);
+        }
+    }
+}
+
+float recall(
+    hnswlib::HierarchicalNSW<float>* alg_hnsw,
+    const std::vector<float>& data,
+    const std::vector<float>& query,
+    int d,
+    size_t n,
+    size_t nq,
+    size_t k) {
+    hnswlib::L2Space space(d);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        if (!alg_hnsw->isMarkedDeleted(alg_hnsw->label_lookup_[i]))
+            alg_brute.addPoint(data.data() + d * i, i);
+    }
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw->searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (expected.count(res.top().second)) correct++;
+            res.pop();
+        }
+    }
+    return correct / (nq * k);
+}
+
+void test() {
+    int d = 16;
+    size_t n = 6000;
+    size_t nq = 100;
+    size_t k = 10;
+    int num_threads = 4;
+    std::string path = "checkpoint.bin";
+    std::string build_path = "checkpoint_build.bin";
+    std::string torn_path = "checkpoint_torn.bin";
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    std::vector<idx_t> labels(n);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = i;
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+
+    // inserting threads with periodic checkpoints from another thread
+    size_t first_part = 2 * n / 5;
+    std::atomic<size_t> next(0);
+    std::atomic<bool> inserting(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&]() {
+            for (size_t i = next++; i < first_part; i = next++) {
+                alg_hnsw->addPoint(data.data() + d * i, i);
+            }
+        });
+    }
+    std::thread checkpointer([&]() {
+        while (inserting) {
+            alg_hnsw->saveCheckpoint(path);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    inserting = false;
+    checkpointer.join();
+    alg_hnsw->saveCheckpoint(path);
+
+    hnswlib::HierarchicalNSW<float>* alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(path, &space, n);
+    checkSameGraph(alg_hnsw, alg_resumed);
+    delete alg_resumed;
+
+    // a new location starts with the whole index
+    alg_hnsw->saveCheckpoint(build_path);
+    size_t first_size = fileSize(build_path);
+    assert(alg_hnsw->checkpoint_sequence_ == 1);
+
+    // the next part with deletions and updates, its checkpoint only holds the new and the changed elements
+    size_t second_part = 3 * n / 5;
+    alg_hnsw->addPoints(data.data() + d * first_part, labels.data() + first_part, second_part - first_part, num_threads);
+    for (size_t i = 0; i < first_part; i += 50) {
+        alg_hnsw->markDelete(i);
+    }
+    alg_hnsw->addPoint(data.data() + d * (n - 1), 1);
+    alg_hnsw->saveCheckpoint(build_path);
+    size_t second_size = fileSize(build_path);
+    assert(alg_hnsw->checkpoint_sequence_ == 2);
+    assert(second_size - first_size < alg_hnsw->indexFileSize());
+
+    // the resumed index is the index at the last checkpoint
+    alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(build_path, &space, n);
+    checkSameGraph(alg_hnsw, alg_resumed);
+    delete alg_resumed;
+
+    // the build is killed while it writes the second checkpoint
+    size_t killed_count = first_part;
+    delete alg_hnsw;
+    copyPrefix(build_path, torn_path, first_size + (second_size - first_size) / 2);
+
+    alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(torn_path, &space, n);
+    assert(alg_resumed->getCurrentElementCount() == killed_count);
+    assert(alg_resumed->getDeletedCount() == 0);
+    alg_resumed->checkIntegrity();
+
+    // resume the build and keep checkpointing to the same file
+    std::vector<idx_t> missing;
+    for (size_t i = 0; i < n; ++i) {
+        if (alg_resumed->label_lookup_.find(i) == alg_resumed->label_lookup_.end())
+            missing.push_back(i);
+    }
+    assert(missing.size() == n - killed_count);
+    std::vector<float> missing_data;
+    for (idx_t label : missing) {
+        missing_data.insert(missing_data.end(), data.begin() + d * label, data.begin() + d * (label + 1));
+    }
+    size_t half = missing.size() / 2;
+    alg_resumed->addPoints(missing_data.data(), missing.data(), half, num_threads);
+    alg_resumed->saveCheckpoint(torn_path);
+    alg_resumed->addPoints(missing_data.data() + d * half, missing.data() + half, missing.size() - half, num_threads);
+    alg_resumed->saveCheckpoint(torn_path);
+
+    hnswlib::HierarchicalNSW<float>* alg_final = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_final->loadCheckpoint(torn_path, &space);
+    checkSameGraph(alg_resumed, alg_final);
+    assert(alg_final->getCurrentElementCount() == n);
+    assert(alg_final->getMaxElements() == n);
+    alg_final->checkIntegrity();
+
+    alg_final->setEf(100);
+    float r = recall(alg_final, data, query, d, n, nq, k);
+    std::cout << "Recall of the resumed build: " << r << std::endl;
+    assert(r > 0.9);
+
+    delete alg_resumed;
+    delete alg_final;
+    remove(path.c_str());
+    remove(build_path.c_str());
+    remove(torn_path.c_str());
+}
+
+void testCheckpointDuringAddPoints() {
+    int d = 16;
+    size_t n = 4000;
+    size_t nq = 100;
+    size_t k = 10;
+    std::string path = "checkpoint_add_points.bin";
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+    std::vector<idx_t> labels(n);
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = i;
+    }
+
+    // one addPoints call, checkpointed from its progress callback once a third of the points is in
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    bool saved = false;
+    alg_hnsw->addPoints(data.data(), labels.data(), n, 4, [&](size_t done, size_t total) {
+        if (!saved && done >= total / 3) {
+            alg_hnsw->saveCheckpoint(path);
+            saved = true;
+        }
+    });
+    assert(saved);
+    delete alg_hnsw;
+
+    // the checkpoint holds the points inserted so far as complete elements
+    hnswlib::HierarchicalNSW<float>* alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(path, &space, n);
+    size_t checkpointed = alg_resumed->getCurrentElementCount();
+    std::cout << "Points in the checkpoint: " << checkpointed << " of " << n << std::endl;
+    assert(checkpointed >= n / 3 && checkpointed < n);
+    alg_resumed->checkIntegrity();
+    for (size_t i = 0; i < checkpointed; ++i) {
+        idx_t label = alg_resumed->getExternalLabel(i);
+        assert(memcmp(alg_resumed->getDataByInternalId(i), data.data() + d * label, d * sizeof(float)) == 0);
+    }
+
+    // the build continues with the rest of the points
+    std::vector<idx_t> missing;
+    std::vector<float> missing_data;
+    for (idx_t i = 0; i < n; ++i) {
+        if (alg_resumed->label_lookup_.find(i) == alg_resumed->label_lookup_.end()) {
+            missing.push_back(i);
+            missing_data.insert(missing_data.end(), data.begin() + d * i, data.begin() + d * (i + 1));
+        }
+    }
+    assert(missing.size() == n - checkpointed);
+    alg_resumed->addPoints(missing_data.data(), missing.data(), missing.size(), 4);
+    assert(alg_resumed->getCurrentElementCount() == n);
+    alg_resumed->checkIntegrity();
+
+    alg_resumed->setEf(100);
+    float r = recall(alg_resumed, data, query, d, n, nq, k);
+    std::cout << "Recall of the build resumed within addPoints: " << r << std::endl;
+    assert(r > 0.9);
+
+    delete alg_resumed;
+    remove(path.c_str());
+}
+
+void testCompaction() {
+    int d = 4;
+    size_t n = 300;
+    std::string path = "checkpoint_compaction.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    // a checkpoint after every insertion, the records are merged into the whole index from time to time
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    size_t max_sequence = 0;
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+        alg_hnsw->saveCheckpoint(path);
+        max_sequence = std::max(max_sequence, alg_hnsw->checkpoint_sequence_);
+        assert(fileSize(path) <= 3 * alg_hnsw->indexFileSize());
+    }
+    assert(alg_hnsw->checkpoint_sequence_ < max_sequence);
+
+    hnswlib::HierarchicalNSW<float>* alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(path, &space);
+    checkSameGraph(alg_hnsw, alg_resumed);
+
+    delete alg_hnsw;
+    delete alg_resumed;
+    remove(path.c_str());
+}
+
+void testNoCompleteRecord() {
+    int d = 4;
+    std::string path = "checkpoint_empty.bin";
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 100);
+    std::vector<float> v(d, 1.0f);
+    alg_hnsw->addPoint(v.data(), 0);
+    alg_hnsw->saveCheckpoint(path);
+    delete alg_hnsw;
+
+    // only the header is left, the index resumes empty
+    std::string torn_path = "checkpoint_empty_torn.bin";
+    copyPrefix(path, torn_path, fileSize(path) - 1);
+    hnswlib::HierarchicalNSW<float>* alg_resumed = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_resumed->loadCheckpoint(torn_path, &space, 100);
+    assert(alg_resumed->getCurrentElementCount() == 0);
+    alg_resumed->addPoint(v.data(), 0);
+    assert(alg_resumed->searchKnn(v.data(), 1).top().second == 0);
+    delete alg_resumed;
+
+    remove(path.c_str());
+    remove(torn_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    testCheckpointDuringAddPoints();
+    testCompaction();
+    testNoCompleteRecord();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
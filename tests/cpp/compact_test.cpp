@@ -0,0 +1,272 @@
+// This is a test file for testing the interfaces
+//  >>> void compact(size_t num_threads);
+//  >>> void startCompaction(size_t num_threads);
+//  >>> void finishCompaction();
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+using Index = hnswlib::HierarchicalNSW<float>;
+
+// Links point to elements of the index, and every element can be reached from the entry point in the base layer
+void checkGraph(Index* alg_hnsw) {
+    size_t n = alg_hnsw->cur_element_count;
+    for (hnswlib::tableint i = 0; i < n; i++) {
+        for (int level = 0; level <= alg_hnsw->element_levels_[i]; level++) {
+            hnswlib::linklistsizeint* ll = alg_hnsw->get_linklist_at_level(i, level);
+            hnswlib::tableint* links = (hnswlib::tableint*) (ll + 1);
+            for (size_t j = 0; j < alg_hnsw->getListCount(ll); j++) {
+                assert(links[j] < n && links[j] != i);
+                assert(alg_hnsw->element_levels_[links[j]] >= level);
+            }
+        }
+    }
+    assert(alg_hnsw->element_levels_[alg_hnsw->enterpoint_node_] == alg_hnsw->maxlevel_);
+
+    std::vector<bool> reached(n, false);
+    std::vector<hnswlib::tableint> queue(1, alg_hnsw->enterpoint_node_);
+    reached[alg_hnsw->enterpoint_node_] = true;
+    for (size_t head = 0; head < queue.size(); head++) {
+        hnswlib::linklistsizeint* ll = alg_hnsw->get_linklist0(queue[head]);
+        hnswlib::tableint* links = (hnswlib::tableint*) (ll + 1);
+        for (size_t j = 0; j < alg_hnsw->getListCount(ll); j++) {
+            if (!reached[links[j]]) {
+                reached[links[j]] = true;
+                queue.push_back(links[j]);
+            }
+        }
+    }
+    assert(queue.size() == n);
+}
+
+// Recall of the k nearest neighbors of the queries among the given labels
+float recall(Index* alg_hnsw, const std::vector<float> &data, const std::vector<idx_t> &labels,
+             const std::vector<float> &query, size_t k, int d) {
+    size_t nq = query.size() / d;
+    size_t dim = d;
+    size_t correct = 0;
+    for (size_t j = 0; j < nq; j++) {
+        const float* q = query.data() + j * d;
+        std::priority_queue<std::pair<float, idx_t>> expected;
+        for (idx_t label : labels) {
+            float dist = hnswlib::L2Sqr(q, data.data() + label * d, &dim);
+            expected.emplace(dist, label);
+            if (expected.size() > k) expected.pop();
+        }
+        std::unordered_set<idx_t> expected_labels;
+        while (!expected.empty()) {
+            expected_labels.insert(expected.top().second);
+            expected.pop();
+        }
+        std::priority_queue<std::pair<float, idx_t>> result = alg_hnsw->searchKnn(q, k);
+        while (!result.empty()) {
+            correct += expected_labels.count(result.top().second);
+            result.pop();
+        }
+    }
+    return (float) correct / (nq * k);
+}
+
+void testCompact(bool soa_layout) {
+    int d = 16;
+    size_t n = 4000;
+    size_t nq = 100;
+    size_t k = 10;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    Index* alg_hnsw = new Index(&space, n, 16, 200, 100, false, soa_layout);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(100);
+
+    // 30% of the elements are deleted, the entry point among them
+    std::vector<idx_t> live;
+    idx_t entry_label = alg_hnsw->getExternalLabel(alg_hnsw->enterpoint_node_);
+    for (idx_t i = 0; i < n; ++i) {
+        if (i % 10 < 3 || i == entry_label)
+            alg_hnsw->markDelete(i);
+        else
+            live.push_back(i);
+    }
+    size_t num_removed = n - live.size();
+    float recall_before = recall(alg_hnsw, data, live, query, k, d);
+
+    alg_hnsw->compact(4);
+    assert(alg_hnsw->getCurrentElementCount() == live.size());
+    assert(alg_hnsw->getMaxElements() == n - num_removed);
+    assert(alg_hnsw->getDeletedCount() == 0);
+    assert(alg_hnsw->label_lookup_.size() == live.size());
+    for (idx_t label : live) {
+        std::vector<float> vector = alg_hnsw->getDataByLabel<float>(label);
+        assert(memcmp(vector.data(), data.data() + label * d, d * sizeof(float)) == 0);
+    }
+    checkGraph(alg_hnsw);
+    float recall_after = recall(alg_hnsw, data, live, query, k, d);
+    std::cout << "Recall before: " << recall_before << ", after: " << recall_after << "\n";
+    assert(recall_after > 0.95);
+    assert(recall_after >= recall_before - 0.02);
+
+    // the labels of the removed elements are free again
+    alg_hnsw->resizeIndex(n);
+    for (idx_t i = 0; i < n; ++i) {
+        if (alg_hnsw->label_lookup_.count(i) == 0)
+            alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    std::vector<idx_t> all(n);
+    for (idx_t i = 0; i < n; ++i) {
+        all[i] = i;
+    }
+    checkGraph(alg_hnsw);
+    assert(recall(alg_hnsw, data, all, query, k, d) > 0.95);
+
+    delete alg_hnsw;
+}
+
+void testOnlineCompaction() {
+    int d = 16;
+    size_t n = 4000;
+    size_t num_new = 1000;
+    size_t nq = 100;
+    size_t k = 10;
+    std::string path = "compact_index.bin";
+    std::string log_path = "compact_log.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data((n + num_new) * d);
+    for (size_t i = 0; i < (n + num_new) * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    Index* alg_hnsw = new Index(&space, 2 * n, 16, 200, 100, false, false, hnswlib::LinkListLockStrategy::SPINLOCK);
+    alg_hnsw->setLockFreeReads(true);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(100);
+    for (idx_t i = 0; i < n; i += 3) {
+        alg_hnsw->markDelete(i);
+    }
+    alg_hnsw->startLog(path, log_path);
+
+    // insertions, searches and changes of the deleted marks go on during the repair, the searches and
+    // the reads of vectors also while finishCompaction moves the elements
+    alg_hnsw->startCompaction(2);
+    std::atomic<bool> done{false};
+    std::thread searcher([&]() {
+        while (!done) {
+            for (size_t j = 0; j < nq; j++) {
+                alg_hnsw->searchKnn(query.data() + j * d, k);
+            }
+        }
+    });
+    std::thread reader([&]() {
+        while (!done) {
+            for (idx_t i = 2; i < n; i += 3) {
+                std::vector<float> vector = alg_hnsw->getDataByLabel<float>(i);
+                assert(memcmp(vector.data(), data.data() + i * d, d * sizeof(float)) == 0);
+            }
+        }
+    });
+    std::thread inserter([&]() {
+        for (size_t i = n; i < n + num_new; ++i) {
+            alg_hnsw->addPoint(data.data() + d * i, i);
+        }
+    });
+    // every third deleted element is kept, and some elements are deleted later
+    for (idx_t i = 0; i < n; i += 9) {
+        alg_hnsw->unmarkDelete(i);
+    }
+    for (idx_t i = 1; i < n; i += 30) {
+        alg_hnsw->markDelete(i);
+    }
+    inserter.join();
+    alg_hnsw->finishCompaction();
+    done = true;
+    searcher.join();
+    reader.join();
+
+    std::vector<idx_t> live;
+    size_t num_removed = 0;
+    size_t num_deleted = 0;
+    for (idx_t i = 0; i < n + num_new; ++i) {
+        if (i < n && i % 3 == 0 && i % 9 != 0) {
+            num_removed++;
+            assert(alg_hnsw->label_lookup_.count(i) == 0);
+        } else if (i < n && i % 30 == 1) {
+            num_deleted++;
+        } else {
+            live.push_back(i);
+        }
+    }
+    assert(alg_hnsw->getCurrentElementCount() == n + num_new - num_removed);
+    assert(alg_hnsw->getMaxElements() == 2 * n - num_removed);
+    assert(alg_hnsw->getDeletedCount() == num_deleted);
+    checkGraph(alg_hnsw);
+    float recall_after = recall(alg_hnsw, data, live, query, k, d);
+    std::cout << "Recall after the online compaction: " << recall_after << "\n";
+    assert(recall_after > 0.95);
+
+    // the kept elements are found again
+    for (idx_t i = 0; i < n; i += 9) {
+        std::priority_queue<std::pair<float, idx_t>> result = alg_hnsw->searchKnn(data.data() + i * d, 1);
+        assert(result.top().second == i);
+    }
+
+    // the repair is in the log, and the commit after the removal writes a new base snapshot
+    alg_hnsw->commitLog();
+    assert(alg_hnsw->getLogSize() == Index::LOG_HEADER_SIZE);
+    alg_hnsw->stopLog();
+    Index* alg_loaded = new Index(&space);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    assert(alg_loaded->getCurrentElementCount() == alg_hnsw->getCurrentElementCount());
+    assert(alg_loaded->getDeletedCount() == num_deleted);
+    assert(alg_loaded->label_lookup_ == alg_hnsw->label_lookup_);
+    checkGraph(alg_loaded);
+
+    delete alg_loaded;
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(log_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testCompact(false);
+    testCompact(true);
+    testOnlineCompaction();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
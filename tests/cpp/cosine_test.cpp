@@ -0,0 +1,175 @@
+// This is a test file for testing the cosine space CosineSpace, which normalizes the vectors
+// when they are inserted and the queries when they enter a search
+//  >>> bool SpaceInterface<dist_t>::has_preprocessing();
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+float cosineDistance(const float *x, const float *y, size_t d) {
+    double xy = 0, xx = 0, yy = 0;
+    for (size_t i = 0; i < d; i++) {
+        xy += (double) x[i] * y[i];
+        xx += (double) x[i] * x[i];
+        yy += (double) y[i] * y[i];
+    }
+    return (float) (1 - xy / std::sqrt(xx * yy));
+}
+
+void testDistances() {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (size_t d : {1, 7, 16, 33, 100}) {
+        std::vector<float> x(d), y(d), scaled(d);
+        for (size_t i = 0; i < d; i++) {
+            x[i] = distrib(rng);
+            y[i] = distrib(rng);
+            scaled[i] = 10 * x[i];
+        }
+        float expected = cosineDistance(x.data(), y.data(), d);
+
+        for (int level = 0; level <= (int) detected; level++) {
+            hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+            for (bool store_norms : {false, true}) {
+                hnswlib::CosineSpace space(d, store_norms);
+                assert(space.has_preprocessing());
+                assert(space.get_query_size() == d * sizeof(float));
+                assert(space.get_data_size() == (store_norms ? d + 1 : d) * sizeof(float));
+
+                std::vector<float> px(d + 1), py(d + 1), ps(d + 1), qy(d);
+                space.prepare_data(x.data(), px.data());
+                space.prepare_data(y.data(), py.data());
+                space.prepare_data(scaled.data(), ps.data());
+                space.prepare_query(y.data(), qy.data());
+                hnswlib::DISTFUNC<float> distfunc = space.get_dist_func();
+                void *param = space.get_dist_func_param();
+                assert(std::fabs(distfunc(qy.data(), px.data(), param) - expected) < 1e-5);
+                assert(std::fabs(distfunc(px.data(), ps.data(), param)) < 1e-5);
+
+                // the stored norm gives back the inserted vector
+                std::vector<float> restored(d);
+                space.restore_data(ps.data(), restored.data());
+                for (size_t i = 0; i < d; i++) {
+                    if (store_norms)
+                        assert(std::fabs(restored[i] - scaled[i]) < 1e-5 * 10);
+                    else
+                        assert(restored[i] == ps[i]);
+                }
+            }
+        }
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+void testSearch(bool store_norms) {
+    int d = 32;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+    std::uniform_real_distribution<> scale(0.1, 100);
+
+    // the norms vary over three orders of magnitude, only the directions matter
+    for (idx_t i = 0; i < n; ++i) {
+        float s = scale(rng);
+        for (int j = 0; j < d; j++) {
+            data[i * d + j] = s * distrib(rng);
+        }
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::CosineSpace space(d, store_norms);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n);
+    hnswlib::BruteforceSearch<float> alg_brute(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.setEf(100);
+
+    std::vector<float> stored = alg_hnsw.getDataByLabel<float>(7);
+    assert(stored.size() == (size_t) d);
+    size_t dim = d;
+    float norm = std::sqrt(hnswlib::InnerProduct(data.data() + d * 7, data.data() + d * 7, &dim));
+    for (int i = 0; i < d; i++) {
+        // the inserted vector with the stored norms, else the normalized one
+        float expected = store_norms ? data[d * 7 + i] : data[d * 7 + i] / norm;
+        assert(std::fabs(stored[i] - expected) < 1e-5 * (1 + std::fabs(expected)));
+    }
+
+    std::vector<idx_t> labels(nq * k);
+    std::vector<float> distances(nq * k);
+    alg_hnsw.searchKnnBatch(query.data(), nq, k, labels.data(), distances.data(), 4);
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw.searchKnnCloserFirst(p, k);
+        assert(res.size() == k);
+        for (size_t i = 0; i < k; i++) {
+            // the distances are cosine distances of the vectors as they were inserted
+            float expected = cosineDistance(p, data.data() + d * res[i].second, d);
+            assert(std::fabs(res[i].first - expected) < 1e-5);
+            // the batch search normalizes the queries the same way
+            assert(labels[j * k + i] == res[i].second);
+            assert(distances[j * k + i] == res[i].first);
+        }
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            assert(std::fabs(gd.top().first - cosineDistance(p, data.data() + d * gd.top().second, d)) < 1e-5);
+            gd.pop();
+        }
+        for (auto &r : res) {
+            if (expected.count(r.second)) correct++;
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.95);
+
+    // the loaded index keeps the normalized vectors and normalizes the queries again
+    alg_hnsw.saveIndex("cosine.bin");
+    hnswlib::HierarchicalNSW<float> alg_loaded(&space, "cosine.bin");
+    alg_loaded.setEf(100);
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto res = alg_loaded.searchKnnCloserFirst(p, k);
+        for (size_t i = 0; i < k; i++) {
+            assert(res[i].second == labels[j * k + i]);
+        }
+    }
+    remove("cosine.bin");
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testDistances();
+    testSearch(false);
+    testSearch(true);
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,126 @@
+// This is a test file for testing the dimension-specialized spaces FixedDimL2Space and FixedDimInnerProductSpace
+// and the factories
+//  >>> std::unique_ptr<SpaceInterface<float>> createL2Space(size_t dim);
+//  >>> std::unique_ptr<SpaceInterface<float>> createInnerProductSpace(size_t dim);
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+template<size_t DIM>
+void testKernels() {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    std::vector<float> x(DIM), y(DIM);
+    for (size_t i = 0; i < DIM; i++) {
+        x[i] = distrib(rng);
+        y[i] = distrib(rng);
+    }
+
+    // the same distances as the generic spaces at every SIMD level
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (int level = 0; level <= (int) detected; level++) {
+        hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+        hnswlib::FixedDimL2Space<DIM> l2_fixed;
+        hnswlib::FixedDimInnerProductSpace<DIM> ip_fixed;
+        hnswlib::L2Space l2(DIM);
+        hnswlib::InnerProductSpace ip(DIM);
+        assert(l2_fixed.get_data_size() == l2.get_data_size());
+
+        float l2_expected = l2.get_dist_func()(x.data(), y.data(), l2.get_dist_func_param());
+        float ip_expected = ip.get_dist_func()(x.data(), y.data(), ip.get_dist_func_param());
+        float l2_dist = l2_fixed.get_dist_func()(x.data(), y.data(), l2_fixed.get_dist_func_param());
+        float ip_dist = ip_fixed.get_dist_func()(x.data(), y.data(), ip_fixed.get_dist_func_param());
+        assert(std::fabs(l2_dist - l2_expected) < 1e-4 * (1 + l2_expected));
+        assert(std::fabs(ip_dist - ip_expected) < 1e-4 * (1 + std::fabs(ip_expected)));
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+void testFactory() {
+    assert(dynamic_cast<hnswlib::FixedDimL2Space<768>*>(hnswlib::createL2Space(768).get()));
+    assert(dynamic_cast<hnswlib::FixedDimInnerProductSpace<1536>*>(hnswlib::createInnerProductSpace(1536).get()));
+    assert(dynamic_cast<hnswlib::L2Space*>(hnswlib::createL2Space(100).get()));
+    assert(dynamic_cast<hnswlib::InnerProductSpace*>(hnswlib::createInnerProductSpace(100).get()));
+}
+
+void testSearch() {
+    int d = 128;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    std::unique_ptr<hnswlib::SpaceInterface<float>> space = hnswlib::createL2Space(d);
+    hnswlib::L2Space generic_space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(space.get(), n);
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&generic_space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(100);
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto gd = alg_brute->searchKnn(p, k);
+        auto res = alg_hnsw->searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (expected.count(res.top().second)) correct++;
+            res.pop();
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.95);
+
+    delete alg_hnsw;
+    delete alg_brute;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testKernels<1>();
+    testKernels<7>();
+    testKernels<20>();
+    testKernels<100>();
+    testKernels<128>();
+    testKernels<768>();
+    testKernels<1536>();
+    testFactory();
+    testSearch();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+// This is a test file for testing the half precision spaces FP16L2Space, FP16InnerProductSpace,
+// BF16L2Space and BF16InnerProductSpace and the conversions
+//  >>> uint16_t FloatToFP16(float f);
+//  >>> uint16_t FloatToBF16(float f);
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void testConversions() {
+    // exactly representable values
+    for (float f : {0.0f, -0.0f, 1.0f, -2.5f, 0.099609375f, 65504.0f, 6.103515625e-05f, 5.9604645e-08f}) {
+        assert(hnswlib::FP16ToFloat(hnswlib::FloatToFP16(f)) == f);
+    }
+    for (float f : {0.0f, 1.0f, -2.5f, 3.0e38f, 1.0e-38f}) {
+        float r = hnswlib::BF16ToFloat(hnswlib::FloatToBF16(f));
+        assert(std::fabs(r - f) <= std::fabs(f) / 128);
+    }
+    assert(hnswlib::FloatToFP16(1.0f) == 0x3c00);
+    assert(hnswlib::FloatToBF16(1.0f) == 0x3f80);
+    // ties to even
+    assert(hnswlib::FloatToFP16(1.0f + 1.0f / 2048) == 0x3c00);
+    assert(hnswlib::FloatToFP16(1.0f + 3.0f / 2048) == 0x3c02);
+    assert(hnswlib::FloatToBF16(1.0f + 1.0f / 256) == 0x3f80);
+    assert(hnswlib::FloatToBF16(1.0f + 3.0f / 256) == 0x3f82);
+    // overflow, infinity and nan
+    assert(hnswlib::FloatToFP16(70000.0f) == 0x7c00);
+    assert(hnswlib::FloatToFP16(-std::numeric_limits<float>::infinity()) == 0xfc00);
+    assert(std::isnan(hnswlib::FP16ToFloat(hnswlib::FloatToFP16(std::nanf("")))));
+    assert(std::isnan(hnswlib::BF16ToFloat(hnswlib::FloatToBF16(std::nanf("")))));
+
+    // the SIMD encoders round like the scalar conversions
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-100, 100);
+    std::vector<float> x(1000);
+    for (size_t i = 0; i < x.size(); i++) {
+        x[i] = distrib(rng) * std::pow(10.0f, (float) (i % 9) - 6);
+    }
+    hnswlib::FP16L2Space fp16(x.size());
+    hnswlib::BF16L2Space bf16(x.size());
+    std::vector<uint16_t> hx(x.size());
+    std::vector<float> dx(x.size());
+    fp16.encode(x.data(), hx.data());
+    fp16.decode(hx.data(), dx.data());
+    for (size_t i = 0; i < x.size(); i++) {
+        assert(hx[i] == hnswlib::FloatToFP16(x[i]));
+        assert(dx[i] == hnswlib::FP16ToFloat(hx[i]));
+    }
+    bf16.encode(x.data(), hx.data());
+    bf16.decode(hx.data(), dx.data());
+    for (size_t i = 0; i < x.size(); i++) {
+        assert(hx[i] == hnswlib::FloatToBF16(x[i]));
+        assert(dx[i] == hnswlib::BF16ToFloat(hx[i]));
+    }
+}
+
+template<typename HalfSpace, typename FloatSpace>
+void testKernels(float tolerance) {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    // odd dimensions exercise the scalar tails of the SIMD kernels
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (int d : {1, 7, 16, 33, 100, 129}) {
+        std::vector<float> x(d), y(d);
+        for (int i = 0; i < d; i++) {
+            x[i] = distrib(rng);
+            y[i] = distrib(rng);
+        }
+        FloatSpace float_space(d);
+        float expected = float_space.get_dist_func()(x.data(), y.data(), float_space.get_dist_func_param());
+
+        for (int level = 0; level <= (int) detected; level++) {
+            hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+            HalfSpace space(d);
+            assert(space.get_data_size() == d * sizeof(uint16_t));
+            std::vector<uint16_t> hx(d), hy(d);
+            space.encode(x.data(), hx.data());
+            space.encode(y.data(), hy.data());
+            float dist = space.get_dist_func()(hx.data(), hy.data(), space.get_dist_func_param());
+            assert(std::fabs(dist - expected) < tolerance * (1 + std::fabs(expected)));
+        }
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+template<typename HalfSpace, typename FloatSpace>
+void testRecall() {
+    int d = 64;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    HalfSpace space(d);
+    FloatSpace float_space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&float_space, n);
+    std::vector<uint16_t> record(d);
+    for (size_t i = 0; i < n; ++i) {
+        space.encode(data.data() + d * i, record.data());
+        alg_hnsw->addPoint(record.data(), i);
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(100);
+
+    // the stored vectors take 2 bytes per component
+    std::vector<uint16_t> stored = alg_hnsw->template getDataByLabel<uint16_t>(7);
+    assert(stored.size() == (size_t) d);
+    space.encode(data.data() + d * 7, record.data());
+    assert(stored == record);
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        space.encode(p, record.data());
+        auto gd = alg_brute->searchKnn(p, k);
+        auto res = alg_hnsw->searchKnn(record.data(), k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (expected.count(res.top().second)) correct++;
+            res.pop();
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.9);
+
+    delete alg_hnsw;
+    delete alg_brute;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testConversions();
+    testKernels<hnswlib::FP16L2Space, hnswlib::L2Space>(1e-2);
+    testKernels<hnswlib::FP16InnerProductSpace, hnswlib::InnerProductSpace>(1e-2);
+    testKernels<hnswlib::BF16L2Space, hnswlib::L2Space>(5e-2);
+    testKernels<hnswlib::BF16InnerProductSpace, hnswlib::InnerProductSpace>(5e-2);
+    testRecall<hnswlib::FP16L2Space, hnswlib::L2Space>();
+    testRecall<hnswlib::FP16InnerProductSpace, hnswlib::InnerProductSpace>();
+    testRecall<hnswlib::BF16L2Space, hnswlib::L2Space>();
+    testRecall<hnswlib::BF16InnerProductSpace, hnswlib::InnerProductSpace>();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+// This is a test file for testing the binary space HammingSpace
+// and the two stage search on binary codes reranked with float vectors
+//  >>> std::vector<std::pair<rerank_dist_t, labeltype>>
+//  >>>    searchKnnReranked(const void *query_data, size_t k, size_t rerank_k, const void *rerank_query,
+//  >>>                      SpaceInterface<rerank_dist_t> *rerank_space, get_rerank_data, BaseFilterFunctor* isIdAllowed) const;
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void testKernels() {
+    std::mt19937_64 rng;
+    rng.seed(47);
+
+    // the number of words exercises the unrolled loops and the tails of the kernels
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (size_t bits : {1, 63, 64, 65, 200, 512, 1000, 1024, 1600}) {
+        size_t words = (bits + 63) / 64;
+        std::vector<uint64_t> a(words), b(words);
+        int expected = 0;
+        for (size_t i = 0; i < bits; i++) {
+            bool x = rng() & 1;
+            bool y = rng() & 1;
+            if (x) a[i / 64] |= (uint64_t) 1 << (i % 64);
+            if (y) b[i / 64] |= (uint64_t) 1 << (i % 64);
+            expected += x != y;
+        }
+
+        for (int level = 0; level <= (int) detected; level++) {
+            hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+            hnswlib::HammingSpace space(bits);
+            assert(space.get_data_size() == words * sizeof(uint64_t));
+            hnswlib::DISTFUNC<int> distfunc = space.get_dist_func();
+            void *param = space.get_dist_func_param();
+            assert(distfunc(a.data(), b.data(), param) == expected);
+            assert(distfunc(a.data(), a.data(), param) == 0);
+        }
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+void testEncode() {
+    float x[70] = {0};
+    x[0] = 1.0f;
+    x[3] = -1.0f;
+    x[65] = 0.5f;
+    hnswlib::HammingSpace space(70);
+    std::vector<uint64_t> code(2, ~(uint64_t) 0);
+    space.encode(x, code.data());
+    assert(code[0] == 1);
+    assert(code[1] == 2);
+}
+
+void testTwoStageSearch() {
+    int d = 256;
+    idx_t n = 5000;
+    idx_t nq = 50;
+    size_t k = 10;
+    size_t rerank_k = 100;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::normal_distribution<> distrib;
+
+    // clustered data, as embeddings are, so that the signs keep the neighborhoods
+    size_t num_clusters = 50;
+    std::vector<float> centers(num_clusters * d);
+    for (size_t i = 0; i < num_clusters * d; ++i) {
+        centers[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = centers[(i / d) % num_clusters * d + i % d] + 0.5 * distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = centers[(i / d) % num_clusters * d + i % d] + 0.5 * distrib(rng);
+    }
+
+    hnswlib::HammingSpace space(d);
+    hnswlib::InnerProductSpace float_space(d);
+    hnswlib::HierarchicalNSW<int> alg_hnsw(&space, n);
+    hnswlib::BruteforceSearch<float> alg_brute(&float_space, n);
+    std::vector<uint64_t> code(space.get_data_size() / sizeof(uint64_t));
+    for (size_t i = 0; i < n; ++i) {
+        space.encode(data.data() + d * i, code.data());
+        alg_hnsw.addPoint(code.data(), i);
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.setEf(200);
+
+    // the float vectors stay in a side store, the index only keeps the codes
+    auto get_float_data = [&](idx_t label) -> const void * { return data.data() + d * label; };
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        space.encode(p, code.data());
+        auto res = alg_hnsw.searchKnnReranked<float>(code.data(), k, rerank_k, p, &float_space, get_float_data);
+        assert(res.size() == k);
+        for (size_t i = 1; i < res.size(); i++) {
+            assert(res[i - 1].first <= res[i].first);
+        }
+        auto gd = alg_brute.searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        for (auto &r : res) {
+            if (expected.count(r.second)) correct++;
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.8);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testKernels();
+    testEncode();
+    testTwoStageSearch();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
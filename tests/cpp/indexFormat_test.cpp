@@ -0,0 +1,191 @@
+// This is a test file for testing the format of the index file
+//  >>> void saveIndex(const std::string &location);
+//  >>> void saveIndexLegacy(const std::string &location);
+//  >>> static void convertIndexFile(const std::string &legacy_location, const std::string &location,
+//  >>>                              SpaceInterface<dist_t> *s);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+using Index = hnswlib::HierarchicalNSW<float>;
+
+std::vector<char> readFile(const std::string &location) {
+    std::ifstream input(location, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &location, const std::vector<char> &buffer) {
+    std::ofstream output(location, std::ios::binary);
+    output.write(buffer.data(), buffer.size());
+}
+
+void checkSameIndex(Index* expected, Index* actual) {
+    assert(actual->cur_element_count == expected->cur_element_count);
+    assert(actual->maxlevel_ == expected->maxlevel_);
+    assert(actual->enterpoint_node_ == expected->enterpoint_node_);
+    assert(actual->getDeletedCount() == expected->getDeletedCount());
+    assert(actual->label_lookup_ == expected->label_lookup_);
+    for (size_t i = 0; i < expected->cur_element_count; i++) {
+        assert(memcmp(actual->get_linklist0(i), expected->get_linklist0(i), expected->size_links_level0_) == 0);
+        assert(memcmp(actual->getDataByInternalId(i), expected->getDataByInternalId(i), expected->data_size_) == 0);
+        assert(actual->getExternalLabel(i) == expected->getExternalLabel(i));
+        assert(actual->element_levels_[i] == expected->element_levels_[i]);
+        if (expected->element_levels_[i] > 0) {
+            assert(memcmp(actual->linkLists_[i], expected->linkLists_[i],
+                          expected->size_links_per_element_ * expected->element_levels_[i]) == 0);
+        }
+    }
+}
+
+// Loads with the parallel, the streaming and the mapping loader, returns the number of them that threw
+int numThrowingLoads(const std::string &location, hnswlib::SpaceInterface<float> *space) {
+    int thrown = 0;
+    Index index(space);
+    try {
+        index.loadIndex(location, space, 0, 4);
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    std::vector<char> buffer = readFile(location);
+    hnswlib::MemorySource source(buffer);
+    try {
+        index.loadIndex(source, space);
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    try {
+        index.loadIndexMmap(location, space, true);
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    return thrown;
+}
+
+void test() {
+    int d = 20;  // 80 bytes per vector, padded in the file
+    size_t n = 2000;
+    std::string path = "index_format.bin";
+    std::string legacy_path = "index_format_legacy.bin";
+    std::string converted_path = "index_format_converted.bin";
+    std::string corrupted_path = "index_format_corrupted.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    Index* alg_hnsw = new Index(&space, 2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, 5 * i);
+    }
+    for (size_t i = 0; i < n; i += 9) {
+        alg_hnsw->markDelete(5 * i);
+    }
+    alg_hnsw->saveIndex(path);
+
+    // the header and the section table
+    std::vector<char> buffer = readFile(path);
+    assert(buffer.size() == alg_hnsw->indexFileSize());
+    uint64_t magic;
+    memcpy(&magic, buffer.data(), sizeof(magic));
+    assert(magic == Index::INDEX_MAGIC);
+    assert(std::string(buffer.data() + 16) == "l2");
+    std::vector<hnswlib::IndexSectionEntry> sections = alg_hnsw->indexSections();
+    assert(sections.size() == 5);
+    for (size_t i = 0; i < sections.size(); i++) {
+        hnswlib::IndexSectionEntry entry;
+        const char *table = buffer.data() + Index::INDEX_FIXED_HEADER_SIZE + i * Index::INDEX_SECTION_ENTRY_SIZE;
+        memcpy(&entry.type, table, 4);
+        memcpy(&entry.crc, table + 4, 4);
+        memcpy(&entry.offset, table + 8, 8);
+        memcpy(&entry.size, table + 16, 8);
+        assert(entry.type == i + 1);
+        assert(entry.offset == sections[i].offset && entry.size == sections[i].size);
+        assert(entry.offset % 64 == 0);
+        assert(entry.crc == hnswlib::CRC32C::update(0, buffer.data() + entry.offset, entry.size));
+    }
+    assert(sections[1].stride == 128);
+    assert(sections[4].size == alg_hnsw->getDeletedCount() * sizeof(hnswlib::tableint));
+
+    // every loader reads the same index, the mapping uses the sections in place
+    Index* alg_loaded = new Index(&space);
+    alg_loaded->loadIndex(path, &space, 0, 4);
+    assert(alg_loaded->getMaxElements() == 2 * n);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    alg_loaded->loadIndexMmap(path, &space);
+    assert(alg_loaded->isReadOnly());
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+    alg_loaded = new Index(&space, path, false, 0, false, true);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+
+    // a legacy file is still loaded, and converted to the same file as saveIndex writes
+    alg_hnsw->saveIndexLegacy(legacy_path);
+    assert(readFile(legacy_path).size() == alg_hnsw->legacyIndexFileSize());
+    alg_loaded = new Index(&space, legacy_path);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    alg_loaded->loadIndexMmap(legacy_path, &space);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+    Index::convertIndexFile(legacy_path, converted_path, &space);
+    assert(readFile(converted_path) == buffer);
+
+    // a changed byte in any section or in the header fails its checksum
+    assert(numThrowingLoads(path, &space) == 0);
+    for (const hnswlib::IndexSectionEntry &section : sections) {
+        if (section.size == 0)
+            continue;
+        std::vector<char> corrupted = buffer;
+        corrupted[section.offset + section.size / 2] ^= 0x10;
+        writeFile(corrupted_path, corrupted);
+        assert(numThrowingLoads(corrupted_path, &space) == 3);
+    }
+    // by default the mapping loader checks only the header, the vectors are not read at load
+    std::vector<char> changed_vector = buffer;
+    changed_vector[sections[1].offset] ^= 0x10;
+    writeFile(corrupted_path, changed_vector);
+    alg_loaded = new Index(&space);
+    alg_loaded->loadIndexMmap(corrupted_path, &space);
+    delete alg_loaded;
+    std::vector<char> corrupted = buffer;
+    corrupted[40] ^= 0x01;
+    writeFile(corrupted_path, corrupted);
+    assert(numThrowingLoads(corrupted_path, &space) == 3);
+
+    // the index is rejected by another space
+    hnswlib::InnerProductSpace ip_space(d);
+    assert(numThrowingLoads(path, &ip_space) == 3);
+    hnswlib::L2Space other_space(d + 1);
+    assert(numThrowingLoads(path, &other_space) == 3);
+
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(legacy_path.c_str());
+    remove(converted_path.c_str());
+    remove(corrupted_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
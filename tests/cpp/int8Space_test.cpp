@@ -0,0 +1,132 @@
+// This is a test file for testing the 8-bit integer spaces L2SpaceI, InnerProductSpaceI,
+// L2SpaceInt8 and InnerProductSpaceInt8 and their kernels at every SIMD level
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+template<typename T>
+int l2(const T *x, const T *y, size_t d) {
+    int res = 0;
+    for (size_t i = 0; i < d; i++) {
+        res += ((int) x[i] - (int) y[i]) * ((int) x[i] - (int) y[i]);
+    }
+    return res;
+}
+
+template<typename T>
+int negatedInnerProduct(const T *x, const T *y, size_t d) {
+    int res = 0;
+    for (size_t i = 0; i < d; i++) {
+        res += (int) x[i] * (int) y[i];
+    }
+    return -res;
+}
+
+template<typename T, typename L2Space, typename IPSpace>
+void testKernels() {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_int_distribution<int> distrib(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+
+    // the dimensions exercise the unrolled loops and the tails, the extreme values the overflows
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    for (size_t d : {1, 15, 16, 31, 32, 63, 64, 65, 100, 128, 200}) {
+        std::vector<T> x(d), y(d), lo(d, std::numeric_limits<T>::min()), hi(d, std::numeric_limits<T>::max());
+        for (size_t i = 0; i < d; i++) {
+            x[i] = (T) distrib(rng);
+            y[i] = (T) distrib(rng);
+        }
+
+        for (int level = 0; level <= (int) detected; level++) {
+            hnswlib::setSIMDLevel((hnswlib::SIMDLevel) level);
+            L2Space l2_space(d);
+            IPSpace ip_space(d);
+            assert(l2_space.get_data_size() == d);
+            assert(ip_space.get_data_size() == d);
+            hnswlib::DISTFUNC<int> l2_func = l2_space.get_dist_func();
+            hnswlib::DISTFUNC<int> ip_func = ip_space.get_dist_func();
+            void *param = l2_space.get_dist_func_param();
+
+            assert(l2_func(x.data(), y.data(), param) == l2(x.data(), y.data(), d));
+            assert(l2_func(lo.data(), hi.data(), param) == l2(lo.data(), hi.data(), d));
+            assert(l2_func(x.data(), x.data(), param) == 0);
+            assert(ip_func(x.data(), y.data(), param) == negatedInnerProduct(x.data(), y.data(), d));
+            assert(ip_func(lo.data(), lo.data(), param) == negatedInnerProduct(lo.data(), lo.data(), d));
+            assert(ip_func(lo.data(), hi.data(), param) == negatedInnerProduct(lo.data(), hi.data(), d));
+            assert(ip_func(hi.data(), hi.data(), param) == negatedInnerProduct(hi.data(), hi.data(), d));
+        }
+    }
+    hnswlib::setSIMDLevel(detected);
+}
+
+template<typename T, typename Space>
+void testRecall() {
+    int d = 128;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<T> data(n * d);
+    std::vector<T> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_int_distribution<int> distrib(std::numeric_limits<T>::min(), std::numeric_limits<T>::max());
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = (T) distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = (T) distrib(rng);
+    }
+
+    Space space(d);
+    hnswlib::HierarchicalNSW<int> alg_hnsw(&space, n);
+    hnswlib::BruteforceSearch<int> alg_brute(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+        alg_brute.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.setEf(100);
+
+    float correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const T* p = query.data() + j * d;
+        auto gd = alg_brute.searchKnn(p, k);
+        auto res = alg_hnsw.searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        while (!res.empty()) {
+            if (expected.count(res.top().second)) correct++;
+            res.pop();
+        }
+    }
+    float recall = correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.9);
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testKernels<unsigned char, hnswlib::L2SpaceI, hnswlib::InnerProductSpaceI>();
+    testKernels<int8_t, hnswlib::L2SpaceInt8, hnswlib::InnerProductSpaceInt8>();
+    testRecall<unsigned char, hnswlib::L2SpaceI>();
+    testRecall<int8_t, hnswlib::L2SpaceInt8>();
+    testRecall<int8_t, hnswlib::InnerProductSpaceInt8>();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+// This is a test file for testing searches with
+//  >>> void setLockFreeReads(bool lock_free_reads);
+// of class HierarchicalNSW while elements are inserted from other threads
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void checkResult(
+    const std::vector<std::pair<float, idx_t>>& result,
+    const std::vector<float>& data,
+    int d,
+    const float* query,
+    idx_t n) {
+    hnswlib::L2Space space(d);
+    for (size_t t = 0; t < result.size(); t++) {
+        assert(result[t].second < n);
+        if (t > 0) assert(result[t - 1].first <= result[t].first);
+        float dist = space.get_dist_func()(query, data.data() + d * result[t].second, space.get_dist_func_param());
+        assert(dist == result[t].first);
+    }
+}
+
+void test() {
+    int d = 16;
+    idx_t n = 10000;
+    idx_t n_initial = 1000;
+    size_t nq = 100;
+    size_t k = 10;
+    int num_writers = 2;
+    int num_readers = 2;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    for (size_t i = 0; i < n_initial; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+
+    // without concurrent writers the copies of the link lists give the same results
+    std::vector<std::vector<std::pair<float, idx_t>>> expected(nq);
+    for (size_t j = 0; j < nq; ++j) {
+        expected[j] = alg_hnsw->searchKnnCloserFirst(query.data() + j * d, k);
+    }
+    alg_hnsw->setLockFreeReads(true);
+    hnswlib::HierarchicalNSW<float>::SearchContext ctx;
+    for (size_t j = 0; j < nq; ++j) {
+        assert(alg_hnsw->searchKnnCloserFirst(query.data() + j * d, k) == expected[j]);
+        assert(alg_hnsw->searchKnn(query.data() + j * d, k, ctx) == expected[j]);
+    }
+
+    // searches run while the rest of the elements is inserted
+    std::atomic<idx_t> next_label{n_initial};
+    std::atomic<int> writers_running{num_writers};
+    std::atomic<size_t> num_searches{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < num_writers; w++) {
+        threads.emplace_back([&]() {
+            idx_t label;
+            while ((label = next_label++) < n) {
+                alg_hnsw->addPoint(data.data() + d * label, label);
+            }
+            writers_running--;
+        });
+    }
+    for (int r = 0; r < num_readers; r++) {
+        threads.emplace_back([&, r]() {
+            hnswlib::HierarchicalNSW<float>::SearchContext reader_ctx;
+            size_t j = r;
+            while (writers_running > 0) {
+                const float* p = query.data() + (j % nq) * d;
+                checkResult(alg_hnsw->searchKnnCloserFirst(p, k), data, d, p, n);
+                checkResult(alg_hnsw->searchKnn(p, k, reader_ctx), data, d, p, n);
+                num_searches++;
+                j++;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::cout << "Searches during the insertions: " << num_searches << std::endl;
+
+    // and the final index has a good recall
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(50);
+    size_t correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        auto gd = alg_brute->searchKnn(query.data() + j * d, k);
+        std::unordered_set<idx_t> gd_labels;
+        while (!gd.empty()) {
+            gd_labels.insert(gd.top().second);
+            gd.pop();
+        }
+        for (auto& r : alg_hnsw->searchKnn(query.data() + j * d, k, ctx)) {
+            if (gd_labels.count(r.second)) correct++;
+        }
+    }
+    float recall = (float) correct / (nq * k);
+    std::cout << "Recall: " << recall << std::endl;
+    assert(recall > 0.9);
+
+    delete alg_hnsw;
+    delete alg_brute;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+// This is a test file for testing the lock_strategy constructor parameter of class HierarchicalNSW
+// (LinkListLockStrategy::MUTEX and LinkListLockStrategy::SPINLOCK)
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+float recall(
+    hnswlib::HierarchicalNSW<float>* alg_hnsw,
+    hnswlib::BruteforceSearch<float>* alg_brute,
+    const std::vector<float>& query,
+    int d,
+    size_t nq,
+    size_t k) {
+    size_t correct = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        auto gd = alg_brute->searchKnn(query.data() + j * d, k);
+        std::unordered_set<idx_t> gd_labels;
+        while (!gd.empty()) {
+            gd_labels.insert(gd.top().second);
+            gd.pop();
+        }
+        for (auto& r : alg_hnsw->searchKnnCloserFirst(query.data() + j * d, k)) {
+            if (gd_labels.count(r.second)) correct++;
+        }
+    }
+    return (float) correct / (nq * k);
+}
+
+void test(hnswlib::LinkListLockStrategy lock_strategy, bool soa_layout) {
+    int d = 16;
+    idx_t n = 4000;
+    size_t nq = 100;
+    size_t k = 10;
+    int num_threads = 4;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw =
+        new hnswlib::HierarchicalNSW<float>(&space, n / 2, 16, 200, 100, true, soa_layout, lock_strategy);
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&space, n);
+    assert(alg_hnsw->link_list_locks_.empty() == (lock_strategy == hnswlib::LinkListLockStrategy::SPINLOCK));
+
+    // concurrent insertions, then the index is resized and filled concurrently again
+    auto add_range = [&](idx_t begin, idx_t end) {
+        std::atomic<idx_t> next_label{begin};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([&]() {
+                idx_t label;
+                while ((label = next_label++) < end) {
+                    alg_hnsw->addPoint(data.data() + d * label, label);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+    add_range(0, n / 2);
+    alg_hnsw->resizeIndex(n);
+    add_range(n / 2, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(50);
+    float recall_added = recall(alg_hnsw, alg_brute, query, d, nq, k);
+
+    // concurrent updates of existing elements and replacements of deleted ones
+    for (size_t i = 0; i < n; i += 4) {
+        alg_hnsw->markDelete(i);
+        alg_brute->removePoint(i);
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < n / 4; i += num_threads) {
+                idx_t updated = 4 * i + 1;
+                alg_hnsw->addPoint(data.data() + d * updated, updated);
+                idx_t replacing = n + i;
+                alg_hnsw->addPoint(data.data() + d * (4 * i), replacing, true);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < n / 4; ++i) {
+        alg_brute->addPoint(data.data() + d * (4 * i), n + i);
+    }
+    assert(alg_hnsw->getDeletedCount() == 0);
+    assert(alg_hnsw->cur_element_count == n);
+    float recall_replaced = recall(alg_hnsw, alg_brute, query, d, nq, k);
+    std::cout << "Recall after insertions: " << recall_added << ", after replacements: " << recall_replaced << std::endl;
+    assert(recall_added > 0.9);
+    assert(recall_replaced > 0.9);
+
+    // all spinlocks are released and a loaded index keeps the strategy it was given
+    for (hnswlib::tableint i = 0; i < n; ++i) {
+        assert(((unsigned char*) alg_hnsw->get_linklist0(i))[3] == 0);
+    }
+    alg_hnsw->saveIndex("lock_strategy.bin");
+    hnswlib::HierarchicalNSW<float>* alg_loaded =
+        new hnswlib::HierarchicalNSW<float>(&space, "lock_strategy.bin", false, 0, true, soa_layout, lock_strategy);
+    assert(alg_loaded->link_list_locks_.empty() == (lock_strategy == hnswlib::LinkListLockStrategy::SPINLOCK));
+    alg_loaded->setEf(50);
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        assert(alg_loaded->searchKnnCloserFirst(p, k) == alg_hnsw->searchKnnCloserFirst(p, k));
+    }
+    alg_loaded->resizeIndex(n + 1);
+    alg_loaded->addPoint(data.data(), 2 * n);
+
+    delete alg_hnsw;
+    delete alg_brute;
+    delete alg_loaded;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    for (bool soa_layout : {false, true}) {
+        test(hnswlib::LinkListLockStrategy::MUTEX, soa_layout);
+        test(hnswlib::LinkListLockStrategy::SPINLOCK, soa_layout);
+    }
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+// This is a test file for testing the memory-mapped index loading
+//  >>> void loadIndexMmap(const std::string &location, SpaceInterface<dist_t> *s);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void test() {
+    int d = 16;
+    idx_t n = 1000;
+    idx_t nq = 100;
+    size_t k = 10;
+    std::string index_path = "mmap_load_test.bin";
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    for (size_t i = 0; i < n; i += 10) {
+        alg_hnsw->markDelete(i);
+    }
+    alg_hnsw->saveIndex(index_path);
+    delete alg_hnsw;
+
+    hnswlib::HierarchicalNSW<float>* alg_heap = new hnswlib::HierarchicalNSW<float>(&space, index_path);
+    hnswlib::HierarchicalNSW<float>* alg_mmap = new hnswlib::HierarchicalNSW<float>(&space);
+    alg_mmap->loadIndexMmap(index_path, &space);
+
+    assert(alg_mmap->isReadOnly());
+    assert(alg_mmap->getCurrentElementCount() == alg_heap->getCurrentElementCount());
+    assert(alg_mmap->getDeletedCount() == alg_heap->getDeletedCount());
+
+    // searches on the mapped index must return exactly what the heap-loaded index returns
+    for (size_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        auto gd = alg_heap->searchKnn(p, k);
+        auto res = alg_mmap->searchKnn(p, k);
+        assert(gd.size() == res.size());
+        while (!gd.empty()) {
+            assert(gd.top() == res.top());
+            gd.pop();
+            res.pop();
+        }
+    }
+
+    std::vector<float> vec = alg_mmap->getDataByLabel<float>(1);
+    for (int i = 0; i < d; i++) {
+        assert(vec[i] == data[d + i]);
+    }
+
+    // the mapped index is read-only
+    bool add_failed = false;
+    try {
+        alg_mmap->addPoint(data.data(), n);
+    } catch (const std::runtime_error&) {
+        add_failed = true;
+    }
+    assert(add_failed);
+
+    bool delete_failed = false;
+    try {
+        alg_mmap->markDelete(1);
+    } catch (const std::runtime_error&) {
+        delete_failed = true;
+    }
+    assert(delete_failed);
+    assert(!alg_mmap->isMarkedDeleted(1));
+
+    delete alg_heap;
+    delete alg_mmap;
+    remove(index_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+// This is a test file for testing the interface
+//  >>> void loadIndex(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements_i,
+//  >>>                size_t num_threads);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <fstream>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void checkSameIndex(hnswlib::HierarchicalNSW<float>* expected, hnswlib::HierarchicalNSW<float>* actual) {
+    assert(actual->cur_element_count == expected->cur_element_count);
+    assert(actual->maxlevel_ == expected->maxlevel_);
+    assert(actual->enterpoint_node_ == expected->enterpoint_node_);
+    assert(actual->getDeletedCount() == expected->getDeletedCount());
+    assert(actual->label_lookup_ == expected->label_lookup_);
+    for (size_t i = 0; i < expected->cur_element_count; i++) {
+        assert(memcmp(actual->get_linklist0(i), expected->get_linklist0(i), expected->size_links_level0_) == 0);
+        assert(memcmp(actual->getDataByInternalId(i), expected->getDataByInternalId(i), expected->data_size_) == 0);
+        assert(actual->getExternalLabel(i) == expected->getExternalLabel(i));
+        assert(actual->element_levels_[i] == expected->element_levels_[i]);
+        if (expected->element_levels_[i] > 0) {
+            assert(memcmp(actual->linkLists_[i], expected->linkLists_[i],
+                          expected->size_links_per_element_ * expected->element_levels_[i]) == 0);
+        }
+    }
+}
+
+void test() {
+    // the base layer is larger than one range of the parallel reads
+    int d = 512;
+    size_t n = 20000;
+    std::string path = "parallel_load.bin";
+    std::string truncated_path = "parallel_load_truncated.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n, 8, 20);
+    std::vector<idx_t> labels(n);
+    for (size_t i = 0; i < n; ++i) {
+        labels[i] = 3 * i + 1;
+    }
+    alg_hnsw->addPoints(data.data(), labels.data(), n - 10);
+    for (size_t i = 0; i < n - 10; i += 7) {
+        alg_hnsw->markDelete(labels[i]);
+    }
+    alg_hnsw->saveIndex(path);
+    assert(alg_hnsw->indexFileSize() > 2 * hnswlib::HierarchicalNSW<float>::LOAD_RANGE_SIZE);
+
+    for (size_t num_threads : {1, 4}) {
+        hnswlib::HierarchicalNSW<float>* alg_loaded = new hnswlib::HierarchicalNSW<float>(&space);
+        alg_loaded->loadIndex(path, &space, n, num_threads);
+        assert(alg_loaded->getMaxElements() == n);
+        checkSameIndex(alg_hnsw, alg_loaded);
+
+        // the lists of new elements are allocated apart from the arena
+        for (size_t i = n - 10; i < n; ++i) {
+            alg_loaded->addPoint(data.data() + d * i, labels[i]);
+        }
+        assert(alg_loaded->searchKnn(data.data() + d * (n - 1), 1).top().second == labels[n - 1]);
+        delete alg_loaded;
+    }
+
+    // the base layer is read into the layout of the index
+    hnswlib::HierarchicalNSW<float>* alg_soa = new hnswlib::HierarchicalNSW<float>(&space, path, false, 0, false, true);
+    checkSameIndex(alg_hnsw, alg_soa);
+    delete alg_soa;
+
+    // a truncated file throws and leaves an index that can be reused
+    {
+        std::ifstream input(path, std::ios::binary);
+        std::vector<char> buffer(alg_hnsw->indexFileSize() - 3);
+        input.read(buffer.data(), buffer.size());
+        std::ofstream output(truncated_path, std::ios::binary);
+        output.write(buffer.data(), buffer.size());
+    }
+    hnswlib::HierarchicalNSW<float>* alg_loaded = new hnswlib::HierarchicalNSW<float>(&space);
+    bool thrown = false;
+    try {
+        alg_loaded->loadIndex(truncated_path, &space, 0, 4);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    alg_loaded->loadIndex(path, &space, 0, 4);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(truncated_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
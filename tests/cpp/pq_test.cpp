@@ -0,0 +1,146 @@
+// This is a test file for testing the product quantized spaces PQL2Space and PQInnerProductSpace
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void testLookupKernels() {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    // numbers of subquantizers that exercise the scalar tails of the SIMD kernels
+    for (size_t M : {1, 7, 8, 16, 20, 33}) {
+        std::vector<float> table(M * hnswlib::PQ_NUM_CENTROIDS);
+        std::vector<uint8_t> codes(M);
+        for (size_t i = 0; i < table.size(); i++) table[i] = distrib(rng);
+        for (size_t m = 0; m < M; m++) codes[m] = rng() % hnswlib::PQ_NUM_CENTROIDS;
+
+        float expected = hnswlib::PQLookupSum(table.data(), codes.data(), M);
+#if defined(USE_AVX) && defined(__AVX2__)
+        if (AVXCapable())
+            assert(std::fabs(hnswlib::PQLookupSumAVX2(table.data(), codes.data(), M) - expected) < 1e-4);
+#endif
+#if defined(USE_AVX512)
+        if (AVX512Capable())
+            assert(std::fabs(hnswlib::PQLookupSumAVX512(table.data(), codes.data(), M) - expected) < 1e-4);
+#endif
+        (void) expected;
+    }
+}
+
+template<typename PQSpace, typename FloatSpace>
+void testRecall() {
+    int d = 32;
+    size_t M = 16;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    PQSpace space(d, M);
+    FloatSpace float_space(d);
+    space.train(data.data(), n);
+    assert(space.get_data_size() == M + 1);
+
+    // the codebooks can be restored from a file
+    space.saveCodebooks("pq_codebooks.bin");
+    PQSpace space_loaded(d, M);
+    space_loaded.loadCodebooks("pq_codebooks.bin");
+
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    hnswlib::BruteforceSearch<float>* alg_brute_pq = new hnswlib::BruteforceSearch<float>(&space, n);
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&float_space, n);
+    std::vector<char> record(space.get_data_size()), record_loaded(space.get_data_size());
+    for (size_t i = 0; i < n; ++i) {
+        space.encode(data.data() + d * i, record.data());
+        space_loaded.encode(data.data() + d * i, record_loaded.data());
+        assert(record == record_loaded);
+        alg_hnsw->addPoint(record.data(), i);
+        alg_brute_pq->addPoint(record.data(), i);
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->setEf(100);
+
+    std::vector<char> query_record(space.get_query_size());
+    std::vector<float> decoded(d);
+    size_t correct_pq = 0, correct_reranked = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + d * j;
+        space.encodeQuery(p, query_record.data());
+
+        // the table lookups give the distance to the decoded vector
+        space.decode(alg_hnsw->getDataByInternalId(0), decoded.data());
+        float dist = space.get_dist_func()(query_record.data(), alg_hnsw->getDataByInternalId(0), space.get_dist_func_param());
+        float expected_dist = float_space.get_dist_func()(p, decoded.data(), float_space.get_dist_func_param());
+        assert(std::fabs(dist - expected_dist) < 1e-3);
+
+        // the graph search finds the nearest codes
+        auto gd_pq = alg_brute_pq->searchKnn(query_record.data(), k);
+        std::unordered_set<idx_t> expected_pq;
+        while (!gd_pq.empty()) {
+            expected_pq.insert(gd_pq.top().second);
+            gd_pq.pop();
+        }
+        auto res = alg_hnsw->searchKnnCloserFirst(query_record.data(), k);
+        for (auto& r : res) {
+            if (expected_pq.count(r.second)) correct_pq++;
+        }
+
+        // and reranking with the original vectors finds the true neighbors
+        auto gd = alg_brute->searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+        auto reranked = alg_hnsw->searchKnnReranked<float>(query_record.data(), k, 10 * k, p, &float_space,
+            [&](idx_t label) { return (const void*) (data.data() + d * label); });
+        assert(reranked.size() == k);
+        for (auto& r : reranked) {
+            if (expected.count(r.second)) correct_reranked++;
+        }
+    }
+    float recall_pq = (float) correct_pq / (nq * k);
+    float recall_reranked = (float) correct_reranked / (nq * k);
+    std::cout << "Recall of PQ neighbors: " << recall_pq << ", with reranking: " << recall_reranked << std::endl;
+    assert(recall_pq > 0.9);
+    assert(recall_reranked > 0.9);
+
+    delete alg_hnsw;
+    delete alg_brute_pq;
+    delete alg_brute;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testLookupKernels();
+    testRecall<hnswlib::PQL2Space, hnswlib::L2Space>();
+    testRecall<hnswlib::PQInnerProductSpace, hnswlib::InnerProductSpace>();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+// This is a test file for testing the interface
+//  >>> void reorderIndex(ReorderStrategy strategy);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+// fraction of the links in the base layer that point to an element at most 64 internal ids away
+double nearLinkFraction(hnswlib::HierarchicalNSW<float>* alg_hnsw) {
+    size_t near = 0;
+    size_t count = 0;
+    for (hnswlib::tableint i = 0; i < alg_hnsw->cur_element_count; i++) {
+        hnswlib::linklistsizeint* ll = alg_hnsw->get_linklist0(i);
+        hnswlib::tableint* links = (hnswlib::tableint*) (ll + 1);
+        for (size_t j = 0; j < alg_hnsw->getListCount(ll); j++) {
+            if (std::abs((double) links[j] - i) <= 64) near++;
+            count++;
+        }
+    }
+    return (double) near / count;
+}
+
+void test(hnswlib::ReorderStrategy strategy, bool soa_layout) {
+    int d = 16;
+    idx_t n = 2000;
+    size_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    // clustered data inserted in random order, so linked elements get distant ids
+    size_t num_clusters = 20;
+    std::vector<float> centers(num_clusters * d);
+    for (size_t i = 0; i < num_clusters * d; ++i) {
+        centers[i] = 10 * distrib(rng);
+    }
+    for (idx_t i = 0; i < n; ++i) {
+        size_t cluster = rng() % num_clusters;
+        for (int t = 0; t < d; t++) {
+            data[i * d + t] = centers[cluster * d + t] + distrib(rng);
+        }
+    }
+    for (idx_t i = 0; i < nq; ++i) {
+        size_t cluster = rng() % num_clusters;
+        for (int t = 0; t < d; t++) {
+            query[i * d + t] = centers[cluster * d + t] + distrib(rng);
+        }
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n, 16, 200, 100, true, soa_layout);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    for (size_t i = 0; i < n; i += 10) {
+        alg_hnsw->markDelete(i);
+    }
+    alg_hnsw->setEf(50);
+
+    std::vector<std::vector<std::pair<float, idx_t>>> expected(nq);
+    for (size_t j = 0; j < nq; ++j) {
+        expected[j] = alg_hnsw->searchKnnCloserFirst(query.data() + j * d, k);
+    }
+    std::vector<int> expected_levels(n);
+    for (size_t i = 0; i < n; ++i) {
+        expected_levels[i] = alg_hnsw->element_levels_[alg_hnsw->label_lookup_[i]];
+    }
+    double near_before = nearLinkFraction(alg_hnsw);
+
+    alg_hnsw->reorderIndex(strategy);
+
+    // the graph is the same, only the internal ids have changed
+    double near_after = nearLinkFraction(alg_hnsw);
+    std::cout << "Fraction of near links before: " << near_before << ", after: " << near_after << std::endl;
+    assert(near_after > 1.5 * near_before);
+    for (size_t i = 0; i < n; ++i) {
+        hnswlib::tableint id = alg_hnsw->label_lookup_[i];
+        assert(alg_hnsw->getExternalLabel(id) == i);
+        assert(alg_hnsw->element_levels_[id] == expected_levels[i]);
+        assert(alg_hnsw->isMarkedDeleted(id) == (i % 10 == 0));
+        if (i % 10 != 0)
+            assert(alg_hnsw->getDataByLabel<float>(i) == std::vector<float>(data.begin() + d * i, data.begin() + d * (i + 1)));
+    }
+    for (size_t j = 0; j < nq; ++j) {
+        assert(alg_hnsw->searchKnnCloserFirst(query.data() + j * d, k) == expected[j]);
+    }
+
+    // the new order is saved with the index
+    alg_hnsw->saveIndex("reorder.bin");
+    hnswlib::HierarchicalNSW<float>* alg_loaded = new hnswlib::HierarchicalNSW<float>(&space, "reorder.bin", false, 2 * n, true);
+    assert(nearLinkFraction(alg_loaded) == near_after);
+    alg_loaded->setEf(50);
+    for (size_t j = 0; j < nq; ++j) {
+        assert(alg_loaded->searchKnnCloserFirst(query.data() + j * d, k) == expected[j]);
+    }
+
+    // the reordered index can still be modified, deleted elements are replaced
+    for (size_t i = 0; i < n / 10; ++i) {
+        alg_loaded->addPoint(data.data() + d * i, n + i, true);
+    }
+    assert(alg_loaded->cur_element_count == n);
+    assert(alg_loaded->getDeletedCount() == 0);
+
+    delete alg_hnsw;
+    delete alg_loaded;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    for (bool soa_layout : {false, true}) {
+        test(hnswlib::ReorderStrategy::BFS, soa_layout);
+        test(hnswlib::ReorderStrategy::RCM, soa_layout);
+        test(hnswlib::ReorderStrategy::GORDER, soa_layout);
+    }
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
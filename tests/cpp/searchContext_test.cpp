@@ -0,0 +1,114 @@
+// This is a test file for testing the interface
+//  >>> const std::vector<std::pair<dist_t, labeltype>> &
+//  >>>    searchKnn(const void *query_data, size_t k, SearchContext &ctx, BaseFilterFunctor* isIdAllowed) const;
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <atomic>
+#include <new>
+#include <vector>
+#include <iostream>
+
+// counts heap allocations to check that searches with a prepared context do not allocate
+static std::atomic<size_t> num_allocations{0};
+
+void* operator new(size_t size) {
+    num_allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+class PickEvenIds : public hnswlib::BaseFilterFunctor {
+ public:
+    bool operator()(idx_t label_id) {
+        return label_id % 2 == 0;
+    }
+};
+
+void test() {
+    int d = 16;
+    idx_t n = 1000;
+    idx_t nq = 100;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    for (size_t i = 0; i < n; i += 7) {
+        alg_hnsw->markDelete(i);
+    }
+    alg_hnsw->setEf(50);
+
+    hnswlib::HierarchicalNSW<float>::SearchContext ctx;
+    PickEvenIds filter;
+    for (hnswlib::BaseFilterFunctor* p_filter : {(hnswlib::BaseFilterFunctor*) nullptr, (hnswlib::BaseFilterFunctor*) &filter}) {
+        for (size_t j = 0; j < nq; ++j) {
+            const void* p = query.data() + j * d;
+            auto gd = alg_hnsw->searchKnnCloserFirst(p, k, p_filter);
+            auto& res = alg_hnsw->searchKnn(p, k, ctx, p_filter);
+            assert(gd == res);
+        }
+    }
+
+    // the buffers of the context have grown during the searches above
+    size_t allocations_before = num_allocations;
+    for (size_t j = 0; j < nq; ++j) {
+        alg_hnsw->searchKnn(query.data() + j * d, k, ctx);
+        alg_hnsw->searchKnn(query.data() + j * d, k, ctx, &filter);
+    }
+    assert(num_allocations == allocations_before);
+
+    // the context follows the growth of the index
+    alg_hnsw->resizeIndex(4 * n);
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, n + i);
+    }
+    for (size_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        assert(alg_hnsw->searchKnnCloserFirst(p, k) == alg_hnsw->searchKnn(p, k, ctx));
+    }
+
+    delete alg_hnsw;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+// Benchmark of the interface
+//  >>> void searchKnnBatch(const void *queries, size_t nq, size_t k, labeltype *labels, dist_t *distances,
+//  >>>                     size_t num_threads, BaseFilterFunctor* isIdAllowed) const;
+// of class HierarchicalNSW against searchKnn with a SearchContext per query, both on one thread.
+// Usage: searchKnnBatch_bench [num_elements [dim [num_queries [ef]]]]
+// The index should be larger than the last level cache for the interleaving of the upper layers to pay off.
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    int d = argc > 2 ? std::atoi(argv[2]) : 64;
+    size_t nq = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10000;
+    size_t ef = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 64;
+    size_t k = 10;
+    int num_runs = 5;
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    std::vector<float> query(nq * d);
+    for (size_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+    std::vector<idx_t> ids(n);
+    for (size_t i = 0; i < n; ++i) {
+        ids[i] = i;
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n, 16, 100);
+    std::cout << "Building " << n << " elements of dimension " << d << std::endl;
+    alg_hnsw.addPoints(data.data(), ids.data(), n);
+    alg_hnsw.setEf(ef);
+
+    // the best of several runs, alternating so both see the same state of the machine
+    std::vector<idx_t> labels(nq * k);
+    std::vector<float> distances(nq * k);
+    hnswlib::HierarchicalNSW<float>::SearchContext ctx;
+    double best_single = 1e30;
+    double best_batch = 1e30;
+    for (int run = 0; run < num_runs; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < nq; ++j) {
+            alg_hnsw.searchKnn(query.data() + j * d, k, ctx);
+        }
+        best_single = std::min(best_single, secondsSince(start));
+
+        start = std::chrono::steady_clock::now();
+        alg_hnsw.searchKnnBatch(query.data(), nq, k, labels.data(), distances.data(), 1);
+        best_batch = std::min(best_batch, secondsSince(start));
+    }
+
+    std::cout << "searchKnn with a context: " << best_single * 1e6 / nq << " us/query" << std::endl;
+    std::cout << "searchKnnBatch:           " << best_batch * 1e6 / nq << " us/query" << std::endl;
+    std::cout << "speedup: " << best_single / best_batch << std::endl;
+    return 0;
+}
@@ -0,0 +1,109 @@
+// This is a test file for testing the interface
+//  >>> void searchKnnBatch(const void *queries, size_t nq, size_t k, labeltype *labels, dist_t *distances,
+//  >>>                     size_t num_threads, BaseFilterFunctor* isIdAllowed) const;
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+class PickEvenIds : public hnswlib::BaseFilterFunctor {
+ public:
+    bool operator()(idx_t label_id) {
+        return label_id % 2 == 0;
+    }
+};
+
+void checkBatchMatchesSearchKnn(
+    hnswlib::HierarchicalNSW<float>* alg_hnsw,
+    const std::vector<float>& query,
+    int d,
+    size_t nq,
+    size_t k,
+    size_t num_threads,
+    hnswlib::BaseFilterFunctor* filter = nullptr) {
+    std::vector<idx_t> labels(nq * k);
+    std::vector<float> distances(nq * k);
+    alg_hnsw->searchKnnBatch(query.data(), nq, k, labels.data(), distances.data(), num_threads, filter);
+
+    for (size_t j = 0; j < nq; ++j) {
+        auto gd = alg_hnsw->searchKnn(query.data() + j * d, k, filter);
+        // slots without a result are filled with -1
+        for (size_t t = gd.size(); t < k; t++) {
+            assert(labels[j * k + t] == (idx_t) -1);
+        }
+        size_t t = gd.size();
+        while (!gd.empty()) {
+            t--;
+            assert(gd.top().first == distances[j * k + t]);
+            assert(gd.top().second == labels[j * k + t]);
+            gd.pop();
+        }
+    }
+}
+
+void test() {
+    int d = 16;
+    idx_t n = 1000;
+    size_t nq = 101;  // not a multiple of the group size
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+
+    for (size_t num_threads : {1, 4}) {
+        checkBatchMatchesSearchKnn(alg_hnsw, query, d, nq, k, num_threads);
+    }
+
+    PickEvenIds filter;
+    checkBatchMatchesSearchKnn(alg_hnsw, query, d, nq, k, 4, &filter);
+
+    for (size_t i = 0; i < n; i += 3) {
+        alg_hnsw->markDelete(i);
+    }
+    checkBatchMatchesSearchKnn(alg_hnsw, query, d, nq, k, 4);
+
+    // more neighbors requested than there are elements
+    hnswlib::HierarchicalNSW<float>* alg_small = new hnswlib::HierarchicalNSW<float>(&space, 5);
+    for (size_t i = 0; i < 5; ++i) {
+        alg_small->addPoint(data.data() + d * i, i);
+    }
+    checkBatchMatchesSearchKnn(alg_small, query, d, nq, k, 4);
+
+    delete alg_hnsw;
+    delete alg_small;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
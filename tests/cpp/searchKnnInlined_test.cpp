@@ -0,0 +1,108 @@
+// This is a test file for testing the search with the distance, the filter and the stop condition as template parameters
+//  >>> std::vector<std::pair<dist_t, labeltype>> searchKnnInlined(const void *query_data, size_t k,
+//  >>>     const dist_func_t &dist_func, filter_t* isIdAllowed, stop_condition_t* stop_condition) const;
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+const size_t d = 128;
+
+// A filter without virtual methods
+struct PickEvenIds {
+    bool operator()(idx_t label) const {
+        return label % 2 == 0;
+    }
+};
+
+class PickEvenIdsVirtual : public hnswlib::BaseFilterFunctor {
+ public:
+    bool operator()(idx_t label) {
+        return label % 2 == 0;
+    }
+};
+
+void checkSame(
+    const std::vector<std::pair<float, idx_t>> &res,
+    const std::vector<std::pair<float, idx_t>> &expected) {
+    assert(res.size() == expected.size());
+    for (size_t i = 0; i < res.size(); i++) {
+        assert(res[i].second == expected[i].second);
+        assert(res[i].first == expected[i].first);
+    }
+}
+
+template<hnswlib::SIMDLevel LEVEL>
+void testSearch(hnswlib::HierarchicalNSW<float> &alg_hnsw, const std::vector<float> &query, size_t nq) {
+    hnswlib::FixedDimL2Distance<d, LEVEL> dist_func;
+    PickEvenIds filter;
+    PickEvenIdsVirtual filter_virtual;
+    size_t k = 10;
+
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+
+        // the same results as the runtime-polymorphic search
+        checkSame(alg_hnsw.searchKnnInlined(p, k, dist_func), alg_hnsw.searchKnnCloserFirst(p, k));
+
+        auto res = alg_hnsw.searchKnnInlined(p, k, dist_func, &filter);
+        checkSame(res, alg_hnsw.searchKnnCloserFirst(p, k, &filter_virtual));
+        for (auto &r : res) {
+            assert(r.second % 2 == 0);
+        }
+
+        hnswlib::EpsilonSearchStopCondition<float> stop_condition(16.0f, 5, 50);
+        hnswlib::EpsilonSearchStopCondition<float> stop_condition_expected(16.0f, 5, 50);
+        res = alg_hnsw.searchKnnInlined(p, 50, dist_func, (PickEvenIds*) nullptr, &stop_condition);
+        checkSame(res, alg_hnsw.searchStopConditionClosest(p, stop_condition_expected));
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+
+    idx_t n = 2000;
+    size_t nq = 50;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::FixedDimL2Space<d> space;
+    hnswlib::HierarchicalNSW<float> alg_hnsw(&space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw.addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw.setEf(100);
+
+    // the functor has to call the same kernel as the space for identical distances
+    switch (hnswlib::getSIMDLevel()) {
+    case hnswlib::SIMDLevel::AVX512: testSearch<hnswlib::SIMDLevel::AVX512>(alg_hnsw, query, nq); break;
+    case hnswlib::SIMDLevel::AVX2: testSearch<hnswlib::SIMDLevel::AVX2>(alg_hnsw, query, nq); break;
+    case hnswlib::SIMDLevel::SCALAR: testSearch<hnswlib::SIMDLevel::SCALAR>(alg_hnsw, query, nq); break;
+    default: testSearch<hnswlib::SIMDLevel::SSE>(alg_hnsw, query, nq); break;
+    }
+
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+// This is a test file for testing the runtime selection of the distance kernels
+//  >>> SIMDLevel getSIMDLevel();
+//  >>> void setSIMDLevel(SIMDLevel level);
+// used by L2Space, InnerProductSpace and L2SpaceI
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+const hnswlib::SIMDLevel ALL_LEVELS[] = {
+    hnswlib::SIMDLevel::SCALAR,
+    hnswlib::SIMDLevel::SSE,
+    hnswlib::SIMDLevel::AVX,
+    hnswlib::SIMDLevel::AVX2,
+    hnswlib::SIMDLevel::AVX512
+};
+
+void testKernels(hnswlib::SIMDLevel level) {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    // every dimension up to a few vectors exercises all the tails
+    for (size_t d = 1; d <= 100; d++) {
+        std::vector<float> x(d), y(d);
+        std::vector<unsigned char> xi(d), yi(d);
+        float l2 = 0, ip = 0;
+        int l2i = 0;
+        for (size_t i = 0; i < d; i++) {
+            x[i] = distrib(rng);
+            y[i] = distrib(rng);
+            xi[i] = rng() % 256;
+            yi[i] = rng() % 256;
+            l2 += (x[i] - y[i]) * (x[i] - y[i]);
+            ip += x[i] * y[i];
+            l2i += (xi[i] - yi[i]) * (xi[i] - yi[i]);
+        }
+
+        hnswlib::L2Space l2_space(d);
+        hnswlib::InnerProductSpace ip_space(d);
+        hnswlib::L2SpaceI l2i_space(d);
+        float l2_simd = l2_space.get_dist_func()(x.data(), y.data(), l2_space.get_dist_func_param());
+        float ip_simd = ip_space.get_dist_func()(x.data(), y.data(), ip_space.get_dist_func_param());
+        int l2i_simd = l2i_space.get_dist_func()(xi.data(), yi.data(), l2i_space.get_dist_func_param());
+        assert(std::fabs(l2_simd - l2) < 1e-4 * (1 + l2));
+        assert(std::fabs(ip_simd - (1.0f - ip)) < 1e-4 * (1 + std::fabs(ip)));
+        assert(l2i_simd == l2i);
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    hnswlib::SIMDLevel detected = hnswlib::getSIMDLevel();
+    std::cout << "Detected SIMD level: " << hnswlib::SIMDLevelName(detected) << std::endl;
+
+    for (hnswlib::SIMDLevel level : ALL_LEVELS) {
+        if (level > detected) {
+            bool thrown = false;
+            try {
+                hnswlib::setSIMDLevel(level);
+            } catch (const std::runtime_error &) {
+                thrown = true;
+            }
+            assert(thrown);
+            assert(hnswlib::getSIMDLevel() != level);
+            continue;
+        }
+        hnswlib::setSIMDLevel(level);
+        assert(hnswlib::getSIMDLevel() == level);
+        testKernels(level);
+        std::cout << "Kernels ok: " << hnswlib::SIMDLevelName(level) << std::endl;
+    }
+    hnswlib::setSIMDLevel(detected);
+
+    std::cout << "Test ok" << std::endl;
+    return 0;
+}
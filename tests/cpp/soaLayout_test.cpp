@@ -0,0 +1,123 @@
+// This is a test file for testing the structure-of-arrays layout of the base layer of HierarchicalNSW
+// (the soa_layout constructor parameter)
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+std::vector<char> readFile(const std::string& location) {
+    std::ifstream input(location, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+void checkSameResults(
+    hnswlib::HierarchicalNSW<float>* expected,
+    hnswlib::HierarchicalNSW<float>* actual,
+    const std::vector<float>& query,
+    int d,
+    size_t nq,
+    size_t k) {
+    assert(expected->cur_element_count == actual->cur_element_count);
+    for (size_t j = 0; j < nq; ++j) {
+        const void* p = query.data() + j * d;
+        assert(expected->searchKnnCloserFirst(p, k) == actual->searchKnnCloserFirst(p, k));
+    }
+}
+
+void test() {
+    int d = 19;  // the vectors are padded to 64 bytes
+    idx_t n = 1000;
+    size_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(2 * n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < 2 * n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_interleaved = new hnswlib::HierarchicalNSW<float>(&space, n, 16, 200, 100, false, false);
+    hnswlib::HierarchicalNSW<float>* alg_soa = new hnswlib::HierarchicalNSW<float>(&space, n, 16, 200, 100, false, true);
+    for (size_t i = 0; i < n; ++i) {
+        alg_interleaved->addPoint(data.data() + d * i, i);
+        alg_soa->addPoint(data.data() + d * i, i);
+    }
+
+    // vectors start at aligned addresses and link lists are stored densely
+    for (hnswlib::tableint i = 0; i < n; ++i) {
+        assert((size_t) alg_soa->getDataByInternalId(i) % 64 == 0);
+        assert(memcmp(alg_soa->getDataByInternalId(i), data.data() + d * alg_soa->getExternalLabel(i), d * sizeof(float)) == 0);
+    }
+    assert((char*) alg_soa->get_linklist0(1) - (char*) alg_soa->get_linklist0(0) == (ptrdiff_t) alg_soa->size_links_level0_);
+
+    checkSameResults(alg_interleaved, alg_soa, query, d, nq, k);
+
+    // deletions, updates and resizing work on the separate arrays
+    for (size_t i = 0; i < n; i += 5) {
+        alg_interleaved->markDelete(i);
+        alg_soa->markDelete(i);
+    }
+    alg_interleaved->resizeIndex(2 * n);
+    alg_soa->resizeIndex(2 * n);
+    for (size_t i = n; i < 2 * n; ++i) {
+        alg_interleaved->addPoint(data.data() + d * i, i);
+        alg_soa->addPoint(data.data() + d * i, i);
+    }
+    for (size_t i = 1; i < n; i += 50) {
+        alg_interleaved->addPoint(data.data() + d * (2 * n - i), i);
+        alg_soa->addPoint(data.data() + d * (2 * n - i), i);
+    }
+    checkSameResults(alg_interleaved, alg_soa, query, d, nq, k);
+
+    // both layouts are saved to the same file
+    alg_interleaved->saveIndex("soa_interleaved.bin");
+    alg_soa->saveIndex("soa_soa.bin");
+    assert(readFile("soa_interleaved.bin") == readFile("soa_soa.bin"));
+
+    // and the file can be loaded into either layout
+    hnswlib::HierarchicalNSW<float>* alg_loaded_soa =
+        new hnswlib::HierarchicalNSW<float>(&space, "soa_interleaved.bin", false, 0, false, true);
+    hnswlib::HierarchicalNSW<float>* alg_loaded_interleaved =
+        new hnswlib::HierarchicalNSW<float>(&space, "soa_soa.bin");
+    assert(alg_loaded_soa->soa_layout_);
+    assert(!alg_loaded_interleaved->soa_layout_);
+    assert(alg_loaded_soa->getDeletedCount() == alg_soa->getDeletedCount());
+    checkSameResults(alg_interleaved, alg_loaded_soa, query, d, nq, k);
+    checkSameResults(alg_interleaved, alg_loaded_interleaved, query, d, nq, k);
+
+    alg_loaded_soa->saveIndex("soa_soa.bin");
+    assert(readFile("soa_interleaved.bin") == readFile("soa_soa.bin"));
+
+    delete alg_interleaved;
+    delete alg_soa;
+    delete alg_loaded_soa;
+    delete alg_loaded_interleaved;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+// This is a test file for testing the scalar quantized spaces SQ8L2Space and SQ8InnerProductSpace
+// and the interface
+//  >>> std::vector<std::pair<rerank_dist_t, labeltype>>
+//  >>>    searchKnnReranked(const void *query_data, size_t k, size_t rerank_k, const void *rerank_query,
+//  >>>                      SpaceInterface<rerank_dist_t> *rerank_space, get_rerank_data, BaseFilterFunctor* isIdAllowed) const;
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+void testKernels() {
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    // odd dimensions exercise the scalar tails of the SIMD kernels
+    for (int d : {1, 7, 16, 33, 100, 129}) {
+        std::vector<float> x(d), y(d);
+        for (int i = 0; i < d; i++) {
+            x[i] = distrib(rng);
+            y[i] = distrib(rng);
+        }
+        hnswlib::SQ8L2Space space(d);
+        std::vector<char> rx(space.get_data_size()), ry(space.get_data_size()), q(space.get_query_size());
+        space.encode(x.data(), rx.data());
+        space.encode(y.data(), ry.data());
+        space.encodeQuery(x.data(), q.data());
+
+        std::vector<float> dx(d), dy(d);
+        space.decode(rx.data(), dx.data());
+        space.decode(ry.data(), dy.data());
+        float sym = 0, asym = 0;
+        for (int i = 0; i < d; i++) {
+            assert(std::fabs(dx[i] - x[i]) <= 1.0f / 127);
+            sym += (dx[i] - dy[i]) * (dx[i] - dy[i]);
+            asym += (x[i] - dy[i]) * (x[i] - dy[i]);
+        }
+
+        hnswlib::DISTFUNC<float> distfunc = space.get_dist_func();
+        void *param = space.get_dist_func_param();
+        assert(std::fabs(distfunc(rx.data(), ry.data(), param) - sym) < 1e-3);
+        assert(std::fabs(distfunc(q.data(), ry.data(), param) - asym) < 1e-3);
+        assert(distfunc(rx.data(), rx.data(), param) < 1e-4);
+    }
+}
+
+template<typename SQ8Space, typename FloatSpace>
+void testRecall() {
+    int d = 32;
+    idx_t n = 2000;
+    idx_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib(-1, 1);
+
+    for (idx_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    SQ8Space space(d);
+    FloatSpace float_space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+    std::vector<char> record(space.get_data_size());
+    for (size_t i = 0; i < n; ++i) {
+        space.encode(data.data() + d * i, record.data());
+        alg_hnsw->addPoint(record.data(), i);
+    }
+    alg_hnsw->setEf(100);
+
+    hnswlib::BruteforceSearch<float>* alg_brute = new hnswlib::BruteforceSearch<float>(&float_space, n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_brute->addPoint(data.data() + d * i, i);
+    }
+
+    // queries have their own record format
+    std::vector<char> query_records(nq * space.get_query_size());
+    for (size_t j = 0; j < nq; ++j) {
+        space.encodeQuery(query.data() + d * j, query_records.data() + j * space.get_query_size());
+    }
+    std::vector<idx_t> labels(nq * k);
+    std::vector<float> distances(nq * k);
+    alg_hnsw->searchKnnBatch(query_records.data(), nq, k, labels.data(), distances.data());
+
+    size_t correct = 0, correct_reranked = 0;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + d * j;
+        const char* p_record = query_records.data() + j * space.get_query_size();
+        auto gd = alg_brute->searchKnn(p, k);
+        std::unordered_set<idx_t> expected;
+        while (!gd.empty()) {
+            expected.insert(gd.top().second);
+            gd.pop();
+        }
+
+        auto res = alg_hnsw->searchKnnCloserFirst(p_record, k);
+        assert(res.size() == k);
+        for (size_t t = 0; t < k; t++) {
+            assert(res[t].second == labels[j * k + t]);
+            if (expected.count(res[t].second)) correct++;
+        }
+
+        auto reranked = alg_hnsw->searchKnnReranked<float>(p_record, k, 4 * k, p, &float_space,
+            [&](idx_t label) { return (const void*) (data.data() + d * label); });
+        assert(reranked.size() == k);
+        for (size_t t = 0; t < k; t++) {
+            if (t > 0) assert(reranked[t - 1].first <= reranked[t].first);
+            if (expected.count(reranked[t].second)) correct_reranked++;
+        }
+    }
+    float recall = (float) correct / (nq * k);
+    float recall_reranked = (float) correct_reranked / (nq * k);
+    std::cout << "Recall: " << recall << ", with reranking: " << recall_reranked << std::endl;
+    assert(recall > 0.85);
+    assert(recall_reranked > 0.97);
+    assert(recall_reranked >= recall);
+
+    delete alg_hnsw;
+    delete alg_brute;
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testKernels();
+    testRecall<hnswlib::SQ8L2Space, hnswlib::L2Space>();
+    testRecall<hnswlib::SQ8InnerProductSpace, hnswlib::InnerProductSpace>();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
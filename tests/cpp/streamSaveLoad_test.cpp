@@ -0,0 +1,191 @@
+// This is a test file for testing the interfaces
+//  >>> void saveIndex(IndexSink &sink, StreamProgress progress, size_t chunk_size);
+//  >>> void loadIndex(IndexSource &source, SpaceInterface<dist_t> *s, size_t max_elements_i,
+//  >>>                StreamProgress progress, size_t chunk_size);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+std::vector<char> readFile(const std::string &location) {
+    std::ifstream input(location, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+// Memory sink that can only append, as a pipe
+class AppendOnlySink : public hnswlib::MemorySink {
+ public:
+    AppendOnlySink(std::vector<char> &buffer) : hnswlib::MemorySink(buffer) {}
+
+    bool seekable() const {
+        return false;
+    }
+};
+
+void checkSameIndex(hnswlib::HierarchicalNSW<float>* expected, hnswlib::HierarchicalNSW<float>* actual) {
+    assert(actual->cur_element_count == expected->cur_element_count);
+    assert(actual->maxlevel_ == expected->maxlevel_);
+    assert(actual->enterpoint_node_ == expected->enterpoint_node_);
+    assert(actual->getDeletedCount() == expected->getDeletedCount());
+    for (size_t i = 0; i < expected->cur_element_count; i++) {
+        assert(memcmp(actual->get_linklist0(i), expected->get_linklist0(i), expected->size_links_level0_) == 0);
+        assert(memcmp(actual->getDataByInternalId(i), expected->getDataByInternalId(i), expected->data_size_) == 0);
+        assert(actual->getExternalLabel(i) == expected->getExternalLabel(i));
+        assert(actual->element_levels_[i] == expected->element_levels_[i]);
+        if (expected->element_levels_[i] > 0) {
+            assert(memcmp(actual->linkLists_[i], expected->linkLists_[i],
+                          expected->size_links_per_element_ * expected->element_levels_[i]) == 0);
+        }
+    }
+}
+
+bool throwsOnLoad(const std::vector<char> &buffer, hnswlib::SpaceInterface<float> *space) {
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(space);
+    hnswlib::MemorySource source(buffer);
+    bool thrown = false;
+    try {
+        alg_hnsw->loadIndex(source, space);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    delete alg_hnsw;
+    return thrown;
+}
+
+void test() {
+    int d = 16;
+    size_t n = 3000;
+    size_t chunk_size = 64 * 1024;
+    std::string path = "stream_index.bin";
+    std::string direct_path = "stream_index_direct.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, 2 * n);
+    for (size_t i = 0; i < n; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    for (size_t i = 0; i < n; i += 10) {
+        alg_hnsw->markDelete(i);
+    }
+
+    // the streamed format is the format of the file
+    std::vector<char> buffer;
+    hnswlib::MemorySink sink(buffer);
+    size_t last_done = 0;
+    size_t num_reports = 0;
+    alg_hnsw->saveIndex(sink, [&](size_t done, size_t total) {
+        assert(total == alg_hnsw->indexFileSize());
+        assert(done > last_done && done <= total);
+        last_done = done;
+        num_reports++;
+        return true;
+    }, chunk_size);
+    assert(buffer.size() == alg_hnsw->indexFileSize());
+    assert(last_done == buffer.size());
+    assert(num_reports == (buffer.size() + chunk_size - 1) / chunk_size);
+    alg_hnsw->saveIndex(path);
+    assert(readFile(path) == buffer);
+
+    // a sink that cannot seek gets the same bytes, the checksums are then computed before the header is written
+    std::vector<char> appended;
+    AppendOnlySink append_sink(appended);
+    alg_hnsw->saveIndex(append_sink, nullptr, chunk_size);
+    assert(appended == buffer);
+
+    // direct I/O falls back to the page cache where the file system does not support it
+    hnswlib::FileSink direct_sink(direct_path, true);
+    alg_hnsw->saveIndex(direct_sink, nullptr, chunk_size);
+    assert(readFile(direct_path) == buffer);
+
+    hnswlib::HierarchicalNSW<float>* alg_loaded = new hnswlib::HierarchicalNSW<float>(&space);
+    hnswlib::MemorySource source(buffer);
+    size_t last_read = 0;
+    alg_loaded->loadIndex(source, &space, 0, [&](size_t done, size_t total) {
+        assert(total == buffer.size());
+        assert(done >= last_read && done <= total);
+        last_read = done;
+        return true;
+    }, chunk_size);
+    assert(last_read == buffer.size());
+    assert(alg_loaded->getMaxElements() == 2 * n);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+
+    alg_loaded = new hnswlib::HierarchicalNSW<float>(&space, direct_path);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+
+#if !defined(_WIN32)
+    // a pipe has no size, the index is checked while it is read
+    int fds[2];
+    assert(pipe(fds) == 0);
+    std::thread writer([&]() {
+        hnswlib::FdSink pipe_sink(fds[1]);
+        alg_hnsw->saveIndex(pipe_sink, nullptr, chunk_size);
+        close(fds[1]);
+    });
+    alg_loaded = new hnswlib::HierarchicalNSW<float>(&space);
+    hnswlib::FdSource pipe_source(fds[0]);
+    alg_loaded->loadIndex(pipe_source, &space, 0, nullptr, chunk_size);
+    writer.join();
+    close(fds[0]);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    delete alg_loaded;
+#endif
+
+    // cancelling stops after the chunk
+    std::vector<char> cancelled;
+    hnswlib::MemorySink cancelled_sink(cancelled);
+    bool thrown = false;
+    try {
+        alg_hnsw->saveIndex(cancelled_sink, [](size_t done, size_t total) { return done < total / 2; }, chunk_size);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(cancelled.size() < buffer.size());
+    // the header is only written at the end, the partial index does not look like one
+    assert(std::all_of(cancelled.begin(), cancelled.begin() + 8, [](char c) { return c == 0; }));
+
+    // truncated or extended streams are rejected
+    assert(throwsOnLoad(std::vector<char>(buffer.begin(), buffer.begin() + buffer.size() / 2), &space));
+    assert(throwsOnLoad(std::vector<char>(buffer.begin(), buffer.end() - 1), &space));
+    std::vector<char> extended = buffer;
+    extended.push_back(0);
+    assert(throwsOnLoad(extended, &space));
+    assert(throwsOnLoad(std::vector<char>(), &space));
+
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(direct_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    test();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+// This is a test file for testing the interfaces
+//  >>> void startLog(const std::string &location, const std::string &log_location);
+//  >>> void commitLog();
+//  >>> void compactLog();
+//  >>> void loadIndexWithLog(const std::string &location, const std::string &log_location,
+//  >>>                       SpaceInterface<dist_t> *s, size_t max_elements_i);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+using Index = hnswlib::HierarchicalNSW<float>;
+
+std::vector<char> readFile(const std::string &location) {
+    std::ifstream input(location, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string &location, const std::vector<char> &buffer) {
+    std::ofstream output(location, std::ios::binary);
+    output.write(buffer.data(), buffer.size());
+}
+
+void checkSameIndex(Index* expected, Index* actual) {
+    assert(actual->cur_element_count == expected->cur_element_count);
+    assert(actual->maxlevel_ == expected->maxlevel_);
+    assert(actual->enterpoint_node_ == expected->enterpoint_node_);
+    assert(actual->getDeletedCount() == expected->getDeletedCount());
+    assert(actual->label_lookup_ == expected->label_lookup_);
+    for (size_t i = 0; i < expected->cur_element_count; i++) {
+        // the byte of the spinlock is not compared
+        assert(memcmp(actual->get_linklist0(i), expected->get_linklist0(i), 3) == 0);
+        assert(memcmp(actual->get_linklist0(i) + 1, expected->get_linklist0(i) + 1, expected->size_links_level0_ - 4) == 0);
+        assert(memcmp(actual->getDataByInternalId(i), expected->getDataByInternalId(i), expected->data_size_) == 0);
+        assert(actual->getExternalLabel(i) == expected->getExternalLabel(i));
+        assert(actual->element_levels_[i] == expected->element_levels_[i]);
+        if (expected->element_levels_[i] > 0) {
+            assert(memcmp(actual->linkLists_[i], expected->linkLists_[i],
+                          expected->size_links_per_element_ * expected->element_levels_[i]) == 0);
+        }
+    }
+}
+
+// Copy of the current state of an index
+Index* copyIndex(Index* index, hnswlib::SpaceInterface<float> *space) {
+    std::vector<char> buffer;
+    hnswlib::MemorySink sink(buffer);
+    index->saveIndex(sink);
+    hnswlib::MemorySource source(buffer);
+    Index* copy = new Index(space);
+    copy->loadIndex(source, space);
+    return copy;
+}
+
+void testConcurrentChanges() {
+    int d = 8;
+    size_t n = 4000;
+    size_t num_base = n / 4;
+    size_t num_threads = 4;
+    std::string path = "update_log_index.bin";
+    std::string log_path = "update_log.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(2 * n * d);
+    for (size_t i = 0; i < 2 * n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    hnswlib::L2Space space(d);
+    Index* alg_hnsw = new Index(&space, n / 2);
+    for (size_t i = 0; i < num_base; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->startLog(path, log_path);
+    size_t base_size = readFile(path).size();
+
+    // inserts, updates of even labels and deletes of odd labels from several threads, each thread commits now and then
+    alg_hnsw->resizeIndex(n);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = num_base + t; i < n; i += num_threads) {
+                alg_hnsw->addPoint(data.data() + d * i, i);
+                if (i % 5 == 0)
+                    alg_hnsw->addPoint(data.data() + d * (n + i), (i / 5 * 2) % num_base);
+                if (i % 7 == 0 && i / 7 * 2 + 1 < num_base) {
+                    alg_hnsw->markDelete(i / 7 * 2 + 1);
+                    if (i % 2 == 0)
+                        alg_hnsw->unmarkDelete(i / 7 * 2 + 1);
+                }
+                if (i % 50 == 0)
+                    alg_hnsw->commitLog();
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    alg_hnsw->commitLog();
+    // nothing changed since, the log stays as it is
+    size_t log_size = alg_hnsw->getLogSize();
+    alg_hnsw->commitLog();
+    assert(alg_hnsw->getLogSize() == log_size);
+    assert(readFile(log_path).size() == log_size);
+    assert(readFile(path).size() == base_size);
+    alg_hnsw->stopLog();
+
+    Index* alg_loaded = new Index(&space);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    assert(alg_loaded->getDeletedCount() > 0);
+
+    // the loaded index continues the log
+    Index* expected = copyIndex(alg_loaded, &space);
+    for (size_t i = 0; i < 20; ++i) {
+        alg_loaded->markDelete(n - 1 - i);
+    }
+    alg_loaded->commitLog();
+    Index* expected_next = copyIndex(alg_loaded, &space);
+
+    // a record cut off by a crash is dropped, the log goes on after the last complete record
+    std::vector<char> log = readFile(log_path);
+    delete alg_loaded;
+    writeFile(log_path, std::vector<char>(log.begin(), log.end() - 10));
+    alg_loaded = new Index(&space);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(expected, alg_loaded);
+    assert(readFile(log_path).size() == log_size);
+    for (size_t i = 0; i < 20; ++i) {
+        alg_loaded->markDelete(n - 1 - i);
+    }
+    alg_loaded->stopLog();
+    assert(readFile(log_path) == log);
+    checkSameIndex(expected_next, alg_loaded);
+
+    // compaction writes the state into the base snapshot and empties the log
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(expected_next, alg_loaded);
+    alg_loaded->compactLog();
+    assert(alg_loaded->getLogSize() == Index::LOG_HEADER_SIZE);
+    assert(readFile(log_path).size() == Index::LOG_HEADER_SIZE);
+    delete alg_loaded;
+    alg_loaded = new Index(&space);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(expected_next, alg_loaded);
+
+    // a compaction cut off between its renames leaves the new log in the temporary file
+    std::vector<char> new_log = readFile(log_path);
+    writeFile(log_path + ".tmp", new_log);
+    writeFile(log_path, log);
+    delete alg_loaded;
+    alg_loaded = new Index(&space);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(expected_next, alg_loaded);
+    assert(readFile(log_path) == new_log);
+    delete alg_loaded;
+
+    // the log of another base snapshot is rejected
+    alg_loaded = new Index(&space);
+    bool thrown = false;
+    try {
+        alg_loaded->loadIndexWithLog(path, log_path, &space);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(!thrown);
+    writeFile(log_path, log);
+    try {
+        alg_loaded->loadIndexWithLog(path, log_path, &space);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    delete alg_loaded;
+    delete expected;
+    delete expected_next;
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(log_path.c_str());
+}
+
+void testBackgroundCommits() {
+    int d = 8;
+    size_t n = 1000;
+    std::string path = "update_log_background_index.bin";
+    std::string log_path = "update_log_background.bin";
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+    std::vector<float> data(n * d);
+    for (size_t i = 0; i < n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+
+    // replacing deleted elements changes their labels, which the log records with the vectors
+    hnswlib::L2Space space(d);
+    Index* alg_hnsw = new Index(&space, n / 2, 16, 200, 100, true);
+    for (size_t i = 0; i < n / 4; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i);
+    }
+    alg_hnsw->startLog(path, log_path);
+    alg_hnsw->setLogCommitInterval(5);
+    for (size_t i = 0; i < n / 4; i += 3) {
+        alg_hnsw->markDelete(i);
+    }
+    for (size_t i = n / 4; i < n / 2; ++i) {
+        alg_hnsw->addPoint(data.data() + d * i, i, true);
+        if (i % 50 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(alg_hnsw->getLogSize() > Index::LOG_HEADER_SIZE);
+    alg_hnsw->stopLog();
+
+    Index* alg_loaded = new Index(&space, n / 2, 16, 200, 100, true);
+    alg_loaded->loadIndexWithLog(path, log_path, &space);
+    checkSameIndex(alg_hnsw, alg_loaded);
+    assert(alg_loaded->getDeletedCount() == 0);
+
+    delete alg_loaded;
+    delete alg_hnsw;
+    remove(path.c_str());
+    remove(log_path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    testConcurrentChanges();
+    testBackgroundCommits();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// This is a test file for testing the visited set backends of VisitedList and
+//  >>> void setVisitedSetType(VisitedSetType visited_set_type);
+// of class HierarchicalNSW
+
+#include "../../hnswlib/hnswlib.h"
+
+#include <assert.h>
+
+#include <vector>
+#include <iostream>
+
+namespace {
+
+using idx_t = hnswlib::labeltype;
+
+const hnswlib::VisitedSetType ALL_TYPES[] = {
+    hnswlib::VisitedSetType::DENSE,
+    hnswlib::VisitedSetType::BITSET,
+    hnswlib::VisitedSetType::HASH_SET,
+    hnswlib::VisitedSetType::PAGED
+};
+
+void testVisitedList(hnswlib::VisitedSetType type) {
+    unsigned int n = 100000;
+    std::mt19937 rng;
+    rng.seed(47);
+
+    hnswlib::VisitedList vl(n, type, 16);
+    std::vector<bool> expected(n);
+    // enough resets for the 16-bit tags to wrap around
+    for (int search = 0; search < 70000; search++) {
+        vl.reset();
+        size_t num_visits = search % 1000 == 0 ? 5000 : 20;
+        std::vector<unsigned int> ids;
+        for (size_t i = 0; i < num_visits; i++) {
+            unsigned int id = rng() % n;
+            vl.prefetch(id);
+            assert(vl.visit(id) == !expected[id]);
+            assert(!vl.visit(id));
+            expected[id] = true;
+            ids.push_back(id);
+        }
+        for (unsigned int id : ids) {
+            expected[id] = false;
+        }
+    }
+    std::cout << "Memory of the visited set: " << vl.memoryUsage() << " bytes" << std::endl;
+    if (type == hnswlib::VisitedSetType::HASH_SET || type == hnswlib::VisitedSetType::PAGED) {
+        // the memory follows the size of the last search, not the number of elements
+        assert(vl.memoryUsage() < sizeof(hnswlib::vl_type) * n);
+    }
+}
+
+void testIndex() {
+    int d = 16;
+    idx_t n = 3000;
+    size_t nq = 50;
+    size_t k = 10;
+
+    std::vector<float> data(2 * n * d);
+    std::vector<float> query(nq * d);
+
+    std::mt19937 rng;
+    rng.seed(47);
+    std::uniform_real_distribution<> distrib;
+
+    for (idx_t i = 0; i < 2 * n * d; ++i) {
+        data[i] = distrib(rng);
+    }
+    for (idx_t i = 0; i < nq * d; ++i) {
+        query[i] = distrib(rng);
+    }
+
+    // the visited set does not change the graph or the results
+    hnswlib::L2Space space(d);
+    std::vector<hnswlib::HierarchicalNSW<float>*> indices;
+    for (hnswlib::VisitedSetType type : ALL_TYPES) {
+        hnswlib::HierarchicalNSW<float>* alg_hnsw = new hnswlib::HierarchicalNSW<float>(&space, n);
+        alg_hnsw->setVisitedSetType(type);
+        for (size_t i = 0; i < n; ++i) {
+            alg_hnsw->addPoint(data.data() + d * i, i);
+        }
+        alg_hnsw->resizeIndex(2 * n);
+        for (size_t i = n; i < 2 * n; ++i) {
+            alg_hnsw->addPoint(data.data() + d * i, i);
+        }
+        assert(alg_hnsw->visited_set_type_ == type);
+        alg_hnsw->setEf(100);
+        indices.push_back(alg_hnsw);
+    }
+    hnswlib::HierarchicalNSW<float>::SearchContext ctx;
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        auto expected = indices[0]->searchKnnCloserFirst(p, k);
+        for (hnswlib::HierarchicalNSW<float>* alg_hnsw : indices) {
+            assert(alg_hnsw->searchKnnCloserFirst(p, k) == expected);
+            assert(alg_hnsw->searchKnn(p, k, ctx) == expected);
+            assert(ctx.visited_list->type == alg_hnsw->visited_set_type_);
+        }
+    }
+
+    // the type can be changed on a built index
+    indices[0]->setVisitedSetType(hnswlib::VisitedSetType::HASH_SET);
+    for (size_t j = 0; j < nq; ++j) {
+        const float* p = query.data() + j * d;
+        assert(indices[0]->searchKnnCloserFirst(p, k) == indices[1]->searchKnnCloserFirst(p, k));
+    }
+
+    for (hnswlib::HierarchicalNSW<float>* alg_hnsw : indices) {
+        delete alg_hnsw;
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::cout << "Testing ..." << std::endl;
+    for (hnswlib::VisitedSetType type : ALL_TYPES) {
+        testVisitedList(type);
+    }
+    testIndex();
+    std::cout << "Test ok" << std::endl;
+
+    return 0;
+}